@@ -1,68 +1,556 @@
 #include <stdint.h>
 #include "kernel_base.h" // Funcoes putc() para log
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Async/async.h" // Sequencia de inicializacao sem pilha
+#include "../../Kernel/Lib/kformat.h"
 
-// Enderecos de I/O Simulados para um Controlador Bluetooth UART/USB (Abstrato)
-// Em um OS real, voce mapearia a memoria ou usaria drivers USB.
-#define BT_COMMAND_PORT 0x4000 // Porta para enviar comandos HCI
-#define BT_STATUS_PORT  0x4001 // Porta para ler o status do chip
-#define BT_DATA_PORT    0x4002 // Porta para enviar/receber dados
+// =======================================================
+// 1. TRANSPORTE H4 (UART)
+// =======================================================
+
+// O controlador Bluetooth fica do outro lado de uma UART 16550 (COM2).
+// No QEMU: -serial null -serial tcp:127.0.0.1:4555 (ver hci_controller_emu.c)
+#define BT_UART_BASE        0x2F8
+#define BT_UART_DIVISOR     1     // 115200 baud (115200 / divisor)
+#define BT_UART_IRQ         3     // COM2
+
+#define UART_REG_DATA       0     // RBR (leitura) / THR (escrita)
+#define UART_REG_IER        1     // Habilitacao de Interrupcoes
+#define UART_REG_IIR_FCR    2     // IIR (leitura) / FCR (escrita)
+#define UART_REG_LCR        3     // Controle de Linha
+#define UART_REG_MCR        4     // Controle de Modem
+#define UART_REG_LSR        5     // Status de Linha
+
+#define UART_IER_RX_DATA    0x01
+#define UART_IER_THR_EMPTY  0x02
+#define UART_LSR_DATA_READY 0x01
+#define UART_LSR_THR_EMPTY  0x20
+#define UART_IIR_NO_IRQ     0x01
+#define UART_FIFO_DEPTH     16    // FIFO de transmissao do 16550A
+
+// Indicadores de tipo de pacote do protocolo H4 (primeiro byte de cada pacote)
+#define H4_TYPE_COMMAND     0x01
+#define H4_TYPE_ACL         0x02
+#define H4_TYPE_SCO         0x03
+#define H4_TYPE_EVENT       0x04
 
 // Comandos HCI Essenciais (Códigos de Operação)
 #define HCI_RESET_OPCODE            0x0C03 // Comando para reiniciar o chip
 #define HCI_READ_BD_ADDR_OPCODE     0x1009 // Comando para ler o endereço MAC do chip (BD_ADDR)
 
+// Eventos HCI usados pelo controle de fluxo de comandos
+#define HCI_EVT_COMMAND_COMPLETE    0x0E
+#define HCI_EVT_COMMAND_STATUS      0x0F
+
+#define HCI_MAX_PARAM_LEN   255
+#define HCI_CMD_QUEUE_SIZE  32    // Potencia de 2 (indices com mascara)
+#define HCI_MAX_IN_FLIGHT   16
+#define BT_TX_RING_SIZE     1024  // Potencia de 2
+#define BT_CMD_TIMEOUT_TICKS 200  // 2s (ticks de 10ms) para cada resposta na inicializacao
+
 // Presume funcoes outb/inb para I/O de baixo nivel (em Assembly)
 extern void outb(uint16_t port, uint8_t value);
 extern uint8_t inb(uint16_t port);
 extern void putc(char c, int row, int col, char color);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern int apic_register_irq(uint8_t irq, void (*handler)()); // Do apic.c
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+extern uint64_t read_tsc(); // Do cpu_diag.c
+
+/**
+ * Callback chamado quando o controlador responde a um comando
+ * (Command Complete ou Command Status).
+ * @param status Codigo de status HCI (0x00 = sucesso).
+ * @param ret Parametros de retorno (apos o status), ou 0 no Command Status.
+ */
+typedef void (*hci_callback_t)(uint16_t opcode, uint8_t status,
+                               const uint8_t *ret, uint8_t ret_len, void *ctx);
 
+// Um comando aguardando credito (fila) ou aguardando resposta (em voo)
+typedef struct {
+    uint16_t opcode;
+    uint8_t param_len;
+    uint8_t params[HCI_MAX_PARAM_LEN];
+    hci_callback_t callback;
+    void *ctx;
+    uint64_t submit_tsc; // Para medir a latencia de ida e volta
+} HCICommand;
+
+// Fila de comandos ainda nao enviados (esperando creditos do controlador)
+static HCICommand cmd_queue[HCI_CMD_QUEUE_SIZE];
+static uint32_t cmd_queue_head = 0;
+static uint32_t cmd_queue_tail = 0;
+
+// Comandos enviados que ainda nao receberam Command Complete/Status
+static HCICommand in_flight[HCI_MAX_IN_FLIGHT];
+static int in_flight_used[HCI_MAX_IN_FLIGHT];
+
+// Num_HCI_Command_Packets: o host pode enviar 1 comando antes do primeiro evento
+static uint8_t hci_credits = 1;
+
+// Fila, creditos, slots em voo e o lado de escrita do anel de transmissao sao
+// mexidos pelos processos (hci_submit_command) e pela interrupcao da UART
+static spinlock_t hci_lock = SPINLOCK_INIT;
+
+// Anel de transmissao esvaziado pela interrupcao THR-Empty
+static uint8_t tx_ring[BT_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+// Estatisticas (usadas pelo benchmark de vazao/latencia)
+static uint32_t stat_sent = 0;
+static uint32_t stat_completed = 0;
+static uint64_t stat_latency_total = 0;
+static uint64_t stat_latency_max = 0;
 
 /**
- * Envia um comando HCI para o Controlador Bluetooth.
- * (Simplificado: apenas envia o opcode)
+ * Inicializa a UART: 8N1, FIFOs habilitados, interrupcoes de RX e TX.
+ */
+static void bt_uart_init() {
+    outb(BT_UART_BASE + UART_REG_IER, 0x00);               // Desliga interrupcoes
+    outb(BT_UART_BASE + UART_REG_LCR, 0x80);               // DLAB = 1
+    outb(BT_UART_BASE + UART_REG_DATA, BT_UART_DIVISOR & 0xFF);
+    outb(BT_UART_BASE + UART_REG_IER, BT_UART_DIVISOR >> 8);
+    outb(BT_UART_BASE + UART_REG_LCR, 0x03);               // 8 bits, sem paridade, 1 stop
+    outb(BT_UART_BASE + UART_REG_IIR_FCR, 0xC7);           // FIFO on, limpa, gatilho 14 bytes
+    outb(BT_UART_BASE + UART_REG_MCR, 0x0B);               // DTR, RTS, OUT2 (liga IRQ)
+    outb(BT_UART_BASE + UART_REG_IER, UART_IER_RX_DATA | UART_IER_THR_EMPTY);
+}
+
+/**
+ * Move bytes do anel de transmissao para o FIFO da UART.
+ * Chamada quando um pacote e enfileirado e na interrupcao THR-Empty, com hci_lock.
+ */
+static void bt_uart_kick_tx() {
+    if (!(inb(BT_UART_BASE + UART_REG_LSR) & UART_LSR_THR_EMPTY)) return;
+
+    // Com o THR vazio, o FIFO inteiro aceita uma rajada sem checar o LSR
+    for (int i = 0; i < UART_FIFO_DEPTH && tx_tail != tx_head; i++) {
+        outb(BT_UART_BASE + UART_REG_DATA, tx_ring[tx_tail]);
+        tx_tail = (tx_tail + 1) & (BT_TX_RING_SIZE - 1);
+    }
+}
+
+static uint32_t bt_tx_space() {
+    return (tx_tail - tx_head - 1) & (BT_TX_RING_SIZE - 1);
+}
+
+static void bt_tx_put(uint8_t byte) {
+    tx_ring[tx_head] = byte;
+    tx_head = (tx_head + 1) & (BT_TX_RING_SIZE - 1);
+}
+
+// =======================================================
+// 2. FILA DE COMANDOS COM CREDITOS
+// =======================================================
+
+/**
+ * Serializa um comando no formato H4:
+ * [0x01][opcode LSB][opcode MSB][param_len][params...]
+ * @return 0 em caso de sucesso, -1 se nao houver espaco.
+ */
+static int hci_transmit(HCICommand *cmd) {
+    int slot;
+    for (slot = 0; slot < HCI_MAX_IN_FLIGHT; slot++) {
+        if (!in_flight_used[slot]) break;
+    }
+    if (slot == HCI_MAX_IN_FLIGHT || bt_tx_space() < 4u + cmd->param_len) return -1;
+
+    bt_tx_put(H4_TYPE_COMMAND);
+    bt_tx_put((uint8_t)(cmd->opcode & 0xFF));
+    bt_tx_put((uint8_t)(cmd->opcode >> 8));
+    bt_tx_put(cmd->param_len);
+    for (int i = 0; i < cmd->param_len; i++) {
+        bt_tx_put(cmd->params[i]);
+    }
+
+    in_flight[slot] = *cmd;
+    in_flight[slot].submit_tsc = read_tsc();
+    in_flight_used[slot] = 1;
+    stat_sent++;
+    return 0;
+}
+
+/**
+ * Envia comandos da fila enquanto o controlador der creditos. Chamar com hci_lock.
+ */
+static void hci_pump_queue() {
+    while (hci_credits > 0 && cmd_queue_tail != cmd_queue_head) {
+        HCICommand *cmd = &cmd_queue[cmd_queue_tail & (HCI_CMD_QUEUE_SIZE - 1)];
+        if (hci_transmit(cmd) != 0) break; // Sem espaco: tenta de novo no proximo evento
+        cmd_queue_tail++;
+        hci_credits--;
+    }
+    bt_uart_kick_tx();
+}
+
+/**
+ * Enfileira um comando HCI. Nao bloqueia: a resposta chega pelo callback,
+ * a partir da interrupcao da UART.
+ * @param params Parametros do comando (ja no formato little-endian do HCI).
+ * @return 0 em caso de sucesso, -1 se a fila estiver cheia.
+ */
+int hci_submit_command(uint16_t opcode, const uint8_t *params, uint8_t param_len,
+                       hci_callback_t callback, void *ctx) {
+    uint32_t flags = spin_lock_irqsave(&hci_lock);
+    if (cmd_queue_head - cmd_queue_tail == HCI_CMD_QUEUE_SIZE) {
+        spin_unlock_irqrestore(&hci_lock, flags);
+        return -1;
+    }
+
+    HCICommand *cmd = &cmd_queue[cmd_queue_head & (HCI_CMD_QUEUE_SIZE - 1)];
+    cmd->opcode = opcode;
+    cmd->param_len = param_len;
+    for (int i = 0; i < param_len; i++) {
+        cmd->params[i] = params[i];
+    }
+    cmd->callback = callback;
+    cmd->ctx = ctx;
+    cmd_queue_head++;
+
+    hci_pump_queue();
+    spin_unlock_irqrestore(&hci_lock, flags);
+    return 0;
+}
+
+/**
+ * Envia um comando HCI para o Controlador Bluetooth (sem parametros e sem callback).
  */
 void send_hci_command(uint16_t opcode) {
     // 1. Loga a acao
     putc('B', 25, 0, 0x05); // 'B' (Roxo)
     putc('T', 25, 1, 0x05);
     putc(':', 25, 2, 0x05);
-    
-    // 2. Envia o opcode (parte baixa e parte alta) para a porta de comando simulada
-    // (Em um driver real, o pacote HCI seria muito mais complexo)
-    outb(BT_COMMAND_PORT, (uint8_t)(opcode & 0xFF));
-    outb(BT_COMMAND_PORT, (uint8_t)(opcode >> 8));
+
+    // 2. Enfileira o pacote HCI completo
+    hci_submit_command(opcode, 0, 0, 0, 0);
 }
 
 /**
- * Funcao para simular a leitura do status do chip apos um comando.
+ * Esquece o callback de todos os comandos (na fila ou em voo) com este 'ctx'.
+ * Usado quando o dono desiste de esperar (prazo esgotado) e vai liberar o ctx.
+ */
+void hci_cancel_callbacks(void *ctx) {
+    uint32_t flags = spin_lock_irqsave(&hci_lock); // A resposta chega pela interrupcao da UART
+    for (uint32_t i = cmd_queue_tail; i != cmd_queue_head; i++) {
+        HCICommand *cmd = &cmd_queue[i & (HCI_CMD_QUEUE_SIZE - 1)];
+        if (cmd->ctx == ctx) cmd->callback = 0;
+    }
+    for (int slot = 0; slot < HCI_MAX_IN_FLIGHT; slot++) {
+        if (in_flight_used[slot] && in_flight[slot].ctx == ctx) in_flight[slot].callback = 0;
+    }
+    spin_unlock_irqrestore(&hci_lock, flags);
+}
+
+/**
+ * Entrega a resposta ao dono do comando e atualiza os creditos.
+ * O callback roda fora de hci_lock (ele pode enfileirar outro comando).
+ */
+static void hci_complete_command(uint8_t num_packets, uint16_t opcode, uint8_t status,
+                                 const uint8_t *ret, uint8_t ret_len) {
+    hci_callback_t callback = 0;
+    void *ctx = 0;
+
+    uint32_t flags = spin_lock_irqsave(&hci_lock);
+    // O controlador informa o valor absoluto de creditos disponiveis
+    hci_credits = num_packets;
+
+    // Opcode 0x0000 (NOP) apenas devolve creditos
+    if (opcode != 0x0000) {
+        // O controlador responde na ordem de envio: com varios comandos do
+        // mesmo opcode em voo, a resposta e do mais antigo
+        int oldest = -1;
+        for (int slot = 0; slot < HCI_MAX_IN_FLIGHT; slot++) {
+            if (!in_flight_used[slot] || in_flight[slot].opcode != opcode) continue;
+            if (oldest < 0 || in_flight[slot].submit_tsc < in_flight[oldest].submit_tsc) oldest = slot;
+        }
+
+        if (oldest >= 0) {
+            uint64_t latency = read_tsc() - in_flight[oldest].submit_tsc;
+            stat_latency_total += latency;
+            if (latency > stat_latency_max) stat_latency_max = latency;
+            stat_completed++;
+
+            in_flight_used[oldest] = 0;
+            callback = in_flight[oldest].callback;
+            ctx = in_flight[oldest].ctx;
+        }
+    }
+
+    hci_pump_queue();
+    spin_unlock_irqrestore(&hci_lock, flags);
+
+    if (callback) callback(opcode, status, ret, ret_len, ctx);
+}
+
+// =======================================================
+// 3. RECEPCAO E PARSER DE EVENTOS
+// =======================================================
+
+// Estados do parser H4 (um byte de cada vez, direto da interrupcao)
+#define RX_WAIT_TYPE    0
+#define RX_HEADER       1
+#define RX_PAYLOAD      2
+
+static int rx_state = RX_WAIT_TYPE;
+static uint8_t rx_type = 0;
+static uint8_t rx_header[4];
+static int rx_header_len = 0;
+static int rx_header_needed = 0;
+static uint8_t rx_payload[HCI_MAX_PARAM_LEN];
+static uint16_t rx_payload_len = 0;
+static uint16_t rx_payload_needed = 0;
+
+/**
+ * Processa um evento HCI completo.
+ */
+static void hci_handle_event(uint8_t event_code, const uint8_t *p, uint8_t len) {
+    if (event_code == HCI_EVT_COMMAND_COMPLETE && len >= 3) {
+        // [Num_HCI_Command_Packets][Opcode (2)][Return_Parameters...]
+        uint16_t opcode = (uint16_t)(p[1] | (p[2] << 8));
+        uint8_t status = (len > 3) ? p[3] : 0x00;
+        const uint8_t *ret = (len > 4) ? &p[4] : 0;
+        hci_complete_command(p[0], opcode, status, ret, (uint8_t)(len > 4 ? len - 4 : 0));
+    } else if (event_code == HCI_EVT_COMMAND_STATUS && len >= 4) {
+        // [Status][Num_HCI_Command_Packets][Opcode (2)]
+        hci_complete_command(p[1], (uint16_t)(p[2] | (p[3] << 8)), p[0], 0, 0);
+    }
+    // Outros eventos (conexao, inquiry...) serao tratados pelas camadas superiores
+}
+
+/**
+ * Alimenta o parser H4 com um byte recebido.
+ * Pacotes ACL/SCO sao lidos pelo tamanho e descartados (ainda sem L2CAP).
+ */
+static void h4_rx_byte(uint8_t byte) {
+    switch (rx_state) {
+    case RX_WAIT_TYPE:
+        rx_type = byte;
+        rx_header_len = 0;
+        if (byte == H4_TYPE_EVENT) rx_header_needed = 2;      // Codigo + tamanho
+        else if (byte == H4_TYPE_ACL) rx_header_needed = 4;   // Handle (2) + tamanho (2)
+        else if (byte == H4_TYPE_SCO) rx_header_needed = 3;   // Handle (2) + tamanho (1)
+        else return; // Lixo na linha: espera o proximo indicador
+        rx_state = RX_HEADER;
+        break;
+
+    case RX_HEADER:
+        rx_header[rx_header_len++] = byte;
+        if (rx_header_len < rx_header_needed) break;
+
+        if (rx_type == H4_TYPE_EVENT) rx_payload_needed = rx_header[1];
+        else if (rx_type == H4_TYPE_ACL) rx_payload_needed = (uint16_t)(rx_header[2] | (rx_header[3] << 8));
+        else rx_payload_needed = rx_header[2];
+
+        rx_payload_len = 0;
+        rx_state = RX_PAYLOAD;
+        if (rx_payload_needed == 0) {
+            if (rx_type == H4_TYPE_EVENT) hci_handle_event(rx_header[0], rx_payload, 0);
+            rx_state = RX_WAIT_TYPE;
+        }
+        break;
+
+    case RX_PAYLOAD:
+        if (rx_payload_len < HCI_MAX_PARAM_LEN) rx_payload[rx_payload_len] = byte;
+        rx_payload_len++;
+        if (rx_payload_len < rx_payload_needed) break;
+
+        if (rx_type == H4_TYPE_EVENT) {
+            hci_handle_event(rx_header[0], rx_payload, (uint8_t)rx_payload_needed);
+        }
+        rx_state = RX_WAIT_TYPE;
+        break;
+    }
+}
+
+/**
+ * Rotina chamada pela interrupcao da UART do Bluetooth (IRQ3, COM2).
+ */
+void bt_uart_interrupt_handler() {
+    // Atende todas as causas pendentes antes de retornar
+    while (!(inb(BT_UART_BASE + UART_REG_IIR_FCR) & UART_IIR_NO_IRQ)) {
+        while (inb(BT_UART_BASE + UART_REG_LSR) & UART_LSR_DATA_READY) {
+            h4_rx_byte(inb(BT_UART_BASE + UART_REG_DATA));
+        }
+        uint32_t flags = spin_lock_irqsave(&hci_lock);
+        bt_uart_kick_tx();
+        spin_unlock_irqrestore(&hci_lock, flags);
+    }
+}
+
+/**
+ * Funcao para ler o status do chip: 0xFF quando o transporte esta ocioso
+ * (nenhum comando na fila ou em voo).
  */
 uint8_t read_bt_status() {
-    // Le a porta de status. Retorna 0xFF se o chip estiver pronto (simulado)
-    return inb(BT_STATUS_PORT);
+    return (cmd_queue_head == cmd_queue_tail && stat_sent == stat_completed) ? 0xFF : 0x00;
+}
+
+// =======================================================
+// 4. BENCHMARK (Vazao e Latencia contra o emulador)
+// =======================================================
+
+static int bench_target = 0;
+static uint64_t bench_start_tsc = 0;
+
+/**
+ * Escreve um numero decimal na tela.
+ * @return Quantidade de digitos escritos.
+ */
+static int bt_print_u64(uint64_t value, int row, int col, char color) {
+    char buffer[21];
+    char *text = u64_to_str(value, buffer, 21);
+    ui_draw_string(text, row, col, color);
+    return (int)(buffer + 20 - text);
+}
+
+static void bench_on_complete(uint16_t opcode, uint8_t status, const uint8_t *ret,
+                              uint8_t ret_len, void *ctx) {
+    (void)opcode; (void)status; (void)ret; (void)ret_len; (void)ctx;
+    if ((int)stat_completed < bench_target) return;
+
+    // Linha 25: "HCI <cmds> cmd em <ciclos> cic, lat media <x> max <y>"
+    uint64_t elapsed = read_tsc() - bench_start_tsc;
+    int col = 0;
+    const char *label = "HCI bench ciclos/cmd:";
+    for (int i = 0; label[i] != '\0'; i++) putc(label[i], 25, col++, 0x0B);
+    col += bt_print_u64(elapsed / stat_completed, 25, col + 1, 0x0F) + 2;
+    const char *lat = "lat media/max:";
+    for (int i = 0; lat[i] != '\0'; i++) putc(lat[i], 25, col++, 0x0B);
+    col += bt_print_u64(stat_latency_total / stat_completed, 25, col + 1, 0x0F) + 2;
+    bt_print_u64(stat_latency_max, 25, col, 0x0F);
+}
+
+/**
+ * Dispara 'count' comandos Read_BD_ADDR de uma vez e mede a vazao e a
+ * latencia media/maxima. Os comandos ficam na fila e saem conforme os creditos.
+ */
+void bt_hci_benchmark(int count) {
+    uint32_t flags = spin_lock_irqsave(&hci_lock);
+    stat_sent = stat_completed = 0;
+    stat_latency_total = stat_latency_max = 0;
+    bench_target = count;
+    bench_start_tsc = read_tsc();
+    spin_unlock_irqrestore(&hci_lock, flags);
+
+    for (int i = 0; i < count; i++) {
+        if (hci_submit_command(HCI_READ_BD_ADDR_OPCODE, 0, 0, bench_on_complete, 0) != 0) {
+            bench_target = i; // Fila cheia: mede apenas o que entrou
+            break;
+        }
+    }
+}
+
+// =======================================================
+// 5. INICIALIZACAO
+// =======================================================
+
+// Quadro da sequencia Reset -> Read_BD_ADDR (vive no heap, nao numa pilha)
+typedef struct {
+    async_task_t task;
+    async_event_t reply;    // Sinalizado pelo callback do comando
+    uint8_t status;
+    uint8_t ret_len;
+    uint8_t ret[6];
+} BtInitFrame;
+
+/**
+ * Callback generico: guarda a resposta no quadro e retoma a tarefa.
+ * Roda dentro da interrupcao da UART.
+ */
+static void bt_async_reply(uint16_t opcode, uint8_t status, const uint8_t *ret,
+                           uint8_t ret_len, void *ctx) {
+    (void)opcode;
+    BtInitFrame *f = (BtInitFrame*)ctx;
+    f->status = status;
+    f->ret_len = (ret_len > 6) ? 6 : ret_len;
+    for (int i = 0; i < f->ret_len; i++) f->ret[i] = ret[i];
+    async_signal(&f->reply);
+}
+
+static void bt_show_bd_addr(const uint8_t *addr) {
+    // BD_ADDR chega em little-endian; exibe como XX:XX:XX:XX:XX:XX
+    const char *hex = "0123456789ABCDEF";
+    putc('M', 25, 7, 0x0A); // 'M' - MAC recebido
+    for (int i = 0; i < 6; i++) {
+        uint8_t b = addr[5 - i];
+        putc(hex[b >> 4], 25, 9 + i * 3, 0x0F);
+        putc(hex[b & 0x0F], 25, 10 + i * 3, 0x0F);
+        if (i < 5) putc(':', 25, 11 + i * 3, 0x07);
+    }
+}
+
+static int bt_init_task(async_task_t *t) {
+    BtInitFrame *f = (BtInitFrame*)t;
+    ASYNC_BEGIN(t);
+
+    // 1. Reset (o primeiro passo para qualquer chip de hardware)
+    if (hci_submit_command(HCI_RESET_OPCODE, 0, 0, bt_async_reply, f) != 0) ASYNC_EXIT(t, -1);
+    ASYNC_AWAIT(t, &f->reply, BT_CMD_TIMEOUT_TICKS);
+    if (t->result == ASYNC_TIMEOUT || f->status != 0x00) {
+        putc('E', 25, 5, 0x0C); // 'E' (Vermelho) - Erro de Reset
+        ASYNC_EXIT(t, -1);
+    }
+    putc('R', 25, 5, 0x0A); // 'R' (Verde) - Reset Sucedido
+
+    // 2. Com o chip pronto, pede o Endereco MAC (BD_ADDR)
+    if (hci_submit_command(HCI_READ_BD_ADDR_OPCODE, 0, 0, bt_async_reply, f) != 0) ASYNC_EXIT(t, -1);
+    ASYNC_AWAIT(t, &f->reply, BT_CMD_TIMEOUT_TICKS);
+    if (t->result == ASYNC_TIMEOUT || f->status != 0x00 || f->ret_len < 6) {
+        putc('E', 25, 7, 0x0C); // 'E' (Vermelho) - Erro ao ler o MAC
+        ASYNC_EXIT(t, -1);
+    }
+    bt_show_bd_addr(f->ret);
+
+    ASYNC_EXIT(t, 0);
+    ASYNC_END(t);
+}
+
+// Ao terminar (com sucesso ou nao), nenhum comando pode mais apontar para o quadro
+static void bt_init_done(async_task_t *t) {
+    hci_cancel_callbacks(t);
+}
+
+/**
+ * Retomada da hibernacao: a UART voltou sem configuracao e o pino da IRQ3
+ * sem rota. Um pacote que chegava pela metade antes de desligar nao volta.
+ */
+static void bt_resume() {
+    bt_uart_init();
+    apic_register_irq(BT_UART_IRQ, bt_uart_interrupt_handler);
+    rx_state = RX_WAIT_TYPE;
+
+    // O que ficou no anel de transmissao sai agora
+    uint32_t flags = spin_lock_irqsave(&hci_lock);
+    bt_uart_kick_tx();
+    spin_unlock_irqrestore(&hci_lock, flags);
 }
 
 /**
  * Funcao de inicializacao do Driver Bluetooth (Chamada pelo Kernel).
  */
 void init_bluetooth_driver() {
-    
+
     // Log de inicializacao
-    const char *status_msg = "Driver Bluetooth Inicializando (HCI)";
+    const char *status_msg = "Driver Bluetooth Inicializando (HCI/H4)";
     for (int i = 0; status_msg[i] != '\0'; i++) {
         putc(status_msg[i], 23, i, 0x0B); // Azul Claro
     }
 
-    // 1. Enviar Comando de Reset (O primeiro passo para qualquer chip de hardware)
-    send_hci_command(HCI_RESET_OPCODE);
-    
-    // 2. Checar Status (Simulacao de espera pelo chip ficar pronto)
-    if (read_bt_status() == 0xFF) {
-        putc('R', 25, 5, 0x0A); // 'R' (Verde) - Reset Sucedido
-        
-        // 3. Enviar Comando para obter o Endereco MAC (BD_ADDR)
-        send_hci_command(HCI_READ_BD_ADDR_OPCODE);
-        putc('M', 25, 7, 0x0A); // 'M' - Solicitado MAC
-    } else {
-        putc('E', 25, 5, 0x0C); // 'E' (Vermelho) - Erro de Reset
+    bt_uart_init();
+    hibernate_register_resume(bt_resume); // A UART perde a configuracao
+    apic_register_irq(BT_UART_IRQ, bt_uart_interrupt_handler);
+
+    // Reset e leitura do BD_ADDR correm como uma tarefa assincrona,
+    // sem espera ativa aqui e sem um processo so para isso.
+    putc('B', 25, 0, 0x05); // 'B' (Roxo)
+    putc('T', 25, 1, 0x05);
+    putc(':', 25, 2, 0x05);
+    async_task_t *t = async_alloc(bt_init_task, sizeof(BtInitFrame));
+    if (!t) {
+        putc('E', 25, 5, 0x0C);
+        return;
     }
+    t->done = bt_init_done;
+    async_start(t);
 }
@@ -0,0 +1,158 @@
+// hci_controller_emu.c - Emulador de controlador Bluetooth HCI (roda no HOST, nao no Core-Blip).
+//
+// Fica do outro lado da porta serial do QEMU e responde aos comandos H4 do
+// bluetooth_driver.c, permitindo medir vazao e latencia da fila de comandos.
+//
+// Compilar:  cc -O2 -o hci_emu hci_controller_emu.c
+// Usar:      ./hci_emu 4555 [creditos] [atraso_us]
+//            qemu-system-i386 ... -serial null -serial tcp:127.0.0.1:4555
+//
+// 'creditos' e o Num_HCI_Command_Packets anunciado em cada evento (padrao 4).
+// 'atraso_us' simula o tempo de processamento do chip por comando (padrao 0).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define H4_TYPE_COMMAND     0x01
+#define H4_TYPE_EVENT       0x04
+
+#define HCI_EVT_COMMAND_COMPLETE    0x0E
+#define HCI_EVT_COMMAND_STATUS      0x0F
+
+#define HCI_RESET_OPCODE                0x0C03
+#define HCI_READ_LOCAL_VERSION_OPCODE   0x1001
+#define HCI_READ_BD_ADDR_OPCODE         0x1009
+
+#define HCI_STATUS_SUCCESS          0x00
+#define HCI_STATUS_UNKNOWN_COMMAND  0x01
+
+// Endereco fixo do controlador emulado (little-endian no fio: 00:1B:DC:C0:B1:1D)
+static const uint8_t emu_bd_addr[6] = { 0x1D, 0xB1, 0xC0, 0xDC, 0x1B, 0x00 };
+
+static int read_exact(int fd, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, buf, len);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int write_exact(int fd, const uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n <= 0) return -1;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_command_complete(int fd, uint8_t credits, uint16_t opcode,
+                                 const uint8_t *ret, uint8_t ret_len) {
+    uint8_t pkt[3 + 3 + 255];
+    pkt[0] = H4_TYPE_EVENT;
+    pkt[1] = HCI_EVT_COMMAND_COMPLETE;
+    pkt[2] = (uint8_t)(3 + ret_len);
+    pkt[3] = credits;
+    pkt[4] = (uint8_t)(opcode & 0xFF);
+    pkt[5] = (uint8_t)(opcode >> 8);
+    memcpy(&pkt[6], ret, ret_len);
+    return write_exact(fd, pkt, 6u + ret_len);
+}
+
+static int send_command_status(int fd, uint8_t credits, uint16_t opcode, uint8_t status) {
+    uint8_t pkt[7] = { H4_TYPE_EVENT, HCI_EVT_COMMAND_STATUS, 4, status, credits,
+                       (uint8_t)(opcode & 0xFF), (uint8_t)(opcode >> 8) };
+    return write_exact(fd, pkt, sizeof(pkt));
+}
+
+/**
+ * Atende uma conexao: le pacotes de comando H4 e responde cada um.
+ */
+static void serve(int fd, uint8_t credits, unsigned delay_us) {
+    unsigned long handled = 0;
+
+    for (;;) {
+        uint8_t type;
+        if (read_exact(fd, &type, 1) != 0) break;
+        if (type != H4_TYPE_COMMAND) continue; // ACL/SCO nao sao emulados
+
+        uint8_t hdr[3];
+        uint8_t params[255];
+        if (read_exact(fd, hdr, 3) != 0) break;
+        if (read_exact(fd, params, hdr[2]) != 0) break;
+
+        uint16_t opcode = (uint16_t)(hdr[0] | (hdr[1] << 8));
+        if (delay_us) usleep(delay_us);
+
+        uint8_t ret[16];
+        int rc;
+        switch (opcode) {
+        case HCI_RESET_OPCODE:
+            ret[0] = HCI_STATUS_SUCCESS;
+            rc = send_command_complete(fd, credits, opcode, ret, 1);
+            break;
+        case HCI_READ_BD_ADDR_OPCODE:
+            ret[0] = HCI_STATUS_SUCCESS;
+            memcpy(&ret[1], emu_bd_addr, 6);
+            rc = send_command_complete(fd, credits, opcode, ret, 7);
+            break;
+        case HCI_READ_LOCAL_VERSION_OPCODE:
+            // Status, HCI 5.0, revisao, LMP 5.0, fabricante 0xFFFF, subversao
+            {
+                const uint8_t v[9] = { HCI_STATUS_SUCCESS, 0x09, 0x00, 0x00, 0x09,
+                                       0xFF, 0xFF, 0x00, 0x00 };
+                memcpy(ret, v, sizeof(v));
+                rc = send_command_complete(fd, credits, opcode, ret, sizeof(v));
+            }
+            break;
+        default:
+            rc = send_command_status(fd, credits, opcode, HCI_STATUS_UNKNOWN_COMMAND);
+            break;
+        }
+        if (rc != 0) break;
+        handled++;
+    }
+
+    fprintf(stderr, "hci_emu: conexao encerrada apos %lu comandos\n", handled);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <porta> [creditos] [atraso_us]\n", argv[0]);
+        return 1;
+    }
+    int port = atoi(argv[1]);
+    uint8_t credits = (uint8_t)(argc > 2 ? atoi(argv[2]) : 4);
+    unsigned delay_us = (unsigned)(argc > 3 ? atoi(argv[3]) : 0);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+        perror("hci_emu");
+        return 1;
+    }
+    fprintf(stderr, "hci_emu: aguardando QEMU em 127.0.0.1:%d (creditos=%u)\n", port, credits);
+
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) continue;
+        serve(fd, credits, delay_us);
+        close(fd);
+    }
+}
@@ -0,0 +1,505 @@
+// ac97_driver.c - Driver de audio AC'97 (ICH) com DMA em anel e mixer.
+//
+// O controlador le a saida PCM de uma lista de descritores (BDL) com 32
+// entradas; aqui elas apontam, em rodizio, para AUDIO_DMA_PERIODS periodos de
+// AUDIO_PERIOD_FRAMES quadros estereo de 16 bits. Enquanto o DMA toca um
+// periodo, os outros ja estao cheios: a IRQ de fim de periodo so precisa
+// misturar o proximo no periodo que acabou de tocar e avancar o LVI.
+//
+// O mixer soma os fluxos (mono, escritos adiantados por quem produz audio),
+// aplica o volume de cada um e o mestre e satura em 16 bits.
+//
+// Contadores:
+//   - underrun do DMA: o controlador chegou ao ultimo descritor valido (a IRQ
+//     atrasou mais que o anel inteiro);
+//   - falta de dados: um fluxo no meio de uma fala nao tinha amostras para o
+//     periodo (o produtor ficou para tras);
+//   - latencia: do pedido (ex.: cursor movido) ate a primeira amostra marcada
+//     com audio_stream_mark() sair do DAC.
+
+#include <stdint.h>
+#include "audio.h"
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Lib/kformat.h"
+#include "../../Kernel/Lib/pci.h"
+
+extern void outb(uint16_t port, uint8_t value);
+extern uint8_t inb(uint16_t port);
+extern void outw(uint16_t port, uint16_t value);
+extern uint16_t inw(uint16_t port);
+extern void outl(uint32_t port, uint32_t value);
+extern uint32_t inl(uint32_t port);
+extern uint32_t alloc_page();                       // Do page_allocator.c
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern uint32_t tsc_get_khz();                      // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles);  // Do cpu_diag.c
+extern int apic_register_pci_irq(uint8_t irq, void (*handler)()); // Do apic.c
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+
+// PCI
+#define PCI_COMMAND         0x04
+#define PCI_CLASS           0x08
+#define PCI_BAR0            0x10
+#define PCI_BAR1            0x14
+#define PCI_INTERRUPT_LINE  0x3C
+#define PCI_COMMAND_IO      0x01
+#define PCI_COMMAND_MASTER  0x04
+#define PCI_CLASS_AUDIO     0x0401  // Multimidia: audio
+
+// Mixer do codec (NAM, BAR0)
+#define NAM_RESET           0x00
+#define NAM_MASTER_VOLUME   0x02
+#define NAM_PCM_OUT_VOLUME  0x18
+#define NAM_VOLUME_0DB      0x0808  // PCM out: ganho 0dB nos dois canais
+
+// Bus master (NABM, BAR1): caixa de saida PCM
+#define PO_BDBAR            0x10    // Endereco da BDL
+#define PO_CIV              0x14    // Descritor atual
+#define PO_LVI              0x15    // Ultimo descritor valido
+#define PO_SR               0x16    // Status
+#define PO_PICB             0x18    // Amostras restantes no descritor atual
+#define PO_CR               0x1B    // Controle
+#define NABM_GLOBAL_CONTROL 0x2C
+#define NABM_GLOBAL_STATUS  0x30
+
+#define CR_RUN              0x01
+#define CR_RESET            0x02
+#define CR_LVB_IRQ          0x04
+#define CR_FIFO_ERROR_IRQ   0x08
+#define CR_COMPLETION_IRQ   0x10
+
+#define SR_HALTED           0x01
+#define SR_LAST_VALID       0x02    // CIV == LVI
+#define SR_LVB_DONE         0x04
+#define SR_COMPLETION       0x08
+#define SR_FIFO_ERROR       0x10
+#define SR_CLEAR            (SR_LVB_DONE | SR_COMPLETION | SR_FIFO_ERROR)
+
+#define GLOBAL_COLD_RESET   0x02    // 1 = fora do reset
+#define GLOBAL_CODEC_READY  0x100
+
+#define BDL_ENTRIES         32
+#define BDL_IOC             0x80000000u // Interrompe ao fim do descritor
+#define CODEC_READY_SPINS   1000000
+#define AC97_RESET_TIMEOUT_MS 10      // Reset do DMA (leva microssegundos)
+
+#define STREAM_MASK         (AUDIO_STREAM_SAMPLES - 1)
+
+// Descritor da BDL: endereco fisico + (amostras de 16 bits | flags << 16)
+typedef struct {
+    uint32_t address;
+    uint32_t control;
+} BdlEntry;
+
+struct audio_stream {
+    int16_t samples[AUDIO_STREAM_SAMPLES];
+    volatile uint32_t head;         // Escrito pelo produtor
+    volatile uint32_t tail;         // Consumido pelo mixer (IRQ)
+    uint32_t low_watermark;
+    uint32_t volume;
+    uint8_t in_use;
+    volatile uint8_t playing;       // Ha uma fala em curso (esvaziar = falta de dados)
+    volatile uint8_t ending;        // O produtor ja escreveu o fim: esvaziar e normal
+    volatile uint8_t mark_set;
+    volatile uint32_t mark_pos;     // Posicao da amostra marcada
+    volatile uint64_t mark_tsc;     // Instante do pedido
+    uint32_t starved;
+    async_event_t low;
+};
+
+// Marca ja misturada, esperando o DMA chegar nela
+typedef struct {
+    uint8_t valid;
+    uint8_t entry;                  // Descritor da BDL
+    uint32_t offset;                // Quadro dentro do periodo
+    uint64_t request_tsc;
+} PendingMark;
+
+static uint16_t nam_base = 0;
+static uint16_t nabm_base = 0;
+static uint8_t audio_irq = 0;
+static int audio_ready = 0;
+
+// Uma pagina: BDL (256 bytes) + 4 periodos de 240 quadros estereo (3840 bytes)
+static BdlEntry *bdl = 0;
+static int16_t *periods = 0;
+static uint8_t fill_index = 0;      // Proximo descritor a misturar
+
+static audio_stream_t streams[AUDIO_MAX_STREAMS];
+static uint32_t master_volume = AUDIO_VOLUME_UNITY;
+static PendingMark pending_mark;
+static int32_t mix_accumulator[AUDIO_PERIOD_FRAMES];
+
+// Estatisticas
+static uint32_t tsc_khz = 0;
+static uint32_t periods_mixed = 0;
+static uint32_t dma_underruns = 0;
+static uint32_t stream_underruns = 0;
+static uint32_t latency_count = 0;
+static uint64_t latency_sum_cycles = 0;
+static uint64_t latency_min_cycles = 0;
+static uint64_t latency_max_cycles = 0;
+static uint64_t latency_last_cycles = 0;
+
+// =======================================================
+// 1. PCI E CODEC
+// =======================================================
+
+/**
+ * Procura a controladora de audio no barramento 0 e liga I/O e bus master.
+ * @return 1 se achou um AC'97 (BARs de I/O).
+ */
+static int ac97_probe() {
+    for (uint8_t slot = 0; slot < 32; slot++) {
+        for (uint8_t function = 0; function < 8; function++) {
+            if ((pci_read32(slot, function, 0) & 0xFFFF) == 0xFFFF) continue;
+            if ((pci_read32(slot, function, PCI_CLASS) >> 16) != PCI_CLASS_AUDIO) continue;
+
+            uint32_t bar0 = pci_read32(slot, function, PCI_BAR0);
+            uint32_t bar1 = pci_read32(slot, function, PCI_BAR1);
+            if (!(bar0 & 0x01) || !(bar1 & 0x01)) continue; // HDA usa MMIO: nao e um AC'97
+            nam_base = (uint16_t)(bar0 & 0xFFFC);
+            nabm_base = (uint16_t)(bar1 & 0xFFFC);
+            audio_irq = (uint8_t)(pci_read32(slot, function, PCI_INTERRUPT_LINE) & 0xFF);
+
+            uint32_t command = pci_read32(slot, function, PCI_COMMAND);
+            pci_write32(slot, function, PCI_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Tira o codec do reset e deixa o caminho PCM em 0dB (o volume e do mixer)
+static int ac97_codec_init() {
+    outl(nabm_base + NABM_GLOBAL_CONTROL, GLOBAL_COLD_RESET);
+    for (uint32_t i = 0; !(inl(nabm_base + NABM_GLOBAL_STATUS) & GLOBAL_CODEC_READY); i++) {
+        if (i == CODEC_READY_SPINS) return -1;
+    }
+    outw(nam_base + NAM_RESET, 0);
+    outw(nam_base + NAM_MASTER_VOLUME, 0);
+    outw(nam_base + NAM_PCM_OUT_VOLUME, NAM_VOLUME_0DB);
+    return 0;
+}
+
+// =======================================================
+// 2. MIXER
+// =======================================================
+
+static int16_t* period_buffer(uint8_t entry) {
+    return periods + (uint32_t)(entry % AUDIO_DMA_PERIODS) * AUDIO_PERIOD_FRAMES * 2;
+}
+
+/**
+ * Mistura um periodo no descritor 'entry'. Roda na IRQ (ou no init).
+ */
+static void mixer_render(uint8_t entry) {
+    for (uint32_t i = 0; i < AUDIO_PERIOD_FRAMES; i++) mix_accumulator[i] = 0;
+
+    for (int n = 0; n < AUDIO_MAX_STREAMS; n++) {
+        audio_stream_t *s = &streams[n];
+        if (!s->in_use) continue;
+
+        uint32_t tail = s->tail;
+        uint32_t available = s->head - tail;
+        uint32_t count = available < AUDIO_PERIOD_FRAMES ? available : AUDIO_PERIOD_FRAMES;
+
+        // A amostra marcada cai neste periodo: falta so o DMA chegar nele
+        if (s->mark_set && s->mark_pos - tail < count) {
+            pending_mark.valid = 1;
+            pending_mark.entry = entry;
+            pending_mark.offset = s->mark_pos - tail;
+            pending_mark.request_tsc = s->mark_tsc;
+            s->mark_set = 0;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            mix_accumulator[i] += ((int32_t)s->samples[(tail + i) & STREAM_MASK] * (int32_t)s->volume) >> 8;
+        }
+        s->tail = tail + count;
+
+        if (count < AUDIO_PERIOD_FRAMES && s->playing) {
+            if (s->ending) {
+                s->playing = 0; // Fim da fala: o resto e silencio de proposito
+            } else {
+                s->starved++;
+                stream_underruns++;
+            }
+        }
+        if (available - count <= s->low_watermark) async_signal(&s->low);
+    }
+
+    int16_t *out = period_buffer(entry);
+    for (uint32_t i = 0; i < AUDIO_PERIOD_FRAMES; i++) {
+        int32_t sample = (mix_accumulator[i] * (int32_t)master_volume) >> 8;
+        if (sample > 32767) sample = 32767;
+        if (sample < -32768) sample = -32768;
+        out[i * 2] = (int16_t)sample;       // Esquerdo
+        out[i * 2 + 1] = (int16_t)sample;   // Direito
+    }
+    periods_mixed++;
+}
+
+// Enche os descritores ate o anel ficar com AUDIO_DMA_PERIODS na frente do DMA
+static void ac97_refill(uint8_t civ) {
+    while (((fill_index - civ) & (BDL_ENTRIES - 1)) < AUDIO_DMA_PERIODS) {
+        mixer_render(fill_index);
+        outb(nabm_base + PO_LVI, fill_index);
+        fill_index = (fill_index + 1) & (BDL_ENTRIES - 1);
+    }
+}
+
+// A amostra marcada ja saiu? Entao fecha a medicao de latencia.
+static void latency_check(uint8_t civ, uint64_t now) {
+    if (!pending_mark.valid) return;
+    uint32_t behind = (uint8_t)(civ - pending_mark.entry) & (BDL_ENTRIES - 1);
+    if (behind >= AUDIO_DMA_PERIODS) return; // Ainda na frente do DMA
+
+    uint32_t remaining = inw(nabm_base + PO_PICB) / 2; // Quadros que faltam no atual
+    uint32_t played = behind * AUDIO_PERIOD_FRAMES + (AUDIO_PERIOD_FRAMES - remaining);
+    if (played < pending_mark.offset) return; // O periodo comecou, a amostra nao
+
+    uint64_t since_sample = (uint64_t)(played - pending_mark.offset) * tsc_khz * 1000 / AUDIO_SAMPLE_RATE;
+    uint64_t cycles = now - since_sample - pending_mark.request_tsc;
+    pending_mark.valid = 0;
+
+    latency_last_cycles = cycles;
+    latency_sum_cycles += cycles;
+    if (latency_count == 0 || cycles < latency_min_cycles) latency_min_cycles = cycles;
+    if (cycles > latency_max_cycles) latency_max_cycles = cycles;
+    latency_count++;
+}
+
+/**
+ * Rotina da IRQ do AC'97 (fim de periodo). O EOI fica com o apic.c.
+ */
+void ac97_interrupt_handler() {
+    uint16_t status = inw(nabm_base + PO_SR);
+    if (!(status & SR_CLEAR)) return; // IRQ compartilhada: nao e nossa (HALTED sozinho nao gera IRQ)
+    outw(nabm_base + PO_SR, status & SR_CLEAR);
+
+    uint64_t now = read_tsc();
+    uint8_t civ = inb(nabm_base + PO_CIV);
+    latency_check(civ, now);
+
+    // Chegou ao LVI: a IRQ atrasou o anel inteiro e o DAC tocou o ultimo periodo de novo
+    int halted = (status & (SR_LVB_DONE | SR_HALTED)) != 0;
+    if (halted) dma_underruns++;
+
+    ac97_refill(civ);
+    if (halted) outb(nabm_base + PO_CR, CR_RUN | CR_LVB_IRQ | CR_FIFO_ERROR_IRQ | CR_COMPLETION_IRQ);
+}
+
+// =======================================================
+// 3. INICIALIZACAO
+// =======================================================
+
+// Programa a BDL, pre-enche o anel e liga o DMA (boot e retomada)
+static int ac97_start() {
+    if (ac97_codec_init() != 0) {
+        ui_log_status("Audio ERRO: codec AC'97 nao ficou pronto.", 0x0C);
+        return -1;
+    }
+
+    // Sem TSC calibrado, conta como se fosse 1GHz
+    uint64_t timeout = (uint64_t)(tsc_khz ? tsc_khz : 1000000) * AC97_RESET_TIMEOUT_MS;
+    uint64_t start = read_tsc();
+    outb(nabm_base + PO_CR, CR_RESET);
+    while (inb(nabm_base + PO_CR) & CR_RESET) {
+        if (read_tsc() - start > timeout) {
+            ui_log_status("Audio ERRO: DMA do AC'97 nao saiu do reset.", 0x0C);
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < BDL_ENTRIES; i++) {
+        bdl[i].address = (uint32_t)period_buffer((uint8_t)i);
+        bdl[i].control = BDL_IOC | (AUDIO_PERIOD_FRAMES * 2);
+    }
+    outl(nabm_base + PO_BDBAR, (uint32_t)bdl);
+
+    uint32_t flags = irq_save();
+    fill_index = 0;
+    pending_mark.valid = 0;
+    ac97_refill(0);
+    outb(nabm_base + PO_CR, CR_RUN | CR_LVB_IRQ | CR_FIFO_ERROR_IRQ | CR_COMPLETION_IRQ);
+    irq_restore(flags);
+    return 0;
+}
+
+static void ac97_resume() {
+    ac97_start();
+}
+
+/**
+ * Procura o AC'97, liga o DMA e comeca a tocar (silencio ate alguem escrever).
+ * @return 0 em caso de sucesso, -1 sem dispositivo de audio (ou se ele nao respondeu).
+ */
+int init_audio_driver() {
+    for (int n = 0; n < AUDIO_MAX_STREAMS; n++) async_event_init(&streams[n].low);
+
+    if (!ac97_probe()) {
+        ui_log_status("Audio: nenhum AC'97 encontrado.", 0x0E);
+        return -1;
+    }
+
+    uint32_t page = alloc_page();
+    if (!page) return -1;
+    bdl = (BdlEntry*)page;
+    periods = (int16_t*)(page + BDL_ENTRIES * sizeof(BdlEntry));
+    tsc_khz = tsc_get_khz();
+
+    if (apic_register_pci_irq(audio_irq, ac97_interrupt_handler) != 0) {
+        ui_log_status("Audio ERRO: AC'97 sem IRQ ISA valida.", 0x0C);
+        return -1;
+    }
+    if (ac97_start() != 0) {
+        apic_register_pci_irq(audio_irq, 0);
+        return -1;
+    }
+    hibernate_register_resume(ac97_resume); // O codec e o DMA voltam zerados
+
+    audio_ready = 1;
+    ui_log_status("Audio: AC'97 ativo (48kHz estereo, DMA em anel).", 0x0A);
+    return 0;
+}
+
+int audio_active() {
+    return audio_ready;
+}
+
+// =======================================================
+// 4. FLUXOS
+// =======================================================
+
+/**
+ * Abre um fluxo mono de AUDIO_SAMPLE_RATE amostras por segundo.
+ * @param low_watermark Abaixo de quantas amostras na fila o evento 'low' e sinalizado.
+ * @return O fluxo, ou 0 se todos estao em uso.
+ */
+audio_stream_t* audio_stream_open(uint32_t low_watermark) {
+    uint32_t flags = irq_save();
+    for (int n = 0; n < AUDIO_MAX_STREAMS; n++) {
+        audio_stream_t *s = &streams[n];
+        if (s->in_use) continue;
+        s->head = s->tail = 0;
+        s->low_watermark = low_watermark;
+        s->volume = AUDIO_VOLUME_UNITY;
+        s->playing = s->ending = s->mark_set = 0;
+        s->starved = 0;
+        s->in_use = 1;
+        irq_restore(flags);
+        return s;
+    }
+    irq_restore(flags);
+    return 0;
+}
+
+void audio_stream_set_volume(audio_stream_t *s, uint32_t volume) {
+    s->volume = volume;
+}
+
+uint32_t audio_stream_queued(audio_stream_t *s) {
+    return s->head - s->tail;
+}
+
+uint32_t audio_stream_space(audio_stream_t *s) {
+    return AUDIO_STREAM_SAMPLES - audio_stream_queued(s);
+}
+
+/**
+ * Enfileira amostras (um unico produtor por fluxo).
+ * @return Quantas couberam.
+ */
+uint32_t audio_stream_write(audio_stream_t *s, const int16_t *samples, uint32_t count) {
+    uint32_t space = audio_stream_space(s);
+    if (count > space) count = space;
+
+    uint32_t head = s->head;
+    for (uint32_t i = 0; i < count; i++) s->samples[(head + i) & STREAM_MASK] = samples[i];
+    __asm__ __volatile__ ("" : : : "memory"); // Amostras antes do head
+    s->head = head + count;
+
+    if (count) {
+        s->ending = 0;
+        s->playing = 1;
+    }
+    return count;
+}
+
+/**
+ * Marca a proxima amostra escrita como a primeira de um pedido feito em
+ * 'request_tsc'; quando ela sair do DAC, a latencia entra nas estatisticas.
+ */
+void audio_stream_mark(audio_stream_t *s, uint64_t request_tsc) {
+    uint32_t flags = irq_save();
+    s->mark_pos = s->head;
+    s->mark_tsc = request_tsc;
+    s->mark_set = 1;
+    irq_restore(flags);
+}
+
+/**
+ * O produtor terminou a fala: esvaziar a fila daqui em diante nao e underrun.
+ */
+void audio_stream_end(audio_stream_t *s) {
+    s->ending = 1;
+}
+
+/**
+ * Descarta o que ainda nao foi misturado (ex.: fala interrompida).
+ */
+void audio_stream_flush(audio_stream_t *s) {
+    uint32_t flags = irq_save();
+    s->head = s->tail;
+    s->playing = s->ending = s->mark_set = 0;
+    irq_restore(flags);
+}
+
+async_event_t* audio_stream_low_event(audio_stream_t *s) {
+    return &s->low;
+}
+
+void audio_set_master_volume(uint32_t volume) {
+    master_volume = volume;
+}
+
+// =======================================================
+// 5. RELATORIO
+// =======================================================
+
+static uint32_t cycles_to_us(uint64_t cycles) {
+    return (uint32_t)(tsc_cycles_to_ns(cycles) / 1000);
+}
+
+/**
+ * Mostra periodos tocados, underruns (DMA e falta de dados) e a latencia do
+ * pedido ate a primeira amostra no DAC (us).
+ */
+void audio_report(int row) {
+    char buffer[12];
+    ui_draw_string("== Audio (AC'97) ==", row, 0, 0x0E);
+    if (!audio_ready) {
+        ui_draw_string("Sem dispositivo de audio.", row + 1, 0, 0x0C);
+        return;
+    }
+
+    ui_draw_string("Periodos:", row + 1, 0, 0x0B);
+    ui_draw_string(u32_to_str(periods_mixed, buffer, 12), row + 1, 10, 0x0F);
+    ui_draw_string("Underrun DMA:", row + 1, 22, 0x0B);
+    ui_draw_string(u32_to_str(dma_underruns, buffer, 12), row + 1, 36, dma_underruns ? 0x0C : 0x0A);
+    ui_draw_string("Falta de dados:", row + 1, 42, 0x0B);
+    ui_draw_string(u32_to_str(stream_underruns, buffer, 12), row + 1, 58, stream_underruns ? 0x0C : 0x0A);
+
+    ui_draw_string("Latencia (us) ultima/min/media/max:", row + 2, 0, 0x0B);
+    if (latency_count == 0) {
+        ui_draw_string("-", row + 2, 36, 0x07);
+        return;
+    }
+    ui_draw_string(u32_to_str(cycles_to_us(latency_last_cycles), buffer, 12), row + 2, 36, 0x0F);
+    ui_draw_string(u32_to_str(cycles_to_us(latency_min_cycles), buffer, 12), row + 2, 46, 0x0F);
+    ui_draw_string(u32_to_str(cycles_to_us(latency_sum_cycles / latency_count), buffer, 12), row + 2, 56, 0x0F);
+    ui_draw_string(u32_to_str(cycles_to_us(latency_max_cycles), buffer, 12), row + 2, 66, 0x0E);
+}
@@ -0,0 +1,41 @@
+// audio.h - Saida de audio (AC'97) com mixer de fluxos.
+//
+// O DMA toca um anel de periodos; a cada periodo tocado, a IRQ do AC'97 pede
+// ao mixer o proximo, somando os fluxos ativos. Quem produz audio (ex.: a
+// sintese de fala) escreve amostras mono num fluxo, adiantado em relacao ao
+// DMA, e e avisado pelo evento 'low' quando o fluxo esvazia abaixo do limite.
+//
+// No QEMU: -audiodev wav,id=snd0,path=saida.wav -device AC97,audiodev=snd0
+
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+#include "../../Kernel/Async/async.h"
+
+#define AUDIO_SAMPLE_RATE       48000   // Taxa fixa do AC'97 (sem VRA)
+#define AUDIO_PERIOD_FRAMES     240     // 5ms por periodo de DMA
+#define AUDIO_DMA_PERIODS       4       // Periodos no anel (DMA toca um, o mixer enche os outros)
+#define AUDIO_MAX_STREAMS       4
+#define AUDIO_STREAM_SAMPLES    16384   // Potencia de 2: ~340ms por fluxo
+#define AUDIO_VOLUME_UNITY      256
+
+typedef struct audio_stream audio_stream_t;
+
+int init_audio_driver();
+int audio_active();
+
+audio_stream_t* audio_stream_open(uint32_t low_watermark);
+void audio_stream_set_volume(audio_stream_t *s, uint32_t volume);
+uint32_t audio_stream_space(audio_stream_t *s);
+uint32_t audio_stream_queued(audio_stream_t *s);
+uint32_t audio_stream_write(audio_stream_t *s, const int16_t *samples, uint32_t count);
+void audio_stream_mark(audio_stream_t *s, uint64_t request_tsc);
+void audio_stream_end(audio_stream_t *s);
+void audio_stream_flush(audio_stream_t *s);
+async_event_t* audio_stream_low_event(audio_stream_t *s);
+
+void audio_set_master_volume(uint32_t volume);
+void audio_report(int row);
+
+#endif
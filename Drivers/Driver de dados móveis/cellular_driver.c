@@ -1,8 +1,61 @@
 #include <stdint.h>
+#include "../../Kernel/Async/async.h" // Envio AT -> espera OK sem pilha
 // ... inclui funcoes putc e I/O de baixo nivel
 
 // Enderecos de I/O UART (Porta Serial 1) para o Modulo Celular
 #define COM1_PORT_DATA 0x3F8
+#define COM1_PORT_IER  0x3F9 // Habilitacao de Interrupcoes
+#define COM1_PORT_FCR  0x3FA // Controle de FIFO
+#define COM1_PORT_LCR  0x3FB // Controle de Linha
+#define COM1_PORT_MCR  0x3FC // Controle de Modem
+#define COM1_PORT_LSR  0x3FD // Status de Linha
+#define COM1_IRQ       4
+
+#define LSR_DATA_READY 0x01
+#define LSR_THR_EMPTY  0x20
+
+#define AT_LINE_MAX          64
+#define AT_TIMEOUT_TICKS     300 // 3s (ticks de 10ms) para o modulo responder
+
+// Resultado final de um comando AT
+#define AT_RESULT_NONE  0
+#define AT_RESULT_OK    1
+#define AT_RESULT_ERROR 2
+
+extern void outb(uint16_t port, uint8_t value);
+extern uint8_t inb(uint16_t port);
+extern void putc(char c, int row, int col, char color);
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+extern int apic_register_irq(uint8_t irq, void (*handler)()); // Do apic.c
+
+// Linha sendo recebida pela interrupcao e a ultima resposta informativa (+CSQ: ...)
+static char rx_line[AT_LINE_MAX];
+static int rx_line_len = 0;
+static char info_line[AT_LINE_MAX];
+static int info_line_len = 0;
+
+// "OK"/"ERROR" chegou: retoma a tarefa que mandou o comando
+static volatile int at_result = AT_RESULT_NONE;
+static async_event_t at_reply_event = ASYNC_EVENT_INIT;
+
+/**
+ * Configura a COM1: 115200 8N1, FIFO, interrupcao de dados recebidos.
+ */
+static void cellular_uart_init() {
+    outb(COM1_PORT_IER, 0x00);
+    outb(COM1_PORT_LCR, 0x80);  // DLAB = 1
+    outb(COM1_PORT_DATA, 0x01); // Divisor 1 = 115200 baud
+    outb(COM1_PORT_IER, 0x00);
+    outb(COM1_PORT_LCR, 0x03);  // 8 bits, sem paridade, 1 stop
+    outb(COM1_PORT_FCR, 0xC7);
+    outb(COM1_PORT_MCR, 0x0B);  // DTR, RTS, OUT2 (liga IRQ)
+    outb(COM1_PORT_IER, 0x01);  // So RX: a transmissao de um comando AT e curta
+}
+
+static void cellular_uart_write(char c) {
+    while (!(inb(COM1_PORT_LSR) & LSR_THR_EMPTY)) { /* loop */ }
+    outb(COM1_PORT_DATA, (uint8_t)c);
+}
 
 /**
  * Envia uma string de comando AT (abstrata) para o modulo celular.
@@ -15,11 +68,80 @@ void send_at_command(const char* command) {
     // 2. Envia a string, byte a byte, para a porta serial
     int i = 0;
     while (command[i] != '\0') {
-        // outb(COM1_PORT_DATA, command[i]); // Comando real em Assembly
-        putc(command[i], 28, 3 + i, 0x0E); // Simula a escrita
+        cellular_uart_write(command[i]);
+        putc(command[i], 28, 3 + i, 0x0E); // Eco na tela
         i++;
     }
-    // outb(COM1_PORT_DATA, '\r'); // Envia Carriage Return para executar
+    cellular_uart_write('\r'); // Envia Carriage Return para executar
+}
+
+static int line_equals(const char *line, int len, const char *word) {
+    int i = 0;
+    while (i < len && word[i] != '\0' && line[i] == word[i]) i++;
+    return i == len && word[i] == '\0';
+}
+
+/**
+ * Rotina chamada pela interrupcao da COM1 (IRQ4). Junta os bytes em linhas
+ * e, quando chega o resultado final ("OK" ou "ERROR"), sinaliza a tarefa.
+ */
+void cellular_uart_interrupt_handler() {
+    while (inb(COM1_PORT_LSR) & LSR_DATA_READY) {
+        char c = (char)inb(COM1_PORT_DATA);
+        if (c == '\r') continue;
+        if (c != '\n') {
+            if (rx_line_len < AT_LINE_MAX) rx_line[rx_line_len++] = c;
+            continue;
+        }
+
+        if (line_equals(rx_line, rx_line_len, "OK")) {
+            at_result = AT_RESULT_OK;
+            async_signal(&at_reply_event);
+        } else if (line_equals(rx_line, rx_line_len, "ERROR")) {
+            at_result = AT_RESULT_ERROR;
+            async_signal(&at_reply_event);
+        } else if (rx_line_len > 0 && rx_line[0] == '+') {
+            // Resposta informativa (ex: "+CSQ: 31,99"), guardada para exibir
+            for (int i = 0; i < rx_line_len; i++) info_line[i] = rx_line[i];
+            info_line_len = rx_line_len;
+        }
+        rx_line_len = 0;
+    }
+}
+
+// Quadro da tarefa AT -> OK
+typedef struct {
+    async_task_t task;
+    const char *command;
+} AtCommandFrame;
+
+static int at_command_task(async_task_t *t) {
+    AtCommandFrame *f = (AtCommandFrame*)t;
+    ASYNC_BEGIN(t);
+
+    at_result = AT_RESULT_NONE;
+    info_line_len = 0;
+    async_event_reset(&at_reply_event);
+    send_at_command(f->command);
+
+    // Espera o "OK" pela interrupcao da UART, sem ocupar a CPU
+    ASYNC_AWAIT(t, &at_reply_event, AT_TIMEOUT_TICKS);
+    if (t->result == ASYNC_TIMEOUT) {
+        putc('T', 29, 35, 0x0C); // 'T' Vermelho - Sem resposta
+        ASYNC_EXIT(t, -1);
+    }
+    if (at_result != AT_RESULT_OK) {
+        putc('E', 29, 35, 0x0C); // 'E' Vermelho - ERROR
+        ASYNC_EXIT(t, -1);
+    }
+
+    putc('O', 29, 35, 0x0A); // 'O' Verde - Resposta OK
+    putc('K', 29, 36, 0x0A);
+    for (int i = 0; i < info_line_len; i++) {
+        putc(info_line[i], 29, 38 + i, 0x0F); // Ex: "+CSQ: 31,99"
+    }
+    ASYNC_EXIT(t, 0);
+    ASYNC_END(t);
 }
 
 /**
@@ -31,13 +153,14 @@ void init_cellular_driver() {
         putc(status_msg[i], 29, i, 0x0B); // Linha 29, Azul Claro
     }
 
-    // Comando AT basico: Checa o nivel de sinal (simulado)
-    send_at_command("AT+CSQ"); 
-    
-    // Em um driver real:
-    // 1. Espera por uma resposta (ex: "+CSQ: 31,99\r\nOK") via interrupcao UART.
-    // 2. Se a resposta for OK, o modulo esta pronto.
-    
-    putc('O', 29, 35, 0x0A); // 'O' Verde - Simula resposta OK
-    putc('K', 29, 36, 0x0A); 
+    cellular_uart_init();
+    hibernate_register_resume(cellular_uart_init); // A UART perde a configuracao
+    apic_register_irq(COM1_IRQ, cellular_uart_interrupt_handler);
+
+    // Comando AT basico: Checa o nivel de sinal. A espera pelo "OK" corre
+    // como tarefa assincrona; o init nao fica preso aqui.
+    async_task_t *t = async_alloc(at_command_task, sizeof(AtCommandFrame));
+    if (!t) return;
+    ((AtCommandFrame*)t)->command = "AT+CSQ";
+    async_start(t);
 }
@@ -1,12 +1,37 @@
 #include <stdint.h>
 #include "kernel_base.h" // Presume putc() e outras funcoes de kernel
+#include "../../Tools/Agendador/sync.h" // Wait queue dos leitores de teclas
 
 // Enderecos de hardware (Portas de I/O) para o Controlador de Teclado (i8042)
 #define KBD_DATA_PORT   0x60 // Onde o codigo de varredura e lido
 #define KBD_STATUS_PORT 0x64 // Onde o status do teclado e verificado
 
-// Funcoes externas para a logica de permissao/cursor
-extern void handle_key_event(int key_code); // Do accessibility_service.c
+// Canal de IPC das teclas (Do ipc_channel.c). O Servico de Acessibilidade le
+// deste canal em seu proprio processo, em vez de ser chamado daqui.
+extern int ipc_channel_open(const char *name);
+extern int ipc_send(int id, const void *message, uint32_t length);
+static int key_channel = -1;
+
+extern int apic_register_irq(uint8_t irq, void (*handler)()); // Do apic.c
+#define KBD_IRQ 1
+
+// Consoles virtuais (Do virtual_console.c): F1..F8 trocam, PgUp/PgDn rolam
+extern int vc_switch(int console);
+extern void vc_scroll(int delta_rows);
+#define SCAN_CODE_F1_PRESS      0x3B
+#define SCAN_CODE_F8_PRESS      0x42
+#define SCAN_CODE_PGUP_PRESS    0x49
+#define SCAN_CODE_PGDN_PRESS    0x51
+#define VC_SCROLL_ROWS          12
+
+// Fila de teclas ja traduzidas. Quem chama keyboard_read_key() dorme na wait
+// queue ate a IRQ1 trazer uma tecla, em vez de girar lendo a porta 0x60.
+#define KEY_BUFFER_SIZE 32 // Potencia de 2
+static int key_buffer[KEY_BUFFER_SIZE];
+static volatile uint32_t key_head = 0;
+static volatile uint32_t key_tail = 0;
+static wait_queue_t key_wait_queue;
+static spinlock_t key_lock = SPINLOCK_INIT; // IRQ1 (produtor) x leitores e keyboard_flush_keys()
 
 /**
  * Funcao de baixo nivel para ler a porta de I/O de dados do teclado.
@@ -41,6 +66,16 @@ void keyboard_interrupt_handler() {
 
     int high_level_code = 0; // Codigo de acao para o Servico de Acessibilidade
 
+    // Teclas do sistema: tratadas aqui mesmo (a copia da tela fica com a tarefa do virtual_console.c)
+    if (scan_code >= SCAN_CODE_F1_PRESS && scan_code <= SCAN_CODE_F8_PRESS) {
+        vc_switch(scan_code - SCAN_CODE_F1_PRESS);
+        return;
+    }
+    if (scan_code == SCAN_CODE_PGUP_PRESS || scan_code == SCAN_CODE_PGDN_PRESS) {
+        vc_scroll(scan_code == SCAN_CODE_PGUP_PRESS ? -VC_SCROLL_ROWS : VC_SCROLL_ROWS);
+        return;
+    }
+
     // 2. Traducao de Codigo de Varredura para Acao de Alto Nivel
     if (scan_code == SCAN_CODE_ENTER_PRESS) {
         high_level_code = 13; // ENTER
@@ -53,8 +88,19 @@ void keyboard_interrupt_handler() {
     
     // 3. Entrega a Acao para o Servico de Acessibilidade (Cursor/Permissao)
     if (high_level_code != 0) {
-        // Esta chamada faz seu cursor mover e aciona a logica de permissao.
-        handle_key_event(high_level_code); 
+        // Guarda a tecla para quem estiver esperando (descarta se a fila encher)
+        uint32_t flags = spin_lock_irqsave(&key_lock);
+        int stored = 0;
+        if (key_head - key_tail < KEY_BUFFER_SIZE) {
+            key_buffer[key_head & (KEY_BUFFER_SIZE - 1)] = high_level_code;
+            key_head++;
+            stored = 1;
+        }
+        spin_unlock_irqrestore(&key_lock, flags);
+        if (stored) wait_queue_wake_one(&key_wait_queue);
+
+        // Publica no canal "input.keys" (sem bloquear: com o anel cheio a tecla se perde)
+        if (key_channel >= 0) ipc_send(key_channel, &high_level_code, sizeof(high_level_code));
         
         // Log de acao (para debug)
         putc('K', 24, 0, 0x0E); // 'K' de Key (Amarelo)
@@ -63,18 +109,52 @@ void keyboard_interrupt_handler() {
         // (Em um OS real, voce formataria o codigo e a acao em string aqui)
     }
 
-    // 4. ENVIA EOI (End Of Interrupt)
-    // O hardware precisa saber que voce terminou de processar a interrupcao.
-    // Isso e crucial para o proximo evento de teclado.
-    // O codigo real e em Assembly e envolve a porta 0x20.
+    // 4. EOI (End Of Interrupt): quem manda e o despachante do apic.c, depois
+    // que esta rotina volta - inclusive pelos 'return' das teclas ignoradas,
+    // que antes deixavam a IRQ1 travada.
+}
+
+/**
+ * Le a proxima tecla (codigo de alto nivel: 13 = ENTER, 400 = DOWN).
+ * Bloqueia o processo ate uma tecla chegar.
+ */
+int keyboard_read_key() {
+    for (;;) {
+        wait_event(&key_wait_queue, key_head != key_tail);
+
+        // Outro leitor (ou um keyboard_flush_keys) pode ter esvaziado a fila
+        uint32_t flags = spin_lock_irqsave(&key_lock);
+        if (key_head != key_tail) {
+            int key = key_buffer[key_tail & (KEY_BUFFER_SIZE - 1)];
+            key_tail++;
+            spin_unlock_irqrestore(&key_lock, flags);
+            return key;
+        }
+        spin_unlock_irqrestore(&key_lock, flags);
+    }
+}
+
+/**
+ * Descarta as teclas ja na fila. Quem vai perguntar algo ao usuario chama
+ * isto depois de mostrar a pergunta, para que um ENTER digitado antes (para
+ * outra tela) nao vire a resposta.
+ */
+void keyboard_flush_keys() {
+    uint32_t flags = spin_lock_irqsave(&key_lock);
+    key_tail = key_head;
+    spin_unlock_irqrestore(&key_lock, flags);
 }
 
 // Funcao de inicializacao: O Kernel a chama no inicio.
 void init_keyboard_driver() {
+    wait_queue_init(&key_wait_queue);
+    key_channel = ipc_channel_open("input.keys");
+
     const char *title = "Driver de Teclado Ativo (IRQ1)";
     for (int i = 0; title[i] != '\0'; i++) {
         putc(title[i], 20, 0, 0x0B); // Azul claro
     }
-    
-    // O Kernel de verdade configuraria a IDT aqui para apontar para keyboard_interrupt_handler()
+
+    // IRQ1 pelo IOAPIC (vetor, EOI e medicao de latencia ficam no apic.c)
+    apic_register_irq(KBD_IRQ, keyboard_interrupt_handler);
 }
@@ -1,4 +1,7 @@
 #include <stdint.h>
+#include "../../Tools/Agendador/sync.h" // Wait queues e mutex
+#include "../../Kernel/Async/async.h"     // Leituras sem pilha (ata_read_sectors_async)
+#include "../../Kernel/Lib/pci.h"         // pci_read32/pci_write32
 
 // Endereços de I/O para o Drive Primário (Master) do Barramento ATA
 #define ATA_PORT_DATA       0x1F0 // Porta de Dados
@@ -12,15 +15,90 @@
 
 // Comando ATA para Leitura de Setor (Read Sectors with Retry)
 #define ATA_CMD_READ_PIO    0x20
+#define ATA_CMD_WRITE_PIO   0x30 // Write Sectors
+#define ATA_CMD_CACHE_FLUSH 0xE7 // Grava o cache interno do drive na midia
+#define ATA_CMD_IDENTIFY    0xEC
+#define ATA_CMD_READ_DMA    0xC8
+#define ATA_CMD_WRITE_DMA   0xCA
+
+#define ATA_IRQ             14    // Canal primario
 
 // Tamanho padrao de um setor
 #define SECTOR_SIZE         512
 
+// Maximo de setores por comando no modo LBA28 (contador 0 = 256)
+#define ATA_MAX_SECTORS_PER_CMD 256
+
+// Prazo para cada setor no caminho assincrono (ticks de 10ms)
+#define ATA_ASYNC_TIMEOUT_TICKS 100
+
+// Prazo da espera ativa limitada: cada leitura de porta leva ~1us, ~1s no total
+#define ATA_POLL_LIMIT      1000000
+
+// Bus Master IDE (DMA): controladora PCI classe 01:01, BAR4 = portas do bus master
+#define PCI_COMMAND         0x04
+#define PCI_CLASS           0x08
+#define PCI_BAR4            0x20
+#define PCI_COMMAND_IO      0x01
+#define PCI_COMMAND_MASTER  0x04
+#define PCI_CLASS_IDE       0x0101
+
+#define BM_COMMAND          0x00 // Deslocamentos no BAR4 (canal primario)
+#define BM_STATUS           0x02
+#define BM_PRDT             0x04
+#define BM_CMD_START        0x01
+#define BM_CMD_READ         0x08 // Direcao: dispositivo -> memoria
+#define BM_STATUS_ERROR     0x02
+#define BM_STATUS_IRQ       0x04
+
+#define PRD_MAX_BYTES       0x10000 // Uma entrada nunca cruza 64KB
+#define PRD_END_OF_TABLE    0x80000000u
+#define ATA_MAX_PRDS        8       // 128KB em pedacos de ate 64KB: no maximo 3
+
+// Operacoes das tarefas assincronas
+#define ATA_OP_READ         0
+#define ATA_OP_WRITE        1
+#define ATA_OP_FLUSH        2
+
 // Presume funcoes outb/inb/insw para I/O de baixo nivel (em Assembly)
 extern void outb(uint16_t port, uint8_t value);
 extern uint8_t inb(uint16_t port);
 extern void insw(uint16_t port, void* addr, uint32_t count);
+extern void outsw(uint16_t port, const void* addr, uint32_t count);
 extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern int scheduler_can_block();
+extern void outl(uint32_t port, uint32_t value);
+extern uint32_t alloc_page();               // Do page_allocator.c
+extern int apic_register_irq(uint8_t irq, void (*handler)()); // Do apic.c
+
+// O drive levanta a IRQ14 quando cada setor fica pronto (DRQ).
+// Quem espera dorme aqui em vez de girar lendo a porta de status.
+static wait_queue_t ata_wait_queue;
+static volatile int ata_irq_pending = 0;
+
+// Um comando por vez no canal primario
+static mutex_t ata_channel_lock;
+
+// Hibernacao: quem congelou o sistema e dono do canal e espera girando (sem IRQ)
+static volatile int ata_frozen = 0;
+
+// Mesmos sinais para as tarefas assincronas: IRQ14 e "canal liberado"
+static async_event_t ata_irq_event = ASYNC_EVENT_INIT;
+static async_event_t ata_channel_free = ASYNC_EVENT_INIT;
+
+// DMA: portas do bus master e a tabela de descritores (PRDT) numa pagina propria.
+// O Kernel usa enderecos fisicos = virtuais, entao o buffer vai direto na PRDT.
+static uint16_t bm_base = 0;
+static uint32_t *ata_prdt = 0;
+static int ata_dma_enabled = 0;
+
+/**
+ * Espera o bit BSY (Busy) cair antes de programar um novo comando.
+ */
+void ata_wait_not_busy() {
+    while (inb(ATA_PORT_COMMAND) & 0x80) { /* loop */ }
+}
 
 /**
  * Funcao para esperar que o disco termine de processar um comando.
@@ -28,59 +106,487 @@ extern void ui_log_status(const char *status_msg, char color_byte);
  */
 void ata_wait_ready() {
     // 1. Espera ate que o bit BSY (Busy) caia (o drive nao esta mais ocupado)
-    while (inb(ATA_PORT_COMMAND) & 0x80) { /* loop */ }
+    ata_wait_not_busy();
     // 2. Espera ate que o bit DRQ (Data Request) suba (pronto para transferir dados)
     while (!(inb(ATA_PORT_COMMAND) & 0x08)) { /* loop */ }
 }
 
 /**
- * Le um unico setor do disco (512 bytes) e coloca os dados no buffer.
- * @param lba_address O endereço lógico do setor a ser lido (LBA).
- * @param buffer O ponteiro para onde os 512 bytes devem ser salvos.
- * @return 0 em caso de sucesso, -1 em caso de falha.
+ * Como ata_wait_ready(), mas desiste se o drive demorar mais que o prazo
+ * (mesmo ~1s do caminho assincrono) ou sinalizar erro (ex.: ATAPI no IDENTIFY).
+ * @return 0 quando o DRQ subiu, -1 em caso de erro ou tempo esgotado.
  */
-int ata_read_sector(uint32_t lba_address, uint8_t* buffer) {
-    // 1. Esperar o drive ficar pronto
-    ata_wait_ready();
+static int ata_wait_ready_timeout() {
+    for (uint32_t i = 0; i < ATA_POLL_LIMIT; i++) {
+        uint8_t status = inb(ATA_PORT_COMMAND);
+        if (status & 0x80) continue;    // BSY
+        if (status & 0x01) return -1;   // ERR
+        if (status & 0x08) return 0;    // DRQ
+    }
+    return -1;
+}
+
+/**
+ * Rotina chamada pela interrupcao do disco (IRQ14).
+ */
+void ata_interrupt_handler() {
+    inb(ATA_PORT_COMMAND); // Ler o status reconhece a interrupcao no drive
+    ata_irq_pending = 1;
+    wait_queue_wake_all(&ata_wait_queue);
+    async_signal(&ata_irq_event);
+}
 
-    // 2. Enviar Endereço LBA e Contador de Setores (LBA28 Mode)
+/**
+ * Espera o proximo setor ficar pronto. Com o agendador ativo, o processo
+ * dorme ate a IRQ14; no boot, cai na espera ativa de ata_wait_ready().
+ */
+static void ata_wait_data() {
+    if (!ata_frozen && scheduler_can_block()) {
+        wait_event(&ata_wait_queue, ata_irq_pending);
+        ata_irq_pending = 0;
+    }
+    ata_wait_ready(); // BSY ja caiu: confirma o DRQ
+}
+
+/**
+ * Programa um comando de setores (LBA28) no drive master. Chamar com o canal travado.
+ */
+static void ata_issue_command(uint32_t lba_address, uint32_t count, uint8_t command) {
+    // Enviar Endereço LBA e Contador de Setores (LBA28 Mode)
     outb(ATA_PORT_DRIVE_SEL, 0xE0 | ((lba_address >> 24) & 0x0F)); // 0xE0: Master Drive, LBA Mode
-    outb(ATA_PORT_SECTOR_CNT, 1);                              // Ler 1 setor
+    outb(ATA_PORT_SECTOR_CNT, (uint8_t)count);                 // 256 e codificado como 0
     outb(ATA_PORT_LBA_LOW, (uint8_t)(lba_address & 0xFF));
     outb(ATA_PORT_LBA_MID, (uint8_t)((lba_address >> 8) & 0xFF));
     outb(ATA_PORT_LBA_HIGH, (uint8_t)((lba_address >> 16) & 0xFF));
 
-    // 3. Enviar Comando de Leitura (READ PIO)
-    outb(ATA_PORT_COMMAND, ATA_CMD_READ_PIO);
+    // Enviar o Comando (READ/WRITE PIO)
+    outb(ATA_PORT_COMMAND, command);
+}
+
+/**
+ * Trava o canal para um comando sincrono. Congelado, o canal ja e de quem
+ * chamou ata_freeze().
+ */
+static void ata_acquire_channel() {
+    if (!ata_frozen) mutex_lock(&ata_channel_lock);
+}
+
+/**
+ * Solta o canal e avisa tanto os processos quanto as tarefas assincronas.
+ */
+static void ata_release_channel() {
+    if (ata_frozen) return; // Continua com quem congelou ate ata_thaw()
+    mutex_unlock(&ata_channel_lock);
+    async_signal(&ata_channel_free);
+}
+
+/**
+ * Reserva o disco para quem vai usa-lo com as interrupcoes desligadas (a
+ * hibernacao). Espera o comando em curso - de um processo ou de uma tarefa
+ * assincrona - terminar e fica com o canal: ate ata_thaw(), nenhuma outra
+ * E/S comeca, e as chamadas sincronas de quem congelou nao travam o canal
+ * nem dormem, esperam girando nos bits de status.
+ * Chamar de um processo, ainda com as interrupcoes ligadas.
+ */
+void ata_freeze() {
+    mutex_lock(&ata_channel_lock);
+    ata_frozen = 1;
+}
+
+/**
+ * Devolve o canal: as E/S que esperavam voltam a andar.
+ */
+void ata_thaw() {
+    ata_frozen = 0;
+    ata_release_channel();
+}
+
+// =======================================================
+// DMA (Bus Master IDE)
+// =======================================================
+
+/**
+ * Procura a controladora IDE no barramento 0 e liga o bus master.
+ * @return 1 se o DMA esta disponivel.
+ */
+static int ata_dma_probe() {
+    for (uint8_t slot = 0; slot < 32; slot++) {
+        for (uint8_t function = 0; function < 8; function++) {
+            if ((pci_read32(slot, function, 0) & 0xFFFF) == 0xFFFF) continue;
+            if ((pci_read32(slot, function, PCI_CLASS) >> 16) != PCI_CLASS_IDE) continue;
+
+            uint32_t bar4 = pci_read32(slot, function, PCI_BAR4);
+            if (!(bar4 & 0x01)) return 0; // O bus master precisa estar no espaco de I/O
+            bm_base = (uint16_t)(bar4 & 0xFFFC);
+
+            uint32_t command = pci_read32(slot, function, PCI_COMMAND);
+            pci_write32(slot, function, PCI_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+
+            ata_prdt = (uint32_t*)alloc_page(); // Alinhada: nunca cruza 64KB
+            return ata_prdt != 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Monta a PRDT para 'bytes' a partir de 'buffer', quebrando nos limites de 64KB.
+ * @return 0 em caso de sucesso, -1 se o buffer nao serve para DMA.
+ */
+static int ata_dma_build_prdt(const uint8_t *buffer, uint32_t bytes) {
+    uint32_t address = (uint32_t)buffer;
+    if (address & 1) return -1; // O bus master transfere palavras
+
+    int entry = 0;
+    while (bytes > 0) {
+        if (entry == ATA_MAX_PRDS) return -1;
+        uint32_t chunk = PRD_MAX_BYTES - (address & (PRD_MAX_BYTES - 1));
+        if (chunk > bytes) chunk = bytes;
+
+        ata_prdt[entry * 2] = address;
+        ata_prdt[entry * 2 + 1] = chunk & 0xFFFF; // 0 = 64KB
+        address += chunk;
+        bytes -= chunk;
+        entry++;
+    }
+    ata_prdt[(entry - 1) * 2 + 1] |= PRD_END_OF_TABLE;
+    return 0;
+}
+
+/**
+ * Programa uma transferencia DMA e dispara o bus master. Chamar com o canal
+ * travado; o fim chega pela IRQ14 (ou pelo bit IRQ do status do bus master).
+ */
+static int ata_dma_start(uint32_t lba_address, uint32_t count, const uint8_t *buffer, int write) {
+    if (ata_dma_build_prdt(buffer, count * SECTOR_SIZE) != 0) return -1;
+
+    outb(bm_base + BM_COMMAND, 0);
+    outb(bm_base + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_IRQ); // Escrever 1 limpa
+    outl(bm_base + BM_PRDT, (uint32_t)ata_prdt);
+    outb(bm_base + BM_COMMAND, write ? 0 : BM_CMD_READ);
+
+    ata_issue_command(lba_address, count, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA);
+    outb(bm_base + BM_COMMAND, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+    return 0;
+}
+
+/**
+ * Para o bus master e confere o resultado da transferencia.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+static int ata_dma_finish() {
+    uint8_t bm_status = inb(bm_base + BM_STATUS);
+    outb(bm_base + BM_COMMAND, 0);
+    outb(bm_base + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_IRQ);
+    ata_wait_not_busy();
+    return ((bm_status & BM_STATUS_ERROR) || (inb(ATA_PORT_COMMAND) & 0x01)) ? -1 : 0;
+}
+
+/**
+ * Transferencia DMA sincrona. Com o agendador ativo, dorme ate a IRQ14;
+ * no boot, espera o bit IRQ do bus master.
+ */
+static int ata_dma_transfer(uint32_t lba_address, uint32_t count, const uint8_t *buffer, int write) {
+    ata_wait_not_busy();
+    ata_irq_pending = 0;
+    if (ata_dma_start(lba_address, count, buffer, write) != 0) return -1;
+
+    if (!ata_frozen && scheduler_can_block()) {
+        wait_event(&ata_wait_queue, ata_irq_pending);
+        ata_irq_pending = 0;
+    } else {
+        while (!(inb(bm_base + BM_STATUS) & BM_STATUS_IRQ)) { /* loop */ }
+    }
+    return ata_dma_finish();
+}
+
+/**
+ * O buffer pode ir por DMA? (alinhado a 2 bytes e DMA detectado)
+ */
+static int ata_use_dma(const uint8_t *buffer) {
+    return ata_dma_enabled && ((uint32_t)buffer & 1) == 0;
+}
 
-    // 4. Esperar que os dados estejam prontos para leitura
-    ata_wait_ready();
+/**
+ * Le 'count' setores consecutivos com um unico comando READ SECTORS.
+ * Usado pelo sistema de arquivos para buscar um extent inteiro de uma vez.
+ * @param lba_address O endereço lógico do primeiro setor (LBA).
+ * @param count Numero de setores (1 a ATA_MAX_SECTORS_PER_CMD).
+ * @param buffer Destino com espaco para count * 512 bytes.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int ata_read_sectors(uint32_t lba_address, uint32_t count, uint8_t* buffer) {
+    if (count == 0 || count > ATA_MAX_SECTORS_PER_CMD) return -1;
 
-    // 5. Ler 256 palavras (512 bytes) da porta de dados para o buffer
-    // 'insw' (Input String Word) e uma instrucao de Assembly crucial.
-    insw(ATA_PORT_DATA, buffer, SECTOR_SIZE / 2); // 512 bytes / 2 bytes por palavra = 256 palavras
+    ata_acquire_channel();
 
-    // 6. Checar status de erro (simplificado)
-    if (inb(ATA_PORT_COMMAND) & 0x01) {
-        ui_log_status("ATA ERRO: Falha na leitura do setor.", 0x0C); // Vermelho
-        return -1;
+    if (ata_use_dma(buffer)) {
+        int result = ata_dma_transfer(lba_address, count, buffer, 0);
+        ata_release_channel();
+        if (result != 0) ui_log_status("ATA ERRO: Falha na leitura do setor.", 0x0C);
+        return result;
     }
 
+    // 1. Esperar o drive terminar o comando anterior
+    ata_wait_not_busy();
+    ata_irq_pending = 0;
+
+    // 2. Enviar LBA, contador e o comando READ PIO
+    ata_issue_command(lba_address, count, ATA_CMD_READ_PIO);
+
+    for (uint32_t i = 0; i < count; i++) {
+        // 4. O drive levanta DRQ (e a IRQ14) uma vez para cada setor do bloco
+        ata_wait_data();
+
+        // 5. Ler 256 palavras (512 bytes) da porta de dados para o buffer
+        // 'insw' (Input String Word) e uma instrucao de Assembly crucial.
+        insw(ATA_PORT_DATA, buffer + i * SECTOR_SIZE, SECTOR_SIZE / 2);
+
+        // 6. Checar status de erro (simplificado)
+        if (inb(ATA_PORT_COMMAND) & 0x01) {
+            ui_log_status("ATA ERRO: Falha na leitura do setor.", 0x0C); // Vermelho
+            ata_release_channel();
+            return -1;
+        }
+    }
+
+    ata_release_channel();
     return 0; // Sucesso
 }
 
+/**
+ * Le um unico setor do disco (512 bytes) e coloca os dados no buffer.
+ * @param lba_address O endereço lógico do setor a ser lido (LBA).
+ * @param buffer O ponteiro para onde os 512 bytes devem ser salvos.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int ata_read_sector(uint32_t lba_address, uint8_t* buffer) {
+    return ata_read_sectors(lba_address, 1, buffer);
+}
+
+/**
+ * Grava 'count' setores consecutivos com um unico comando: WRITE DMA se
+ * houver bus master, senao WRITE SECTORS (PIO). No PIO o drive pede cada
+ * setor com DRQ; espera ativa, pois a IRQ14 so chega depois que o setor
+ * ja foi aceito.
+ * A gravacao pode ficar no cache interno do drive: use ata_flush_cache()
+ * quando precisar de durabilidade.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int ata_write_sectors(uint32_t lba_address, uint32_t count, const uint8_t* buffer) {
+    if (count == 0 || count > ATA_MAX_SECTORS_PER_CMD) return -1;
+
+    ata_acquire_channel();
+
+    if (ata_use_dma(buffer)) {
+        int result = ata_dma_transfer(lba_address, count, buffer, 1);
+        ata_release_channel();
+        if (result != 0) ui_log_status("ATA ERRO: Falha na gravacao do setor.", 0x0C);
+        return result;
+    }
+
+    ata_wait_not_busy();
+    ata_issue_command(lba_address, count, ATA_CMD_WRITE_PIO);
+
+    for (uint32_t i = 0; i < count; i++) {
+        ata_wait_ready();
+        outsw(ATA_PORT_DATA, buffer + i * SECTOR_SIZE, SECTOR_SIZE / 2);
+    }
+
+    ata_wait_not_busy();
+    int failed = inb(ATA_PORT_COMMAND) & 0x01;
+    ata_release_channel();
+
+    if (failed) ui_log_status("ATA ERRO: Falha na gravacao do setor.", 0x0C);
+    return failed ? -1 : 0;
+}
+
+/**
+ * Manda o drive gravar o cache interno na midia (barreira de escrita).
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int ata_flush_cache() {
+    ata_acquire_channel();
+    ata_wait_not_busy();
+    outb(ATA_PORT_DRIVE_SEL, 0xE0);
+    outb(ATA_PORT_COMMAND, ATA_CMD_CACHE_FLUSH);
+    ata_wait_not_busy();
+    int failed = inb(ATA_PORT_COMMAND) & 0x01;
+    ata_release_channel();
+    return failed ? -1 : 0;
+}
+
+/**
+ * Capacidade do drive master (IDENTIFY DEVICE, palavras 60-61: setores LBA28).
+ * @return Numero de setores, ou 0 se nao ha drive.
+ */
+uint32_t ata_get_sector_count() {
+    uint16_t identify[SECTOR_SIZE / 2];
+
+    ata_acquire_channel();
+    ata_wait_not_busy();
+    outb(ATA_PORT_DRIVE_SEL, 0xA0);
+    outb(ATA_PORT_COMMAND, ATA_CMD_IDENTIFY);
+    if (inb(ATA_PORT_COMMAND) == 0) { // Status 0: nenhum drive no canal
+        ata_release_channel();
+        return 0;
+    }
+    if (ata_wait_ready_timeout() != 0) { // Drive mudo ou que nao aceita IDENTIFY
+        ata_release_channel();
+        return 0;
+    }
+    insw(ATA_PORT_DATA, identify, SECTOR_SIZE / 2);
+    ata_release_channel();
+
+    return (uint32_t)identify[60] | ((uint32_t)identify[61] << 16);
+}
+
+// =======================================================
+// E/S ASSINCRONA (sem pilha, conduzida pela IRQ14)
+// =======================================================
+
+typedef struct {
+    async_task_t task;
+    uint32_t lba;
+    uint32_t count;
+    uint8_t *buffer;
+    uint32_t sector;
+    uint8_t op;         // ATA_OP_READ / ATA_OP_WRITE / ATA_OP_FLUSH
+} AtaIoFrame;
+
+// Fim com erro: solta o canal para o proximo da fila
+static int ata_io_fail(async_task_t *t, const char *message) {
+    ui_log_status(message, 0x0C);
+    ata_release_channel();
+    t->status = -1;
+    return ASYNC_DONE;
+}
+
+static int ata_io_task(async_task_t *t) {
+    AtaIoFrame *f = (AtaIoFrame*)t;
+    ASYNC_BEGIN(t);
+
+    // 1. Espera o canal sem bloquear o executor (retesta a cada liberacao)
+    while (!mutex_trylock(&ata_channel_lock)) {
+        ASYNC_AWAIT(t, &ata_channel_free, 0);
+    }
+
+    ata_wait_not_busy();
+    async_event_reset(&ata_irq_event);
+
+    // 2a. FLUSH CACHE: uma IRQ quando o cache do drive chegou a midia
+    if (f->op == ATA_OP_FLUSH) {
+        outb(ATA_PORT_DRIVE_SEL, 0xE0);
+        outb(ATA_PORT_COMMAND, ATA_CMD_CACHE_FLUSH);
+        ASYNC_AWAIT(t, &ata_irq_event, ATA_ASYNC_TIMEOUT_TICKS);
+        if (t->result == ASYNC_TIMEOUT) return ata_io_fail(t, "ATA ERRO: Tempo esgotado esperando o disco.");
+        ata_wait_not_busy();
+        if (inb(ATA_PORT_COMMAND) & 0x01) return ata_io_fail(t, "ATA ERRO: Falha no FLUSH CACHE.");
+        ata_release_channel();
+        ASYNC_EXIT(t, 0);
+    }
+
+    // 2b. DMA: uma unica IRQ no fim do bloco inteiro
+    if (ata_use_dma(f->buffer)) {
+        if (ata_dma_start(f->lba, f->count, f->buffer, f->op == ATA_OP_WRITE) != 0) {
+            return ata_io_fail(t, "ATA ERRO: Buffer invalido para DMA.");
+        }
+        ASYNC_AWAIT(t, &ata_irq_event, ATA_ASYNC_TIMEOUT_TICKS);
+        if (t->result == ASYNC_TIMEOUT) {
+            outb(bm_base + BM_COMMAND, 0);
+            return ata_io_fail(t, "ATA ERRO: Tempo esgotado esperando o disco.");
+        }
+        if (ata_dma_finish() != 0) return ata_io_fail(t, "ATA ERRO: Falha na transferencia DMA.");
+        ata_release_channel();
+        ASYNC_EXIT(t, 0);
+    }
+
+    // 2c. PIO: a IRQ14 de cada setor retoma a tarefa
+    if (f->op == ATA_OP_READ) {
+        ata_issue_command(f->lba, f->count, ATA_CMD_READ_PIO);
+        for (f->sector = 0; f->sector < f->count; f->sector++) {
+            ASYNC_AWAIT(t, &ata_irq_event, ATA_ASYNC_TIMEOUT_TICKS);
+            if (t->result == ASYNC_TIMEOUT) return ata_io_fail(t, "ATA ERRO: Tempo esgotado esperando o disco.");
+
+            ata_wait_ready(); // BSY ja caiu: confirma o DRQ
+            insw(ATA_PORT_DATA, f->buffer + f->sector * SECTOR_SIZE, SECTOR_SIZE / 2);
+            if (inb(ATA_PORT_COMMAND) & 0x01) return ata_io_fail(t, "ATA ERRO: Falha na leitura do setor.");
+        }
+    } else {
+        // Na gravacao o primeiro DRQ vem sem IRQ; as seguintes sinalizam "setor aceito"
+        ata_issue_command(f->lba, f->count, ATA_CMD_WRITE_PIO);
+        for (f->sector = 0; f->sector < f->count; f->sector++) {
+            ata_wait_ready();
+            outsw(ATA_PORT_DATA, f->buffer + f->sector * SECTOR_SIZE, SECTOR_SIZE / 2);
+            ASYNC_AWAIT(t, &ata_irq_event, ATA_ASYNC_TIMEOUT_TICKS);
+            if (t->result == ASYNC_TIMEOUT) return ata_io_fail(t, "ATA ERRO: Tempo esgotado esperando o disco.");
+            if (inb(ATA_PORT_COMMAND) & 0x01) return ata_io_fail(t, "ATA ERRO: Falha na gravacao do setor.");
+        }
+    }
+
+    ata_release_channel();
+    ASYNC_EXIT(t, 0);
+    ASYNC_END(t);
+}
+
+static int ata_io_async(uint8_t op, uint32_t lba_address, uint32_t count, uint8_t* buffer,
+                        async_done_t done, void *ctx) {
+    if (op != ATA_OP_FLUSH && (count == 0 || count > ATA_MAX_SECTORS_PER_CMD)) return -1;
+
+    async_task_t *t = async_alloc(ata_io_task, sizeof(AtaIoFrame));
+    if (!t) return -1;
+
+    AtaIoFrame *f = (AtaIoFrame*)t;
+    f->lba = lba_address;
+    f->count = count;
+    f->buffer = buffer;
+    f->op = op;
+    t->done = done;
+    t->ctx = ctx;
+    async_start(t);
+    return 0;
+}
+
+/**
+ * Versao assincrona de ata_read_sectors(): retorna na hora e chama 'done'
+ * (com task->status 0 ou -1 e task->ctx = 'ctx') quando o ultimo setor chegar.
+ * Custa um quadro de ~60 bytes em vez de um processo com pilha propria.
+ * @return 0 se a leitura foi enfileirada, -1 se os parametros forem invalidos
+ *         ou faltar memoria.
+ */
+int ata_read_sectors_async(uint32_t lba_address, uint32_t count, uint8_t* buffer,
+                           async_done_t done, void *ctx) {
+    return ata_io_async(ATA_OP_READ, lba_address, count, buffer, done, ctx);
+}
+
+/**
+ * Versao assincrona de ata_write_sectors() (mesmo contrato de 'done').
+ * O buffer precisa continuar valido ate 'done'.
+ */
+int ata_write_sectors_async(uint32_t lba_address, uint32_t count, const uint8_t* buffer,
+                            async_done_t done, void *ctx) {
+    return ata_io_async(ATA_OP_WRITE, lba_address, count, (uint8_t*)buffer, done, ctx);
+}
+
+/**
+ * Versao assincrona de ata_flush_cache(): 'done' roda quando tudo que foi
+ * gravado antes ja esta na midia.
+ */
+int ata_flush_cache_async(async_done_t done, void *ctx) {
+    return ata_io_async(ATA_OP_FLUSH, 0, 0, 0, done, ctx);
+}
+
 // Buffer de teste para armazenar o primeiro setor
 static uint8_t boot_sector_data[SECTOR_SIZE];
 
 /**
- * Funcao de inicializacao do Driver ATA.
+ * Fim da leitura do setor de boot (chamada pelo executor assincrono).
  */
-void init_ata_driver() {
-    ui_draw_string("Driver ATA: Lendo Setor de Boot (LBA 0)...", 30, 0, 0x07);
-
-    if (ata_read_sector(0, boot_sector_data) == 0) {
+static void on_boot_sector_read(async_task_t *t) {
+    if (t->status == 0) {
         // Se a leitura foi bem-sucedida, loga os primeiros bytes do setor de boot
-        ui_log_status("ATA OK. Setor de Boot lido com sucesso.", 0x0A); // Verde
+        ui_log_status(ata_dma_enabled ? "ATA OK (DMA). Setor de Boot lido com sucesso."
+                                      : "ATA OK (PIO). Setor de Boot lido com sucesso.", 0x0A); // Verde
         
         // Em um OS real, voce checaria a assinatura MBR (0xAA55) aqui.
         if (boot_sector_data[510] == 0x55 && boot_sector_data[511] == 0xAA) {
@@ -91,3 +597,20 @@ void init_ata_driver() {
         ui_log_status("ATA ERRO: Falha ao inicializar o disco.", 0x0C);
     }
 }
+
+/**
+ * Funcao de inicializacao do Driver ATA.
+ */
+void init_ata_driver() {
+    wait_queue_init(&ata_wait_queue);
+    mutex_init(&ata_channel_lock);
+    ata_dma_enabled = ata_dma_probe();
+    apic_register_irq(ATA_IRQ, ata_interrupt_handler);
+
+    ui_draw_string("Driver ATA: Lendo Setor de Boot (LBA 0)...", 30, 0, 0x07);
+
+    // A leitura segue em segundo plano; on_boot_sector_read() mostra o resultado
+    if (ata_read_sectors_async(0, 1, boot_sector_data, on_boot_sector_read, 0) != 0) {
+        ui_log_status("ATA ERRO: Falha ao inicializar o disco.", 0x0C);
+    }
+}
@@ -0,0 +1,361 @@
+// async.c - Executor das tarefas assincronas sem pilha (ver async.h).
+//
+// Um unico processo do agendador ("executor") roda todas as tarefas prontas,
+// uma apos a outra, na mesma pilha: trocar de tarefa e so chamar outra funcao.
+// As IRQs apenas sinalizam eventos (colocam a tarefa na fila de prontos) e o
+// timer avanca uma roda de prazos.
+
+#include <stdint.h>
+#include "async.h"
+#include "../spinlock.h"
+#include "../../Tools/Agendador/sync.h"
+#include "../Lib/kmemory.h"
+#include "../Lib/kformat.h"
+
+extern void* kmalloc(uint32_t size);
+extern void kfree(void *ptr);
+extern void create_process(void (*entry_point)());
+extern int scheduler_current_pid();
+extern uint64_t read_tsc(); // Do cpu_diag.c
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern void ui_log_status(const char *status_msg, char color_byte);
+
+#define TIMER_WHEEL_SLOTS   64  // Potencia de 2
+
+// Estados da tarefa
+#define TASK_NEW        0
+#define TASK_RUNNABLE   1
+#define TASK_WAITING    2
+
+static spinlock_t async_lock = SPINLOCK_INIT;
+static async_task_t *ready_head = 0;
+static async_task_t *ready_tail = 0;
+static async_task_t *timer_wheel[TIMER_WHEEL_SLOTS];
+static volatile uint32_t async_ticks = 0;
+static wait_queue_t executor_wait_queue;
+static volatile int task_pid = -1;  // Processo que esta rodando uma tarefa (-1 = nenhum)
+
+// Estatisticas
+static uint32_t async_live_tasks = 0;
+static uint32_t async_steps = 0;
+
+// =======================================================
+// 1. FILA DE PRONTOS E RODA DE TIMERS (chamar com async_lock)
+// =======================================================
+
+static void ready_push_locked(async_task_t *task) {
+    task->state = TASK_RUNNABLE;
+    task->next = 0;
+    if (ready_tail) ready_tail->next = task;
+    else ready_head = task;
+    ready_tail = task;
+}
+
+static void timer_insert_locked(async_task_t *task, uint32_t timeout_ticks) {
+    task->deadline = async_ticks + timeout_ticks;
+    async_task_t **slot = &timer_wheel[task->deadline & (TIMER_WHEEL_SLOTS - 1)];
+    task->timer_next = *slot;
+    if (*slot) (*slot)->timer_pprev = &task->timer_next;
+    task->timer_pprev = slot;
+    *slot = task;
+}
+
+static void timer_remove_locked(async_task_t *task) {
+    if (!task->timer_pprev) return;
+    *task->timer_pprev = task->timer_next;
+    if (task->timer_next) task->timer_next->timer_pprev = task->timer_pprev;
+    task->timer_next = 0;
+    task->timer_pprev = 0;
+}
+
+// Tira a tarefa da fila de espera do seu evento (so no caminho do prazo)
+static void event_remove_locked(async_task_t *task) {
+    async_event_t *ev = task->event;
+    if (!ev) return;
+
+    async_task_t *prev = 0;
+    for (async_task_t *it = ev->head; it; prev = it, it = it->next) {
+        if (it != task) continue;
+        if (prev) prev->next = it->next;
+        else ev->head = it->next;
+        if (ev->tail == it) ev->tail = prev;
+        break;
+    }
+    task->event = 0;
+}
+
+// =======================================================
+// 2. EVENTOS
+// =======================================================
+
+void async_event_init(async_event_t *ev) {
+    ev->head = 0;
+    ev->tail = 0;
+    ev->signalled = 0;
+}
+
+/**
+ * Descarta um sinal guardado (antes de disparar um novo comando de I/O).
+ */
+void async_event_reset(async_event_t *ev) {
+    ev->signalled = 0;
+}
+
+/**
+ * Acorda a tarefa mais antiga esperando 'ev' (ou guarda o sinal).
+ * Pode ser chamada de rotinas de interrupcao.
+ */
+void async_signal(async_event_t *ev) {
+    uint32_t flags = spin_lock_irqsave(&async_lock);
+    async_task_t *task = ev->head;
+    if (task) {
+        ev->head = task->next;
+        if (!ev->head) ev->tail = 0;
+        task->event = 0;
+        task->result = ASYNC_OK;
+        timer_remove_locked(task);
+        ready_push_locked(task);
+    } else {
+        ev->signalled = 1;
+    }
+    spin_unlock_irqrestore(&async_lock, flags);
+
+    if (task) wait_queue_wake_one(&executor_wait_queue);
+}
+
+// =======================================================
+// 3. CICLO DE VIDA DAS TAREFAS
+// =======================================================
+
+/**
+ * Aloca o quadro de uma tarefa (zerado). O quadro comeca com um async_task_t
+ * e continua com o estado proprio da tarefa.
+ * @param frame_size sizeof() do quadro completo.
+ * @return A tarefa (ainda parada: preencha o quadro e chame async_start), ou 0.
+ */
+async_task_t* async_alloc(async_fn_t fn, uint32_t frame_size) {
+    if (frame_size < sizeof(async_task_t)) frame_size = sizeof(async_task_t);
+
+    uint8_t *frame = (uint8_t*)kmalloc(frame_size);
+    if (!frame) return 0;
+    kmemset(frame, 0, frame_size);
+
+    async_task_t *task = (async_task_t*)frame;
+    task->fn = fn;
+    task->state = TASK_NEW;
+    return task;
+}
+
+/**
+ * Coloca uma tarefa recem-alocada na fila de prontos.
+ */
+void async_start(async_task_t *task) {
+    uint32_t flags = spin_lock_irqsave(&async_lock);
+    async_live_tasks++;
+    ready_push_locked(task);
+    spin_unlock_irqrestore(&async_lock, flags);
+
+    wait_queue_wake_one(&executor_wait_queue);
+}
+
+/**
+ * Recoloca a tarefa na fila de prontos (ASYNC_YIELD).
+ */
+void async_make_ready(async_task_t *task) {
+    uint32_t flags = spin_lock_irqsave(&async_lock);
+    ready_push_locked(task);
+    spin_unlock_irqrestore(&async_lock, flags);
+}
+
+/**
+ * Parte de ASYNC_AWAIT: registra a tarefa no evento e/ou na roda de timers.
+ * @return 0 se o evento ja estava sinalizado (a tarefa segue sem parar),
+ *         1 se a tarefa deve devolver ASYNC_PENDING.
+ */
+int async_wait_prepare(async_task_t *task, async_event_t *ev, uint32_t timeout_ticks) {
+    uint32_t flags = spin_lock_irqsave(&async_lock);
+
+    if ((ev && ev->signalled) || (!ev && timeout_ticks == 0)) {
+        if (ev) ev->signalled = 0;
+        task->result = ASYNC_OK;
+        spin_unlock_irqrestore(&async_lock, flags);
+        return 0;
+    }
+
+    task->state = TASK_WAITING;
+    task->event = ev;
+    task->next = 0;
+    if (ev) {
+        if (ev->tail) ev->tail->next = task;
+        else ev->head = task;
+        ev->tail = task;
+    }
+    if (timeout_ticks) timer_insert_locked(task, timeout_ticks);
+
+    spin_unlock_irqrestore(&async_lock, flags);
+    return 1;
+}
+
+/**
+ * Avanca a roda de timers. Chamada pelo scheduler_timer_interrupt() (IRQ0).
+ */
+void async_timer_tick() {
+    int woke = 0;
+    uint32_t flags = spin_lock_irqsave(&async_lock);
+
+    async_ticks++;
+    async_task_t *task = timer_wheel[async_ticks & (TIMER_WHEEL_SLOTS - 1)];
+    while (task) {
+        async_task_t *next = task->timer_next;
+        // O slot mistura prazos de varias voltas da roda: so os vencidos saem
+        if ((int32_t)(task->deadline - async_ticks) <= 0) {
+            timer_remove_locked(task);
+            event_remove_locked(task);
+            task->result = ASYNC_TIMEOUT;
+            ready_push_locked(task);
+            woke = 1;
+        }
+        task = next;
+    }
+
+    spin_unlock_irqrestore(&async_lock, flags);
+    if (woke) wait_queue_wake_one(&executor_wait_queue);
+}
+
+/**
+ * Ticks do timer desde o init_async().
+ */
+uint32_t async_now() {
+    return async_ticks;
+}
+
+// =======================================================
+// 4. EXECUTOR
+// =======================================================
+
+/**
+ * Roda todas as tarefas prontas ate a fila esvaziar. Cada passo vai de um
+ * ponto de retomada ate o proximo ASYNC_AWAIT, sem troca de contexto.
+ */
+void async_run_ready() {
+    for (;;) {
+        uint32_t flags = spin_lock_irqsave(&async_lock);
+        async_task_t *task = ready_head;
+        if (task) {
+            ready_head = task->next;
+            if (!ready_head) ready_tail = 0;
+        }
+        spin_unlock_irqrestore(&async_lock, flags);
+        if (!task) return;
+
+        async_steps++;
+        task_pid = scheduler_current_pid();
+        int done = task->fn(task) == ASYNC_DONE;
+        if (done && task->done) task->done(task);
+        task_pid = -1;
+        if (!done) continue;
+
+        flags = spin_lock_irqsave(&async_lock);
+        async_live_tasks--;
+        spin_unlock_irqrestore(&async_lock, flags);
+        kfree(task);
+    }
+}
+
+/**
+ * Diz se o codigo atual roda dentro de uma tarefa (ou do seu 'done'). Ai
+ * nao se pode dormir esperando outra tarefa: ela nunca rodaria. Compara o
+ * pid porque a tarefa pode bloquear numa E/S e outro processo rodar.
+ */
+int async_in_task() {
+    return task_pid >= 0 && task_pid == scheduler_current_pid();
+}
+
+// Processo do executor: uma pilha para todas as tarefas assincronas
+static void async_executor_loop() {
+    for (;;) {
+        async_run_ready();
+        wait_event(&executor_wait_queue, ready_head != 0);
+    }
+}
+
+/**
+ * Inicializa o executor. Chamar depois de kmalloc_init() e antes dos drivers.
+ */
+void init_async() {
+    wait_queue_init(&executor_wait_queue);
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) timer_wheel[i] = 0;
+    create_process(async_executor_loop);
+    ui_log_status("Executor assincrono ativo.", 0x0A);
+}
+
+// =======================================================
+// 5. BENCHMARK (custo por tarefa e por passo)
+// =======================================================
+
+#define ASYNC_BENCH_TASKS   2000
+#define ASYNC_BENCH_STEPS   4
+#define PCB_STACK_BYTES     4096 // Pilha de um processo (STACK_SIZE_WORDS * 4)
+
+typedef struct {
+    async_task_t task;
+    async_event_t completion;   // "IRQ" desta operacao
+    uint32_t step;
+} AsyncBenchFrame;
+
+static AsyncBenchFrame *bench_frames[ASYNC_BENCH_TASKS];
+static uint32_t bench_finished;
+
+static int async_bench_task(async_task_t *t) {
+    AsyncBenchFrame *f = (AsyncBenchFrame*)t;
+    ASYNC_BEGIN(t);
+    for (f->step = 0; f->step < ASYNC_BENCH_STEPS; f->step++) {
+        ASYNC_AWAIT(t, &f->completion, 0);
+    }
+    ASYNC_EXIT(t, 0);
+    ASYNC_END(t);
+}
+
+static void async_bench_done(async_task_t *t) {
+    (void)t;
+    bench_finished++;
+}
+
+/**
+ * Cria ASYNC_BENCH_TASKS operacoes simultaneas, cada uma esperando
+ * ASYNC_BENCH_STEPS "completions", e as conduz sinalizando os eventos
+ * como uma IRQ faria. Mostra bytes por operacao e ciclos por passo.
+ */
+void async_run_benchmark(int row) {
+    char buffer[12];
+    uint32_t created = 0;
+    bench_finished = 0;
+
+    for (; created < ASYNC_BENCH_TASKS; created++) {
+        async_task_t *t = async_alloc(async_bench_task, sizeof(AsyncBenchFrame));
+        if (!t) break;
+        t->done = async_bench_done;
+        bench_frames[created] = (AsyncBenchFrame*)t;
+        async_start(t);
+    }
+
+    uint64_t start = read_tsc();
+    async_run_ready(); // Todas param no primeiro AWAIT
+    for (int s = 0; s < ASYNC_BENCH_STEPS; s++) {
+        // Os quadros sao liberados no ultimo passo: nao toque neles depois
+        for (uint32_t i = 0; i < created; i++) async_signal(&bench_frames[i]->completion);
+        async_run_ready();
+    }
+    uint64_t cycles = read_tsc() - start;
+    uint32_t steps = created * (ASYNC_BENCH_STEPS + 1);
+
+    // "Async: <n> ops  <b> B/op (pilha 4096)  <c> ciclos/passo"
+    ui_draw_string("Async ops:", row, 0, 0x0B);
+    ui_draw_string(u32_to_str(bench_finished, buffer, 12), row, 11, 0x0F);
+    ui_draw_string("B/op:", row, 18, 0x0B);
+    ui_draw_string(u32_to_str(sizeof(AsyncBenchFrame), buffer, 12), row, 24, 0x0F);
+    ui_draw_string("(pilha", row, 29, 0x07);
+    ui_draw_string(u32_to_str(PCB_STACK_BYTES, buffer, 12), row, 36, 0x07);
+    ui_draw_string(") ciclos/passo:", row, 40, 0x0B);
+    ui_draw_string(u32_to_str(steps ? (uint32_t)(cycles / steps) : 0, buffer, 12), row, 56, 0x0F);
+}
@@ -0,0 +1,120 @@
+// async.h - Executor de tarefas assincronas sem pilha do Core-Blip.
+//
+// Uma tarefa assincrona e uma funcao retomavel (estilo "protothread"): o
+// estado que precisa sobreviver entre os passos fica num quadro pequeno
+// alocado com kmalloc(), e nao numa pilha de 4KB. A tarefa devolve o controle
+// ao executor em cada ASYNC_AWAIT e e retomada no mesmo ponto quando o evento
+// esperado (IRQ de fim de I/O) chega ou o prazo (em ticks do timer) acaba.
+//
+// Uso:
+//   typedef struct { async_task_t task; uint32_t i; } MeuQuadro;
+//
+//   static int minha_tarefa(async_task_t *t) {
+//       MeuQuadro *f = (MeuQuadro*)t;
+//       ASYNC_BEGIN(t);
+//       for (f->i = 0; f->i < 4; f->i++) {
+//           ASYNC_AWAIT(t, &evento_da_irq, 100);
+//           if (t->result == ASYNC_TIMEOUT) ASYNC_EXIT(t, -1);
+//       }
+//       ASYNC_EXIT(t, 0);
+//       ASYNC_END(t);
+//   }
+//
+// Regras (as mesmas de qualquer protothread):
+//   - Variaveis locais NAO sobrevivem a um ASYNC_AWAIT: guarde-as no quadro.
+//   - Nao use 'switch' em volta de um ASYNC_AWAIT, nem dois AWAITs na mesma linha.
+
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include <stdint.h>
+
+// Retorno das funcoes de tarefa
+#define ASYNC_PENDING   0   // Esperando um evento: o executor a retoma depois
+#define ASYNC_DONE      1   // Terminou: o executor chama 'done' e libera o quadro
+
+// Resultado do ultimo ASYNC_AWAIT (em task->result)
+#define ASYNC_OK        0
+#define ASYNC_TIMEOUT   1
+
+typedef struct async_task async_task_t;
+typedef struct async_event async_event_t;
+
+typedef int (*async_fn_t)(async_task_t *task);
+typedef void (*async_done_t)(async_task_t *task);
+
+struct async_task {
+    async_fn_t fn;
+    async_done_t done;          // Chamado ao terminar, antes do quadro ser liberado
+    void *ctx;                  // Livre para quem criou a tarefa
+    async_task_t *next;         // Fila de prontos ou fila de espera do evento
+    async_task_t *timer_next;   // Roda de timers
+    async_task_t **timer_pprev;
+    async_event_t *event;       // Evento esperado (0 = nenhum)
+    uint32_t deadline;          // Tick do prazo (se estiver na roda de timers)
+    uint16_t line;              // Ponto de retomada (0 = inicio)
+    uint8_t state;
+    int8_t result;              // ASYNC_OK / ASYNC_TIMEOUT
+    int32_t status;             // Codigo de saida (ASYNC_EXIT)
+};
+
+/**
+ * Evento que as tarefas esperam. async_signal() acorda a mais antiga; se
+ * ninguem estiver esperando, o sinal fica guardado para o proximo AWAIT.
+ */
+struct async_event {
+    async_task_t *head;
+    async_task_t *tail;
+    volatile uint8_t signalled;
+};
+
+#define ASYNC_EVENT_INIT { 0, 0, 0 }
+
+void async_event_init(async_event_t *ev);
+void async_event_reset(async_event_t *ev);
+void async_signal(async_event_t *ev);
+
+async_task_t* async_alloc(async_fn_t fn, uint32_t frame_size);
+void async_start(async_task_t *task);
+int async_wait_prepare(async_task_t *task, async_event_t *ev, uint32_t timeout_ticks);
+void async_make_ready(async_task_t *task);
+void async_run_ready();
+void async_timer_tick();
+uint32_t async_now();
+int async_in_task();
+
+#define ASYNC_BEGIN(t)  switch ((t)->line) { case 0:
+
+#define ASYNC_END(t)    } (t)->line = 0; return ASYNC_DONE
+
+/**
+ * Suspende a tarefa ate 'ev' ser sinalizado ou passarem 'timeout_ticks'
+ * (0 = sem prazo). Ao voltar, (t)->result diz qual dos dois aconteceu.
+ */
+#define ASYNC_AWAIT(t, ev, timeout_ticks)                               \
+    do {                                                                \
+        (t)->line = __LINE__;                                           \
+        if (async_wait_prepare((t), (ev), (timeout_ticks))) return ASYNC_PENDING; \
+        case __LINE__:;                                                 \
+    } while (0)
+
+// Dorme 'ticks' ticks do timer
+#define ASYNC_SLEEP(t, ticks)   ASYNC_AWAIT(t, 0, ticks)
+
+// Devolve o executor para as outras tarefas prontas e volta em seguida
+#define ASYNC_YIELD(t)                                                  \
+    do {                                                                \
+        (t)->line = __LINE__;                                           \
+        async_make_ready(t);                                            \
+        return ASYNC_PENDING;                                           \
+        case __LINE__:;                                                 \
+    } while (0)
+
+// Termina a tarefa com o codigo 'code' (lido pelo callback 'done' em task->status)
+#define ASYNC_EXIT(t, code)                                             \
+    do {                                                                \
+        (t)->status = (code);                                           \
+        return ASYNC_DONE;                                              \
+    } while (0)
+
+#endif
@@ -0,0 +1,914 @@
+// hibernate.c - Hibernacao e retomada do Core-Blip.
+//
+// hibernate() congela o sistema (interrupcoes desligadas), comprime cada
+// pagina em uso (Kernel, tabela de descritores e tudo que o buddy entregou:
+// PCBs, pilhas, quadros das tarefas, estado dos drivers) para um pool em
+// memoria e so depois grava a imagem na area reservada do disco, logo apos
+// o volume BlipFS. O sistema continua congelado durante a gravacao (o disco
+// e usado so por nos, por espera ativa) e a maquina e desligada no fim:
+// nada escreve no disco depois da copia, entao disco e imagem nunca
+// divergem. O cabecalho e gravado por ultimo: imagem pela metade nunca e
+// valida.
+//
+// No boot, hibernate_try_resume() acha a imagem, le tudo em transferencias
+// sequenciais de 128KB e descomprime cada pagina numa pagina "segura" (livre
+// agora e que nao e destino de nenhuma pagina da imagem). Por fim uma rotina
+// em Assembly, so com registradores, copia as paginas para o lugar, recarrega
+// GDT/IDT/CR0/CR3/CR4 e volta para dentro de hibernate() como se ela tivesse
+// acabado de salvar. So o estado do hardware e refeito (ganchos registrados
+// pelos drivers com hibernate_register_resume()).
+//
+// A imagem so vale para o mesmo binario do Kernel e o mesmo mapa de memoria.
+// hibernate_try_resume() deve ser chamada no boot depois de pmm_init(),
+// kmalloc_init() e da configuracao de GDT/IDT/PIC/PIT, antes de criar processos.
+
+#include <stdint.h>
+#include "hibernate.h"
+#include "../spinlock.h"
+#include "../Lib/kmemory.h"
+#include "../Lib/kformat.h"
+#include "../Lib/adler32.h"
+#include "../../Tools/CPU/fpu_context.h"
+#include "../../Tools/Sistema de arquivos/blipfs_format.h"
+
+extern uint8_t _kernel_end[];   // Do script do linker
+
+extern uint32_t alloc_pages(int order);
+extern void free_pages(uint32_t address, int order);
+extern uint32_t pmm_max_pfn();
+extern int pmm_is_kernel_page(uint32_t pfn);
+extern int pmm_block_state(uint32_t pfn, uint32_t *pages);
+extern int ata_read_sectors(uint32_t lba_address, uint32_t count, uint8_t* buffer);
+extern int ata_write_sectors(uint32_t lba_address, uint32_t count, const uint8_t* buffer);
+extern int ata_flush_cache();
+extern uint32_t ata_get_sector_count();
+extern void ata_freeze();                           // Do ata_driver.c
+extern void ata_thaw();
+extern void outw(uint16_t port, uint16_t value);
+extern int bcache_sync();                           // Do block_cache.c
+extern void scheduler_rebase_clock();               // Do scheduler.c
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles);  // Do cpu_diag.c
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+
+#define PAGE_SIZE           4096
+#define PAGE_SHIFT          12
+#define SECTOR_SIZE         512
+#define MAX_PAGE_ORDER      10
+#define LOW_MEMORY_PFN      0x100   // Abaixo de 1MB (BIOS/VGA) nada e salvo
+
+#define HIB_MAGIC           0x42494842 // "BHIB"
+#define HIB_VERSION         3
+#define HIB_IO_SECTORS      256     // Setores por comando ATA (128KB)
+#define HIB_IO_ORDER        5       // Buffer de leitura: 32 paginas = 128KB
+#define HIB_MAX_BLOCKS      128     // Blocos do pool (quase todos de 4MB)
+#define HIB_MAX_HOOKS       16
+
+// Desligamento ACPI do QEMU (PIIX4, e o antigo do Bochs): SLP_TYP 5 | SLP_EN
+#define ACPI_PM1A_QEMU      0x604
+#define ACPI_PM1A_BOCHS     0xB004
+#define ACPI_SLEEP_S5       0x2000
+
+// Tipo de cada pagina na tabela (2 bits baixos da entrada; o resto e o PFN)
+#define HIB_PAGE_ZERO       0       // Pagina toda zerada: nao vai para o fluxo
+#define HIB_PAGE_LZ         1       // Tamanho (16 bits) + dados comprimidos
+#define HIB_PAGE_RAW        2       // 4096 bytes sem compressao
+#define HIB_ENTRY(pfn, kind) (((pfn) << 2) | (kind))
+
+// Compressor LZ (formato no estilo do LZ4, uma pagina por vez)
+#define LZ_MIN_MATCH        4
+#define LZ_HASH_BITS        12
+#define LZ_HASH_SIZE        (1 << LZ_HASH_BITS)
+
+// Cabecalho da imagem (primeiro setor da area)
+typedef struct {
+    uint32_t magic;             // HIB_MAGIC; 0 = imagem ja consumida
+    uint32_t version;
+    uint32_t kernel_end;        // Mesmo binario do Kernel...
+    uint32_t restore_entry;
+    uint32_t max_pfn;           // ...e mesmo mapa de memoria
+    uint32_t page_count;        // Entradas da tabela (logo apos o cabecalho)
+    uint32_t zero_pages;
+    uint32_t table_sectors;
+    uint32_t data_sectors;      // Fluxo comprimido (logo apos a tabela)
+    uint32_t data_bytes;
+    uint32_t data_checksum;     // Adler-32 do fluxo
+    uint32_t table_checksum;    // Adler-32 das page_count entradas da tabela
+    uint32_t save_ms;           // Do pedido ate o cabecalho (a maquina desliga em seguida)
+    uint32_t header_checksum;   // Adler-32 dos campos acima
+    uint8_t reserved[SECTOR_SIZE - 14 * 4];
+} HibHeader;
+
+// Registradores salvos por hib_save_context() (deslocamentos usados no Assembly)
+typedef struct {
+    uint32_t ebx, esi, edi, ebp;    // 0, 4, 8, 12
+    uint32_t esp, eip, eflags;      // 16, 20, 24
+    uint32_t cr0, cr3, cr4;         // 28, 32, 36
+    uint8_t gdtr[8];                // 40
+    uint8_t idtr[8];                // 48
+} HibernateContext;
+
+// Uma copia da retomada: 'source' 0 = zerar a pagina
+typedef struct {
+    uint32_t target;
+    uint32_t source;
+} HibCopy;
+
+typedef struct {
+    uint32_t address;
+    int order;
+} HibBlock;
+
+HibernateContext hibernate_cpu_context; // Global: lido pelo Assembly
+
+// Pool da imagem em memoria (excluido da propria imagem)
+static HibBlock hib_blocks[HIB_MAX_BLOCKS];
+static int hib_block_count = 0;
+static int hib_stream_first = 0;    // Primeiro bloco do fluxo comprimido
+static uint32_t *hib_hash = 0;      // Tabela do compressor
+static uint32_t *hib_table = 0;     // Tabela de paginas
+static uint32_t hib_table_capacity = 0;
+static uint8_t *hib_scratch = 0;    // Uma pagina comprimida (tamanho + dados)
+
+// Estado do fluxo (gravacao e leitura)
+static int stream_block = 0;
+static uint32_t stream_offset = 0;
+static uint32_t stream_bytes = 0;
+static uint32_t stream_checksum = ADLER32_INIT;
+static uint8_t *reader_buffer = 0;
+static uint32_t reader_pos = 0;
+static uint32_t reader_len = 0;
+static uint32_t reader_lba = 0;
+static uint32_t reader_sectors_left = 0;
+
+static uint32_t hib_page_count = 0;
+static uint32_t hib_zero_pages = 0;
+static uint16_t lz_generation = 0;
+
+static uint32_t hib_area_lba = 0;
+static uint32_t hib_disk_sectors = 0;
+static uint8_t hib_sector[SECTOR_SIZE];
+static HibHeader hib_last_header;   // Ultima imagem gravada ou retomada
+static uint32_t hib_saved_flags = 0;
+
+static hibernate_resume_fn resume_hooks[HIB_MAX_HOOKS];
+static int resume_hook_count = 0;
+
+// Medicoes de tempo ate o prompt (ms desde o reset da CPU, pelo TSC)
+static uint32_t hib_cold_boot_ms = 0;
+static uint32_t hib_resume_ms = 0;
+static uint32_t hib_save_ms = 0;
+
+// =======================================================
+// 1. CONTEXTO DA CPU (Assembly)
+// =======================================================
+
+// Tipo setjmp: devolve 0 ao salvar e 1 quando a retomada volta por aqui
+extern int hib_save_context() __attribute__((returns_twice));
+extern void hib_restore_pages(HibCopy *copies, uint32_t count) __attribute__((noreturn));
+
+__asm__ (
+    ".globl hib_save_context\n"
+    "hib_save_context:\n"
+    "    movl %ebx, hibernate_cpu_context+0\n"
+    "    movl %esi, hibernate_cpu_context+4\n"
+    "    movl %edi, hibernate_cpu_context+8\n"
+    "    movl %ebp, hibernate_cpu_context+12\n"
+    "    leal 4(%esp), %eax\n"              // ESP depois do 'ret'
+    "    movl %eax, hibernate_cpu_context+16\n"
+    "    movl (%esp), %eax\n"               // Endereco de retorno
+    "    movl %eax, hibernate_cpu_context+20\n"
+    "    pushfl\n"
+    "    popl hibernate_cpu_context+24\n"
+    "    movl %cr0, %eax\n"
+    "    movl %eax, hibernate_cpu_context+28\n"
+    "    movl %cr3, %eax\n"
+    "    movl %eax, hibernate_cpu_context+32\n"
+    "    movl %cr4, %eax\n"
+    "    movl %eax, hibernate_cpu_context+36\n"
+    "    sgdt hibernate_cpu_context+40\n"
+    "    sidt hibernate_cpu_context+48\n"
+    "    xorl %eax, %eax\n"
+    "    ret\n"
+);
+
+// Copia final. Nao usa pilha: a pilha atual e uma das paginas sobrescritas.
+// O codigo tambem e sobrescrito, mas com os mesmos bytes (mesmo binario).
+__asm__ (
+    ".globl hib_restore_pages\n"
+    "hib_restore_pages:\n"
+    "    movl 4(%esp), %ebx\n"              // HibCopy*
+    "    movl 8(%esp), %edx\n"              // Quantidade
+    "    cld\n"
+    "1:  testl %edx, %edx\n"
+    "    jz 4f\n"
+    "    movl (%ebx), %edi\n"
+    "    movl 4(%ebx), %esi\n"
+    "    movl $1024, %ecx\n"
+    "    testl %esi, %esi\n"
+    "    jz 2f\n"
+    "    rep movsl\n"
+    "    jmp 3f\n"
+    "2:  xorl %eax, %eax\n"
+    "    rep stosl\n"
+    "3:  addl $8, %ebx\n"
+    "    decl %edx\n"
+    "    jmp 1b\n"
+    "4:  lgdt hibernate_cpu_context+40\n"   // A memoria ja e a da imagem
+    "    lidt hibernate_cpu_context+48\n"
+    "    movl hibernate_cpu_context+36, %eax\n"
+    "    movl %eax, %cr4\n"
+    "    movl hibernate_cpu_context+32, %eax\n"
+    "    movl %eax, %cr3\n"
+    "    movl hibernate_cpu_context+28, %eax\n"
+    "    movl %eax, %cr0\n"
+    "    movl hibernate_cpu_context+0, %ebx\n"
+    "    movl hibernate_cpu_context+4, %esi\n"
+    "    movl hibernate_cpu_context+8, %edi\n"
+    "    movl hibernate_cpu_context+12, %ebp\n"
+    "    movl hibernate_cpu_context+16, %esp\n"
+    "    pushl hibernate_cpu_context+24\n"
+    "    popfl\n"
+    "    movl $1, %eax\n"                   // hib_save_context() "devolve" 1
+    "    jmp *hibernate_cpu_context+20\n"
+);
+
+// =======================================================
+// 2. COMPRESSAO LZ POR PAGINA
+// =======================================================
+
+static uint32_t load32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Escreve o resto de um comprimento >= 15 (bytes 255 + ultimo byte)
+static int lz_put_length(uint8_t *out, uint32_t *op, uint32_t out_max, uint32_t length) {
+    while (length >= 255) {
+        if (*op >= out_max) return -1;
+        out[(*op)++] = 255;
+        length -= 255;
+    }
+    if (*op >= out_max) return -1;
+    out[(*op)++] = (uint8_t)length;
+    return 0;
+}
+
+// Uma sequencia: literais [src, src+literals) e depois (offset, match) se match > 0
+static int lz_put_sequence(uint8_t *out, uint32_t *op, uint32_t out_max, const uint8_t *src,
+                           uint32_t literals, uint32_t offset, uint32_t match) {
+    uint32_t lit_code = literals < 15 ? literals : 15;
+    uint32_t match_code = 0;
+    if (match) match_code = (match - LZ_MIN_MATCH) < 15 ? (match - LZ_MIN_MATCH) : 15;
+
+    if (*op >= out_max) return -1;
+    out[(*op)++] = (uint8_t)((lit_code << 4) | match_code);
+    if (lit_code == 15 && lz_put_length(out, op, out_max, literals - 15) != 0) return -1;
+
+    if (*op + literals > out_max) return -1;
+    for (uint32_t i = 0; i < literals; i++) out[(*op)++] = src[i];
+    if (!match) return 0;
+
+    if (*op + 2 > out_max) return -1;
+    out[(*op)++] = (uint8_t)(offset & 0xFF);
+    out[(*op)++] = (uint8_t)(offset >> 8);
+    if (match_code == 15 && lz_put_length(out, op, out_max, match - LZ_MIN_MATCH - 15) != 0) return -1;
+    return 0;
+}
+
+/**
+ * Comprime uma pagina. A tabela de hash guarda (geracao << 16 | posicao):
+ * trocar de geracao "limpa" a tabela sem escrever nela.
+ * @return Tamanho comprimido, ou 0 se nao coube em 'out_max' bytes.
+ */
+static uint32_t lz_compress_page(const uint8_t *src, uint8_t *out, uint32_t out_max, uint32_t *table) {
+    if (++lz_generation == 0) {
+        for (int i = 0; i < LZ_HASH_SIZE; i++) table[i] = 0;
+        lz_generation = 1;
+    }
+
+    uint32_t ip = 0, anchor = 0, op = 0;
+    while (ip + LZ_MIN_MATCH <= PAGE_SIZE) {
+        uint32_t value = load32(src + ip);
+        uint32_t h = (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+        uint32_t entry = table[h];
+        table[h] = ((uint32_t)lz_generation << 16) | ip;
+
+        if ((entry >> 16) == lz_generation && load32(src + (entry & 0xFFFF)) == value) {
+            uint32_t ref = entry & 0xFFFF;
+            uint32_t match = LZ_MIN_MATCH;
+            while (ip + match < PAGE_SIZE && src[ref + match] == src[ip + match]) match++;
+
+            if (lz_put_sequence(out, &op, out_max, src + anchor, ip - anchor, ip - ref, match) != 0) return 0;
+            ip += match;
+            anchor = ip;
+            continue;
+        }
+        ip++;
+    }
+
+    if (anchor < PAGE_SIZE &&
+        lz_put_sequence(out, &op, out_max, src + anchor, PAGE_SIZE - anchor, 0, 0) != 0) return 0;
+    return op;
+}
+
+// Le o resto de um comprimento >= 15
+static int lz_get_length(const uint8_t *in, uint32_t *ip, uint32_t in_len, uint32_t *length) {
+    uint8_t b;
+    do {
+        if (*ip >= in_len) return -1;
+        b = in[(*ip)++];
+        *length += b;
+    } while (b == 255);
+    return 0;
+}
+
+/**
+ * Descomprime uma pagina (confere todos os limites: a imagem vem do disco).
+ * @return 0 se gerou exatamente PAGE_SIZE bytes, -1 se os dados estao corrompidos.
+ */
+static int lz_decompress_page(const uint8_t *in, uint32_t in_len, uint8_t *dest) {
+    uint32_t ip = 0, op = 0;
+    while (ip < in_len) {
+        uint8_t token = in[ip++];
+
+        uint32_t literals = token >> 4;
+        if (literals == 15 && lz_get_length(in, &ip, in_len, &literals) != 0) return -1;
+        if (op + literals > PAGE_SIZE || ip + literals > in_len) return -1;
+        for (uint32_t i = 0; i < literals; i++) dest[op++] = in[ip++];
+        if (op == PAGE_SIZE) break; // Ultima sequencia: so literais
+
+        if (ip + 2 > in_len) return -1;
+        uint32_t offset = (uint32_t)in[ip] | ((uint32_t)in[ip + 1] << 8);
+        ip += 2;
+        uint32_t match = (token & 0x0F) + LZ_MIN_MATCH;
+        if ((token & 0x0F) == 15 && lz_get_length(in, &ip, in_len, &match) != 0) return -1;
+        if (offset == 0 || offset > op || op + match > PAGE_SIZE) return -1;
+
+        // Byte a byte: a copia pode se sobrepor (repeticoes curtas)
+        for (uint32_t i = 0; i < match; i++, op++) dest[op] = dest[op - offset];
+    }
+    return op == PAGE_SIZE ? 0 : -1;
+}
+
+static int page_is_zero(const uint32_t *page) {
+    for (int i = 0; i < PAGE_SIZE / 4; i++) {
+        if (page[i]) return 0;
+    }
+    return 1;
+}
+
+// =======================================================
+// 3. POOL EM MEMORIA E FLUXO COMPRIMIDO
+// =======================================================
+
+static int order_for(uint32_t bytes) {
+    uint32_t order = 0;
+    while (((uint32_t)PAGE_SIZE << order) < bytes) order++;
+    return (int)order;
+}
+
+static uint32_t pool_add(int order) {
+    if (hib_block_count == HIB_MAX_BLOCKS || order > MAX_PAGE_ORDER) return 0;
+    uint32_t address = alloc_pages(order);
+    if (!address) return 0;
+    hib_blocks[hib_block_count].address = address;
+    hib_blocks[hib_block_count].order = order;
+    hib_block_count++;
+    return address;
+}
+
+static void pool_release() {
+    for (int i = 0; i < hib_block_count; i++) {
+        free_pages(hib_blocks[i].address, hib_blocks[i].order);
+    }
+    hib_block_count = 0;
+}
+
+// O bloco que comeca em 'pfn' pertence ao pool?
+static int pool_owns(uint32_t pfn) {
+    for (int i = 0; i < hib_block_count; i++) {
+        if ((hib_blocks[i].address >> PAGE_SHIFT) == pfn) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Reserva tabela, buffers e espaco para o pior caso do fluxo (paginas sem
+ * compressao), com os maiores blocos que o buddy tiver. Se faltar memoria o
+ * fluxo pode ainda caber, pois quase tudo comprime.
+ */
+static int pool_reserve(uint32_t pages) {
+    hib_block_count = 0;
+    hib_hash = (uint32_t*)pool_add(order_for(LZ_HASH_SIZE * 4));
+    hib_scratch = (uint8_t*)pool_add(order_for(PAGE_SIZE + 2));
+    hib_table_capacity = pages;
+    hib_table = (uint32_t*)pool_add(order_for(pages * 4));
+    if (!hib_hash || !hib_scratch || !hib_table) return -1;
+    for (int i = 0; i < LZ_HASH_SIZE; i++) hib_hash[i] = 0;
+    lz_generation = 0;
+
+    hib_stream_first = hib_block_count;
+    uint64_t needed = (uint64_t)pages * (PAGE_SIZE + 2);
+    while (needed > 0 && hib_block_count < HIB_MAX_BLOCKS) {
+        int order = MAX_PAGE_ORDER;
+        while (order > 0 && (uint64_t)(PAGE_SIZE << (order - 1)) >= needed) order--;
+        uint32_t block = 0;
+        for (; order >= 0 && !block; order--) block = pool_add(order);
+        if (!block) break;
+        uint32_t size = PAGE_SIZE << hib_blocks[hib_block_count - 1].order;
+        needed = needed > size ? needed - size : 0;
+    }
+    return hib_block_count > hib_stream_first ? 0 : -1;
+}
+
+static void stream_reset() {
+    stream_block = hib_stream_first;
+    stream_offset = 0;
+    stream_bytes = 0;
+    stream_checksum = ADLER32_INIT;
+}
+
+static int stream_put(const uint8_t *data, uint32_t n) {
+    stream_checksum = adler32(stream_checksum, data, n);
+    stream_bytes += n;
+
+    while (n > 0) {
+        if (stream_block >= hib_block_count) return -1; // Pool cheio
+        HibBlock *block = &hib_blocks[stream_block];
+        uint32_t room = (PAGE_SIZE << block->order) - stream_offset;
+        uint32_t chunk = n < room ? n : room;
+
+        kmemcpy((uint8_t*)block->address + stream_offset, data, chunk);
+        data += chunk;
+        n -= chunk;
+        stream_offset += chunk;
+        if (stream_offset == ((uint32_t)PAGE_SIZE << block->order)) {
+            stream_block++;
+            stream_offset = 0;
+        }
+    }
+    return 0;
+}
+
+static void reader_start(uint32_t lba, uint32_t sectors) {
+    reader_pos = 0;
+    reader_len = 0;
+    reader_lba = lba;
+    reader_sectors_left = sectors;
+    stream_bytes = 0;
+    stream_checksum = ADLER32_INIT;
+}
+
+// Le do fluxo no disco, em transferencias de HIB_IO_SECTORS setores
+static int reader_get(uint8_t *dest, uint32_t n) {
+    while (n > 0) {
+        if (reader_pos == reader_len) {
+            uint32_t sectors = reader_sectors_left < HIB_IO_SECTORS ? reader_sectors_left : HIB_IO_SECTORS;
+            if (sectors == 0 || ata_read_sectors(reader_lba, sectors, reader_buffer) != 0) return -1;
+            reader_lba += sectors;
+            reader_sectors_left -= sectors;
+            reader_len = sectors * SECTOR_SIZE;
+            reader_pos = 0;
+        }
+
+        uint32_t chunk = reader_len - reader_pos;
+        if (chunk > n) chunk = n;
+        kmemcpy(dest, reader_buffer + reader_pos, chunk);
+        stream_checksum = adler32(stream_checksum, dest, chunk);
+        stream_bytes += chunk;
+        reader_pos += chunk;
+        dest += chunk;
+        n -= chunk;
+    }
+    return 0;
+}
+
+// Grava 'sectors' setores contiguos em comandos de HIB_IO_SECTORS
+static int write_region(const uint8_t *data, uint32_t sectors, uint32_t *lba) {
+    while (sectors > 0) {
+        uint32_t n = sectors < HIB_IO_SECTORS ? sectors : HIB_IO_SECTORS;
+        if (ata_write_sectors(*lba, n, data) != 0) return -1;
+        *lba += n;
+        data += n * SECTOR_SIZE;
+        sectors -= n;
+    }
+    return 0;
+}
+
+static int read_region(uint8_t *data, uint32_t sectors, uint32_t lba) {
+    while (sectors > 0) {
+        uint32_t n = sectors < HIB_IO_SECTORS ? sectors : HIB_IO_SECTORS;
+        if (ata_read_sectors(lba, n, data) != 0) return -1;
+        lba += n;
+        data += n * SECTOR_SIZE;
+        sectors -= n;
+    }
+    return 0;
+}
+
+// =======================================================
+// 4. AREA NO DISCO E CABECALHO
+// =======================================================
+
+/**
+ * A area de hibernacao comeca no primeiro setor depois do volume BlipFS e
+ * vai ate o fim do disco.
+ */
+static int locate_area() {
+    if (ata_read_sectors(BLIPFS_SUPER_LBA, 1, hib_sector) != 0) return -1;
+    BlipfsSuperblock *super = (BlipfsSuperblock*)hib_sector;
+    if (super->magic != BLIPFS_MAGIC) return -1;
+
+    hib_area_lba = super->total_sectors;
+    hib_disk_sectors = ata_get_sector_count();
+    return hib_disk_sectors > hib_area_lba + 1 ? 0 : -1;
+}
+
+static uint32_t header_checksum(const HibHeader *header) {
+    return adler32(ADLER32_INIT, (const uint8_t*)header, __builtin_offsetof(HibHeader, header_checksum));
+}
+
+static int header_valid(const HibHeader *header) {
+    return header->magic == HIB_MAGIC &&
+           header->version == HIB_VERSION &&
+           header->kernel_end == (uint32_t)_kernel_end &&
+           header->restore_entry == (uint32_t)hib_restore_pages &&
+           header->max_pfn == pmm_max_pfn() &&
+           header->header_checksum == header_checksum(header) &&
+           hib_area_lba + 1 + header->table_sectors + header->data_sectors <= hib_disk_sectors;
+}
+
+// =======================================================
+// 5. HIBERNAR
+// =======================================================
+
+// Paginas que entram na imagem: Kernel + tabela do buddy + blocos alocados
+static uint32_t count_image_pages() {
+    uint32_t count = 0, pages;
+    uint32_t max_pfn = pmm_max_pfn();
+    for (uint32_t pfn = LOW_MEMORY_PFN; pfn < max_pfn; pfn += pages) {
+        int state = pmm_block_state(pfn, &pages);
+        if (state > 0) count += pages;
+        else if (state < 0 && pmm_is_kernel_page(pfn)) count++;
+    }
+    return count;
+}
+
+static int save_page(uint32_t pfn) {
+    if (hib_page_count == hib_table_capacity) return -1;
+    const uint8_t *page = (const uint8_t*)(pfn << PAGE_SHIFT);
+
+    if (page_is_zero((const uint32_t*)page)) {
+        hib_table[hib_page_count++] = HIB_ENTRY(pfn, HIB_PAGE_ZERO);
+        hib_zero_pages++;
+        return 0;
+    }
+
+    uint32_t size = lz_compress_page(page, hib_scratch + 2, PAGE_SIZE - 1, hib_hash);
+    if (size) {
+        hib_scratch[0] = (uint8_t)(size & 0xFF);
+        hib_scratch[1] = (uint8_t)(size >> 8);
+        hib_table[hib_page_count++] = HIB_ENTRY(pfn, HIB_PAGE_LZ);
+        return stream_put(hib_scratch, size + 2);
+    }
+    hib_table[hib_page_count++] = HIB_ENTRY(pfn, HIB_PAGE_RAW);
+    return stream_put(page, PAGE_SIZE);
+}
+
+/**
+ * Copia atomica: com as interrupcoes desligadas, nada alem desta funcao mexe
+ * na memoria. As paginas do pool ficam de fora.
+ */
+static int snapshot_pages() {
+    uint32_t pages;
+    uint32_t max_pfn = pmm_max_pfn();
+
+    stream_reset();
+    hib_page_count = 0;
+    hib_zero_pages = 0;
+
+    for (uint32_t pfn = LOW_MEMORY_PFN; pfn < max_pfn; pfn += pages) {
+        int state = pmm_block_state(pfn, &pages);
+        if (state < 0 && !pmm_is_kernel_page(pfn)) continue;
+        if (state == 0 || (state > 0 && pool_owns(pfn))) continue;
+
+        for (uint32_t i = 0; i < pages; i++) {
+            if (save_page(pfn + i) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+// Grava tabela e fluxo e, depois de uma barreira, o cabecalho
+static int write_image(uint64_t start) {
+    HibHeader *header = (HibHeader*)hib_sector;
+    uint32_t table_sectors = (hib_page_count * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    uint32_t data_sectors = (stream_bytes + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    if (hib_area_lba + 1 + table_sectors + data_sectors > hib_disk_sectors) {
+        ui_log_status("HIBERNACAO ERRO: Imagem maior que a area reservada.", 0x0C);
+        return -1;
+    }
+
+    uint32_t lba = hib_area_lba + 1;
+    if (write_region((const uint8_t*)hib_table, table_sectors, &lba) != 0) return -1;
+
+    uint32_t remaining = data_sectors;
+    for (int i = hib_stream_first; i < hib_block_count && remaining > 0; i++) {
+        uint32_t sectors = (PAGE_SIZE << hib_blocks[i].order) / SECTOR_SIZE;
+        if (sectors > remaining) sectors = remaining;
+        if (write_region((const uint8_t*)hib_blocks[i].address, sectors, &lba) != 0) return -1;
+        remaining -= sectors;
+    }
+    if (ata_flush_cache() != 0) return -1;
+
+    kmemset(header, 0, SECTOR_SIZE);
+    header->magic = HIB_MAGIC;
+    header->version = HIB_VERSION;
+    header->kernel_end = (uint32_t)_kernel_end;
+    header->restore_entry = (uint32_t)hib_restore_pages;
+    header->max_pfn = pmm_max_pfn();
+    header->page_count = hib_page_count;
+    header->zero_pages = hib_zero_pages;
+    header->table_sectors = table_sectors;
+    header->data_sectors = data_sectors;
+    header->data_bytes = stream_bytes;
+    header->data_checksum = stream_checksum;
+    header->table_checksum = adler32(ADLER32_INIT, (const uint8_t*)hib_table, hib_page_count * 4);
+    header->save_ms = (uint32_t)(tsc_cycles_to_ns(read_tsc() - start) / 1000000ull);
+    header->header_checksum = header_checksum(header);
+    hib_last_header = *header;
+
+    lba = hib_area_lba;
+    if (write_region(hib_sector, 1, &lba) != 0) return -1;
+    return ata_flush_cache();
+}
+
+// Volta da retomada: so o hardware precisa ser refeito
+static int hibernate_resumed() {
+    pool_release(); // Blocos do pool: alocados na imagem, mas sem conteudo salvo
+
+    scheduler_rebase_clock(); // O TSC recomecou do zero neste boot
+    for (int i = 0; i < resume_hook_count; i++) resume_hooks[i]();
+    kernel_fpu_end(hib_saved_flags);
+    ata_thaw(); // A imagem foi tirada com o disco reservado para a hibernacao
+
+    // O cabecalho (ja invalidado) ainda tem os numeros da imagem
+    if (locate_area() == 0 && ata_read_sectors(hib_area_lba, 1, hib_sector) == 0) {
+        hib_last_header = *(HibHeader*)hib_sector;
+        hib_save_ms = hib_last_header.save_ms;
+    }
+    hib_resume_ms = (uint32_t)(tsc_cycles_to_ns(read_tsc()) / 1000000ull);
+    ui_log_status("HIBERNACAO: Sistema retomado da imagem.", 0x0A);
+    return 1;
+}
+
+// Imagem no disco: desliga a maquina (ACPI do QEMU/Bochs) ou para a CPU
+static void hibernate_power_off() __attribute__((noreturn));
+static void hibernate_power_off() {
+    outw(ACPI_PM1A_QEMU, ACPI_SLEEP_S5);
+    outw(ACPI_PM1A_BOCHS, ACPI_SLEEP_S5);
+    for (;;) {
+        __asm__ __volatile__ ("cli; hlt");
+    }
+}
+
+/**
+ * Grava a imagem de hibernacao e desliga a maquina. Chamar de um processo
+ * (nunca de uma IRQ). No proximo boot, hibernate_try_resume() faz esta
+ * mesma chamada devolver 1.
+ * @return 1 ao voltar da retomada, -1 em caso de falha (o sistema segue
+ *         rodando). Com a imagem gravada, nao retorna.
+ */
+int hibernate() {
+    uint64_t start = read_tsc();
+    if (locate_area() != 0) {
+        ui_log_status("HIBERNACAO ERRO: Sem area reservada apos o BlipFS.", 0x0C);
+        return -1;
+    }
+    // Setores sujos do cache vao para o disco antes: se a retomada falhar, nada se perde
+    bcache_sync();
+    ui_log_status("HIBERNACAO: Congelando o sistema...", 0x0E);
+
+    // 1. Congela: o disco fica so para a imagem (espera o comando em curso),
+    //    interrupcoes desligadas e registradores da FPU salvos no dono
+    ata_freeze();
+    hib_saved_flags = kernel_fpu_begin();
+
+    // 2. Pool para a copia comprimida (as paginas dele nao entram na imagem)
+    if (pool_reserve(count_image_pages()) != 0) {
+        pool_release();
+        kernel_fpu_end(hib_saved_flags);
+        ata_thaw();
+        ui_log_status("HIBERNACAO ERRO: Memoria insuficiente para a imagem.", 0x0C);
+        return -1;
+    }
+
+    // 3. Ponto de retomada. Daqui para baixo, so variaveis globais no caminho de volta.
+    if (hib_save_context()) return hibernate_resumed();
+
+    // 4. Copia e gravacao com o sistema ainda congelado: nenhum processo,
+    //    tarefa ou IRQ muda a memoria ou o disco depois da copia
+    int result = snapshot_pages();
+    if (result == 0) result = write_image(start);
+
+    if (result != 0) {
+        pool_release();
+        kernel_fpu_end(hib_saved_flags);
+        ata_thaw();
+        ui_log_status("HIBERNACAO ERRO: Falha ao gravar a imagem.", 0x0C);
+        return -1;
+    }
+    ui_log_status("HIBERNACAO: Imagem gravada. Desligando.", 0x0A);
+    hibernate_power_off();
+}
+
+// =======================================================
+// 6. RETOMAR
+// =======================================================
+
+static uint8_t *target_map = 0;     // 1 bit por PFN: destino de alguma pagina
+static uint32_t discarded = 0;      // Blocos recusados (encadeados pela 1a palavra)
+static HibCopy *copies = 0;
+static uint32_t copy_count = 0;
+
+static int target_is_set(uint32_t pfn) {
+    return target_map[pfn >> 3] & (1 << (pfn & 7));
+}
+
+/**
+ * Aloca um bloco que nao seja destino de nenhuma pagina da imagem (senao a
+ * copia final o sobrescreveria antes de ser lido). Blocos recusados ficam
+ * presos numa lista ate a retomada acabar.
+ */
+static uint32_t safe_alloc(int order) {
+    for (;;) {
+        uint32_t block = alloc_pages(order);
+        if (!block) return 0;
+
+        uint32_t pfn = block >> PAGE_SHIFT;
+        int collides = 0;
+        for (uint32_t i = 0; i < (1u << order) && !collides; i++) collides = target_is_set(pfn + i);
+        if (!collides) return block;
+
+        ((uint32_t*)block)[0] = discarded;
+        ((uint32_t*)block)[1] = (uint32_t)order;
+        discarded = block;
+    }
+}
+
+// Retomada abortada: devolve tudo e o boot segue a frio
+static void resume_cleanup(uint32_t table, int table_order, int map_order, int copies_order) {
+    for (uint32_t i = 0; i < copy_count; i++) {
+        if (copies[i].source) free_pages(copies[i].source, 0);
+    }
+    while (discarded) {
+        uint32_t next = ((uint32_t*)discarded)[0];
+        free_pages(discarded, (int)((uint32_t*)discarded)[1]);
+        discarded = next;
+    }
+    if (copies) free_pages((uint32_t)copies, copies_order);
+    if (target_map) free_pages((uint32_t)target_map, map_order);
+    if (table) free_pages(table, table_order);
+    if (reader_buffer) free_pages((uint32_t)reader_buffer, HIB_IO_ORDER);
+    if (hib_scratch) free_pages((uint32_t)hib_scratch, order_for(PAGE_SIZE + 2));
+    copies = 0;
+    copy_count = 0;
+    target_map = 0;
+    reader_buffer = 0;
+    hib_scratch = 0;
+}
+
+/**
+ * Procura uma imagem valida e, se houver, restaura o sistema salvo.
+ * @return -1 se nao ha imagem (ou ela e invalida): o boot segue a frio.
+ *         Em caso de sucesso, nao retorna (a execucao continua em hibernate()).
+ */
+int hibernate_try_resume() {
+    if (locate_area() != 0 || ata_read_sectors(hib_area_lba, 1, hib_sector) != 0) return -1;
+    HibHeader header = *(HibHeader*)hib_sector;
+    if (!header_valid(&header)) return -1;
+
+    ui_log_status("HIBERNACAO: Imagem encontrada, retomando...", 0x0E);
+    uint32_t max_pfn = pmm_max_pfn();
+    int table_order = order_for(header.table_sectors * SECTOR_SIZE);
+    int map_order = order_for((max_pfn + 7) / 8);
+    int copies_order = order_for(header.page_count * sizeof(HibCopy));
+    uint32_t table = 0;
+
+    // 1. Tabela de paginas, numa leitura sequencial
+    table = alloc_pages(table_order);
+    reader_buffer = (uint8_t*)alloc_pages(HIB_IO_ORDER);
+    hib_scratch = (uint8_t*)alloc_pages(order_for(PAGE_SIZE + 2));
+    target_map = (uint8_t*)alloc_pages(map_order);
+    if (!table || !reader_buffer || !hib_scratch || !target_map ||
+        read_region((uint8_t*)table, header.table_sectors, hib_area_lba + 1) != 0) goto fail;
+
+    // A tabela diz onde cada pagina vai parar: um bit trocado nela corromperia
+    // memoria na copia final, entao confere antes de usar qualquer entrada
+    if (header.page_count * 4 > header.table_sectors * SECTOR_SIZE ||
+        adler32(ADLER32_INIT, (const uint8_t*)table, header.page_count * 4) != header.table_checksum) goto fail;
+
+    // 2. Mapa dos destinos: Kernel, tabela do buddy e cada pagina da imagem
+    uint32_t *entries = (uint32_t*)table;
+    kmemset(target_map, 0, (max_pfn + 7) / 8);
+    for (uint32_t pfn = LOW_MEMORY_PFN; pfn < max_pfn; pfn++) {
+        if (pmm_is_kernel_page(pfn)) target_map[pfn >> 3] |= (uint8_t)(1 << (pfn & 7));
+    }
+    for (uint32_t i = 0; i < header.page_count; i++) {
+        uint32_t pfn = entries[i] >> 2;
+        if (pfn >= max_pfn) goto fail;
+        target_map[pfn >> 3] |= (uint8_t)(1 << (pfn & 7));
+    }
+
+    // 3. Cada pagina descomprimida numa pagina segura
+    copies = (HibCopy*)safe_alloc(copies_order);
+    if (!copies) goto fail;
+    reader_start(hib_area_lba + 1 + header.table_sectors, header.data_sectors);
+
+    for (copy_count = 0; copy_count < header.page_count; ) {
+        uint32_t pfn = entries[copy_count] >> 2;
+        uint32_t kind = entries[copy_count] & 3;
+        HibCopy *copy = &copies[copy_count];
+        copy->target = pfn << PAGE_SHIFT;
+        copy->source = 0;
+        copy_count++;
+        if (kind == HIB_PAGE_ZERO) continue;
+
+        copy->source = safe_alloc(0);
+        if (!copy->source) goto fail;
+
+        if (kind == HIB_PAGE_RAW) {
+            if (reader_get((uint8_t*)copy->source, PAGE_SIZE) != 0) goto fail;
+        } else {
+            if (reader_get(hib_scratch, 2) != 0) goto fail;
+            uint32_t size = (uint32_t)hib_scratch[0] | ((uint32_t)hib_scratch[1] << 8);
+            if (size == 0 || size >= PAGE_SIZE || reader_get(hib_scratch, size) != 0 ||
+                lz_decompress_page(hib_scratch, size, (uint8_t*)copy->source) != 0) goto fail;
+        }
+    }
+    if (stream_bytes != header.data_bytes || stream_checksum != header.data_checksum) goto fail;
+
+    // 4. Invalida a imagem antes de usa-la: uma retomada que trave nao vira laco de boot
+    ((HibHeader*)hib_sector)->magic = 0;
+    uint32_t lba = hib_area_lba;
+    if (write_region(hib_sector, 1, &lba) != 0 || ata_flush_cache() != 0) goto fail;
+
+    // 5. Sem volta: copia as paginas e pula para dentro de hibernate()
+    irq_save();
+    hib_restore_pages(copies, copy_count);
+
+fail:
+    ui_log_status("HIBERNACAO ERRO: Imagem corrompida, boot normal.", 0x0C);
+    resume_cleanup(table, table_order, map_order, copies_order);
+    return -1;
+}
+
+// =======================================================
+// 7. GANCHOS DE HARDWARE E MEDICOES
+// =======================================================
+
+/**
+ * Registra uma rotina que refaz estado de hardware (registradores de
+ * dispositivo, MSRs, modo de video) depois de uma retomada. O estado em
+ * memoria dos drivers volta sozinho com a imagem.
+ * @return 0 em caso de sucesso, -1 se a tabela de ganchos esta cheia.
+ */
+int hibernate_register_resume(hibernate_resume_fn fn) {
+    if (resume_hook_count == HIB_MAX_HOOKS) return -1;
+    resume_hooks[resume_hook_count++] = fn;
+    return 0;
+}
+
+/**
+ * Chamada quando o prompt aparece num boot a frio: guarda o tempo desde o
+ * reset (o TSC comeca em zero ao ligar a maquina).
+ */
+void hibernate_mark_prompt() {
+    hib_cold_boot_ms = (uint32_t)(tsc_cycles_to_ns(read_tsc()) / 1000000ull);
+}
+
+/**
+ * Desenha os tempos ate o prompt (boot a frio x retomada) e o tamanho da
+ * ultima imagem a partir de 'row'.
+ */
+void hibernate_report(int row) {
+    char buffer[12];
+    HibHeader *h = &hib_last_header;
+    uint32_t image_kb = (h->table_sectors + h->data_sectors + 1) / 2;
+    uint32_t memory_kb = h->page_count * (PAGE_SIZE / 1024);
+
+    ui_draw_string("== HIBERNACAO: tempo ate o prompt ==", row, 0, 0x0E);
+    ui_draw_string("Boot a frio (ms)", row + 1, 0, 0x0B);
+    ui_draw_string(u32_to_str(hib_cold_boot_ms, buffer, 12), row + 1, 24, 0x0F);
+    ui_draw_string("Retomada (ms)", row + 2, 0, 0x0B);
+    ui_draw_string(hib_resume_ms ? u32_to_str(hib_resume_ms, buffer, 12) : "-", row + 2, 24, 0x0A);
+    ui_draw_string("Gravacao (ms)", row + 3, 0, 0x0B);
+    ui_draw_string(hib_save_ms ? u32_to_str(hib_save_ms, buffer, 12) : "-", row + 3, 24, 0x0F);
+
+    ui_draw_string("Imagem: memoria/disco (KB)", row + 4, 0, 0x0B);
+    ui_draw_string(u32_to_str(memory_kb, buffer, 12), row + 4, 28, 0x0F);
+    ui_draw_string(u32_to_str(image_kb, buffer, 12), row + 4, 38, 0x0A);
+    ui_draw_string("Paginas zeradas", row + 5, 0, 0x0B);
+    ui_draw_string(u32_to_str(h->zero_pages, buffer, 12), row + 5, 28, 0x0F);
+}
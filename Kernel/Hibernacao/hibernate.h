@@ -0,0 +1,16 @@
+// hibernate.h - Hibernacao: imagem comprimida da memoria no disco e retomada no boot.
+
+#ifndef HIBERNATE_H
+#define HIBERNATE_H
+
+#include <stdint.h>
+
+typedef void (*hibernate_resume_fn)();
+
+int hibernate();
+int hibernate_try_resume();
+int hibernate_register_resume(hibernate_resume_fn fn);
+void hibernate_mark_prompt();
+void hibernate_report(int row);
+
+#endif
@@ -1,7 +1,16 @@
 // kernel.c - O Ponto de Entrada Reutilizavel para todos os seus SOs.
 
+// Se o SO instalar um backend de video proprio (ex.: framebuffer grafico),
+// o putc() passa a desenhar por ele.
+void (*putc_redirect)(char c, int row, int col, char color) = 0;
+
 // A unica funcao que interage com o hardware de video.
 void putc(char c, int row, int col, char color) {
+    if (putc_redirect) {
+        putc_redirect(c, row, col, color);
+        return;
+    }
+
     unsigned char* video_memory = (unsigned char*)0xb8000;
     int offset = (row * 80 + col) * 2;
     
@@ -0,0 +1,27 @@
+// adler32.c - Adler-32 (ver adler32.h). Usada pela imagem da hibernacao e
+// pelo journal do cache de blocos.
+
+#include <stdint.h>
+#include "adler32.h"
+
+#define ADLER_MOD   65521
+#define ADLER_NMAX  5552    // Maior bloco sem estourar 32 bits antes do modulo
+
+/**
+ * Continua a soma 'adler' sobre 'n' bytes (comece com ADLER32_INIT).
+ * @return A soma atualizada.
+ */
+uint32_t adler32(uint32_t adler, const uint8_t *data, uint32_t n) {
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while (n > 0) {
+        uint32_t chunk = n < ADLER_NMAX ? n : ADLER_NMAX;
+        n -= chunk;
+        while (chunk--) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+    return (b << 16) | a;
+}
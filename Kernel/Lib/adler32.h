@@ -0,0 +1,12 @@
+// adler32.h - Soma de verificacao Adler-32 (a do zlib) para o que vai ao disco.
+
+#ifndef ADLER32_H
+#define ADLER32_H
+
+#include <stdint.h>
+
+#define ADLER32_INIT    1   // Valor inicial de uma soma nova
+
+uint32_t adler32(uint32_t adler, const uint8_t *data, uint32_t n);
+
+#endif
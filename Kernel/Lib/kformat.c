@@ -0,0 +1,33 @@
+// kformat.c - Numeros em texto decimal (ver kformat.h).
+//
+// Uma copia so para o Kernel inteiro: cada relatorio tinha a sua.
+
+#include <stdint.h>
+#include "kformat.h"
+
+/**
+ * Converte um numero para decimal no fim de 'buffer'.
+ * @return O inicio da string dentro de 'buffer'.
+ */
+char* u32_to_str(uint32_t value, char *buffer, int size) {
+    int i = size - 1;
+    buffer[i] = '\0';
+    do {
+        buffer[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 && i > 0);
+    return &buffer[i];
+}
+
+/**
+ * Como u32_to_str(), para 64 bits (divisao de 64 bits: so nos relatorios).
+ */
+char* u64_to_str(uint64_t value, char *buffer, int size) {
+    int i = size - 1;
+    buffer[i] = '\0';
+    do {
+        buffer[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 && i > 0);
+    return &buffer[i];
+}
@@ -0,0 +1,15 @@
+// kformat.h - Numeros em texto decimal para os relatorios da tela.
+//
+// As rotinas escrevem do fim de 'buffer' para tras e devolvem o inicio da
+// string dentro dele; 'size' inclui o '\0' (12 bytes cabem qualquer uint32_t,
+// 21 qualquer uint64_t).
+
+#ifndef KFORMAT_H
+#define KFORMAT_H
+
+#include <stdint.h>
+
+char* u32_to_str(uint32_t value, char *buffer, int size);
+char* u64_to_str(uint64_t value, char *buffer, int size);
+
+#endif
@@ -0,0 +1,637 @@
+// kmemory.c - Copiar, preencher e comparar memoria com a melhor instrucao da CPU.
+//
+// Blocos minusculos (< KMEM_TINY) sao um laco de inteiros em C: o REP MOVS/STOS
+// tem dezenas de ciclos de partida. Blocos pequenos (< KMEM_SMALL) vao sempre
+// pelo REP MOVSL/STOSL.
+// Para blocos maiores, kmem_init() escolhe uma vez, pelo CPUID:
+//   - ERMS: REP MOVSB/STOSB (o microcodigo copia linhas inteiras, sem FPU);
+//   - AVX2 ou SSE2: laco de 128/64 bytes por volta, com escrita nao-temporal
+//     acima de KMEM_NT_THRESHOLD. So vale a pena a partir de KMEM_SIMD_MIN,
+//     porque kernel_fpu_begin() pode ter que salvar o estado SIMD da tarefa;
+//   - REP MOVSL/STOSL em CPUs sem nada disso.
+// Todos os lacos sao em Assembly: o compilador nao pode transformar um laco
+// de copia de volta numa chamada a memcpy() (que e esta propria biblioteca).
+
+#include <stdint.h>
+#include "kmemory.h"
+#include "../../Tools/CPU/cpu_features.h"
+#include "../../Tools/CPU/fpu_context.h"
+
+extern uint64_t read_tsc(); // Do cpu_diag.c
+extern uint32_t alloc_pages(int order);
+extern void free_pages(uint32_t address, int order);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern void ui_log_status(const char *status_msg, char color_byte);
+
+#define KMEM_TINY           16          // Abaixo disso: laco de inteiros (sem REP)
+#define KMEM_SMALL          64          // Abaixo disso: REP MOVSL + MOVSB direto
+#define KMEM_SIMD_MIN       512         // Abaixo disso o custo do kernel_fpu_begin() domina
+#define KMEM_NT_THRESHOLD   (256 * 1024) // Acima disso a copia nao deve poluir o cache
+
+// Variantes (tambem as colunas do benchmark)
+#define KMEM_VARIANT_MOVSL  0
+#define KMEM_VARIANT_ERMS   1
+#define KMEM_VARIANT_SSE2   2
+#define KMEM_VARIANT_AVX2   3
+#define KMEM_VARIANTS       4
+
+static const char *variant_names[KMEM_VARIANTS] = { "MOVSL", "ERMS", "SSE2", "AVX2" };
+static const char *variant_messages[KMEM_VARIANTS] = {
+    "Memoria: REP MOVSL (sem ERMS/SSE2).",
+    "Memoria: REP MOVSB (ERMS).",
+    "Memoria: SSE2 (com kernel_fpu_begin).",
+    "Memoria: AVX2 (com kernel_fpu_begin).",
+};
+static int variant_available[KMEM_VARIANTS] = { 1, 0, 0, 0 };
+
+static int copy_variant = KMEM_VARIANT_MOVSL;
+static int set_variant = KMEM_VARIANT_MOVSL;
+static int cmp_variant = KMEM_VARIANT_MOVSL;
+
+// =======================================================
+// 1. CAMINHO DE INTEIROS (REP MOVS/STOS)
+// =======================================================
+
+// Laco de palavras para blocos minusculos. O asm vazio impede o compilador de
+// reconhecer o laco e troca-lo por uma chamada a memcpy()/memset().
+static void copy_tiny(uint8_t *dest, const uint8_t *src, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        *(uint32_t*)(dest + i) = *(const uint32_t*)(src + i);
+        __asm__ __volatile__ ("" : "+r"(i));
+    }
+    for (; i < n; i++) {
+        dest[i] = src[i];
+        __asm__ __volatile__ ("" : "+r"(i));
+    }
+}
+
+static void set16_tiny(uint16_t *dest, uint16_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i] = value;
+        __asm__ __volatile__ ("" : "+r"(i));
+    }
+}
+
+static void copy_movsb(void *dest, const void *src, uint32_t n) {
+    uint32_t d0, d1, d2;
+    __asm__ __volatile__ (
+        "rep movsb"
+        : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+        : "0"(n), "1"(dest), "2"(src)
+        : "memory"
+    );
+}
+
+static void copy_movsl(void *dest, const void *src, uint32_t n) {
+    uint32_t d0, d1, d2;
+    __asm__ __volatile__ (
+        "rep movsl\n"
+        "movl %4, %%ecx\n"
+        "rep movsb\n"
+        : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+        : "0"(n >> 2), "g"(n & 3), "1"(dest), "2"(src)
+        : "memory"
+    );
+}
+
+// Copia de tras para frente (sobreposicao com dest > src)
+static void copy_backward_movsb(void *dest, const void *src, uint32_t n) {
+    uint32_t d0, d1, d2;
+    if (n == 0) return;
+    __asm__ __volatile__ (
+        "std\n"
+        "rep movsb\n"
+        "cld\n"
+        : "=&c"(d0), "=&D"(d1), "=&S"(d2)
+        : "0"(n), "1"((uint8_t*)dest + n - 1), "2"((const uint8_t*)src + n - 1)
+        : "memory"
+    );
+}
+
+static void set_stosb(void *dest, uint8_t value, uint32_t n) {
+    uint32_t d0, d1;
+    __asm__ __volatile__ (
+        "rep stosb"
+        : "=&c"(d0), "=&D"(d1)
+        : "0"(n), "1"(dest), "a"(value)
+        : "memory"
+    );
+}
+
+static void set_stosl(void *dest, uint8_t value, uint32_t n) {
+    uint32_t d0, d1;
+    __asm__ __volatile__ (
+        "rep stosl\n"
+        "movl %3, %%ecx\n"
+        "rep stosb\n"
+        : "=&c"(d0), "=&D"(d1)
+        : "0"(n >> 2), "g"(n & 3), "1"(dest), "a"(value * 0x01010101u)
+        : "memory"
+    );
+}
+
+static int cmp_words(const uint8_t *a, const uint8_t *b, uint32_t n) {
+    uint32_t i = 0;
+    // Pula palavras iguais de 4 em 4 e resolve a diferenca byte a byte
+    while (i + 4 <= n && *(const uint32_t*)(a + i) == *(const uint32_t*)(b + i)) i += 4;
+    for (; i < n; i++) {
+        if (a[i] != b[i]) return (int)a[i] - (int)b[i];
+    }
+    return 0;
+}
+
+// =======================================================
+// 2. SSE2 (16 bytes por registrador)
+// =======================================================
+
+// Alinha o destino em 16 e copia 64 bytes por volta
+static void copy_sse2(uint8_t *dest, const uint8_t *src, uint32_t n) {
+    if (n < KMEM_SMALL) {
+        copy_movsl(dest, src, n);
+        return;
+    }
+    uint32_t head = (0u - (uint32_t)dest) & 15;
+    copy_movsb(dest, src, head);
+    dest += head;
+    src += head;
+    n -= head;
+
+    uint32_t blocks = n >> 6;
+    if (n >= KMEM_NT_THRESHOLD) {
+        __asm__ __volatile__ (
+            "1:\n"
+            "movdqu (%1), %%xmm0\n"
+            "movdqu 16(%1), %%xmm1\n"
+            "movdqu 32(%1), %%xmm2\n"
+            "movdqu 48(%1), %%xmm3\n"
+            "movntdq %%xmm0, (%0)\n"
+            "movntdq %%xmm1, 16(%0)\n"
+            "movntdq %%xmm2, 32(%0)\n"
+            "movntdq %%xmm3, 48(%0)\n"
+            "addl $64, %1\n"
+            "addl $64, %0\n"
+            "decl %2\n"
+            "jnz 1b\n"
+            "sfence\n"
+            : "+r"(dest), "+r"(src), "+r"(blocks) : : "memory", "cc"
+        );
+    } else if (blocks) {
+        __asm__ __volatile__ (
+            "1:\n"
+            "movdqu (%1), %%xmm0\n"
+            "movdqu 16(%1), %%xmm1\n"
+            "movdqu 32(%1), %%xmm2\n"
+            "movdqu 48(%1), %%xmm3\n"
+            "movdqa %%xmm0, (%0)\n"
+            "movdqa %%xmm1, 16(%0)\n"
+            "movdqa %%xmm2, 32(%0)\n"
+            "movdqa %%xmm3, 48(%0)\n"
+            "addl $64, %1\n"
+            "addl $64, %0\n"
+            "decl %2\n"
+            "jnz 1b\n"
+            : "+r"(dest), "+r"(src), "+r"(blocks) : : "memory", "cc"
+        );
+    }
+    copy_movsb(dest, src, n & 63);
+}
+
+// Sobreposicao com dest > src: 16 bytes por volta a partir do fim
+static void copy_backward_sse2(uint8_t *dest, const uint8_t *src, uint32_t n) {
+    uint32_t blocks = n >> 4;
+    uint32_t head = n & 15;
+    if (blocks) {
+        uint8_t *d = dest + n;
+        const uint8_t *s = src + n;
+        __asm__ __volatile__ (
+            "1:\n"
+            "subl $16, %1\n"
+            "subl $16, %0\n"
+            "movdqu (%1), %%xmm0\n"
+            "movdqu %%xmm0, (%0)\n"
+            "decl %2\n"
+            "jnz 1b\n"
+            : "+r"(d), "+r"(s), "+r"(blocks) : : "memory", "cc"
+        );
+    }
+    copy_backward_movsb(dest, src, head);
+}
+
+static void set_sse2(uint8_t *dest, uint8_t value, uint32_t n) {
+    if (n < KMEM_SMALL) {
+        set_stosl(dest, value, n);
+        return;
+    }
+    uint32_t head = (0u - (uint32_t)dest) & 15;
+    set_stosb(dest, value, head);
+    dest += head;
+    n -= head;
+
+    uint32_t blocks = n >> 6;
+    if (blocks) {
+        __asm__ __volatile__ (
+            "movd %2, %%xmm0\n"
+            "pshufd $0, %%xmm0, %%xmm0\n"
+            "1:\n"
+            "movdqa %%xmm0, (%0)\n"
+            "movdqa %%xmm0, 16(%0)\n"
+            "movdqa %%xmm0, 32(%0)\n"
+            "movdqa %%xmm0, 48(%0)\n"
+            "addl $64, %0\n"
+            "decl %1\n"
+            "jnz 1b\n"
+            : "+r"(dest), "+r"(blocks) : "r"(value * 0x01010101u) : "memory", "cc"
+        );
+    }
+    set_stosb(dest, value, n & 63);
+}
+
+static int cmp_sse2(const uint8_t *a, const uint8_t *b, uint32_t n) {
+    uint32_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint32_t mask;
+        __asm__ __volatile__ (
+            "movdqu (%1), %%xmm0\n"
+            "movdqu (%2), %%xmm1\n"
+            "pcmpeqb %%xmm1, %%xmm0\n"
+            "pmovmskb %%xmm0, %0\n"
+            : "=r"(mask) : "r"(a + i), "r"(b + i) : "memory"
+        );
+        if (mask != 0xFFFF) {
+            uint32_t k = i + (uint32_t)__builtin_ctz(~mask);
+            return (int)a[k] - (int)b[k];
+        }
+    }
+    return cmp_words(a + i, b + i, n - i);
+}
+
+// =======================================================
+// 3. AVX2 (32 bytes por registrador)
+// =======================================================
+
+static void copy_avx2(uint8_t *dest, const uint8_t *src, uint32_t n) {
+    if (n < KMEM_SMALL) {
+        copy_movsl(dest, src, n);
+        return;
+    }
+    uint32_t head = (0u - (uint32_t)dest) & 31;
+    copy_movsb(dest, src, head);
+    dest += head;
+    src += head;
+    n -= head;
+
+    uint32_t blocks = n >> 7;
+    if (n >= KMEM_NT_THRESHOLD) {
+        __asm__ __volatile__ (
+            "1:\n"
+            "vmovdqu (%1), %%ymm0\n"
+            "vmovdqu 32(%1), %%ymm1\n"
+            "vmovdqu 64(%1), %%ymm2\n"
+            "vmovdqu 96(%1), %%ymm3\n"
+            "vmovntdq %%ymm0, (%0)\n"
+            "vmovntdq %%ymm1, 32(%0)\n"
+            "vmovntdq %%ymm2, 64(%0)\n"
+            "vmovntdq %%ymm3, 96(%0)\n"
+            "addl $128, %1\n"
+            "addl $128, %0\n"
+            "decl %2\n"
+            "jnz 1b\n"
+            "sfence\n"
+            "vzeroupper\n"
+            : "+r"(dest), "+r"(src), "+r"(blocks) : : "memory", "cc"
+        );
+    } else if (blocks) {
+        __asm__ __volatile__ (
+            "1:\n"
+            "vmovdqu (%1), %%ymm0\n"
+            "vmovdqu 32(%1), %%ymm1\n"
+            "vmovdqu 64(%1), %%ymm2\n"
+            "vmovdqu 96(%1), %%ymm3\n"
+            "vmovdqa %%ymm0, (%0)\n"
+            "vmovdqa %%ymm1, 32(%0)\n"
+            "vmovdqa %%ymm2, 64(%0)\n"
+            "vmovdqa %%ymm3, 96(%0)\n"
+            "addl $128, %1\n"
+            "addl $128, %0\n"
+            "decl %2\n"
+            "jnz 1b\n"
+            "vzeroupper\n"
+            : "+r"(dest), "+r"(src), "+r"(blocks) : : "memory", "cc"
+        );
+    }
+    copy_movsb(dest, src, n & 127);
+}
+
+static void set_avx2(uint8_t *dest, uint8_t value, uint32_t n) {
+    if (n < KMEM_SMALL) {
+        set_stosl(dest, value, n);
+        return;
+    }
+    uint32_t head = (0u - (uint32_t)dest) & 31;
+    set_stosb(dest, value, head);
+    dest += head;
+    n -= head;
+
+    uint32_t blocks = n >> 7;
+    if (blocks) {
+        __asm__ __volatile__ (
+            "vmovd %2, %%xmm0\n"
+            "vpbroadcastd %%xmm0, %%ymm0\n"
+            "1:\n"
+            "vmovdqa %%ymm0, (%0)\n"
+            "vmovdqa %%ymm0, 32(%0)\n"
+            "vmovdqa %%ymm0, 64(%0)\n"
+            "vmovdqa %%ymm0, 96(%0)\n"
+            "addl $128, %0\n"
+            "decl %1\n"
+            "jnz 1b\n"
+            "vzeroupper\n"
+            : "+r"(dest), "+r"(blocks) : "r"(value * 0x01010101u) : "memory", "cc"
+        );
+    }
+    set_stosb(dest, value, n & 127);
+}
+
+static int cmp_avx2(const uint8_t *a, const uint8_t *b, uint32_t n) {
+    uint32_t i = 0;
+    int result = 0;
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask;
+        __asm__ __volatile__ (
+            "vmovdqu (%1), %%ymm0\n"
+            "vpcmpeqb (%2), %%ymm0, %%ymm0\n"
+            "vpmovmskb %%ymm0, %0\n"
+            : "=r"(mask) : "r"(a + i), "r"(b + i) : "memory"
+        );
+        if (mask != 0xFFFFFFFFu) {
+            uint32_t k = i + (uint32_t)__builtin_ctz(~mask);
+            result = (int)a[k] - (int)b[k];
+            break;
+        }
+    }
+    __asm__ __volatile__ ("vzeroupper");
+    if (result) return result;
+    return cmp_words(a + i, b + i, n - i);
+}
+
+// =======================================================
+// 4. DESPACHO
+// =======================================================
+
+// Executa a variante pedida (o benchmark usa todas; o Kernel, so a escolhida)
+static void copy_with(int variant, void *dest, const void *src, uint32_t n) {
+    if (variant == KMEM_VARIANT_ERMS) {
+        copy_movsb(dest, src, n);
+    } else if (variant == KMEM_VARIANT_SSE2 || variant == KMEM_VARIANT_AVX2) {
+        uint32_t flags = kernel_fpu_begin();
+        if (variant == KMEM_VARIANT_AVX2) copy_avx2((uint8_t*)dest, (const uint8_t*)src, n);
+        else copy_sse2((uint8_t*)dest, (const uint8_t*)src, n);
+        kernel_fpu_end(flags);
+    } else {
+        copy_movsl(dest, src, n);
+    }
+}
+
+static void set_with(int variant, void *dest, uint8_t value, uint32_t n) {
+    if (variant == KMEM_VARIANT_ERMS) {
+        set_stosb(dest, value, n);
+    } else if (variant == KMEM_VARIANT_SSE2 || variant == KMEM_VARIANT_AVX2) {
+        uint32_t flags = kernel_fpu_begin();
+        if (variant == KMEM_VARIANT_AVX2) set_avx2((uint8_t*)dest, value, n);
+        else set_sse2((uint8_t*)dest, value, n);
+        kernel_fpu_end(flags);
+    } else {
+        set_stosl(dest, value, n);
+    }
+}
+
+static int cmp_with(int variant, const void *a, const void *b, uint32_t n) {
+    if (variant == KMEM_VARIANT_SSE2 || variant == KMEM_VARIANT_AVX2) {
+        uint32_t flags = kernel_fpu_begin();
+        int result = (variant == KMEM_VARIANT_AVX2)
+                   ? cmp_avx2((const uint8_t*)a, (const uint8_t*)b, n)
+                   : cmp_sse2((const uint8_t*)a, (const uint8_t*)b, n);
+        kernel_fpu_end(flags);
+        return result;
+    }
+    return cmp_words((const uint8_t*)a, (const uint8_t*)b, n);
+}
+
+static int variant_is_simd(int variant) {
+    return variant == KMEM_VARIANT_SSE2 || variant == KMEM_VARIANT_AVX2;
+}
+
+/**
+ * Escolhe as variantes. Chamar depois de cpu_features_detect() e init_fpu()
+ * (as variantes SIMD precisam do SSE/AVX ligados no CR4/XCR0).
+ */
+void kmem_init() {
+    variant_available[KMEM_VARIANT_ERMS] = cpu_has(CPU_FEATURE_ERMS);
+    variant_available[KMEM_VARIANT_SSE2] = fpu_sse_enabled();
+    variant_available[KMEM_VARIANT_AVX2] = fpu_avx_enabled() && cpu_has(CPU_FEATURE_AVX2);
+
+    // Copia/preenchimento: ERMS nao mexe na FPU e e tao rapido quanto SIMD
+    // para blocos grandes; sem ERMS, o maior vetor disponivel.
+    if (variant_available[KMEM_VARIANT_ERMS]) copy_variant = KMEM_VARIANT_ERMS;
+    else if (variant_available[KMEM_VARIANT_AVX2]) copy_variant = KMEM_VARIANT_AVX2;
+    else if (variant_available[KMEM_VARIANT_SSE2]) copy_variant = KMEM_VARIANT_SSE2;
+    else copy_variant = KMEM_VARIANT_MOVSL;
+    set_variant = copy_variant;
+
+    // Comparacao: nao existe "ERMS" para CMPSB, so vetores
+    if (variant_available[KMEM_VARIANT_AVX2]) cmp_variant = KMEM_VARIANT_AVX2;
+    else if (variant_available[KMEM_VARIANT_SSE2]) cmp_variant = KMEM_VARIANT_SSE2;
+    else cmp_variant = KMEM_VARIANT_MOVSL;
+
+    ui_log_status(variant_messages[copy_variant], 0x0A);
+}
+
+// =======================================================
+// 5. INTERFACE PUBLICA
+// =======================================================
+
+void* kmemcpy(void *dest, const void *src, uint32_t n) {
+    if (n < KMEM_TINY) {
+        copy_tiny((uint8_t*)dest, (const uint8_t*)src, n);
+    } else if (n < KMEM_SMALL || (n < KMEM_SIMD_MIN && variant_is_simd(copy_variant))) {
+        copy_movsl(dest, src, n);
+    } else {
+        copy_with(copy_variant, dest, src, n);
+    }
+    return dest;
+}
+
+/**
+ * Como kmemcpy(), mas aceita regioes sobrepostas.
+ */
+void* kmemmove(void *dest, const void *src, uint32_t n) {
+    uint8_t *d = (uint8_t*)dest;
+    const uint8_t *s = (const uint8_t*)src;
+
+    // Para frente e seguro se o destino esta antes da origem ou nao encosta nela
+    if (d <= s || d >= s + n) return kmemcpy(dest, src, n);
+
+    if (n >= KMEM_SIMD_MIN && variant_available[KMEM_VARIANT_SSE2]) {
+        uint32_t flags = kernel_fpu_begin();
+        copy_backward_sse2(d, s, n);
+        kernel_fpu_end(flags);
+    } else {
+        copy_backward_movsb(d, s, n);
+    }
+    return dest;
+}
+
+void* kmemset(void *dest, int value, uint32_t n) {
+    if (n < KMEM_SMALL || (n < KMEM_SIMD_MIN && variant_is_simd(set_variant))) {
+        set_stosl(dest, (uint8_t)value, n);
+    } else {
+        set_with(set_variant, dest, (uint8_t)value, n);
+    }
+    return dest;
+}
+
+int kmemcmp(const void *a, const void *b, uint32_t n) {
+    if (n < KMEM_SIMD_MIN / 2) return cmp_words((const uint8_t*)a, (const uint8_t*)b, n);
+    return cmp_with(cmp_variant, a, b, n);
+}
+
+/**
+ * Procura o primeiro byte igual a 'value' nos 'n' primeiros bytes.
+ * @return Ponteiro para ele, ou 0 se nao houver.
+ */
+void* kmemchr(const void *src, int value, uint32_t n) {
+    const uint8_t *p = (const uint8_t*)src;
+    uint32_t d0;
+    const uint8_t *end;
+    if (n == 0) return 0;
+    __asm__ __volatile__ (
+        "repne scasb"
+        : "=&c"(d0), "=&D"(end)
+        : "0"(n), "1"(p), "a"((uint8_t)value)
+        : "memory", "cc"
+    );
+    // SCASB para depois do byte encontrado (ou no fim)
+    return (end[-1] == (uint8_t)value) ? (void*)(end - 1) : 0;
+}
+
+/**
+ * Preenche 'count' palavras de 16 bits (ex.: celulas da tela em modo texto).
+ */
+void kmemset16(uint16_t *dest, uint16_t value, uint32_t count) {
+    uint32_t d0, d1;
+    if (count < KMEM_TINY / 2) {
+        set16_tiny(dest, value, count); // Ex.: uma celula ou uma palavra curta na tela
+        return;
+    }
+    // Com o destino alinhado em 4, o miolo vai de 2 em 2 celulas
+    if (((uint32_t)dest & 2) && count) {
+        *dest++ = value;
+        count--;
+    }
+    __asm__ __volatile__ (
+        "rep stosl\n"
+        "movl %3, %%ecx\n"
+        "rep stosw\n"
+        : "=&c"(d0), "=&D"(d1)
+        : "0"(count >> 1), "g"(count & 1), "1"(dest), "a"(value * 0x00010001u)
+        : "memory"
+    );
+}
+
+// Nomes padrao: o compilador gera chamadas a eles em copias de structs
+void* memcpy(void *dest, const void *src, uint32_t n) { return kmemcpy(dest, src, n); }
+void* memmove(void *dest, const void *src, uint32_t n) { return kmemmove(dest, src, n); }
+void* memset(void *dest, int value, uint32_t n) { return kmemset(dest, value, n); }
+int memcmp(const void *a, const void *b, uint32_t n) { return kmemcmp(a, b, n); }
+
+// =======================================================
+// 6. BENCHMARK (bytes por ciclo, 16B a 1MB)
+// =======================================================
+
+#define BENCH_BUFFER_ORDER  8                   // 256 paginas = 1MB
+#define BENCH_MAX_SIZE      (1024 * 1024)
+#define BENCH_BYTES_PER_ROW (4 * 1024 * 1024)   // Volume copiado em cada medida
+
+// Laco byte a byte: o que o codigo fazia antes (volatile impede a troca por memcpy)
+static void copy_bytes(void *dest, const void *src, uint32_t n) {
+    volatile uint8_t *d = (volatile uint8_t*)dest;
+    const uint8_t *s = (const uint8_t*)src;
+    for (uint32_t i = 0; i < n; i++) d[i] = s[i];
+}
+
+// Formata bytes/ciclo com duas casas ("12.34")
+static char* format_rate(uint64_t bytes, uint64_t cycles, char *buffer) {
+    uint32_t hundredths = cycles ? (uint32_t)(bytes * 100 / cycles) : 0;
+    int i = 11;
+    buffer[i] = '\0';
+    buffer[--i] = (char)('0' + hundredths % 10);
+    buffer[--i] = (char)('0' + (hundredths / 10) % 10);
+    buffer[--i] = '.';
+    uint32_t whole = hundredths / 100;
+    do {
+        buffer[--i] = (char)('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0 && i > 0);
+    return &buffer[i];
+}
+
+/**
+ * Mede bytes/ciclo do memcpy para cada variante disponivel (e do laco byte a
+ * byte antigo), de 16B a 1MB, e desenha a tabela a partir de 'row'.
+ */
+void kmem_run_benchmark(int row) {
+    char buffer[12];
+    uint32_t src = alloc_pages(BENCH_BUFFER_ORDER);
+    uint32_t dst = alloc_pages(BENCH_BUFFER_ORDER);
+    if (!src || !dst) {
+        ui_log_status("KMEM: Sem memoria para o benchmark.", 0x0C);
+        if (src) free_pages(src, BENCH_BUFFER_ORDER);
+        if (dst) free_pages(dst, BENCH_BUFFER_ORDER);
+        return;
+    }
+    set_with(set_variant, (void*)src, 0x5A, BENCH_MAX_SIZE);
+
+    // Linha 'row': titulo; 'row + 1': colunas; depois uma linha por tamanho
+    ui_draw_string("== memcpy: bytes por ciclo ==", row, 0, 0x0E);
+    ui_draw_string("Tamanho", row + 1, 0, 0x0E);
+    ui_draw_string("Laco", row + 1, 13, 0x0E);
+    for (int v = 0; v < KMEM_VARIANTS; v++) {
+        ui_draw_string(variant_names[v], row + 1, 22 + v * 9, variant_available[v] ? 0x0E : 0x08);
+    }
+
+    int line = row + 2;
+    for (uint32_t size = 16; size <= BENCH_MAX_SIZE; size <<= 2) {
+        uint32_t reps = BENCH_BYTES_PER_ROW / size;
+        uint64_t start, cycles;
+
+        // Tamanho e o laco byte a byte
+        int i = 11;
+        uint32_t shown = (size >= 1024) ? size / 1024 : size;
+        buffer[i] = '\0';
+        if (size >= 1024) buffer[--i] = 'K';
+        do {
+            buffer[--i] = (char)('0' + shown % 10);
+            shown /= 10;
+        } while (shown > 0);
+        ui_draw_string(&buffer[i], line, 0, 0x0B);
+
+        start = read_tsc();
+        for (uint32_t r = 0; r < reps; r++) copy_bytes((void*)dst, (void*)src, size);
+        cycles = read_tsc() - start;
+        ui_draw_string(format_rate((uint64_t)size * reps, cycles, buffer), line, 13, 0x07);
+
+        for (int v = 0; v < KMEM_VARIANTS; v++) {
+            if (!variant_available[v]) continue;
+            start = read_tsc();
+            for (uint32_t r = 0; r < reps; r++) copy_with(v, (void*)dst, (void*)src, size);
+            cycles = read_tsc() - start;
+            ui_draw_string(format_rate((uint64_t)size * reps, cycles, buffer), line, 22 + v * 9,
+                           v == copy_variant ? 0x0A : 0x0F);
+        }
+        line++;
+    }
+
+    free_pages(src, BENCH_BUFFER_ORDER);
+    free_pages(dst, BENCH_BUFFER_ORDER);
+}
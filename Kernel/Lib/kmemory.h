@@ -0,0 +1,22 @@
+// kmemory.h - Rotinas de memoria do Kernel (copiar, preencher, comparar).
+//
+// A implementacao (REP MOVSB/ERMS, SSE2 ou AVX2) e escolhida uma vez no boot
+// por kmem_init(), a partir dos recursos detectados pelo CPUID.
+
+#ifndef KMEMORY_H
+#define KMEMORY_H
+
+#include <stdint.h>
+
+void kmem_init();
+
+void* kmemcpy(void *dest, const void *src, uint32_t n);
+void* kmemmove(void *dest, const void *src, uint32_t n);
+void* kmemset(void *dest, int value, uint32_t n);
+int kmemcmp(const void *a, const void *b, uint32_t n);
+void* kmemchr(const void *src, int value, uint32_t n);
+
+// Preenche 'count' palavras de 16 bits (celulas do modo texto: caractere | cor << 8)
+void kmemset16(uint16_t *dest, uint16_t value, uint32_t count);
+
+#endif
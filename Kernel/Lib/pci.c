@@ -0,0 +1,38 @@
+// pci.c - Leitura e escrita do espaco de configuracao PCI (ver pci.h).
+//
+// O par endereco/dado e uma janela unica: uma IRQ que tambem acessasse o
+// PCI entre as duas portas leria o registrador errado, entao o acesso e
+// feito com as interrupcoes desligadas.
+
+#include <stdint.h>
+#include "pci.h"
+#include "../spinlock.h"
+
+extern void outl(uint32_t port, uint32_t value);
+extern uint32_t inl(uint32_t port);
+
+#define PCI_CONFIG_ADDRESS  0xCF8
+#define PCI_CONFIG_DATA     0xCFC
+#define PCI_CONFIG_ENABLE   0x80000000u
+
+static uint32_t pci_address(uint8_t slot, uint8_t function, uint8_t offset) {
+    return PCI_CONFIG_ENABLE | ((uint32_t)slot << 11) | ((uint32_t)function << 8) | (offset & 0xFC);
+}
+
+/**
+ * Le um registrador de 32 bits (offset alinhado a 4) do dispositivo.
+ */
+uint32_t pci_read32(uint8_t slot, uint8_t function, uint8_t offset) {
+    uint32_t flags = irq_save();
+    outl(PCI_CONFIG_ADDRESS, pci_address(slot, function, offset));
+    uint32_t value = inl(PCI_CONFIG_DATA);
+    irq_restore(flags);
+    return value;
+}
+
+void pci_write32(uint8_t slot, uint8_t function, uint8_t offset, uint32_t value) {
+    uint32_t flags = irq_save();
+    outl(PCI_CONFIG_ADDRESS, pci_address(slot, function, offset));
+    outl(PCI_CONFIG_DATA, value);
+    irq_restore(flags);
+}
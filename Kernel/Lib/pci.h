@@ -0,0 +1,14 @@
+// pci.h - Espaco de configuracao PCI pelo mecanismo 1 (portas 0xCF8/0xCFC).
+//
+// So o barramento 0: os dispositivos que os drivers procuram (IDE, AC'97,
+// VGA do QEMU/Bochs) ficam todos nele.
+
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+uint32_t pci_read32(uint8_t slot, uint8_t function, uint8_t offset);
+void pci_write32(uint8_t slot, uint8_t function, uint8_t offset, uint32_t value);
+
+#endif
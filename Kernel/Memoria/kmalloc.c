@@ -0,0 +1,190 @@
+// kmalloc.c - Alocador de uso geral do Kernel (kmalloc/kfree) sobre o Buddy Allocator.
+//
+// Pedidos de ate 1KB saem de "slabs": uma pagina de 4KB dividida em objetos
+// de um mesmo tamanho (16, 32, ... 1024 bytes). Pedidos maiores vao direto
+// para alloc_pages(). O cabecalho fica no inicio da pagina, entao kfree()
+// encontra o dono so mascarando o endereco.
+
+#include <stdint.h>
+#include "../spinlock.h"
+
+extern uint32_t alloc_page();
+extern void free_page(uint32_t address);
+extern uint32_t alloc_pages(int order);
+extern void free_pages(uint32_t address, int order);
+
+#define PAGE_SIZE           4096
+#define MAX_ORDER           10
+
+#define KMALLOC_MIN_SHIFT   4       // Menor classe: 16 bytes
+#define KMALLOC_CLASSES     7       // 16, 32, 64, 128, 256, 512, 1024
+#define KMALLOC_MAX_SMALL   (1 << (KMALLOC_MIN_SHIFT + KMALLOC_CLASSES - 1))
+
+#define SLAB_MAGIC          0x51AB0001
+#define LARGE_MAGIC         0x1A460001
+#define SLAB_HEADER_SIZE    32      // Objetos comecam alinhados a 32 bytes
+
+typedef struct SlabHeader {
+    uint32_t magic;
+    uint16_t size_class;
+    uint16_t in_use;
+    void *free_list;                // Objetos livres encadeados por dentro deles mesmos
+    struct SlabHeader *next;        // Lista de slabs com objetos livres
+    struct SlabHeader *prev;
+} SlabHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t order;
+    uint32_t size;
+    uint32_t reserved;
+} LargeHeader; // 16 bytes: o objeto comeca logo depois
+
+typedef struct {
+    spinlock_t lock;
+    SlabHeader *partial;            // Slabs com pelo menos um objeto livre
+    uint32_t object_size;
+    uint32_t objects_per_slab;
+} SlabClass;
+
+static SlabClass slab_classes[KMALLOC_CLASSES];
+
+/**
+ * Inicializa as classes de tamanho. Chamar depois de pmm_init().
+ */
+void kmalloc_init() {
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        slab_classes[i].lock.locked = 0;
+        slab_classes[i].partial = 0;
+        slab_classes[i].object_size = 1u << (KMALLOC_MIN_SHIFT + i);
+        slab_classes[i].objects_per_slab = (PAGE_SIZE - SLAB_HEADER_SIZE) / slab_classes[i].object_size;
+    }
+}
+
+static int kmalloc_size_class(uint32_t size) {
+    int cls = 0;
+    while ((1u << (KMALLOC_MIN_SHIFT + cls)) < size) cls++;
+    return cls;
+}
+
+/**
+ * Cria um slab novo (uma pagina) e encadeia todos os objetos na lista livre.
+ */
+static SlabHeader* slab_create(int cls) {
+    uint32_t page = alloc_page();
+    if (page == 0) return 0;
+
+    SlabHeader *slab = (SlabHeader*)page;
+    slab->magic = SLAB_MAGIC;
+    slab->size_class = (uint16_t)cls;
+    slab->in_use = 0;
+    slab->next = slab->prev = 0;
+
+    uint32_t size = slab_classes[cls].object_size;
+    uint8_t *obj = (uint8_t*)page + SLAB_HEADER_SIZE;
+    slab->free_list = 0;
+    for (uint32_t i = 0; i < slab_classes[cls].objects_per_slab; i++) {
+        *(void**)obj = slab->free_list;
+        slab->free_list = obj;
+        obj += size;
+    }
+    return slab;
+}
+
+static void slab_list_remove(SlabClass *sc, SlabHeader *slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else sc->partial = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->next = slab->prev = 0;
+}
+
+static void slab_list_push(SlabClass *sc, SlabHeader *slab) {
+    slab->prev = 0;
+    slab->next = sc->partial;
+    if (sc->partial) sc->partial->prev = slab;
+    sc->partial = slab;
+}
+
+/**
+ * Aloca 'size' bytes de memoria do Kernel.
+ * @return Ponteiro para a memoria, ou 0 se nao houver memoria.
+ */
+void* kmalloc(uint32_t size) {
+    if (size == 0) return 0;
+
+    if (size > KMALLOC_MAX_SMALL) {
+        // Objeto grande: bloco do buddy com um cabecalho de 16 bytes
+        int order = 0;
+        while (order <= MAX_ORDER && ((uint32_t)PAGE_SIZE << order) < size + sizeof(LargeHeader)) order++;
+        if (order > MAX_ORDER) return 0;
+
+        uint32_t block = (order == 0) ? alloc_page() : alloc_pages(order);
+        if (block == 0) return 0;
+
+        LargeHeader *hdr = (LargeHeader*)block;
+        hdr->magic = LARGE_MAGIC;
+        hdr->order = (uint32_t)order;
+        hdr->size = size;
+        return hdr + 1;
+    }
+
+    int cls = kmalloc_size_class(size);
+    SlabClass *sc = &slab_classes[cls];
+
+    uint32_t flags = spin_lock_irqsave(&sc->lock);
+    SlabHeader *slab = sc->partial;
+    if (!slab) {
+        slab = slab_create(cls);
+        if (!slab) {
+            spin_unlock_irqrestore(&sc->lock, flags);
+            return 0;
+        }
+        slab_list_push(sc, slab);
+    }
+
+    void *obj = slab->free_list;
+    slab->free_list = *(void**)obj;
+    slab->in_use++;
+    if (!slab->free_list) slab_list_remove(sc, slab); // Slab cheio sai da lista
+    spin_unlock_irqrestore(&sc->lock, flags);
+
+    return obj;
+}
+
+/**
+ * Libera memoria obtida com kmalloc().
+ */
+void kfree(void *ptr) {
+    if (!ptr) return;
+
+    uint32_t page = (uint32_t)ptr & ~(PAGE_SIZE - 1);
+
+    if (((LargeHeader*)page)->magic == LARGE_MAGIC) {
+        uint32_t order = ((LargeHeader*)page)->order;
+        ((LargeHeader*)page)->magic = 0;
+        if (order == 0) free_page(page);
+        else free_pages(page, (int)order);
+        return;
+    }
+
+    SlabHeader *slab = (SlabHeader*)page;
+    if (slab->magic != SLAB_MAGIC) return; // Ponteiro invalido: ignora
+
+    SlabClass *sc = &slab_classes[slab->size_class];
+    uint32_t flags = spin_lock_irqsave(&sc->lock);
+
+    int was_full = (slab->free_list == 0);
+    *(void**)ptr = slab->free_list;
+    slab->free_list = ptr;
+    slab->in_use--;
+
+    if (was_full) {
+        slab_list_push(sc, slab);
+    } else if (slab->in_use == 0 && (sc->partial != slab || slab->next)) {
+        // Slab vazio volta ao buddy, mas a classe guarda pelo menos um
+        slab_list_remove(sc, slab);
+        slab->magic = 0;
+        free_page(page);
+    }
+    spin_unlock_irqrestore(&sc->lock, flags);
+}
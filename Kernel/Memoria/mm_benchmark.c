@@ -0,0 +1,148 @@
+// mm_benchmark.c - Mede latencia e fragmentacao do alocador de memoria.
+//
+// Carga aleatoria de alocacoes e liberacoes (paginas do buddy e kmalloc),
+// reportando ciclos medios/maximos por operacao e o indice de fragmentacao.
+
+#include <stdint.h>
+#include "../Lib/kformat.h"
+
+extern uint64_t read_tsc(); // Do cpu_diag.c
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern uint32_t alloc_page();
+extern void free_page(uint32_t address);
+extern uint32_t alloc_pages(int order);
+extern void free_pages(uint32_t address, int order);
+extern void* kmalloc(uint32_t size);
+extern void kfree(void *ptr);
+extern uint32_t pmm_free_pages();
+extern uint32_t pmm_free_blocks(int order);
+
+#define MAX_ORDER           10
+#define BENCH_SLOTS         512     // Alocacoes vivas ao mesmo tempo
+#define BENCH_OPERATIONS    20000
+
+typedef struct {
+    uint64_t total;
+    uint64_t max;
+    uint32_t count;
+} LatencyStat;
+
+typedef struct {
+    uint32_t address;
+    int order;              // -1 = slot vazio
+} PageSlot;
+
+static PageSlot page_slots[BENCH_SLOTS];
+static void *kmalloc_slots[BENCH_SLOTS];
+static uint32_t rng_state = 0x12345678;
+
+// xorshift32: aleatorio barato e reproduzivel
+static uint32_t bench_random() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void stat_add(LatencyStat *stat, uint64_t cycles) {
+    stat->total += cycles;
+    stat->count++;
+    if (cycles > stat->max) stat->max = cycles;
+}
+
+static void draw_stat(const char *label, LatencyStat *stat, int row) {
+    char buffer[24];
+    ui_draw_string(label, row, 0, 0x0B);
+    ui_draw_string("media:", row, 22, 0x07);
+    ui_draw_string(u64_to_str(stat->count ? stat->total / stat->count : 0, buffer, 24), row, 29, 0x0F);
+    ui_draw_string("max:", row, 42, 0x07);
+    ui_draw_string(u64_to_str(stat->max, buffer, 24), row, 47, 0x0F);
+    ui_draw_string("ciclos", row, 62, 0x07);
+}
+
+/**
+ * Indice de fragmentacao externa para blocos de 'order':
+ * porcentagem da memoria livre que NAO serve para um pedido desse tamanho.
+ */
+static uint32_t fragmentation_percent(int order) {
+    uint32_t free_total = pmm_free_pages();
+    if (free_total == 0) return 0;
+
+    uint32_t usable = 0;
+    for (int o = order; o <= MAX_ORDER; o++) usable += pmm_free_blocks(o) << o;
+    return 100 - (uint32_t)(((uint64_t)usable * 100) / free_total);
+}
+
+/**
+ * Roda a carga aleatoria e desenha a tabela de resultados a partir de 'row'.
+ */
+void mm_run_benchmark(int row) {
+    LatencyStat page_alloc = {0, 0, 0}, page_free = {0, 0, 0};
+    LatencyStat block_alloc = {0, 0, 0}, block_free = {0, 0, 0};
+    LatencyStat small_alloc = {0, 0, 0}, small_free = {0, 0, 0};
+
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        page_slots[i].order = -1;
+        kmalloc_slots[i] = 0;
+    }
+
+    for (int op = 0; op < BENCH_OPERATIONS; op++) {
+        uint32_t r = bench_random();
+        int slot = (int)((r >> 8) % BENCH_SLOTS);
+
+        // 1. Paginas: 3/4 dos pedidos sao de ordem 0 (magazine), o resto ordem 1-4
+        PageSlot *ps = &page_slots[slot];
+        if (ps->order < 0) {
+            int order = (r & 3) ? 0 : (int)(1 + ((r >> 2) & 3));
+            uint64_t start = read_tsc();
+            uint32_t addr = order ? alloc_pages(order) : alloc_page();
+            uint64_t cycles = read_tsc() - start;
+            if (addr) {
+                stat_add(order ? &block_alloc : &page_alloc, cycles);
+                ps->address = addr;
+                ps->order = order;
+            }
+        } else {
+            uint64_t start = read_tsc();
+            if (ps->order) free_pages(ps->address, ps->order);
+            else free_page(ps->address);
+            stat_add(ps->order ? &block_free : &page_free, read_tsc() - start);
+            ps->order = -1;
+        }
+
+        // 2. kmalloc: tamanhos de 8 bytes a 2KB
+        int kslot = (int)((r >> 20) % BENCH_SLOTS);
+        if (!kmalloc_slots[kslot]) {
+            uint32_t size = 8u << ((r >> 12) % 9);
+            uint64_t start = read_tsc();
+            kmalloc_slots[kslot] = kmalloc(size);
+            stat_add(&small_alloc, read_tsc() - start);
+        } else {
+            uint64_t start = read_tsc();
+            kfree(kmalloc_slots[kslot]);
+            stat_add(&small_free, read_tsc() - start);
+            kmalloc_slots[kslot] = 0;
+        }
+    }
+
+    // Fragmentacao medida com a carga ainda viva (antes da limpeza)
+    char buffer[24];
+    ui_draw_string("== Benchmark de Memoria (carga aleatoria) ==", row, 0, 0x0E);
+    draw_stat("alloc_page (ord 0)", &page_alloc, row + 1);
+    draw_stat("free_page  (ord 0)", &page_free, row + 2);
+    draw_stat("alloc_pages(ord1-4)", &block_alloc, row + 3);
+    draw_stat("free_pages (ord1-4)", &block_free, row + 4);
+    draw_stat("kmalloc (8B-2KB)", &small_alloc, row + 5);
+    draw_stat("kfree", &small_free, row + 6);
+    ui_draw_string("Fragmentacao % ord4:", row + 7, 0, 0x0B);
+    ui_draw_string(u64_to_str(fragmentation_percent(4), buffer, 24), row + 7, 22, 0x0F);
+    ui_draw_string("ord10:", row + 7, 30, 0x0B);
+    ui_draw_string(u64_to_str(fragmentation_percent(MAX_ORDER), buffer, 24), row + 7, 37, 0x0F);
+
+    // Limpeza: devolve tudo ao alocador
+    for (int i = 0; i < BENCH_SLOTS; i++) {
+        if (page_slots[i].order == 0) free_page(page_slots[i].address);
+        else if (page_slots[i].order > 0) free_pages(page_slots[i].address, page_slots[i].order);
+        kfree(kmalloc_slots[i]);
+    }
+}
@@ -0,0 +1,418 @@
+// page_allocator.c - Gerenciador de memoria fisica (Buddy Allocator) do Core-Blip.
+//
+// Le o mapa de memoria entregue pelo bootloader (Multiboot / BIOS E820) e
+// gerencia os quadros de 4KB em blocos de ordem 0 a 10 (4KB a 4MB).
+// Paginas avulsas (ordem 0) passam por um "magazine" por CPU: o caminho comum
+// de alocar/liberar so desliga as interrupcoes locais, sem pegar nenhuma trava.
+
+#include <stdint.h>
+#include "../spinlock.h"
+
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern uint32_t apic_current_cpu(); // Do apic.c
+
+// Fim da imagem do Kernel (definido no script do linker)
+extern uint8_t _kernel_end[];
+
+#define PAGE_SIZE           4096
+#define PAGE_SHIFT          12
+#define MAX_ORDER           10      // Maior bloco: 2^10 paginas = 4MB
+#define NO_PAGE             0xFFFFFFFF
+
+#define LOW_MEMORY_LIMIT    0x100000 // Abaixo de 1MB fica a BIOS/VGA: nunca usamos
+
+// Tipos de regiao do mapa de memoria (E820)
+#define MMAP_TYPE_USABLE    1
+
+// Estado de cada quadro fisico
+#define PAGE_RESERVED       0       // Nao gerenciado (BIOS, Kernel, buraco no mapa)
+#define PAGE_FREE           1       // Cabeca de um bloco livre no buddy
+#define PAGE_ALLOCATED      2       // Entregue a alguem (ou parte de um bloco entregue)
+#define PAGE_CACHED         3       // Livre, mas guardado em um magazine de CPU
+
+// Magazines por CPU
+#define MM_MAX_CPUS         8
+#define MAGAZINE_SIZE       32
+#define MAGAZINE_BATCH      16      // Quantas paginas trocar com o buddy de uma vez
+
+// Descritor de um quadro fisico (indexado pelo PFN)
+typedef struct {
+    uint32_t next;  // Proximo bloco livre da mesma ordem
+    uint32_t prev;
+    uint8_t order;
+    uint8_t state;
+    uint16_t reserved;
+} PageFrame;
+
+// Cada magazine ocupa sua propria linha de cache (sem falso compartilhamento)
+typedef struct {
+    uint32_t count;
+    uint32_t pfns[MAGAZINE_SIZE];
+} __attribute__((aligned(64))) PageMagazine;
+
+// Entrada do mapa de memoria Multiboot ('size' nao conta a si mesmo)
+typedef struct {
+    uint32_t size;
+    uint64_t base_addr;
+    uint64_t length;
+    uint32_t type;
+} __attribute__((packed)) MultibootMmapEntry;
+
+static PageFrame *frames = 0;
+static uint32_t max_pfn = 0;
+static uint32_t kernel_end_pfn = 0;     // Fim da imagem do Kernel
+static uint32_t table_start_pfn = 0;    // Paginas da tabela de descritores
+static uint32_t table_end_pfn = 0;
+
+static uint32_t free_lists[MAX_ORDER + 1];
+static uint32_t free_blocks[MAX_ORDER + 1];
+static spinlock_t buddy_lock = SPINLOCK_INIT;
+
+static PageMagazine magazines[MM_MAX_CPUS];
+
+/**
+ * Identifica a CPU atual (indice do magazine). Com uma so CPU ligada, o
+ * apic.c devolve o indice guardado, sem acessar o Local APIC. Sem APIC, e 0.
+ */
+uint32_t mm_current_cpu() {
+    uint32_t cpu = apic_current_cpu();
+    return cpu < MM_MAX_CPUS ? cpu : 0;
+}
+
+// =======================================================
+// 1. LISTAS LIVRES DO BUDDY
+// =======================================================
+
+static void free_list_push(uint32_t pfn, int order) {
+    PageFrame *frame = &frames[pfn];
+    frame->order = (uint8_t)order;
+    frame->state = PAGE_FREE;
+    frame->prev = NO_PAGE;
+    frame->next = free_lists[order];
+    if (free_lists[order] != NO_PAGE) frames[free_lists[order]].prev = pfn;
+    free_lists[order] = pfn;
+    free_blocks[order]++;
+}
+
+static void free_list_remove(uint32_t pfn, int order) {
+    PageFrame *frame = &frames[pfn];
+    if (frame->prev != NO_PAGE) frames[frame->prev].next = frame->next;
+    else free_lists[order] = frame->next;
+    if (frame->next != NO_PAGE) frames[frame->next].prev = frame->prev;
+    frame->state = PAGE_ALLOCATED;
+    free_blocks[order]--;
+}
+
+/**
+ * Devolve um bloco ao buddy, juntando-o com o "irmao" enquanto possivel.
+ * Chamar com buddy_lock preso.
+ */
+static void buddy_free_locked(uint32_t pfn, int order) {
+    while (order < MAX_ORDER) {
+        uint32_t buddy = pfn ^ (1u << order);
+        if (buddy >= max_pfn || frames[buddy].state != PAGE_FREE || frames[buddy].order != order) {
+            break;
+        }
+        free_list_remove(buddy, order);
+        pfn &= ~(1u << order); // O bloco unido comeca no menor dos dois
+        order++;
+    }
+    free_list_push(pfn, order);
+}
+
+/**
+ * Retira um bloco de 2^order paginas, partindo blocos maiores se preciso.
+ * Chamar com buddy_lock preso.
+ * @return PFN do bloco, ou NO_PAGE se nao houver memoria.
+ */
+static uint32_t buddy_alloc_locked(int order) {
+    int current = order;
+    while (current <= MAX_ORDER && free_lists[current] == NO_PAGE) current++;
+    if (current > MAX_ORDER) return NO_PAGE;
+
+    uint32_t pfn = free_lists[current];
+    free_list_remove(pfn, current);
+
+    // Divide ao meio ate chegar na ordem pedida; a metade de cima volta a lista
+    while (current > order) {
+        current--;
+        free_list_push(pfn + (1u << current), current);
+    }
+
+    frames[pfn].order = (uint8_t)order;
+    frames[pfn].state = PAGE_ALLOCATED;
+    return pfn;
+}
+
+// =======================================================
+// 2. API PUBLICA
+// =======================================================
+
+/**
+ * Aloca 2^order paginas fisicas contiguas (alinhadas ao proprio tamanho).
+ * @return Endereco fisico do bloco, ou 0 se nao houver memoria.
+ */
+uint32_t alloc_pages(int order) {
+    if (order < 0 || order > MAX_ORDER) return 0;
+
+    uint32_t flags = spin_lock_irqsave(&buddy_lock);
+    uint32_t pfn = buddy_alloc_locked(order);
+    spin_unlock_irqrestore(&buddy_lock, flags);
+
+    return pfn == NO_PAGE ? 0 : pfn << PAGE_SHIFT;
+}
+
+/**
+ * Libera um bloco obtido com alloc_pages() (mesma ordem).
+ */
+void free_pages(uint32_t address, int order) {
+    if (address == 0 || order < 0 || order > MAX_ORDER) return;
+
+    uint32_t flags = spin_lock_irqsave(&buddy_lock);
+    buddy_free_locked(address >> PAGE_SHIFT, order);
+    spin_unlock_irqrestore(&buddy_lock, flags);
+}
+
+/**
+ * Recarrega um magazine vazio com um lote de paginas do buddy.
+ */
+static void magazine_refill(PageMagazine *mag) {
+    spin_lock(&buddy_lock);
+    while (mag->count < MAGAZINE_BATCH) {
+        uint32_t pfn = buddy_alloc_locked(0);
+        if (pfn == NO_PAGE) break;
+        frames[pfn].state = PAGE_CACHED;
+        mag->pfns[mag->count++] = pfn;
+    }
+    spin_unlock(&buddy_lock);
+}
+
+/**
+ * Esvazia metade de um magazine cheio de volta no buddy.
+ */
+static void magazine_drain(PageMagazine *mag) {
+    spin_lock(&buddy_lock);
+    while (mag->count > MAGAZINE_SIZE - MAGAZINE_BATCH) {
+        buddy_free_locked(mag->pfns[--mag->count], 0);
+    }
+    spin_unlock(&buddy_lock);
+}
+
+/**
+ * Aloca uma unica pagina de 4KB. Caminho rapido: magazine da CPU atual.
+ * @return Endereco fisico da pagina, ou 0 se nao houver memoria.
+ */
+uint32_t alloc_page() {
+    uint32_t flags = irq_save();
+    PageMagazine *mag = &magazines[mm_current_cpu()];
+
+    if (mag->count == 0) magazine_refill(mag);
+
+    uint32_t pfn = NO_PAGE;
+    if (mag->count > 0) {
+        pfn = mag->pfns[--mag->count];
+        frames[pfn].state = PAGE_ALLOCATED;
+    }
+    irq_restore(flags);
+
+    return pfn == NO_PAGE ? 0 : pfn << PAGE_SHIFT;
+}
+
+/**
+ * Libera uma pagina obtida com alloc_page().
+ */
+void free_page(uint32_t address) {
+    if (address == 0) return;
+
+    uint32_t flags = irq_save();
+    PageMagazine *mag = &magazines[mm_current_cpu()];
+
+    if (mag->count == MAGAZINE_SIZE) magazine_drain(mag);
+
+    uint32_t pfn = address >> PAGE_SHIFT;
+    frames[pfn].state = PAGE_CACHED;
+    mag->pfns[mag->count++] = pfn;
+    irq_restore(flags);
+}
+
+/**
+ * Numero de blocos livres de uma ordem (para medir fragmentacao).
+ */
+uint32_t pmm_free_blocks(int order) {
+    return (order >= 0 && order <= MAX_ORDER) ? free_blocks[order] : 0;
+}
+
+/**
+ * Total de paginas livres (buddy + magazines).
+ */
+uint32_t pmm_free_pages() {
+    uint32_t total = 0;
+    for (int order = 0; order <= MAX_ORDER; order++) {
+        total += free_blocks[order] << order;
+    }
+    for (int cpu = 0; cpu < MM_MAX_CPUS; cpu++) {
+        total += magazines[cpu].count;
+    }
+    return total;
+}
+
+/**
+ * Maior PFN gerenciado (+1).
+ */
+uint32_t pmm_max_pfn() {
+    return max_pfn;
+}
+
+/**
+ * Diz se o quadro guarda a imagem do Kernel ou a tabela de descritores
+ * (reservados, mas com conteudo que o sistema precisa).
+ */
+int pmm_is_kernel_page(uint32_t pfn) {
+    return (pfn >= (LOW_MEMORY_LIMIT >> PAGE_SHIFT) && pfn < kernel_end_pfn) ||
+           (pfn >= table_start_pfn && pfn < table_end_pfn);
+}
+
+/**
+ * Descreve o bloco que comeca em 'pfn'. Para percorrer a memoria, comece no
+ * PFN 0 e pule 'pages' a cada chamada: assim so cabecas de bloco sao lidas
+ * (os quadros do meio de um bloco podem ter estado antigo).
+ * Chamar com as interrupcoes desligadas.
+ * @param pages Recebe o tamanho do bloco em paginas.
+ * @return 1 se o bloco esta alocado, 0 se livre (buddy ou magazine),
+ *         -1 se e reservado (fora do buddy).
+ */
+int pmm_block_state(uint32_t pfn, uint32_t *pages) {
+    PageFrame *frame = &frames[pfn];
+    switch (frame->state) {
+    case PAGE_ALLOCATED:
+        *pages = 1u << frame->order;
+        return 1;
+    case PAGE_FREE:
+        *pages = 1u << frame->order;
+        return 0;
+    case PAGE_CACHED:
+        *pages = 1;
+        return 0;
+    default:
+        *pages = 1;
+        return -1;
+    }
+}
+
+// =======================================================
+// 3. INICIALIZACAO A PARTIR DO MAPA DE MEMORIA
+// =======================================================
+
+/**
+ * Entrega ao buddy todas as paginas inteiras de [start, end), em blocos
+ * alinhados o maior possivel.
+ */
+static void pmm_add_range(uint32_t start_pfn, uint32_t end_pfn) {
+    uint32_t pfn = start_pfn;
+    while (pfn < end_pfn) {
+        int order = MAX_ORDER;
+        while (order > 0 && ((pfn & ((1u << order) - 1)) != 0 || pfn + (1u << order) > end_pfn)) {
+            order--;
+        }
+        buddy_free_locked(pfn, order);
+        pfn += 1u << order;
+    }
+}
+
+// Recorta uma regiao do mapa para os limites que sabemos gerenciar (< 4GB, >= 1MB)
+static int pmm_clip_region(const MultibootMmapEntry *entry, uint32_t *start, uint32_t *end) {
+    if (entry->type != MMAP_TYPE_USABLE) return 0;
+
+    uint64_t base = entry->base_addr;
+    uint64_t limit = entry->base_addr + entry->length;
+    if (base < LOW_MEMORY_LIMIT) base = LOW_MEMORY_LIMIT;
+    if (limit > 0xFFFFF000ull) limit = 0xFFFFF000ull;
+    if (limit <= base) return 0;
+
+    *start = (uint32_t)((base + PAGE_SIZE - 1) >> PAGE_SHIFT);
+    *end = (uint32_t)(limit >> PAGE_SHIFT);
+    return *end > *start;
+}
+
+/**
+ * Inicializa o gerenciador de memoria fisica.
+ * @param multiboot_info Ponteiro para a estrutura Multiboot passada em EBX.
+ */
+void pmm_init(uint32_t multiboot_info) {
+    uint32_t *info = (uint32_t*)multiboot_info;
+    uint32_t mb_flags = info[0];
+
+    for (int order = 0; order <= MAX_ORDER; order++) {
+        free_lists[order] = NO_PAGE;
+        free_blocks[order] = 0;
+    }
+
+    // Sem mapa detalhado (bit 6), usa so 'mem_upper' (KB acima de 1MB, bit 0)
+    MultibootMmapEntry fallback;
+    uint32_t mmap_addr, mmap_length;
+    if (mb_flags & (1 << 6)) {
+        mmap_length = info[11];
+        mmap_addr = info[12];
+    } else if (mb_flags & (1 << 0)) {
+        fallback.size = sizeof(MultibootMmapEntry) - 4;
+        fallback.base_addr = LOW_MEMORY_LIMIT;
+        fallback.length = (uint64_t)info[2] * 1024;
+        fallback.type = MMAP_TYPE_USABLE;
+        mmap_addr = (uint32_t)&fallback;
+        mmap_length = sizeof(fallback);
+    } else {
+        ui_log_status("MEMORIA ERRO: Bootloader nao informou o mapa de memoria.", 0x0C);
+        return;
+    }
+
+    // 1. Descobre o maior PFN utilizavel
+    uint32_t start, end;
+    for (uint32_t off = 0; off < mmap_length; ) {
+        MultibootMmapEntry *entry = (MultibootMmapEntry*)(mmap_addr + off);
+        if (pmm_clip_region(entry, &start, &end) && end > max_pfn) max_pfn = end;
+        off += entry->size + 4;
+    }
+
+    // 2. Coloca a tabela de descritores logo apos o Kernel, numa regiao utilizavel
+    uint32_t table_bytes = max_pfn * sizeof(PageFrame);
+    kernel_end_pfn = ((uint32_t)_kernel_end + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    for (uint32_t off = 0; off < mmap_length; ) {
+        MultibootMmapEntry *entry = (MultibootMmapEntry*)(mmap_addr + off);
+        off += entry->size + 4;
+        if (!pmm_clip_region(entry, &start, &end)) continue;
+        if (start < kernel_end_pfn) start = kernel_end_pfn;
+        if (end <= start || ((end - start) << PAGE_SHIFT) < table_bytes) continue;
+
+        frames = (PageFrame*)(start << PAGE_SHIFT);
+        table_start_pfn = start;
+        table_end_pfn = start + ((table_bytes + PAGE_SIZE - 1) >> PAGE_SHIFT);
+        break;
+    }
+    if (!frames) {
+        ui_log_status("MEMORIA ERRO: Sem espaco para a tabela de paginas.", 0x0C);
+        return;
+    }
+
+    for (uint32_t pfn = 0; pfn < max_pfn; pfn++) {
+        frames[pfn].state = PAGE_RESERVED;
+        frames[pfn].order = 0;
+    }
+
+    // 3. Libera as regioes utilizaveis, menos o Kernel e a propria tabela
+    for (uint32_t off = 0; off < mmap_length; ) {
+        MultibootMmapEntry *entry = (MultibootMmapEntry*)(mmap_addr + off);
+        off += entry->size + 4;
+        if (!pmm_clip_region(entry, &start, &end)) continue;
+        if (start < kernel_end_pfn) start = kernel_end_pfn;
+        if (end <= start) continue;
+
+        if (end <= table_start_pfn || start >= table_end_pfn) {
+            pmm_add_range(start, end);
+        } else {
+            if (start < table_start_pfn) pmm_add_range(start, table_start_pfn);
+            if (end > table_end_pfn) pmm_add_range(table_end_pfn, end);
+        }
+    }
+
+    ui_log_status("Memoria fisica: Buddy Allocator ativo (ordens 0-10).", 0x0A);
+}
@@ -0,0 +1,245 @@
+// syscall.c - Interface de chamadas de sistema do Core-Blip.
+//
+// Entrada rapida por SYSENTER/SYSEXIT (sem a pilha de interrupcao nem o IRET),
+// com INT 0x80 como alternativa em CPUs sem SEP. As duas portas caem na mesma
+// tabela de despacho. Tambem publica a pagina de tempo (TimePage), que os
+// aplicativos leem sem entrar no Kernel.
+
+#include <stdint.h>
+#include "syscall.h"
+
+extern uint64_t read_tsc();                 // Do cpu_diag.c
+extern uint32_t tsc_get_khz();              // Do cpu_diag.c
+extern uint32_t alloc_page();               // Do page_allocator.c
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+
+// Instalacao de portoes na IDT e pilha do TSS (codigo de GDT/IDT, nao mostrado)
+extern void idt_set_gate(uint8_t vector, uint32_t handler, uint16_t selector, uint8_t flags);
+extern void tss_set_esp0(uint32_t esp0);
+
+// Seletores da GDT. O SYSEXIT exige o layout: codigo do Kernel, dados do Kernel,
+// codigo do usuario, dados do usuario, nesta ordem.
+#define KERNEL_CODE_SELECTOR    0x08
+
+// MSRs do SYSENTER
+#define MSR_SYSENTER_CS         0x174
+#define MSR_SYSENTER_ESP        0x175
+#define MSR_SYSENTER_EIP        0x176
+
+#define IDT_GATE_USER_INTERRUPT 0xEE // Presente, DPL 3, portao de interrupcao 32 bits
+
+#define TIMER_HZ                100  // O agendador roda a cada 10ms
+#define TIME_NS_SHIFT           22
+
+typedef int32_t (*syscall_handler_t)(uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+static syscall_handler_t syscall_table[SYS_MAX];
+static TimePage *time_page = 0;
+static int sysenter_supported = 0;
+static uint32_t syscall_esp0 = 0;  // Ultima pilha definida (para refazer o MSR)
+
+// Pontos de entrada em Assembly (abaixo)
+extern void syscall_sysenter_entry();
+extern void syscall_int80_entry();
+
+// =======================================================
+// 1. PONTOS DE ENTRADA (Assembly)
+// =======================================================
+
+// SYSENTER: a CPU carrega CS/EIP/ESP dos MSRs e nao salva nada.
+// O usuario deixou o ESP em ECX e o endereco de retorno em EDX.
+__asm__ (
+    ".globl syscall_sysenter_entry\n"
+    "syscall_sysenter_entry:\n"
+    "    pushl %ecx\n"              // ESP do usuario (para o SYSEXIT)
+    "    pushl %edx\n"              // EIP de retorno (para o SYSEXIT)
+    "    pushl %edi\n"              // arg3
+    "    pushl %esi\n"              // arg2
+    "    pushl %ebx\n"              // arg1
+    "    pushl %eax\n"              // numero
+    "    sti\n"                     // O SYSENTER desliga IF
+    "    call syscall_dispatch\n"
+    "    addl $16, %esp\n"
+    "    cli\n"
+    "    popl %edx\n"
+    "    popl %ecx\n"
+    "    sti\n"                     // So vale depois da proxima instrucao
+    "    sysexit\n"
+);
+
+// INT 0x80: o hardware ja empilhou EIP/CS/EFLAGS (e ESP/SS do usuario)
+__asm__ (
+    ".globl syscall_int80_entry\n"
+    "syscall_int80_entry:\n"
+    "    pushl %edi\n"
+    "    pushl %esi\n"
+    "    pushl %ebx\n"
+    "    pushl %eax\n"
+    "    call syscall_dispatch\n"
+    "    addl $16, %esp\n"
+    "    iret\n"
+);
+
+/**
+ * Despacha uma chamada de sistema pela tabela.
+ * Chamada pelas duas portas de entrada; o retorno volta ao usuario em EAX.
+ */
+int32_t syscall_dispatch(uint32_t number, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    if (number >= SYS_MAX || !syscall_table[number]) return SYSCALL_ENOSYS;
+    return syscall_table[number](arg1, arg2, arg3);
+}
+
+/**
+ * Registra o tratador de uma chamada de sistema (usado por outros modulos).
+ * @return 0 em caso de sucesso, -1 se o numero for invalido ou ja estiver em uso.
+ */
+int syscall_register(uint32_t number, syscall_handler_t handler) {
+    if (number >= SYS_MAX || syscall_table[number]) return -1;
+    syscall_table[number] = handler;
+    return 0;
+}
+
+// =======================================================
+// 2. CHAMADAS BASICAS
+// =======================================================
+
+/**
+ * Confere uma string vinda do usuario: inteira abaixo de SYSCALL_USER_LIMIT
+ * e terminada em '\0' dentro de SYSCALL_STRING_MAX bytes.
+ * @return 1 se pode ser lida pelo Kernel, 0 se nao.
+ */
+static int user_string_ok(uint32_t str) {
+    if (str == 0 || str >= SYSCALL_USER_LIMIT) return 0;
+    for (uint32_t i = 0; i < SYSCALL_STRING_MAX && str + i < SYSCALL_USER_LIMIT; i++) {
+        if (((const char*)str)[i] == '\0') return 1;
+    }
+    return 0;
+}
+
+static int32_t sys_null(uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    (void)arg1; (void)arg2; (void)arg3;
+    return 0;
+}
+
+static int32_t sys_get_time_page(uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    (void)arg1; (void)arg2; (void)arg3;
+    return (int32_t)(uint32_t)time_page;
+}
+
+static int32_t sys_draw_string(uint32_t str, uint32_t position, uint32_t color) {
+    if (!user_string_ok(str)) return SYSCALL_EFAULT;
+    ui_draw_string((const char*)str, (int)(position >> 8), (int)(position & 0xFF), (char)color);
+    return 0;
+}
+
+static int32_t sys_log_status(uint32_t str, uint32_t color, uint32_t arg3) {
+    (void)arg3;
+    if (!user_string_ok(str)) return SYSCALL_EFAULT;
+    ui_log_status((const char*)str, (char)color);
+    return 0;
+}
+
+// =======================================================
+// 3. PAGINA DE TEMPO
+// =======================================================
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__ ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/**
+ * Atualiza a pagina de tempo. Chamada a cada tick do timer (IRQ0),
+ * de dentro de scheduler_timer_interrupt().
+ */
+void time_page_tick() {
+    if (!time_page) return;
+
+    uint64_t now = read_tsc();
+
+    time_page->sequence++;      // Impar: leitores vao tentar de novo
+    __asm__ __volatile__ ("" : : : "memory");
+
+    time_page->tick_ns += ((now - time_page->tick_tsc) * time_page->ns_mult) >> time_page->ns_shift;
+    time_page->tick_tsc = now;
+    time_page->tick_count++;
+
+    __asm__ __volatile__ ("" : : : "memory");
+    time_page->sequence++;      // Par de novo: dados consistentes
+}
+
+/**
+ * Define a pilha do Kernel usada pela proxima entrada de chamada de sistema.
+ * O agendador chama isto a cada troca de contexto.
+ */
+void syscall_set_kernel_stack(uint32_t esp0) {
+    syscall_esp0 = esp0;
+    if (sysenter_supported) wrmsr(MSR_SYSENTER_ESP, esp0);
+    tss_set_esp0(esp0);
+}
+
+/**
+ * Retomada da hibernacao: os MSRs nao fazem parte da imagem e o TSC
+ * recomecou do zero (a pagina de tempo continua contando de onde parou).
+ */
+static void syscall_resume() {
+    if (sysenter_supported) {
+        wrmsr(MSR_SYSENTER_CS, KERNEL_CODE_SELECTOR);
+        wrmsr(MSR_SYSENTER_EIP, (uint32_t)syscall_sysenter_entry);
+        wrmsr(MSR_SYSENTER_ESP, syscall_esp0);
+    }
+    if (time_page) {
+        time_page->sequence++;
+        __asm__ __volatile__ ("" : : : "memory");
+        time_page->tick_tsc = read_tsc();
+        __asm__ __volatile__ ("" : : : "memory");
+        time_page->sequence++;
+    }
+}
+
+/**
+ * Inicializa a interface de chamadas de sistema e a pagina de tempo.
+ */
+void init_syscalls() {
+    // 1. Detecta SEP (CPUID.1:EDX bit 11). Pentium Pro antigos anunciam SEP sem ter.
+    uint32_t eax, ebx, ecx, edx;
+    __asm__ __volatile__ ("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    uint32_t family = (eax >> 8) & 0x0F, model = (eax >> 4) & 0x0F, stepping = eax & 0x0F;
+    sysenter_supported = (edx & (1 << 11)) && !(family == 6 && model < 3 && stepping < 3);
+
+    // 2. Tabela de despacho
+    syscall_register(SYS_NULL, sys_null);
+    syscall_register(SYS_GET_TIME_PAGE, sys_get_time_page);
+    syscall_register(SYS_DRAW_STRING, sys_draw_string);
+    syscall_register(SYS_LOG_STATUS, sys_log_status);
+
+    // 3. Portas de entrada. A pilha real de cada tarefa e definida na troca de contexto.
+    idt_set_gate(SYSCALL_VECTOR, (uint32_t)syscall_int80_entry, KERNEL_CODE_SELECTOR,
+                 IDT_GATE_USER_INTERRUPT);
+    if (sysenter_supported) {
+        wrmsr(MSR_SYSENTER_CS, KERNEL_CODE_SELECTOR);
+        wrmsr(MSR_SYSENTER_EIP, (uint32_t)syscall_sysenter_entry);
+    }
+
+    // 4. Pagina de tempo (todos os processos compartilham o espaco de enderecos;
+    // com paginacao ela seria mapeada somente-leitura em cada processo)
+    time_page = (TimePage*)alloc_page();
+    if (time_page) {
+        uint32_t khz = tsc_get_khz();
+        time_page->sequence = 0;
+        time_page->features = (sysenter_supported ? TIME_FEATURE_SYSENTER : 0) |
+                              (khz ? TIME_FEATURE_TSC_STABLE : 0);
+        time_page->tsc_khz = khz;
+        time_page->ns_shift = TIME_NS_SHIFT;
+        time_page->ns_mult = khz ? (uint32_t)((1000000ull << TIME_NS_SHIFT) / khz) : 0;
+        time_page->tick_hz = TIMER_HZ;
+        time_page->tick_count = 0;
+        time_page->tick_tsc = read_tsc();
+        time_page->tick_ns = 0;
+    }
+
+    hibernate_register_resume(syscall_resume);
+    ui_log_status(sysenter_supported ? "Chamadas de sistema ativas (SYSENTER + INT 0x80)."
+                                     : "Chamadas de sistema ativas (INT 0x80).", 0x0A);
+}
@@ -0,0 +1,52 @@
+// syscall.h - Numeros das chamadas de sistema e formato da pagina de tempo
+// (compartilhado entre o Kernel e a biblioteca dos aplicativos).
+//
+// Convencao de registradores (SYSENTER e INT 0x80):
+//   EAX = numero da chamada, EBX/ESI/EDI = argumentos 1 a 3, retorno em EAX.
+//   No SYSENTER, ECX = ESP do usuario e EDX = EIP de retorno.
+
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include <stdint.h>
+
+#define SYSCALL_VECTOR          0x80
+
+#define SYS_NULL                0   // Nao faz nada (mede o custo da travessia)
+#define SYS_GET_TIME_PAGE       1   // Retorna o endereco da pagina de tempo
+#define SYS_DRAW_STRING         2   // (str, (row << 8) | col, cor)
+#define SYS_LOG_STATUS          3   // (str, cor)
+#define SYS_FUTEX_WAIT          4   // (endereco, valor_esperado)
+#define SYS_FUTEX_WAKE          5   // (endereco, quantos)
+#define SYS_YIELD               6
+#define SYS_MAX                 32
+
+#define SYSCALL_EFAULT          (-14)   // Ponteiro do usuario invalido
+#define SYSCALL_ENOSYS          (-38)
+
+// Ponteiros vindos do usuario ficam abaixo da divisao usuario/Kernel
+#define SYSCALL_USER_LIMIT      0xC0000000
+#define SYSCALL_STRING_MAX      256     // Maior string aceita (com o '\0')
+
+// Bits de TimePage.features
+#define TIME_FEATURE_SYSENTER   0x01 // A CPU suporta SYSENTER/SYSEXIT
+#define TIME_FEATURE_TSC_STABLE 0x02 // tsc_khz foi calibrado
+
+/**
+ * Pagina somente-leitura visivel a todos os processos. Os aplicativos leem
+ * o tempo daqui sem entrar no Kernel (protocolo seqlock: 'sequence' impar
+ * significa atualizacao em andamento; releia ate obter o mesmo valor par).
+ */
+typedef struct {
+    volatile uint32_t sequence;
+    uint32_t features;
+    uint32_t tsc_khz;           // Ciclos de TSC por milissegundo
+    uint32_t ns_mult;           // ns = (ciclos * ns_mult) >> ns_shift
+    uint32_t ns_shift;
+    uint32_t tick_hz;           // Frequencia do timer do agendador
+    volatile uint64_t tick_count;
+    volatile uint64_t tick_tsc; // TSC lido no ultimo tick
+    volatile uint64_t tick_ns;  // Nanossegundos desde o boot no ultimo tick
+} TimePage;
+
+#endif
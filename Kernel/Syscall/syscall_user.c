@@ -0,0 +1,187 @@
+// syscall_user.c - Lado do aplicativo das chamadas de sistema (ligado junto com cada App).
+//
+// Escolhe SYSENTER quando a CPU suporta, com INT 0x80 como alternativa, e le o
+// relogio direto da pagina de tempo, sem entrar no Kernel. Tambem traz o mutex
+// de usuario sobre o futex.
+
+#include <stdint.h>
+#include "syscall.h"
+
+#define BENCH_ITERATIONS 10000
+
+static const TimePage *user_time_page = 0;
+
+/**
+ * Chamada de sistema pela porta INT 0x80 (funciona em qualquer CPU).
+ */
+int32_t syscall_int80(uint32_t number, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    int32_t ret;
+    __asm__ __volatile__ (
+        "int $0x80"
+        : "=a"(ret)
+        : "a"(number), "b"(arg1), "S"(arg2), "D"(arg3)
+        : "ecx", "edx", "memory"
+    );
+    return ret;
+}
+
+/**
+ * Chamada de sistema pela porta SYSENTER. O Kernel volta com SYSEXIT
+ * para o EIP em EDX e o ESP em ECX.
+ */
+int32_t syscall_sysenter(uint32_t number, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    int32_t ret;
+    __asm__ __volatile__ (
+        "movl %%esp, %%ecx\n"
+        "movl $1f, %%edx\n"
+        "sysenter\n"
+        "1:\n"
+        : "=a"(ret)
+        : "a"(number), "b"(arg1), "S"(arg2), "D"(arg3)
+        : "ecx", "edx", "memory"
+    );
+    return ret;
+}
+
+static const TimePage* time_page_get() {
+    if (!user_time_page) {
+        user_time_page = (const TimePage*)syscall_int80(SYS_GET_TIME_PAGE, 0, 0, 0);
+    }
+    return user_time_page;
+}
+
+/**
+ * Porta de entrada padrao para os Apps: usa a mais rapida disponivel.
+ */
+int32_t syscall(uint32_t number, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    const TimePage *tp = time_page_get();
+    if (tp && (tp->features & TIME_FEATURE_SYSENTER)) {
+        return syscall_sysenter(number, arg1, arg2, arg3);
+    }
+    return syscall_int80(number, arg1, arg2, arg3);
+}
+
+static uint64_t user_read_tsc() {
+    uint32_t high, low;
+    __asm__ __volatile__ ("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+/**
+ * Nanossegundos desde o boot, lidos da pagina de tempo (sem entrar no Kernel).
+ */
+uint64_t vtime_now_ns() {
+    const TimePage *tp = time_page_get();
+    if (!tp) return 0;
+
+    uint32_t seq;
+    uint64_t base_ns, base_tsc;
+    do {
+        seq = tp->sequence;
+        __asm__ __volatile__ ("" : : : "memory");
+        base_ns = tp->tick_ns;
+        base_tsc = tp->tick_tsc;
+        __asm__ __volatile__ ("" : : : "memory");
+    } while ((seq & 1) || seq != tp->sequence);
+
+    return base_ns + (((user_read_tsc() - base_tsc) * tp->ns_mult) >> tp->ns_shift);
+}
+
+/**
+ * Numero de ticks do timer desde o boot (sem entrar no Kernel).
+ */
+uint64_t vtime_ticks() {
+    const TimePage *tp = time_page_get();
+    if (!tp) return 0;
+
+    uint32_t seq;
+    uint64_t ticks;
+    do {
+        seq = tp->sequence;
+        __asm__ __volatile__ ("" : : : "memory");
+        ticks = tp->tick_count;
+        __asm__ __volatile__ ("" : : : "memory");
+    } while ((seq & 1) || seq != tp->sequence);
+    return ticks;
+}
+
+// =======================================================
+// MUTEX DE USUARIO (futex)
+// =======================================================
+
+// Estados da palavra do mutex
+#define UMUTEX_FREE         0
+#define UMUTEX_LOCKED       1
+#define UMUTEX_CONTENDED    2   // Travado e com alguem dormindo no Kernel
+
+/**
+ * Trava um mutex de usuario. Sem disputa e so um CMPXCHG: nunca entra no Kernel.
+ * Com disputa, marca a palavra como CONTENDED e dorme via SYS_FUTEX_WAIT.
+ */
+void umutex_lock(volatile uint32_t *word) {
+    uint32_t c = UMUTEX_FREE;
+    if (__atomic_compare_exchange_n(word, &c, UMUTEX_LOCKED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+
+    if (c != UMUTEX_CONTENDED) c = __atomic_exchange_n(word, UMUTEX_CONTENDED, __ATOMIC_ACQUIRE);
+    while (c != UMUTEX_FREE) {
+        syscall(SYS_FUTEX_WAIT, (uint32_t)word, UMUTEX_CONTENDED, 0);
+        c = __atomic_exchange_n(word, UMUTEX_CONTENDED, __ATOMIC_ACQUIRE);
+    }
+}
+
+/**
+ * Destrava um mutex de usuario. So entra no Kernel se alguem estiver dormindo.
+ */
+void umutex_unlock(volatile uint32_t *word) {
+    if (__atomic_exchange_n(word, UMUTEX_FREE, __ATOMIC_RELEASE) == UMUTEX_CONTENDED) {
+        syscall(SYS_FUTEX_WAKE, (uint32_t)word, 1, 0);
+    }
+}
+
+// Converte um numero para decimal no fim de 'buffer'; retorna o inicio
+static char* u32_to_str(uint32_t value, char *buffer, int size) {
+    int i = size - 1;
+    buffer[i] = '\0';
+    do {
+        buffer[--i] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0 && i > 0);
+    return &buffer[i];
+}
+
+/**
+ * Mede o custo de ida e volta de uma chamada nula por cada porta de entrada
+ * (e da leitura do relogio pela pagina de tempo) e desenha na linha 'row'.
+ */
+void syscall_benchmark(int row) {
+    char buffer[12];
+    uint64_t start, int80_cycles, sysenter_cycles = 0, vtime_cycles;
+    const TimePage *tp = time_page_get();
+
+    start = user_read_tsc();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) syscall_int80(SYS_NULL, 0, 0, 0);
+    int80_cycles = (user_read_tsc() - start) / BENCH_ITERATIONS;
+
+    if (tp && (tp->features & TIME_FEATURE_SYSENTER)) {
+        start = user_read_tsc();
+        for (int i = 0; i < BENCH_ITERATIONS; i++) syscall_sysenter(SYS_NULL, 0, 0, 0);
+        sysenter_cycles = (user_read_tsc() - start) / BENCH_ITERATIONS;
+    }
+
+    start = user_read_tsc();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) vtime_now_ns();
+    vtime_cycles = (user_read_tsc() - start) / BENCH_ITERATIONS;
+
+    // "Ciclos/chamada nula: INT80 <n>  SYSENTER <n>  Relogio <n>"
+    syscall(SYS_DRAW_STRING, (uint32_t)"Ciclos/chamada nula: INT80", ((uint32_t)row << 8) | 0, 0x0B);
+    syscall(SYS_DRAW_STRING, (uint32_t)u32_to_str((uint32_t)int80_cycles, buffer, 12),
+            ((uint32_t)row << 8) | 27, 0x0F);
+    syscall(SYS_DRAW_STRING, (uint32_t)"SYSENTER", ((uint32_t)row << 8) | 36, 0x0B);
+    syscall(SYS_DRAW_STRING, (uint32_t)(sysenter_cycles ? u32_to_str((uint32_t)sysenter_cycles, buffer, 12) : "n/d"),
+            ((uint32_t)row << 8) | 45, 0x0F);
+    syscall(SYS_DRAW_STRING, (uint32_t)"Relogio", ((uint32_t)row << 8) | 54, 0x0B);
+    syscall(SYS_DRAW_STRING, (uint32_t)u32_to_str((uint32_t)vtime_cycles, buffer, 12),
+            ((uint32_t)row << 8) | 62, 0x0F);
+}
@@ -0,0 +1,53 @@
+// spinlock.h - Travas de giro (spinlocks) do Core-Blip.
+//
+// As versoes _irqsave tambem desligam as interrupcoes locais, entao podem ser
+// usadas em dados tocados por rotinas de interrupcao sem risco de deadlock.
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock(spinlock_t *lock) {
+    // 'xchg' com memoria e atomica (LOCK implicito)
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+        while (lock->locked) {
+            __asm__ __volatile__ ("pause");
+        }
+    }
+}
+
+static inline void spin_unlock(spinlock_t *lock) {
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+// Salva EFLAGS e desliga as interrupcoes (retorna o EFLAGS antigo)
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    __asm__ __volatile__ ("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Restaura o estado do bit IF salvo por irq_save()
+static inline void irq_restore(uint32_t flags) {
+    __asm__ __volatile__ ("pushl %0; popfl" : : "r"(flags) : "memory", "cc");
+}
+
+static inline uint32_t spin_lock_irqsave(spinlock_t *lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
+
+#endif
@@ -7,17 +7,44 @@ extern void move_selector(int delta_col, int delta_row);
 extern void update_cursor_and_talk(int new_row, int new_col);
 extern void init_talkback_logic();
 extern void putc(char c, int row, int col, char color);
+extern void create_process(void (*entry_point)());
+extern int ipc_channel_open(const char *name);
+extern void* ipc_peek_wait(int id, unsigned int *length, int *is_grant);
+extern void ipc_release(int id);
+extern int vc_open(const char *name);      // Do virtual_console.c
+extern int vc_select(int console);
+
+void handle_key_event(int key_code);
 
 
 // Variaveis globais de estado do servico
 static int current_selection_row = 10;
 static int current_selection_col = 5;
+static int key_channel = -1; // Canal "input.keys", alimentado pelo driver de teclado
+static int service_console = -1; // Console virtual do seletor, do log de fala e do titulo
+
+/**
+ * Processo do servico: dorme no canal de teclas e trata cada uma que chegar.
+ */
+static void accessibility_input_task() {
+    vc_select(service_console); // Tudo que o servico desenha vai para o seu console
+    for (;;) {
+        unsigned int length;
+        int *key = (int*)ipc_peek_wait(key_channel, &length, 0);
+        if (key && length == sizeof(int)) handle_key_event(*key);
+        ipc_release(key_channel);
+    }
+}
 
 /**
  * Funcao principal para iniciar o servico de acessibilidade.
  * O kernel_main() chamaria esta funcao.
  */
 void start_accessibility_service() {
+
+    // 0. Console proprio: a inicializacao ja desenha nele (e nao no do boot)
+    service_console = vc_open("Acessibilidade");
+    int boot_console = vc_select(service_console);
     
     // 1. Inicializa o modulo de TalkBack (Logica de Buffer de Fala)
     init_talkback_logic(); 
@@ -33,11 +60,17 @@ void start_accessibility_service() {
     // 3. Informa a logica de fala (TalkBack) qual conteudo foi selecionado inicialmente.
     // O (10, 5) e a posicao onde o cursor azul foi desenhado primeiro.
     update_cursor_and_talk(current_selection_row, current_selection_col);
+
+    vc_select(boot_console);
+
+    // 4. Passa a receber as teclas pelo canal de IPC, num processo proprio
+    key_channel = ipc_channel_open("input.keys");
+    if (key_channel >= 0) create_process(accessibility_input_task);
 }
 
 /**
  * Funcao de manipulacao de evento (Simula o pressionar de uma tecla).
- * Esta funcao seria chamada quando o driver de teclado estivesse pronto.
+ * Chamada pelo accessibility_input_task() para cada tecla lida do canal.
  */
 void handle_key_event(int key_code) {
     // Simula a tecla de seta para baixo
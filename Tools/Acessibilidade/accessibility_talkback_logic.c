@@ -1,21 +1,34 @@
 // accessibility_talkback_logic.c - Simula o Servico de Leitor de Tela (TalkBack)
 
-// Presume que o Kernel tem acesso direto a memoria de video
-#define VIDEO_MEMORY_START 0xb8000
+#include <stdint.h>
+
+// O texto vem da grade do console do servico (Do virtual_console.c): o
+// console pode estar em segundo plano, e a VRAM so tem o visivel
+extern int vc_current();
+extern char vc_get_char(int console, int row, int col);
+
+// Sintese e saida de audio (Do speech_synth.c e do cpu_diag.c)
+extern int speech_say(const char *text, uint64_t request_tsc);
+extern void init_speech_synth();
+extern uint64_t read_tsc();
 
 // Buffer onde o texto a ser 'falado' sera armazenado.
 // Este e o nosso "fila de fala" simulada.
 static char speech_buffer[100];
 static int buffer_index = 0;
 
-// Funcao que 'fala' o conteudo lido (na verdade, apenas registra o que seria falado)
+// Instante do movimento do cursor que originou a fala (latencia ate o DAC)
+static uint64_t speech_request_tsc = 0;
+
+// Funcao que fala o conteudo lido (sintese de audio + registro na tela)
 void speak_buffer() {
-    // Esta funcao seria o ponto de injecao do Driver de Audio e do TTS.
-    
-    // Por enquanto, apenas esvazia o buffer e imprime um status
+    // Entrega o texto a sintese (audio pelo AC'97) e repete na linha de log
     if (buffer_index > 0) {
         // Encerra a string
         speech_buffer[buffer_index] = '\0'; 
+
+        // Interrompe a fala anterior; sem audio, fica so o log
+        speech_say(speech_buffer, speech_request_tsc);
         
         // Simula a fala imprimindo o texto em uma area de log do Kernel (linha 22)
         const char *log_prefix = "FALA: ";
@@ -44,10 +57,8 @@ void read_and_speak_cursor_content(int row, int col) {
     // Reseta o buffer antes de ler a nova informacao
     buffer_index = 0; 
 
-    // 1. Le o caractere na memoria de video (na posicao do cursor)
-    unsigned char* video_memory = (unsigned char*)VIDEO_MEMORY_START;
-    int offset = (row * 80 + col) * 2;
-    char current_char = video_memory[offset];
+    // 1. Le o caractere do console (na posicao do cursor)
+    char current_char = vc_get_char(vc_current(), row, col);
 
     // 2. Coloca o caractere lido no buffer
     if (current_char != ' ' && current_char != '\0') {
@@ -77,11 +88,14 @@ void update_cursor_and_talk(int new_row, int new_col) {
     // 4. draw_cursor(); (Desenhar o novo)
     
     // 5. O novo passo de acessibilidade:
+    speech_request_tsc = read_tsc();
     read_and_speak_cursor_content(new_row, new_col);
 }
 
 // Funcao de inicializacao que o Kernel chamaria
 void init_talkback_logic() {
+    init_speech_synth(); // Depois de init_audio_driver()
+
     const char *title = "Logica TalkBack Ativa (Checando linha 10, coluna 0)";
     for (int i = 0; title[i] != '\0'; i++) {
         putc(title[i], 14, i, 0x0C); // Vermelho Claro
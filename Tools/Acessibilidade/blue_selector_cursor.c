@@ -3,6 +3,10 @@
 // Presume-se que 'putc' esta disponivel
 extern void putc(char c, int row, int col, char color);
 
+// A grade do console de quem desenha (Do virtual_console.c), em vez da VRAM
+extern int vc_current();
+extern char vc_get_char(int console, int row, int col);
+
 // Cores usadas:
 #define DEFAULT_COLOR 0x07 // Fundo Preto (0), Texto Branco (7)
 #define SELECT_COLOR  0x1F // Fundo Azul (1), Texto Branco (F)
@@ -15,10 +19,8 @@ static int selector_col = 0;
  * Funcao para aplicar o highlight azul na posicao atual do cursor.
  */
 void highlight_cursor() {
-    // 1. Le o caractere que esta na posicao do cursor
-    unsigned char* video_memory = (unsigned char*)0xb8000;
-    int offset = (selector_row * 80 + selector_col) * 2;
-    char current_char = video_memory[offset];
+    // 1. Le o caractere que esta na posicao do cursor (no console do servico)
+    char current_char = vc_get_char(vc_current(), selector_row, selector_col);
 
     // 2. Desenha o caractere com o destaque (Fundo Azul, Texto Branco)
     putc(current_char, selector_row, selector_col, SELECT_COLOR);
@@ -28,10 +30,8 @@ void highlight_cursor() {
  * Funcao para remover o highlight e restaurar a cor padrao.
  */
 void unhighlight_cursor() {
-    // 1. Le o caractere que esta na posicao do cursor
-    unsigned char* video_memory = (unsigned char*)0xb8000;
-    int offset = (selector_row * 80 + selector_col) * 2;
-    char current_char = video_memory[offset];
+    // 1. Le o caractere que esta na posicao do cursor (no console do servico)
+    char current_char = vc_get_char(vc_current(), selector_row, selector_col);
 
     // 2. Restaura a cor padrao (Fundo Preto, Texto Branco)
     putc(current_char, selector_row, selector_col, DEFAULT_COLOR);
@@ -0,0 +1,260 @@
+// speech_synth.c - Sintese de fala do TalkBack, adiantada em relacao ao audio.
+//
+// Cada caractere vira um segmento curto: vogais e sonoras sao um pulso
+// glotal (dente de serra a SPEECH_PITCH_HZ) modulando dois formantes
+// triangulares; fricativas sao ruido; oclusivas, um estalo de ruido e uma
+// pausa; espaco e pontuacao, silencio. E uma voz de "soletrar", sem
+// dicionario nem prosodia, so com inteiros (sem FPU no caminho).
+//
+// Fluxo: speech_say() descarta a fala anterior (o foco mudou), sintetiza o
+// primeiro periodo na hora - para o mixer pegar ja na proxima IRQ - e acorda
+// a tarefa assincrona, que mantem SPEECH_AHEAD_SAMPLES na frente do DMA. Com
+// MAX_PROCESSES na fila round-robin de 10ms, o executor roda bem antes de a
+// folga de SPEECH_LOW_WATERMARK acabar, entao a carga de CPU nao vira underrun.
+
+#include <stdint.h>
+#include "../../Drivers/Driver de audio/audio.h"
+#include "../../Kernel/Async/async.h"
+#include "../../Kernel/spinlock.h"
+
+extern void ui_log_status(const char *status_msg, char color_byte);
+
+#define SPEECH_TEXT_MAX         100
+#define SPEECH_CHUNK_SAMPLES    480     // 10ms por passo da tarefa
+#define SPEECH_AHEAD_SAMPLES    7200    // 150ms adiantados
+#define SPEECH_LOW_WATERMARK    4800    // Abaixo de 100ms na fila, sintetiza mais
+#define SPEECH_PITCH_HZ         140
+#define SPEECH_AMPLITUDE        9000    // Pico (de 32767): sobra para o mixer somar
+#define SPEECH_RAMP_SAMPLES     240     // 5ms de ataque/soltura (sem estalos)
+
+// Tipos de segmento
+#define SEG_SILENCE     0
+#define SEG_VOICED      1   // Pulso glotal + formantes
+#define SEG_NOISE       2   // Ruido (fricativa)
+#define SEG_BURST       3   // Ruido curto + silencio (oclusiva)
+
+typedef struct {
+    uint8_t kind;
+    uint16_t f1;            // Hz
+    uint16_t f2;
+    uint16_t duration;      // Amostras
+} Segment;
+
+static audio_stream_t *speech_stream = 0;
+static spinlock_t speech_lock = SPINLOCK_INIT;
+
+// Fala em curso (protegida por speech_lock)
+static char speech_text[SPEECH_TEXT_MAX];
+static uint32_t speech_length = 0;
+static uint32_t speech_pos = 0;         // Caractere atual
+static uint32_t segment_pos = 0;        // Amostra dentro do segmento
+static Segment segment;
+static int speech_active = 0;
+static uint32_t phase_pitch = 0, phase_f1 = 0, phase_f2 = 0;
+static uint32_t step_pitch = 0, step_f1 = 0, step_f2 = 0; // Por segmento: sem divisao por amostra
+static uint16_t noise_lfsr = 0xACE1;
+static int16_t synth_chunk[SPEECH_CHUNK_SAMPLES];
+
+// =======================================================
+// 1. FONEMAS
+// =======================================================
+
+// Passo do acumulador de fase (32 bits = uma volta) para 'hz'
+static uint32_t phase_step(uint32_t hz) {
+    return (uint32_t)(((uint64_t)hz << 32) / AUDIO_SAMPLE_RATE);
+}
+
+static char lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+/**
+ * Escolhe o segmento de um caractere (formantes aproximados do portugues).
+ */
+static Segment segment_for(char c) {
+    Segment s = { SEG_SILENCE, 0, 0, AUDIO_SAMPLE_RATE * 60 / 1000 };
+    c = lower(c);
+
+    switch (c) {
+        case 'a': s.kind = SEG_VOICED; s.f1 = 730; s.f2 = 1090; break;
+        case 'e': s.kind = SEG_VOICED; s.f1 = 530; s.f2 = 1840; break;
+        case 'i': s.kind = SEG_VOICED; s.f1 = 270; s.f2 = 2290; break;
+        case 'o': s.kind = SEG_VOICED; s.f1 = 570; s.f2 = 840;  break;
+        case 'u': s.kind = SEG_VOICED; s.f1 = 300; s.f2 = 870;  break;
+        case 'm': case 'n':
+            s.kind = SEG_VOICED; s.f1 = 250; s.f2 = 1200; break;
+        case 'l': case 'r': case 'y': case 'w':
+            s.kind = SEG_VOICED; s.f1 = 350; s.f2 = 1400; break;
+        case 's': case 'f': case 'x': case 'z': case 'j': case 'v': case 'h': case 'c':
+            s.kind = SEG_NOISE; break;
+        case 'p': case 't': case 'k': case 'b': case 'd': case 'g': case 'q':
+            s.kind = SEG_BURST; break;
+        case '.': case ',': case ':': case ';': case '!': case '?':
+            s.duration = AUDIO_SAMPLE_RATE * 150 / 1000; return s;
+        case ' ':
+            return s;
+        default:
+            // Digitos e o resto: uma vogal neutra com F2 variando pelo codigo
+            s.kind = SEG_VOICED; s.f1 = 500; s.f2 = (uint16_t)(1000 + ((uint8_t)c % 16) * 80); break;
+    }
+    s.duration = AUDIO_SAMPLE_RATE * 90 / 1000;
+    return s;
+}
+
+static int32_t triangle(uint32_t phase) {
+    uint32_t p = phase >> 16;
+    return (int32_t)(p < 32768 ? p : 65535 - p) * 2 - 32768;
+}
+
+static int32_t noise() {
+    noise_lfsr = (uint16_t)((noise_lfsr >> 1) ^ (-(noise_lfsr & 1) & 0xB400)); // LFSR de Galois
+    return (int32_t)(int16_t)noise_lfsr;
+}
+
+// Envelope linear nas pontas do segmento (0..65536)
+static int32_t envelope(uint32_t pos, uint32_t duration) {
+    uint32_t to_end = duration - pos;
+    uint32_t edge = pos < to_end ? pos : to_end;
+    if (edge >= SPEECH_RAMP_SAMPLES) return 65536;
+    return (int32_t)(edge * 65536 / SPEECH_RAMP_SAMPLES);
+}
+
+static int32_t segment_sample() {
+    int32_t value = 0;
+    switch (segment.kind) {
+        case SEG_VOICED: {
+            // Pulso glotal: cai de 1 a 0 em cada periodo do pitch
+            int32_t glottal = 65535 - (int32_t)(phase_pitch >> 16);
+            int32_t formants = (triangle(phase_f1) * 3 + triangle(phase_f2) * 2) / 5;
+            value = (int32_t)(((int64_t)formants * glottal) >> 16);
+            phase_pitch += step_pitch;
+            phase_f1 += step_f1;
+            phase_f2 += step_f2;
+            break;
+        }
+        case SEG_NOISE:
+            value = noise() / 2;
+            break;
+        case SEG_BURST:
+            value = segment_pos < segment.duration / 3 ? noise() : 0;
+            break;
+    }
+    value = (int32_t)(((int64_t)value * envelope(segment_pos, segment.duration)) >> 16);
+    return value * SPEECH_AMPLITUDE / 32768;
+}
+
+/**
+ * Sintetiza ate 'count' amostras da fala em curso. Chamar com speech_lock.
+ * @return Quantas foram geradas (menos que 'count' = a fala acabou).
+ */
+static uint32_t synth_render(int16_t *out, uint32_t count) {
+    uint32_t produced = 0;
+    while (produced < count && speech_active) {
+        if (segment_pos == segment.duration) {
+            if (speech_pos == speech_length) {
+                speech_active = 0;
+                break;
+            }
+            segment = segment_for(speech_text[speech_pos++]);
+            segment_pos = 0;
+            step_f1 = phase_step(segment.f1);
+            step_f2 = phase_step(segment.f2);
+            continue;
+        }
+        out[produced++] = (int16_t)segment_sample();
+        segment_pos++;
+    }
+    return produced;
+}
+
+// =======================================================
+// 2. ESTAGIO DE SINTESE (ADIANTADO)
+// =======================================================
+
+// Sintetiza um bloco e o entrega ao fluxo. Chamar com speech_lock.
+static void synth_chunk_to_stream(uint32_t max) {
+    uint32_t produced = synth_render(synth_chunk, max);
+    audio_stream_write(speech_stream, synth_chunk, produced);
+    if (!speech_active) audio_stream_end(speech_stream);
+}
+
+/**
+ * Completa a folga de SPEECH_AHEAD_SAMPLES, um bloco de 10ms por vez (a
+ * trava so fica presa durante um bloco).
+ */
+static void speech_fill() {
+    for (;;) {
+        uint32_t flags = spin_lock_irqsave(&speech_lock);
+        uint32_t queued = audio_stream_queued(speech_stream);
+        if (!speech_active || queued >= SPEECH_AHEAD_SAMPLES) {
+            spin_unlock_irqrestore(&speech_lock, flags);
+            return;
+        }
+        uint32_t want = SPEECH_AHEAD_SAMPLES - queued;
+        synth_chunk_to_stream(want < SPEECH_CHUNK_SAMPLES ? want : SPEECH_CHUNK_SAMPLES);
+        spin_unlock_irqrestore(&speech_lock, flags);
+    }
+}
+
+// Tarefa da sintese: acorda quando a fila do fluxo baixa (ou chega fala nova)
+static int speech_task(async_task_t *t) {
+    ASYNC_BEGIN(t);
+    for (;;) {
+        ASYNC_AWAIT(t, audio_stream_low_event(speech_stream), 0);
+        speech_fill();
+    }
+    ASYNC_END(t);
+}
+
+/**
+ * Fala 'text', interrompendo a fala anterior.
+ * @param request_tsc Instante do evento que pediu a fala (para medir a latencia
+ *                    ate a primeira amostra no DAC).
+ * @return 0 se a fala foi enfileirada, -1 sem audio.
+ */
+int speech_say(const char *text, uint64_t request_tsc) {
+    if (!speech_stream) return -1;
+
+    uint32_t flags = spin_lock_irqsave(&speech_lock);
+    audio_stream_flush(speech_stream);
+
+    while (*text == ' ') text++; // Silencio na frente so atrasaria a primeira amostra
+    speech_length = 0;
+    while (text[speech_length] != '\0' && speech_length < SPEECH_TEXT_MAX) {
+        speech_text[speech_length] = text[speech_length];
+        speech_length++;
+    }
+    speech_pos = 0;
+    segment.duration = 0;
+    segment_pos = 0;
+    phase_pitch = phase_f1 = phase_f2 = 0;
+    speech_active = 1;
+
+    // Primeiro periodo ja, no processo de quem pediu: o resto fica com a tarefa
+    audio_stream_mark(speech_stream, request_tsc);
+    synth_chunk_to_stream(AUDIO_PERIOD_FRAMES);
+    spin_unlock_irqrestore(&speech_lock, flags);
+
+    async_signal(audio_stream_low_event(speech_stream));
+    return 0;
+}
+
+/**
+ * Abre o fluxo da fala e inicia a tarefa de sintese. Chamar depois de
+ * init_audio_driver(); sem audio, a fala continua so no log da tela.
+ */
+void init_speech_synth() {
+    if (!audio_active()) return;
+
+    step_pitch = phase_step(SPEECH_PITCH_HZ);
+    speech_stream = audio_stream_open(SPEECH_LOW_WATERMARK);
+    if (!speech_stream) return;
+
+    async_task_t *t = async_alloc(speech_task, sizeof(async_task_t));
+    if (!t) {
+        ui_log_status("Fala ERRO: sem memoria para a tarefa de sintese.", 0x0C);
+        return;
+    }
+    async_start(t);
+    ui_log_status("Fala: sintese ativa (150ms adiantados).", 0x0A);
+}
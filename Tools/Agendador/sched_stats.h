@@ -0,0 +1,29 @@
+// sched_stats.h - Contabilidade de tempo de CPU por processo (guardada no PCB).
+//
+// Tudo em ciclos do TSC: o agendador so soma diferencas de RDTSC na troca.
+// A conversao para nanossegundos (tsc_cycles_to_ns) fica com quem le.
+
+#ifndef SCHED_STATS_H
+#define SCHED_STATS_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t run_cycles;    // Tempo rodando na CPU
+    uint64_t wait_cycles;   // Tempo PRONTO, esperando na fila (latencia do agendador)
+    uint64_t sleep_cycles;  // Tempo BLOQUEADO numa wait queue
+    uint64_t stamp;         // TSC da ultima mudanca de estado (uso interno)
+    uint32_t switches;      // Vezes em que ganhou a CPU
+    uint32_t voluntary;     // Saidas por yield ou bloqueio
+    uint32_t involuntary;   // Saidas por preempcao do timer
+} sched_stats_t;
+
+// Estado devolvido por scheduler_get_stats()
+#define SCHED_STATE_FREE     0
+#define SCHED_STATE_READY    1
+#define SCHED_STATE_BLOCKED  2
+#define SCHED_STATE_RUNNING  3
+
+int scheduler_get_stats(int pid, sched_stats_t *out);
+
+#endif
@@ -1,5 +1,9 @@
 #include <stdint.h>
 #include "kernel_base.h" // Funcoes putc, ui_log_status
+#include "../../Kernel/spinlock.h" // irq_save/irq_restore
+#include "../CPU/fpu_context.h"      // Estado de FPU/SSE por tarefa (troca preguicosa)
+#include "../../Kernel/Lib/kmemory.h"
+#include "sched_stats.h"              // Tempo de CPU, espera e trocas por processo
 
 // =======================================================
 // 1. ESTRUTURAS DE DADOS DO AGENDADOR
@@ -10,42 +14,106 @@ typedef struct {
     uint32_t esp;       // Endereco do topo da Pilha (Stack Pointer)
     uint32_t pid;       // ID do Processo
     uint32_t state;     // Estado (e.g., RUNNING, READY, BLOCKED)
+    uint32_t kernel_stack; // Pagina usada pelas chamadas de sistema (SYSENTER/INT 0x80)
+    fpu_ctx_t fpu;      // Estado x87/SSE/AVX (area criada so se a tarefa usar a FPU)
+    sched_stats_t stats; // Contabilidade de tempo (ciclos do TSC)
     uint32_t stack[1024]; // Espaco de pilha dedicado (4KB)
 } PCB;
 
 #define MAX_PROCESSES 4
 #define STACK_SIZE_WORDS 1024 // 4KB
+#define KERNEL_STACK_SIZE 4096
+
+// Estados do PCB
+#define TASK_FREE       0
+#define TASK_READY      1   // Pronto (ou rodando, se for o current_pid)
+#define TASK_BLOCKED    2   // Dormindo em uma wait queue: nunca e visitado pelo agendador
+
+#define IDLE_PID        0   // O Kernel Idle Loop nunca bloqueia
+#define SCHED_YIELD_VECTOR 0x81
 
 // Array para armazenar todos os PCBs
 static PCB process_table[MAX_PROCESSES];
 static int current_pid = 0; // O PID do processo atualmente em execucao
+static int scheduler_started = 0;
+
+// Fila circular dos processos READY (o atual nao fica na fila enquanto roda)
+static uint8_t run_queue[MAX_PROCESSES];
+static int run_queue_head = 0;
+static int run_queue_count = 0;
 
 // Funcao externa (em Assembly) para fazer o Context Switch
 // Ele salva os registradores na pilha antiga e carrega os da nova.
 extern void context_switch(uint32_t new_esp);
 
+extern void time_page_tick();                       // Do syscall.c
+extern void async_timer_tick();                     // Do async.c
+extern void syscall_set_kernel_stack(uint32_t esp0); // Do syscall.c
+extern uint32_t alloc_page();                       // Do page_allocator.c
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern void vc_reset_pid(int pid);                  // Do virtual_console.c
+extern void apic_irq_enter();                       // Do apic.c
+extern void apic_irq_exit();
+extern void idt_set_gate(uint8_t vector, uint32_t handler, uint16_t selector, uint8_t flags);
+
 // =======================================================
 // 2. FUNCOES DE CONTROLE DO AGENDADOR
 // =======================================================
 
+static void run_queue_push(int pid) {
+    run_queue[(run_queue_head + run_queue_count) % MAX_PROCESSES] = (uint8_t)pid;
+    run_queue_count++;
+}
+
+static int run_queue_pop() {
+    if (run_queue_count == 0) return -1;
+    int pid = run_queue[run_queue_head];
+    run_queue_head = (run_queue_head + 1) % MAX_PROCESSES;
+    run_queue_count--;
+    return pid;
+}
+
 /**
- * Rotina que e chamada pela Interrupcao do Timer (IRQ0).
- * Este é o ponto de entrada da multitarefa.
+ * Troca para o proximo processo da fila de prontos.
+ * Chamada com as interrupcoes desligadas (timer ou yield).
+ * @param preempted 1 se veio do timer (troca involuntaria), 0 se do yield.
  */
-void scheduler_timer_interrupt(uint32_t esp_from_interrupt) {
-    
+static void scheduler_switch(uint32_t esp_from_interrupt, int preempted) {
     // 1. Salvar o contexto (estado) do processo atual
     // O esp_from_interrupt e o topo da pilha onde o hardware salvou os registradores
-    process_table[current_pid].esp = esp_from_interrupt;
+    PCB *prev = &process_table[current_pid];
+    prev->esp = esp_from_interrupt;
+
+    // Contabilidade: um RDTSC e algumas somas por troca, nada de divisoes
+    uint64_t now = read_tsc();
+    prev->stats.run_cycles += now - prev->stats.stamp;
+    prev->stats.stamp = now;
 
-    // 2. Logica de Selecao (Round-Robin)
-    // Apenas avanca para o proximo processo na tabela
-    do {
-        current_pid = (current_pid + 1) % MAX_PROCESSES;
-    } while (process_table[current_pid].state != 1); // Garante que o processo esta READY/RUNNING
+    // 2. Logica de Selecao (Round-Robin sobre a fila de prontos)
+    // Se o processo atual continua pronto, volta para o fim da fila.
+    // Processos BLOCKED nao estao na fila, entao nunca sao visitados.
+    if (process_table[current_pid].state == TASK_READY) run_queue_push(current_pid);
+    int next = run_queue_pop();
+    current_pid = (next < 0) ? IDLE_PID : next;
+
+    if (&process_table[current_pid] != prev) {
+        if (preempted && prev->state == TASK_READY) prev->stats.involuntary++;
+        else prev->stats.voluntary++;
+
+        // O tempo desde que ficou pronto foi espera na fila
+        PCB *incoming = &process_table[current_pid];
+        incoming->stats.wait_cycles += now - incoming->stats.stamp;
+        incoming->stats.stamp = now;
+        incoming->stats.switches++;
+    }
 
     // 3. Carregar o contexto (estado) do proximo processo
     uint32_t new_esp = process_table[current_pid].esp;
+    if (process_table[current_pid].kernel_stack) {
+        syscall_set_kernel_stack(process_table[current_pid].kernel_stack + KERNEL_STACK_SIZE);
+    }
+    // A FPU nao e salva aqui: so liga o CR0.TS (ou antecipa, para quem usa sempre)
+    fpu_switch(&process_table[current_pid].fpu);
     
     // 4. Efetuar o Salto! (Context Switching)
     // O Assembly ira restaurar os registradores do novo processo e retornar
@@ -53,6 +121,139 @@ void scheduler_timer_interrupt(uint32_t esp_from_interrupt) {
     context_switch(new_esp);
 }
 
+/**
+ * Rotina que e chamada pela Interrupcao do Timer (IRQ0).
+ * Este é o ponto de entrada da multitarefa.
+ */
+void scheduler_timer_interrupt(uint32_t esp_from_interrupt) {
+    // Tick do APIC ou do PIT: o trabalho abaixo e de IRQ (desenha no console
+    // do sistema); a troca nao volta, entao a marca sai antes dela
+    apic_irq_enter();
+
+    // 0. Avanca o relogio publicado na pagina de tempo
+    time_page_tick();
+
+    // 1. Vence os prazos das tarefas assincronas (ASYNC_AWAIT com timeout)
+    async_timer_tick();
+
+    apic_irq_exit();
+    scheduler_switch(esp_from_interrupt, 1);
+}
+
+/**
+ * Rotina chamada pela interrupcao de software SCHED_YIELD_VECTOR.
+ * Mesmo caminho do timer, mas sem contar um tick.
+ */
+void scheduler_yield_interrupt(uint32_t esp_from_interrupt) {
+    scheduler_switch(esp_from_interrupt, 0);
+}
+
+// Ponto de entrada do INT 0x81: monta o mesmo quadro que o stub do IRQ0
+// (registradores salvos + ESP como argumento) para o context_switch restaurar.
+__asm__ (
+    ".globl scheduler_yield_entry\n"
+    "scheduler_yield_entry:\n"
+    "    pushal\n"
+    "    pushl %esp\n"
+    "    call scheduler_yield_interrupt\n"
+);
+extern void scheduler_yield_entry();
+
+/**
+ * Cede a CPU voluntariamente para o proximo processo pronto.
+ */
+void scheduler_yield() {
+    __asm__ __volatile__ ("int %0" : : "i"(SCHED_YIELD_VECTOR) : "memory");
+}
+
+/**
+ * Bloqueia o processo atual ate que alguem chame scheduler_wake() nele.
+ * Chamar com as interrupcoes desligadas, DEPOIS de se registrar numa wait
+ * queue: assim um wake vindo de uma IRQ nao pode se perder no meio.
+ */
+void scheduler_block_current() {
+    if (current_pid == IDLE_PID) return; // O Idle Loop nunca dorme
+    process_table[current_pid].state = TASK_BLOCKED;
+    scheduler_yield();
+}
+
+/**
+ * Acorda um processo bloqueado: ele volta direto para a fila de prontos.
+ * Pode ser chamada de rotinas de interrupcao.
+ */
+void scheduler_wake(int pid) {
+    uint32_t flags = irq_save();
+    if (pid >= 0 && pid < MAX_PROCESSES && process_table[pid].state == TASK_BLOCKED) {
+        // Fim do sono; a partir daqui o tempo conta como espera na fila
+        sched_stats_t *stats = &process_table[pid].stats;
+        uint64_t now = read_tsc();
+        stats->sleep_cycles += now - stats->stamp;
+        stats->stamp = now;
+
+        process_table[pid].state = TASK_READY;
+        run_queue_push(pid);
+    }
+    irq_restore(flags);
+}
+
+/**
+ * PID do processo em execucao.
+ */
+int scheduler_current_pid() {
+    return current_pid;
+}
+
+/**
+ * Copia a contabilidade de um processo, ja incluindo o trecho em curso
+ * (rodando, esperando ou dormindo desde a ultima troca).
+ * @return O estado (SCHED_STATE_*), ou -1 se o PID nao existe.
+ */
+int scheduler_get_stats(int pid, sched_stats_t *out) {
+    if (pid < 0 || pid >= MAX_PROCESSES) return -1;
+
+    uint32_t flags = irq_save();
+    PCB *pcb = &process_table[pid];
+    *out = pcb->stats;
+    int state = (int)pcb->state;
+
+    if (state != TASK_FREE) {
+        uint64_t now = read_tsc();
+        uint64_t elapsed = now - out->stamp;
+        if (pid == current_pid) {
+            out->run_cycles += elapsed;
+            state = SCHED_STATE_RUNNING;
+        } else if (state == TASK_BLOCKED) {
+            out->sleep_cycles += elapsed;
+        } else {
+            out->wait_cycles += elapsed;
+        }
+        out->stamp = now;
+    }
+    irq_restore(flags);
+    return state;
+}
+
+/**
+ * Depois de uma retomada da hibernacao o TSC recomeca do zero: reinicia o
+ * carimbo de todos os processos para que o trecho em curso nao vire lixo.
+ */
+void scheduler_rebase_clock() {
+    uint32_t flags = irq_save();
+    uint64_t now = read_tsc();
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        process_table[i].stats.stamp = now;
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Diz se o chamador pode dormir numa wait queue. Antes do agendador
+ * comecar (boot) e no Idle Loop, os drivers devem usar espera ativa.
+ */
+int scheduler_can_block() {
+    return scheduler_started && current_pid != IDLE_PID;
+}
+
 /**
  * Funcao para criar um novo processo e adiciona-lo ao Agendador.
  */
@@ -61,7 +262,7 @@ void create_process(void (*entry_point)()) {
     // Encontra o proximo slot PID disponivel
     int new_pid = 0;
     for (new_pid = 0; new_pid < MAX_PROCESSES; new_pid++) {
-        if (process_table[new_pid].state == 0) break; // 0 = FREE
+        if (process_table[new_pid].state == TASK_FREE) break;
     }
     
     if (new_pid == MAX_PROCESSES) {
@@ -72,7 +273,10 @@ void create_process(void (*entry_point)()) {
     // 1. Inicializar o PCB
     PCB *new_pcb = &process_table[new_pid];
     new_pcb->pid = new_pid;
-    new_pcb->state = 1; // 1 = READY (Pronto para rodar)
+    new_pcb->kernel_stack = alloc_page(); // Pilha das chamadas de sistema
+    fpu_release(&new_pcb->fpu);           // Sem estado de FPU ate o primeiro uso
+    kmemset(&new_pcb->stats, 0, sizeof(sched_stats_t));
+    vc_reset_pid(new_pid);                // Comeca no console do sistema
 
     // 2. Configurar a Pilha (Simular um estado de interrupcao limpo)
     // O ponto de entrada da pilha e onde o Context Switch ira "retornar".
@@ -84,6 +288,13 @@ void create_process(void (*entry_point)()) {
 
     // Salva o novo topo da pilha (ESP)
     new_pcb->esp = (uint32_t)stack_ptr;
+
+    // 3. Entra na fila de prontos (so agora o PCB esta completo)
+    uint32_t flags = irq_save();
+    new_pcb->stats.stamp = read_tsc(); // Comeca esperando na fila
+    new_pcb->state = TASK_READY;
+    run_queue_push(new_pid);
+    irq_restore(flags);
     
     ui_log_status("Novo processo criado e agendado.", 0x0A);
 }
@@ -92,15 +303,22 @@ void create_process(void (*entry_point)()) {
  * Funcao de inicializacao do Agendador.
  */
 void init_scheduler() {
-    // A rotina de init_timer_driver() (nao mostrada) configuraria o timer para 10ms.
+    // O tick de 10ms vem do timer do Local APIC (init_apic() no apic.c chama
+    // scheduler_timer_interrupt()); sem APIC, de um PIT no IRQ0.
     
     // Exemplo de criacao de processos (App Loader e Diagnostico)
     // create_process(action_run_app); // Funcao para rodar um aplicativo
     // create_process(action_diagnostics); // Funcao para rodar o monitor CPU
     
     // Inicializa o processo 0 (o Kernel Idle Loop)
-    process_table[0].pid = 0;
-    process_table[0].state = 1; 
+    process_table[IDLE_PID].pid = IDLE_PID;
+    process_table[IDLE_PID].state = TASK_READY;
+    process_table[IDLE_PID].stats.stamp = read_tsc();
+    fpu_switch(&process_table[IDLE_PID].fpu); // O boot passa a ser a tarefa do Idle
+
+    // Portao do yield voluntario (usado pelas wait queues)
+    idt_set_gate(SCHED_YIELD_VECTOR, (uint32_t)scheduler_yield_entry, 0x08, 0x8E);
+    scheduler_started = 1;
     
     ui_log_status("Agendador Ativo. Pronto para multitarefa.", 0x0F);
 }
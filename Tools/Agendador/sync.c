@@ -0,0 +1,248 @@
+// sync.c - Wait queues, mutexes, semaforos, variaveis de condicao e futex.
+
+#include <stdint.h>
+#include "sync.h"
+#include "../../Kernel/Syscall/syscall.h"
+
+extern void scheduler_block_current();
+extern void scheduler_yield();
+extern void scheduler_wake(int pid);
+extern int scheduler_current_pid();
+extern int scheduler_can_block();
+extern int syscall_register(uint32_t number, int32_t (*handler)(uint32_t, uint32_t, uint32_t));
+
+#define FUTEX_SLOTS     16
+#define SYSCALL_EAGAIN  (-11)
+
+// =======================================================
+// 1. WAIT QUEUES
+// =======================================================
+
+void wait_queue_init(wait_queue_t *wq) {
+    wq->lock.locked = 0;
+    wq->head = 0;
+    wq->count = 0;
+}
+
+/**
+ * Coloca o processo atual na fila e bloqueia.
+ * Chamar com as interrupcoes desligadas (use wait_event()).
+ */
+void wait_queue_sleep_irqoff(wait_queue_t *wq) {
+    if (!scheduler_can_block()) {
+        // Boot/Idle: nao ha para onde trocar. Abre uma janela para as IRQs
+        // pendentes entrarem e devolve o controle para o chamador retestar.
+        __asm__ __volatile__ ("sti; nop; cli" : : : "memory");
+        return;
+    }
+
+    spin_lock(&wq->lock);
+    wq->pids[(wq->head + wq->count) % WAIT_QUEUE_CAPACITY] = (uint8_t)scheduler_current_pid();
+    wq->count++;
+    spin_unlock(&wq->lock);
+
+    scheduler_block_current(); // Volta daqui quando alguem nos acordar
+}
+
+/**
+ * Acorda o processo mais antigo da fila.
+ * @return 1 se alguem foi acordado, 0 se a fila estava vazia.
+ */
+int wait_queue_wake_one(wait_queue_t *wq) {
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    int pid = -1;
+    if (wq->count > 0) {
+        pid = wq->pids[wq->head];
+        wq->head = (uint8_t)((wq->head + 1) % WAIT_QUEUE_CAPACITY);
+        wq->count--;
+    }
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    if (pid < 0) return 0;
+    scheduler_wake(pid);
+    return 1;
+}
+
+/**
+ * Acorda todos os processos da fila.
+ * @return Numero de processos acordados.
+ */
+int wait_queue_wake_all(wait_queue_t *wq) {
+    int woken = 0;
+    while (wait_queue_wake_one(wq)) woken++;
+    return woken;
+}
+
+// =======================================================
+// 2. MUTEX
+// =======================================================
+
+void mutex_init(mutex_t *m) {
+    m->locked = 0;
+    m->owner = -1;
+    wait_queue_init(&m->waiters);
+}
+
+int mutex_trylock(mutex_t *m) {
+    if (__atomic_exchange_n(&m->locked, 1, __ATOMIC_ACQUIRE) != 0) return 0;
+    m->owner = scheduler_current_pid();
+    return 1;
+}
+
+/**
+ * Trava o mutex. Sem disputa, e so uma troca atomica.
+ */
+void mutex_lock(mutex_t *m) {
+    if (mutex_trylock(m)) return;
+    wait_event(&m->waiters, mutex_trylock(m));
+}
+
+void mutex_unlock(mutex_t *m) {
+    m->owner = -1;
+    __atomic_store_n(&m->locked, 0, __ATOMIC_RELEASE);
+    wait_queue_wake_one(&m->waiters);
+}
+
+// =======================================================
+// 3. SEMAFORO DE CONTAGEM
+// =======================================================
+
+void semaphore_init(semaphore_t *s, int32_t initial) {
+    s->count = initial;
+    wait_queue_init(&s->waiters);
+}
+
+void semaphore_down(semaphore_t *s) {
+    uint32_t flags = irq_save();
+    while (s->count <= 0) {
+        wait_queue_sleep_irqoff(&s->waiters);
+    }
+    s->count--;
+    irq_restore(flags);
+}
+
+/**
+ * Libera uma unidade. Pode ser chamada de rotinas de interrupcao.
+ */
+void semaphore_up(semaphore_t *s) {
+    uint32_t flags = irq_save();
+    s->count++;
+    irq_restore(flags);
+    wait_queue_wake_one(&s->waiters);
+}
+
+// =======================================================
+// 4. VARIAVEL DE CONDICAO
+// =======================================================
+
+void condvar_init(condvar_t *cv) {
+    wait_queue_init(&cv->waiters);
+}
+
+/**
+ * Solta o mutex e dorme, atomicamente; retoma o mutex ao acordar.
+ * Como toda variavel de condicao, o chamador deve retestar o predicado.
+ */
+void condvar_wait(condvar_t *cv, mutex_t *m) {
+    uint32_t flags = irq_save();
+    mutex_unlock(m);
+    wait_queue_sleep_irqoff(&cv->waiters);
+    irq_restore(flags);
+    mutex_lock(m);
+}
+
+void condvar_signal(condvar_t *cv) {
+    wait_queue_wake_one(&cv->waiters);
+}
+
+void condvar_broadcast(condvar_t *cv) {
+    wait_queue_wake_all(&cv->waiters);
+}
+
+// =======================================================
+// 5. FUTEX (caminho lento dos mutexes de usuario)
+// =======================================================
+
+// Uma fila por endereco com alguem dormindo; o slot e liberado quando esvazia
+typedef struct {
+    uint32_t address;   // 0 = slot livre
+    wait_queue_t waiters;
+} FutexSlot;
+
+static FutexSlot futex_slots[FUTEX_SLOTS];
+
+static FutexSlot* futex_find(uint32_t address, int create) {
+    FutexSlot *free_slot = 0;
+    uint32_t start = (address >> 2) % FUTEX_SLOTS;
+    for (int i = 0; i < FUTEX_SLOTS; i++) {
+        FutexSlot *slot = &futex_slots[(start + i) % FUTEX_SLOTS];
+        if (slot->address == address) return slot;
+        if (slot->address == 0 && !free_slot) free_slot = slot;
+    }
+    if (create && free_slot) {
+        free_slot->address = address;
+        wait_queue_init(&free_slot->waiters);
+        return free_slot;
+    }
+    return 0;
+}
+
+/**
+ * SYS_FUTEX_WAIT(endereco, valor_esperado): dorme se *endereco ainda vale
+ * 'valor_esperado'. O teste e o sono acontecem com as interrupcoes
+ * desligadas, entao um FUTEX_WAKE nao pode passar no meio.
+ */
+static int32_t sys_futex_wait(uint32_t address, uint32_t expected, uint32_t arg3) {
+    (void)arg3;
+    if (address == 0 || (address & 3)) return SYSCALL_EAGAIN;
+
+    uint32_t flags = irq_save();
+    if (*(volatile uint32_t*)address != expected) {
+        irq_restore(flags);
+        return SYSCALL_EAGAIN;
+    }
+    FutexSlot *slot = futex_find(address, 1);
+    if (!slot) {
+        irq_restore(flags);
+        return SYSCALL_EAGAIN; // Sem slots: o usuario tenta de novo
+    }
+    wait_queue_sleep_irqoff(&slot->waiters);
+    irq_restore(flags);
+    return 0;
+}
+
+/**
+ * SYS_FUTEX_WAKE(endereco, quantos): acorda ate 'quantos' processos.
+ * @return Numero de processos acordados.
+ */
+static int32_t sys_futex_wake(uint32_t address, uint32_t count, uint32_t arg3) {
+    (void)arg3;
+    uint32_t flags = irq_save();
+    FutexSlot *slot = futex_find(address, 0);
+    int32_t woken = 0;
+    if (slot) {
+        while ((uint32_t)woken < count && wait_queue_wake_one(&slot->waiters)) woken++;
+        if (slot->waiters.count == 0) slot->address = 0;
+    }
+    irq_restore(flags);
+    return woken;
+}
+
+/**
+ * SYS_YIELD: cede a CPU (usado pelos Apps depois de girar um pouco num lock).
+ */
+static int32_t sys_yield(uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+    (void)arg1; (void)arg2; (void)arg3;
+    scheduler_yield();
+    return 0;
+}
+
+/**
+ * Registra as chamadas de sistema do futex. Chamar depois de init_syscalls().
+ */
+void init_sync() {
+    for (int i = 0; i < FUTEX_SLOTS; i++) futex_slots[i].address = 0;
+    syscall_register(SYS_FUTEX_WAIT, sys_futex_wait);
+    syscall_register(SYS_FUTEX_WAKE, sys_futex_wake);
+    syscall_register(SYS_YIELD, sys_yield);
+}
@@ -0,0 +1,71 @@
+// sync.h - Wait queues e primitivas de bloqueio do Core-Blip.
+//
+// Um processo que espera algo dorme numa wait queue (estado BLOCKED) e sai da
+// fila de prontos; quem produz o evento o acorda direto de volta para ela.
+// Nenhuma dessas primitivas faz espera ativa.
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <stdint.h>
+#include "../../Kernel/spinlock.h"
+
+// Deve ser >= MAX_PROCESSES do scheduler.c (cada processo dorme em no maximo uma fila)
+#define WAIT_QUEUE_CAPACITY 8
+
+typedef struct {
+    spinlock_t lock;
+    uint8_t pids[WAIT_QUEUE_CAPACITY];  // FIFO: acorda na ordem de chegada
+    uint8_t head;
+    uint8_t count;
+} wait_queue_t;
+
+typedef struct {
+    volatile uint32_t locked;
+    int owner;
+    wait_queue_t waiters;
+} mutex_t;
+
+typedef struct {
+    volatile int32_t count;
+    wait_queue_t waiters;
+} semaphore_t;
+
+typedef struct {
+    wait_queue_t waiters;
+} condvar_t;
+
+void wait_queue_init(wait_queue_t *wq);
+void wait_queue_sleep_irqoff(wait_queue_t *wq);
+int wait_queue_wake_one(wait_queue_t *wq);
+int wait_queue_wake_all(wait_queue_t *wq);
+
+void mutex_init(mutex_t *m);
+void mutex_lock(mutex_t *m);
+int mutex_trylock(mutex_t *m);
+void mutex_unlock(mutex_t *m);
+
+void semaphore_init(semaphore_t *s, int32_t initial);
+void semaphore_down(semaphore_t *s);
+void semaphore_up(semaphore_t *s);
+
+void condvar_init(condvar_t *cv);
+void condvar_wait(condvar_t *cv, mutex_t *m);
+void condvar_signal(condvar_t *cv);
+void condvar_broadcast(condvar_t *cv);
+
+/**
+ * Dorme em 'wq' ate 'condition' ficar verdadeira.
+ * A condicao e testada com as interrupcoes desligadas, entao um wake vindo
+ * de uma IRQ entre o teste e o sono nao se perde.
+ */
+#define wait_event(wq, condition)                   \
+    do {                                            \
+        uint32_t __wait_flags = irq_save();         \
+        while (!(condition)) {                      \
+            wait_queue_sleep_irqoff(wq);            \
+        }                                           \
+        irq_restore(__wait_flags);                  \
+    } while (0)
+
+#endif
@@ -0,0 +1,735 @@
+// apic.c - Interrupcoes pelo Local APIC e pelo IOAPIC.
+//
+// Substitui o par de 8259 (que fica remapeado e todo mascarado):
+//   - O timer do Local APIC, em modo periodico a TIMER_HZ, e o relogio do
+//     agendador (no lugar do IRQ0 do PIT).
+//   - Cada IRQ de dispositivo passa pelo IOAPIC, com o vetor APIC_IRQ_BASE + irq
+//     e uma CPU de destino (afinidade) escolhida por irq.
+//   - O EOI e uma unica escrita no registrador EOI do Local APIC (sem OUT em
+//     porta de I/O), feita pelo despachante para todo IRQ: nenhum driver
+//     precisa lembrar de manda-lo.
+//
+// Sem APIC, os mesmos stubs atendem os vetores do 8259 (0x20 + n, menos o
+// IRQ0, que fica com o PIT do boot) e o despachante manda o EOI pela porta.
+//
+// CPUs, IOAPIC e remapeamentos de IRQ ISA (ex.: IRQ0 -> GSI2) vem da tabela
+// MADT do ACPI; sem ACPI, valem os enderecos padrao.
+//
+// Latencia: cada vetor tem dois histogramas em potencias de 2 (ciclos do TSC):
+//   - entrada: da chegada do pedido ate a rotina do driver comecar. Para o
+//     timer a chegada e exata (o contador do APIC diz ha quanto tempo ele
+//     zerou); para os dispositivos e o primeiro RDTSC do stub, entao o tempo
+//     com as interrupcoes desligadas antes disso nao aparece no vetor - ele
+//     aparece no histograma do timer, que sofre os mesmos trechos;
+//   - duracao: quanto a rotina do driver levou.
+
+#include <stdint.h>
+#include "cpu_features.h"
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Lib/kformat.h"
+
+extern void outb(uint16_t port, uint8_t value);
+extern uint8_t inb(uint16_t port);
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern uint32_t tsc_get_khz();                      // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles);  // Do cpu_diag.c
+extern void scheduler_timer_interrupt(uint32_t esp_from_interrupt);
+extern void idt_set_gate(uint8_t vector, uint32_t handler, uint16_t selector, uint8_t flags);
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+
+#define KERNEL_CODE_SELECTOR    0x08
+#define IDT_GATE_KERNEL_INTERRUPT 0x8E
+
+#define TIMER_HZ                100     // Mesmo tick do PIT (syscall.c, async.c)
+#define APIC_IRQ_BASE           0x30    // IRQ n -> vetor 0x30 + n
+#define APIC_IRQ_COUNT          16      // IRQs ISA
+#define APIC_TIMER_VECTOR       0x40    // Acima dos dispositivos (prioridade maior)
+#define APIC_SPURIOUS_VECTOR    0xFF
+#define APIC_MAX_CPUS           8
+#define APIC_TIMER_SLOT         APIC_IRQ_COUNT // Estatisticas: 0..15 IRQs, 16 = timer
+#define APIC_HIST_BUCKETS       24      // Potencias de 2 de ciclos: 1 .. 2^23+
+
+// 8259
+#define PIC1_COMMAND            0x20
+#define PIC1_DATA               0x21
+#define PIC2_COMMAND            0xA0
+#define PIC2_DATA               0xA1
+#define PIC_REMAP_BASE          0x20    // Vetores 0x20-0x2F, longe das excecoes
+#define PIC_EOI                 0x20
+#define PIC_READ_ISR            0x0B    // OCW3: a proxima leitura do comando devolve o ISR
+#define PIC_CASCADE_IRQ         2
+
+// Local APIC (MMIO; o Kernel usa enderecos fisicos = virtuais)
+#define MSR_APIC_BASE           0x1B
+#define MSR_APIC_ENABLE         (1u << 11)
+#define LAPIC_DEFAULT_BASE      0xFEE00000
+#define LAPIC_ID                0x020
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0B0
+#define LAPIC_SVR               0x0F0
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_INITIAL     0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3E0
+#define LAPIC_SVR_ENABLE        (1u << 8)
+#define LAPIC_LVT_MASKED        (1u << 16)
+#define LAPIC_TIMER_PERIODIC    (1u << 17)
+#define LAPIC_LVT_NMI           (4u << 8)
+#define LAPIC_LVT_EXTINT        (7u << 8)   // O 8259 entra pelo LINT0 (virtual wire)
+#define LAPIC_DIVIDE_16         0x03
+
+// IOAPIC
+#define IOAPIC_DEFAULT_BASE     0xFEC00000
+#define IOAPIC_REGSEL           0x00
+#define IOAPIC_WINDOW           0x10
+#define IOAPIC_VERSION          0x01
+#define IOAPIC_REDIRECTION      0x10    // Entrada n: registradores 0x10+2n e 0x11+2n
+#define IOAPIC_ACTIVE_LOW       (1u << 13)
+#define IOAPIC_LEVEL            (1u << 15)
+#define IOAPIC_MASKED           (1u << 16)
+
+// ACPI
+#define ACPI_EBDA_POINTER       0x40E
+#define ACPI_BIOS_START         0xE0000
+#define ACPI_BIOS_END           0x100000
+#define ACPI_HEADER_SIZE        36
+#define MADT_LOCAL_APIC         0
+#define MADT_IO_APIC            1
+#define MADT_OVERRIDE           2
+
+typedef void (*irq_handler_t)();
+
+typedef struct {
+    uint32_t count;
+    uint32_t entry_max;                     // Ciclos
+    uint32_t run_max;
+    uint32_t entry_hist[APIC_HIST_BUCKETS];
+    uint32_t run_hist[APIC_HIST_BUCKETS];
+} IrqLatency;
+
+static volatile uint32_t *lapic = 0;
+static volatile uint32_t *ioapic = 0;
+static uint32_t ioapic_gsi_base = 0;
+static uint32_t ioapic_entries = 24;
+static int apic_enabled = 0;
+static int pic_fallback = 0;    // Sem APIC: stubs nos vetores do 8259
+
+// CPUs da MADT: indice -> APIC ID, e o inverso para apic_current_cpu()
+static uint8_t cpu_apic_ids[APIC_MAX_CPUS];
+static uint8_t cpu_online[APIC_MAX_CPUS];
+static uint32_t cpu_count = 0;
+static uint8_t apic_id_to_cpu[256];
+static uint32_t boot_cpu = 0;               // Indice da CPU do boot
+static volatile uint32_t online_count = 1;  // Com uma so, apic_current_cpu() nem le o APIC
+
+// IRQ ISA -> GSI e flags de polaridade/gatilho (remapeamentos da MADT)
+static uint32_t irq_gsi[APIC_IRQ_COUNT];
+static uint32_t irq_flags[APIC_IRQ_COUNT];
+static uint8_t irq_overridden[APIC_IRQ_COUNT];  // A MADT deu a polaridade/gatilho
+static irq_handler_t irq_handlers[APIC_IRQ_COUNT];
+static uint8_t irq_cpu[APIC_IRQ_COUNT];     // Afinidade (indice da CPU)
+static uint32_t irq_per_cpu[APIC_MAX_CPUS]; // IRQs atendidos por CPU
+static volatile uint32_t irq_depth = 0;     // > 0 dentro de uma rotina de IRQ
+
+// Timer: ticks do APIC por periodo e ciclos do TSC por tick (ponto fixo 16.16)
+static uint32_t timer_initial_count = 0;
+static uint32_t tsc_per_timer_tick_q16 = 0;
+
+static IrqLatency latency[APIC_IRQ_COUNT + 1];
+
+// =======================================================
+// 1. ACESSO AO HARDWARE
+// =======================================================
+
+static uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    __asm__ __volatile__ ("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ __volatile__ ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+}
+
+static uint32_t ioapic_read(uint32_t reg) {
+    ioapic[IOAPIC_REGSEL / 4] = reg;
+    return ioapic[IOAPIC_WINDOW / 4];
+}
+
+static void ioapic_write(uint32_t reg, uint32_t value) {
+    ioapic[IOAPIC_REGSEL / 4] = reg;
+    ioapic[IOAPIC_WINDOW / 4] = value;
+}
+
+/**
+ * Remapeia o 8259 para 0x20-0x2F e mascara tudo. Mesmo mascarado ele pode
+ * gerar um IRQ7/15 espurio, que cai num vetor inofensivo em vez de uma excecao.
+ */
+static void pic_disable() {
+    outb(PIC1_COMMAND, 0x11);               // ICW1: inicializa, com ICW4
+    outb(PIC2_COMMAND, 0x11);
+    outb(PIC1_DATA, PIC_REMAP_BASE);        // ICW2: vetores
+    outb(PIC2_DATA, PIC_REMAP_BASE + 8);
+    outb(PIC1_DATA, 0x04);                  // ICW3: escravo no IRQ2
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);                  // ICW4: modo 8086
+    outb(PIC2_DATA, 0x01);
+    outb(PIC1_DATA, 0xFF);
+    outb(PIC2_DATA, 0xFF);
+}
+
+// Mascara ou libera uma linha do 8259 (e a cascata, para as do escravo)
+static void pic_set_masked(uint8_t irq, int masked) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    uint8_t bit = (uint8_t)(1u << (irq & 7));
+    uint8_t mask = inb(port);
+    outb(port, masked ? (uint8_t)(mask | bit) : (uint8_t)(mask & ~bit));
+    if (irq >= 8 && !masked) outb(PIC1_DATA, (uint8_t)(inb(PIC1_DATA) & ~(1u << PIC_CASCADE_IRQ)));
+}
+
+static void pic_send_eoi(uint32_t irq) {
+    if (irq >= 8) outb(PIC2_COMMAND, PIC_EOI);
+    outb(PIC1_COMMAND, PIC_EOI);
+}
+
+/**
+ * IRQ7/15 sem o bit no ISR e espurio (a linha caiu antes do INTA): nao tem
+ * EOI, a nao ser o do mestre quando o espurio veio do escravo.
+ */
+static int pic_spurious(uint32_t irq) {
+    if (irq != 7 && irq != 15) return 0;
+    uint16_t port = irq == 7 ? PIC1_COMMAND : PIC2_COMMAND;
+    outb(port, PIC_READ_ISR);
+    if (inb(port) & 0x80) return 0;
+    if (irq == 15) outb(PIC1_COMMAND, PIC_EOI);
+    return 1;
+}
+
+// =======================================================
+// 2. DESCOBERTA (ACPI MADT)
+// =======================================================
+
+static int acpi_checksum_ok(const uint8_t *table, uint32_t length) {
+    uint8_t sum = 0;
+    for (uint32_t i = 0; i < length; i++) sum = (uint8_t)(sum + table[i]);
+    return sum == 0;
+}
+
+static int signature_is(const uint8_t *p, const char *signature, int length) {
+    for (int i = 0; i < length; i++) {
+        if (p[i] != (uint8_t)signature[i]) return 0;
+    }
+    return 1;
+}
+
+// Procura o RSDP em [start, end) (sempre alinhado a 16 bytes)
+static const uint8_t* rsdp_scan(uint32_t start, uint32_t end) {
+    for (uint32_t p = start; p + 20 <= end; p += 16) {
+        const uint8_t *candidate = (const uint8_t*)p;
+        if (signature_is(candidate, "RSD PTR ", 8) && acpi_checksum_ok(candidate, 20)) return candidate;
+    }
+    return 0;
+}
+
+static const uint8_t* find_madt() {
+    uint32_t bda = ACPI_EBDA_POINTER;
+    __asm__ ("" : "+r"(bda)); // Para o GCC, 0x40E constante parece um ponteiro invalido
+    uint32_t ebda = (uint32_t)(*(volatile const uint16_t*)bda) << 4;
+    const uint8_t *rsdp = ebda ? rsdp_scan(ebda, ebda + 1024) : 0;
+    if (!rsdp) rsdp = rsdp_scan(ACPI_BIOS_START, ACPI_BIOS_END);
+    if (!rsdp) return 0;
+
+    const uint8_t *rsdt = (const uint8_t*)*(const uint32_t*)(rsdp + 16);
+    uint32_t length = *(const uint32_t*)(rsdt + 4);
+    if (!signature_is(rsdt, "RSDT", 4) || !acpi_checksum_ok(rsdt, length)) return 0;
+
+    for (uint32_t off = ACPI_HEADER_SIZE; off + 4 <= length; off += 4) {
+        const uint8_t *table = (const uint8_t*)*(const uint32_t*)(rsdt + off);
+        if (signature_is(table, "APIC", 4) && acpi_checksum_ok(table, *(const uint32_t*)(table + 4))) return table;
+    }
+    return 0;
+}
+
+static void add_cpu(uint8_t apic_id) {
+    if (cpu_count == APIC_MAX_CPUS) return;
+    cpu_apic_ids[cpu_count] = apic_id;
+    apic_id_to_cpu[apic_id] = (uint8_t)cpu_count;
+    cpu_count++;
+}
+
+/**
+ * Le da MADT as CPUs, o (primeiro) IOAPIC e os remapeamentos de IRQ ISA.
+ * Sem MADT: uma CPU, IOAPIC no endereco padrao e IRQ n = GSI n.
+ */
+static void discover_topology() {
+    uint32_t lapic_base = (uint32_t)rdmsr(MSR_APIC_BASE) & 0xFFFFF000;
+    uint32_t ioapic_base = IOAPIC_DEFAULT_BASE;
+
+    for (int i = 0; i < APIC_IRQ_COUNT; i++) {
+        irq_gsi[i] = (uint32_t)i;
+        irq_flags[i] = 0; // ISA: borda, ativo em alto
+    }
+
+    const uint8_t *madt = find_madt();
+    if (madt) {
+        uint32_t length = *(const uint32_t*)(madt + 4);
+        lapic_base = *(const uint32_t*)(madt + ACPI_HEADER_SIZE);
+        int found_ioapic = 0;
+
+        for (uint32_t off = ACPI_HEADER_SIZE + 8; off + 2 <= length; ) {
+            const uint8_t *entry = madt + off;
+            if (entry[1] < 2) break;
+
+            if (entry[0] == MADT_LOCAL_APIC && (*(const uint32_t*)(entry + 4) & 1)) {
+                add_cpu(entry[3]);
+            } else if (entry[0] == MADT_IO_APIC && !found_ioapic) {
+                ioapic_base = *(const uint32_t*)(entry + 4);
+                ioapic_gsi_base = *(const uint32_t*)(entry + 8);
+                found_ioapic = 1;
+            } else if (entry[0] == MADT_OVERRIDE && entry[3] < APIC_IRQ_COUNT) {
+                uint16_t flags = *(const uint16_t*)(entry + 8);
+                irq_gsi[entry[3]] = *(const uint32_t*)(entry + 4);
+                irq_overridden[entry[3]] = 1;
+                irq_flags[entry[3]] = ((flags & 0x3) == 0x3 ? IOAPIC_ACTIVE_LOW : 0) |
+                                      (((flags >> 2) & 0x3) == 0x3 ? IOAPIC_LEVEL : 0);
+            }
+            off += entry[1];
+        }
+    }
+
+    lapic = (volatile uint32_t*)lapic_base;
+    ioapic = (volatile uint32_t*)ioapic_base;
+    ioapic_entries = ((ioapic_read(IOAPIC_VERSION) >> 16) & 0xFF) + 1;
+
+    // A CPU do boot sempre existe (e e a unica ligada ate alguem subir as outras)
+    uint8_t boot_id = (uint8_t)(lapic_read(LAPIC_ID) >> 24);
+    if (cpu_count == 0) add_cpu(boot_id);
+    boot_cpu = apic_id_to_cpu[boot_id];
+    cpu_online[boot_cpu] = 1;
+    for (int i = 0; i < APIC_IRQ_COUNT; i++) irq_cpu[i] = (uint8_t)boot_cpu;
+}
+
+// =======================================================
+// 3. IOAPIC E AFINIDADE
+// =======================================================
+
+static void ioapic_route(uint8_t irq, int masked) {
+    uint32_t pin = irq_gsi[irq] - ioapic_gsi_base;
+    if (pin >= ioapic_entries) return;
+
+    uint32_t low = (APIC_IRQ_BASE + irq) | irq_flags[irq] | (masked ? IOAPIC_MASKED : 0);
+    ioapic_write(IOAPIC_REDIRECTION + pin * 2 + 1, (uint32_t)cpu_apic_ids[irq_cpu[irq]] << 24);
+    ioapic_write(IOAPIC_REDIRECTION + pin * 2, low); // Fisico, entrega fixa
+}
+
+/**
+ * Escolhe a CPU que atende um IRQ. So CPUs ligadas podem receber: uma CPU
+ * ainda em espera de SIPI perderia a interrupcao.
+ * @return 0 em caso de sucesso, -1 se a CPU nao existe ou esta desligada.
+ */
+int apic_set_irq_affinity(uint8_t irq, uint32_t cpu) {
+    if (irq >= APIC_IRQ_COUNT || cpu >= cpu_count || !cpu_online[cpu]) return -1;
+    uint32_t flags = irq_save();
+    irq_cpu[irq] = (uint8_t)cpu;
+    if (apic_enabled) ioapic_route(irq, irq_handlers[irq] == 0);
+    irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Espalha os IRQs registrados pelas CPUs ligadas (rodizio, na ordem dos IRQs).
+ */
+void apic_balance_irqs() {
+    uint32_t next = 0;
+    for (uint8_t irq = 0; irq < APIC_IRQ_COUNT; irq++) {
+        if (!irq_handlers[irq]) continue;
+        for (uint32_t tries = 0; tries < cpu_count; tries++) {
+            uint32_t cpu = (next + tries) % cpu_count;
+            if (cpu_online[cpu]) {
+                apic_set_irq_affinity(irq, cpu);
+                next = cpu + 1;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Marca uma CPU como ligada (chamado por quem subir as APs) e redistribui os IRQs.
+ */
+void apic_cpu_online(uint8_t apic_id) {
+    uint32_t cpu = apic_id_to_cpu[apic_id];
+    if (cpu >= cpu_count || cpu_apic_ids[cpu] != apic_id) return;
+    if (!cpu_online[cpu]) {
+        cpu_online[cpu] = 1;
+        online_count++;
+    }
+    apic_balance_irqs();
+}
+
+/**
+ * Indice da CPU atual. Sem APIC, sempre 0; enquanto so a CPU do boot esta
+ * ligada, o indice guardado (sem ler o registrador de ID, que e MMIO nao
+ * cacheavel, a cada alocacao de pagina).
+ */
+uint32_t apic_current_cpu() {
+    if (!apic_enabled) return 0;
+    if (online_count == 1) return boot_cpu;
+    return apic_id_to_cpu[lapic_read(LAPIC_ID) >> 24];
+}
+
+/**
+ * Diz se o codigo roda dentro de uma rotina de IRQ ou excecao (e nao no
+ * processo atual).
+ */
+int apic_in_irq() {
+    return irq_depth != 0;
+}
+
+/**
+ * Marcam a entrada e a saida de toda interrupcao que roda codigo do Kernel:
+ * os stubs de IRQ (APIC ou 8259), o tick do agendador e as excecoes.
+ */
+void apic_irq_enter() {
+    irq_depth++;
+}
+
+void apic_irq_exit() {
+    irq_depth--;
+}
+
+/**
+ * Instala a rotina de um IRQ ISA e libera o pino no IOAPIC (ou a linha no
+ * 8259, sem APIC). A rotina roda com as interrupcoes desligadas e NAO manda EOI.
+ * @return 0 em caso de sucesso, -1 se o IRQ e invalido.
+ */
+int apic_register_irq(uint8_t irq, irq_handler_t handler) {
+    if (irq >= APIC_IRQ_COUNT) return -1;
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    if (apic_enabled) ioapic_route(irq, handler == 0);
+    else if (pic_fallback && irq != 0) pic_set_masked(irq, handler == 0);
+    irq_restore(flags);
+    return 0;
+}
+
+/**
+ * Como apic_register_irq(), para a linha de interrupcao de um dispositivo
+ * PCI: nivel e ativo em baixo (a linha pode ser compartilhada), a menos que
+ * a MADT tenha dito outra coisa para esse IRQ. Com gatilho por borda, uma
+ * IRQ compartilhada que chega enquanto a outra ainda esta ativa se perde.
+ * @return 0 em caso de sucesso, -1 se o IRQ e invalido.
+ */
+int apic_register_pci_irq(uint8_t irq, irq_handler_t handler) {
+    if (irq >= APIC_IRQ_COUNT) return -1;
+    if (!irq_overridden[irq]) irq_flags[irq] = IOAPIC_LEVEL | IOAPIC_ACTIVE_LOW;
+    return apic_register_irq(irq, handler);
+}
+
+// =======================================================
+// 4. DESPACHO E LATENCIA
+// =======================================================
+
+// Balde = posicao do bit mais alto (log2 dos ciclos)
+static void hist_add(uint32_t *hist, uint32_t *max, uint32_t cycles) {
+    uint32_t bucket = 0;
+    if (cycles) __asm__ ("bsrl %1, %0" : "=r"(bucket) : "rm"(cycles));
+    if (bucket >= APIC_HIST_BUCKETS) bucket = APIC_HIST_BUCKETS - 1;
+    hist[bucket]++;
+    if (cycles > *max) *max = cycles;
+}
+
+static uint32_t clamp_cycles(uint64_t cycles) {
+    return cycles > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)cycles;
+}
+
+/**
+ * Chamada pelos stubs de IRQ com o RDTSC da chegada.
+ */
+void apic_irq_dispatch(uint32_t irq, uint64_t arrival) {
+    if (!apic_enabled && pic_spurious(irq)) return;
+
+    uint64_t entry = read_tsc();
+    irq_handler_t handler = irq_handlers[irq];
+    apic_irq_enter();
+    if (handler) handler();
+    apic_irq_exit();
+    uint64_t done = read_tsc();
+
+    if (apic_enabled) lapic_write(LAPIC_EOI, 0); // Um store: o EOI mais barato que existe
+    else pic_send_eoi(irq);
+
+    IrqLatency *stats = &latency[irq];
+    stats->count++;
+    hist_add(stats->entry_hist, &stats->entry_max, clamp_cycles(entry - arrival));
+    hist_add(stats->run_hist, &stats->run_max, clamp_cycles(done - entry));
+    irq_per_cpu[apic_current_cpu()]++;
+}
+
+/**
+ * Tick do agendador. O contador do timer recarrega quando zera, entao
+ * (inicial - atual) e exatamente o tempo desde que a interrupcao foi pedida.
+ * O EOI vai antes: scheduler_timer_interrupt() nao volta (troca de contexto).
+ */
+void apic_timer_interrupt(uint32_t esp_from_interrupt) {
+    uint32_t elapsed_ticks = timer_initial_count - lapic_read(LAPIC_TIMER_CURRENT);
+    uint64_t entry = read_tsc();
+    lapic_write(LAPIC_EOI, 0);
+
+    IrqLatency *stats = &latency[APIC_TIMER_SLOT];
+    stats->count++;
+    hist_add(stats->entry_hist, &stats->entry_max,
+             clamp_cycles(((uint64_t)elapsed_ticks * tsc_per_timer_tick_q16) >> 16));
+    hist_add(stats->run_hist, &stats->run_max, clamp_cycles(read_tsc() - entry));
+
+    scheduler_timer_interrupt(esp_from_interrupt);
+}
+
+// Um stub por IRQ: salva tudo, marca a chegada e cai no caminho comum
+#define IRQ_STUB(n)                                 \
+    ".globl apic_irq_stub_" #n "\n"                 \
+    "apic_irq_stub_" #n ":\n"                       \
+    "    pushal\n"                                  \
+    "    rdtsc\n"                                   \
+    "    pushl %edx\n"                              \
+    "    pushl %eax\n"                              \
+    "    pushl $" #n "\n"                           \
+    "    jmp apic_irq_common\n"
+
+__asm__ (
+    IRQ_STUB(0)  IRQ_STUB(1)  IRQ_STUB(2)  IRQ_STUB(3)
+    IRQ_STUB(4)  IRQ_STUB(5)  IRQ_STUB(6)  IRQ_STUB(7)
+    IRQ_STUB(8)  IRQ_STUB(9)  IRQ_STUB(10) IRQ_STUB(11)
+    IRQ_STUB(12) IRQ_STUB(13) IRQ_STUB(14) IRQ_STUB(15)
+    "apic_irq_common:\n"
+    "    cld\n"
+    "    call apic_irq_dispatch\n"
+    "    addl $12, %esp\n"
+    "    popal\n"
+    "    iret\n"
+
+    // Timer: mesmo quadro do yield (registradores + ESP) para o context_switch
+    ".globl apic_timer_entry\n"
+    "apic_timer_entry:\n"
+    "    pushal\n"
+    "    cld\n"
+    "    pushl %esp\n"
+    "    call apic_timer_interrupt\n"
+
+    // Espurio: sem EOI
+    ".globl apic_spurious_entry\n"
+    "apic_spurious_entry:\n"
+    "    iret\n"
+);
+
+extern void apic_irq_stub_0(), apic_irq_stub_1(), apic_irq_stub_2(), apic_irq_stub_3();
+extern void apic_irq_stub_4(), apic_irq_stub_5(), apic_irq_stub_6(), apic_irq_stub_7();
+extern void apic_irq_stub_8(), apic_irq_stub_9(), apic_irq_stub_10(), apic_irq_stub_11();
+extern void apic_irq_stub_12(), apic_irq_stub_13(), apic_irq_stub_14(), apic_irq_stub_15();
+extern void apic_timer_entry();
+extern void apic_spurious_entry();
+
+static void (*const irq_stubs[APIC_IRQ_COUNT])() = {
+    apic_irq_stub_0,  apic_irq_stub_1,  apic_irq_stub_2,  apic_irq_stub_3,
+    apic_irq_stub_4,  apic_irq_stub_5,  apic_irq_stub_6,  apic_irq_stub_7,
+    apic_irq_stub_8,  apic_irq_stub_9,  apic_irq_stub_10, apic_irq_stub_11,
+    apic_irq_stub_12, apic_irq_stub_13, apic_irq_stub_14, apic_irq_stub_15,
+};
+
+// =======================================================
+// 5. INICIALIZACAO
+// =======================================================
+
+/**
+ * Mede quantos ticks do timer do APIC (divisor 16) cabem em 10ms do TSC.
+ */
+static uint32_t timer_calibrate() {
+    uint32_t khz = tsc_get_khz();
+    if (khz == 0) return 0;
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_INITIAL, 0xFFFFFFFF);
+
+    uint64_t window = (uint64_t)khz * (1000 / TIMER_HZ);
+    uint64_t start = read_tsc();
+    while (read_tsc() - start < window) { /* loop */ }
+    uint32_t ticks = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+
+    lapic_write(LAPIC_TIMER_INITIAL, 0);
+    if (ticks) tsc_per_timer_tick_q16 = (uint32_t)((window << 16) / ticks);
+    return ticks;
+}
+
+static void lapic_enable() {
+    wrmsr(MSR_APIC_BASE, rdmsr(MSR_APIC_BASE) | MSR_APIC_ENABLE);
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+}
+
+// Liga o Local APIC, o timer e as rotas do IOAPIC (boot e retomada)
+static void apic_program() {
+    lapic_enable();
+
+    for (uint32_t pin = 0; pin < ioapic_entries; pin++) {
+        ioapic_write(IOAPIC_REDIRECTION + pin * 2, IOAPIC_MASKED);
+    }
+    for (uint8_t irq = 0; irq < APIC_IRQ_COUNT; irq++) {
+        if (irq_handlers[irq]) ioapic_route(irq, 0);
+    }
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_DIVIDE_16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | APIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INITIAL, timer_initial_count);
+}
+
+// Sem APIC: libera no 8259 as linhas com rotina (boot e retomada)
+static void pic_program() {
+    for (uint8_t irq = 1; irq < APIC_IRQ_COUNT; irq++) {
+        if (irq_handlers[irq] && irq != PIC_CASCADE_IRQ) pic_set_masked(irq, 0);
+    }
+}
+
+/**
+ * Fica no 8259 + PIT: os stubs atendem os vetores 0x20 + n (menos o IRQ0,
+ * do PIT) e apic_register_irq() passa a liberar as linhas do 8259.
+ */
+static void pic_fallback_init() {
+    uint32_t flags = irq_save();
+    for (uint8_t irq = 1; irq < APIC_IRQ_COUNT; irq++) {
+        if (irq == PIC_CASCADE_IRQ) continue;
+        idt_set_gate(PIC_REMAP_BASE + irq, (uint32_t)irq_stubs[irq], KERNEL_CODE_SELECTOR,
+                     IDT_GATE_KERNEL_INTERRUPT);
+    }
+    pic_fallback = 1;
+    pic_program();
+    irq_restore(flags);
+    hibernate_register_resume(pic_program);
+}
+
+/**
+ * Passa as interrupcoes do 8259 para o APIC. Chamar com as interrupcoes
+ * desligadas, depois da IDT e de cpu_features_detect() e antes dos drivers
+ * registrarem seus IRQs (os que chegarem antes sao roteados na hora).
+ * @return 1 se o APIC assumiu, 0 se o sistema continua no 8259 + PIT.
+ */
+int init_apic() {
+    if (!cpu_has(CPU_FEATURE_APIC)) {
+        pic_fallback_init();
+        ui_log_status("APIC: ausente, mantendo 8259 + PIT.", 0x0E);
+        return 0;
+    }
+
+    discover_topology();
+    lapic_enable();
+
+    // Sem o timer do APIC o agendador ficaria sem relogio: so troca com ele
+    timer_initial_count = timer_calibrate(); // 10ms = 1 tick do agendador
+    if (timer_initial_count == 0) {
+        // lapic_enable() mascarou o LINT0: sem isso o 8259 nao chegaria a CPU
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+        lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_NMI);
+        pic_fallback_init();
+        ui_log_status("APIC AVISO: timer sem calibrar, mantendo 8259 + PIT.", 0x0E);
+        return 0;
+    }
+
+    for (uint8_t irq = 0; irq < APIC_IRQ_COUNT; irq++) {
+        idt_set_gate(APIC_IRQ_BASE + irq, (uint32_t)irq_stubs[irq], KERNEL_CODE_SELECTOR,
+                     IDT_GATE_KERNEL_INTERRUPT);
+    }
+    idt_set_gate(APIC_TIMER_VECTOR, (uint32_t)apic_timer_entry, KERNEL_CODE_SELECTOR, IDT_GATE_KERNEL_INTERRUPT);
+    idt_set_gate(APIC_SPURIOUS_VECTOR, (uint32_t)apic_spurious_entry, KERNEL_CODE_SELECTOR,
+                 IDT_GATE_KERNEL_INTERRUPT);
+
+    pic_disable();
+    apic_enabled = 1;
+    apic_program();
+
+    hibernate_register_resume(apic_program);
+    ui_log_status("APIC: IOAPIC + timer do Local APIC ativos.", 0x0A);
+    return 1;
+}
+
+// =======================================================
+// 6. RELATORIO DE LATENCIA
+// =======================================================
+
+static uint32_t cycles_to_us(uint64_t cycles) {
+    return (uint32_t)(tsc_cycles_to_ns(cycles) / 1000);
+}
+
+// Limite superior (em ciclos) do balde onde cai o percentil 'permille'
+static uint64_t hist_percentile(const uint32_t *hist, uint32_t count, uint32_t permille) {
+    uint32_t target = (uint32_t)(((uint64_t)count * permille + 999) / 1000);
+    uint32_t seen = 0;
+    for (int b = 0; b < APIC_HIST_BUCKETS; b++) {
+        seen += hist[b];
+        if (seen >= target) return (uint64_t)2 << b;
+    }
+    return (uint64_t)2 << (APIC_HIST_BUCKETS - 1);
+}
+
+static void report_line(const char *name, const IrqLatency *stats, int row) {
+    char buffer[12];
+    ui_draw_string(name, row, 0, 0x0B);
+    ui_draw_string(u32_to_str(stats->count, buffer, 12), row, 12, 0x0F);
+    if (stats->count == 0) return;
+
+    ui_draw_string(u32_to_str(cycles_to_us(hist_percentile(stats->entry_hist, stats->count, 990)), buffer, 12),
+                   row, 22, 0x0F);
+    ui_draw_string(u32_to_str(cycles_to_us(stats->entry_max), buffer, 12), row, 32, 0x0E);
+    ui_draw_string(u32_to_str(cycles_to_us(hist_percentile(stats->run_hist, stats->count, 990)), buffer, 12),
+                   row, 42, 0x0F);
+    ui_draw_string(u32_to_str(cycles_to_us(stats->run_max), buffer, 12), row, 52, 0x0E);
+}
+
+/**
+ * Mostra, por fonte de interrupcao, o p99 e o maximo da latencia de entrada e
+ * da duracao (em us), o pior caso estimado e a carga de IRQs por CPU.
+ */
+void apic_latency_report(int row) {
+    char buffer[12];
+    ui_draw_string("== APIC: latencia de interrupcao (us) ==", row, 0, 0x0E);
+    if (!apic_enabled) {
+        ui_draw_string("APIC desligado (8259 + PIT).", row + 1, 0, 0x0C);
+        return;
+    }
+
+    ui_draw_string("Fonte       Total     Ent.p99   Ent.max   Dur.p99   Dur.max", row + 1, 0, 0x07);
+    report_line("Timer", &latency[APIC_TIMER_SLOT], row + 2);
+    report_line("Teclado", &latency[1], row + 3);
+    report_line("Disco", &latency[14], row + 4);
+    report_line("COM1", &latency[4], row + 5);
+
+    // Pior caso dos dispositivos: o maior trecho com as interrupcoes
+    // desligadas (visto pelo timer) mais o despacho e a rotina do proprio IRQ
+    uint32_t masked = latency[APIC_TIMER_SLOT].entry_max;
+    ui_draw_string("Pior caso teclado/disco", row + 6, 0, 0x0B);
+    ui_draw_string(u32_to_str(cycles_to_us((uint64_t)masked + latency[1].entry_max + latency[1].run_max),
+                              buffer, 12), row + 6, 26, 0x0C);
+    ui_draw_string(u32_to_str(cycles_to_us((uint64_t)masked + latency[14].entry_max + latency[14].run_max),
+                              buffer, 12), row + 6, 36, 0x0C);
+
+    ui_draw_string("IRQs por CPU", row + 7, 0, 0x0B);
+    for (uint32_t cpu = 0; cpu < cpu_count && cpu < 6; cpu++) {
+        ui_draw_string(u32_to_str(irq_per_cpu[cpu], buffer, 12), row + 7, 14 + (int)cpu * 10,
+                       cpu_online[cpu] ? 0x0F : 0x08);
+    }
+}
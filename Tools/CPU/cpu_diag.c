@@ -17,6 +17,74 @@ uint64_t read_tsc() {
     return ((uint64_t)high << 32) | low;
 }
 
+// Portas do PIT (8253/8254). O canal 2 pode ser contado sem gerar interrupcoes.
+#define PIT_CHANNEL2_DATA   0x42
+#define PIT_COMMAND         0x43
+#define PIT_GATE_PORT       0x61   // Bit 0: gate do canal 2, bit 5: saida do canal 2
+#define PIT_FREQUENCY_HZ    1193182
+#define CALIBRATION_MS      10
+#define CALIBRATION_RUNS    3      // Fica com a menor janela (descarta SMIs e IRQs)
+
+extern void outb(uint16_t port, uint8_t value);
+extern uint8_t inb(uint16_t port);
+extern void start_top_monitor(int row); // Do top_monitor.c
+
+// Frequencia do TSC em kHz (ciclos por milissegundo), 0 = ainda nao calibrado
+static uint32_t tsc_khz = 0;
+
+// Conta os ciclos do TSC durante uma janela de CALIBRATION_MS medida pelo PIT
+static uint64_t calibration_window() {
+    uint16_t pit_ticks = (uint16_t)(PIT_FREQUENCY_HZ * CALIBRATION_MS / 1000);
+
+    // 1. Liga o gate do canal 2 e desliga o alto-falante (bit 1)
+    outb(PIT_GATE_PORT, (uint8_t)((inb(PIT_GATE_PORT) & ~0x02) | 0x01));
+
+    // 2. Canal 2, modo 0 (conta ate zero e levanta a saida), binario
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2_DATA, (uint8_t)(pit_ticks & 0xFF));
+    outb(PIT_CHANNEL2_DATA, (uint8_t)(pit_ticks >> 8));
+
+    // 3. Mede os ciclos ate a saida do canal 2 subir
+    uint64_t start = read_tsc();
+    while (!(inb(PIT_GATE_PORT) & 0x20)) { /* loop */ }
+    return read_tsc() - start;
+}
+
+/**
+ * Calibra o TSC contra o canal 2 do PIT. Mede CALIBRATION_RUNS janelas de
+ * CALIBRATION_MS milissegundos e usa a menor: uma interrupcao ou SMI no meio
+ * da janela so pode aumentar a contagem, nunca diminuir.
+ * @return Frequencia do TSC em kHz.
+ */
+uint32_t calibrate_tsc() {
+    uint64_t best = 0;
+    for (int run = 0; run < CALIBRATION_RUNS; run++) {
+        uint64_t cycles = calibration_window();
+        if (best == 0 || cycles < best) best = cycles;
+    }
+
+    tsc_khz = (uint32_t)(best / CALIBRATION_MS);
+    return tsc_khz;
+}
+
+/**
+ * Frequencia do TSC em kHz (calibra na primeira chamada).
+ */
+uint32_t tsc_get_khz() {
+    if (tsc_khz == 0) calibrate_tsc();
+    return tsc_khz;
+}
+
+/**
+ * Converte ciclos do TSC em nanossegundos. Divide antes de multiplicar
+ * para nao estourar 64 bits em contagens longas (horas de CPU).
+ */
+uint64_t tsc_cycles_to_ns(uint64_t cycles) {
+    uint32_t khz = tsc_get_khz();
+    if (khz == 0) return 0;
+    return (cycles / khz) * 1000000ull + ((cycles % khz) * 1000000ull) / khz;
+}
+
 // Funcao que formata e exibe o valor do TSC
 void display_cpu_cycles(int row, int col) {
     uint64_t cycles = read_tsc();
@@ -57,4 +125,7 @@ void init_cpu_monitor() {
     
     // Exibe a leitura da CPU na linha 7
     display_cpu_cycles(7, 0); 
+
+    // Tabela por processo (atualizada pelo executor assincrono)
+    start_top_monitor(9);
 }
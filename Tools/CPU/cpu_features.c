@@ -0,0 +1,101 @@
+// cpu_features.c - Deteccao dos recursos da CPU (CPUID).
+//
+// Roda uma vez no boot; os outros modulos (contexto de FPU, rotinas de
+// memoria, APIC) consultam o resultado com cpu_has().
+
+#include <stdint.h>
+#include "cpu_features.h"
+
+extern void ui_log_status(const char *status_msg, char color_byte);
+
+static uint32_t feature_bits = 0;
+static int features_detected = 0;
+
+/**
+ * Executa CPUID com EAX = 'leaf' e ECX = 'subleaf'.
+ */
+void cpu_cpuid(uint32_t leaf, uint32_t subleaf,
+               uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ __volatile__ (
+        "cpuid"
+        : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+        : "a"(leaf), "c"(subleaf)
+    );
+}
+
+// O bit 21 (ID) do EFLAGS so pode ser trocado se a CPU tiver CPUID (486 tardio em diante)
+static int cpuid_supported() {
+    uint32_t before, after;
+    __asm__ __volatile__ (
+        "pushfl\n"
+        "popl %0\n"
+        "movl %0, %1\n"
+        "xorl $0x200000, %1\n"
+        "pushl %1\n"
+        "popfl\n"
+        "pushfl\n"
+        "popl %1\n"
+        "pushl %0\n"
+        "popfl\n"
+        : "=&r"(before), "=&r"(after)
+        :
+        : "cc"
+    );
+    return ((before ^ after) & 0x200000) != 0;
+}
+
+/**
+ * Le os recursos da CPU. Chamar uma vez no boot, antes de init_fpu().
+ */
+void cpu_features_detect() {
+    uint32_t eax, ebx, ecx, edx;
+    uint32_t max_leaf;
+
+    feature_bits = 0;
+    features_detected = 1;
+    if (!cpuid_supported()) return;
+
+    cpu_cpuid(0, 0, &max_leaf, &ebx, &ecx, &edx);
+
+    // Folha 1: recursos basicos
+    cpu_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    if (edx & (1u << 0))  feature_bits |= CPU_FEATURE_FPU;
+    if (edx & (1u << 4))  feature_bits |= CPU_FEATURE_TSC;
+    if (edx & (1u << 9))  feature_bits |= CPU_FEATURE_APIC;
+    if (edx & (1u << 11)) feature_bits |= CPU_FEATURE_SEP;
+    if (edx & (1u << 24)) feature_bits |= CPU_FEATURE_FXSR;
+    if (edx & (1u << 25)) feature_bits |= CPU_FEATURE_SSE;
+    if (edx & (1u << 26)) feature_bits |= CPU_FEATURE_SSE2;
+    if (ecx & (1u << 26)) feature_bits |= CPU_FEATURE_XSAVE;
+    if (ecx & (1u << 28)) feature_bits |= CPU_FEATURE_AVX;
+
+    // Folha 7: recursos estendidos (AVX2, ERMS)
+    if (max_leaf >= 7) {
+        cpu_cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        if (ebx & (1u << 5)) feature_bits |= CPU_FEATURE_AVX2;
+        if (ebx & (1u << 9)) feature_bits |= CPU_FEATURE_ERMS;
+    }
+
+    // Folha 0xD, subfolha 1: variantes do XSAVE
+    if (max_leaf >= 0xD && (feature_bits & CPU_FEATURE_XSAVE)) {
+        cpu_cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+        if (eax & (1u << 0)) feature_bits |= CPU_FEATURE_XSAVEOPT;
+    }
+
+    // AVX/AVX2 sem XSAVE nao tem como ser salvo: trata como ausente
+    if (!(feature_bits & CPU_FEATURE_XSAVE)) {
+        feature_bits &= ~(CPU_FEATURE_AVX | CPU_FEATURE_AVX2);
+    }
+}
+
+/**
+ * Mascara CPU_FEATURE_* da CPU (detecta na primeira chamada).
+ */
+uint32_t cpu_features() {
+    if (!features_detected) cpu_features_detect();
+    return feature_bits;
+}
+
+int cpu_has(uint32_t feature) {
+    return (cpu_features() & feature) == feature;
+}
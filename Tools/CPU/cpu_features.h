@@ -0,0 +1,28 @@
+// cpu_features.h - Recursos da CPU detectados por CPUID no boot.
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#include <stdint.h>
+
+// Bits de cpu_features()
+#define CPU_FEATURE_FPU         0x0001  // x87
+#define CPU_FEATURE_FXSR        0x0002  // FXSAVE/FXRSTOR
+#define CPU_FEATURE_SSE         0x0004
+#define CPU_FEATURE_SSE2        0x0008
+#define CPU_FEATURE_XSAVE       0x0010  // XSAVE/XRSTOR/XSETBV
+#define CPU_FEATURE_XSAVEOPT    0x0020
+#define CPU_FEATURE_AVX         0x0040
+#define CPU_FEATURE_AVX2        0x0080
+#define CPU_FEATURE_ERMS        0x0100  // REP MOVSB/STOSB rapidos
+#define CPU_FEATURE_SEP         0x0200  // SYSENTER/SYSEXIT
+#define CPU_FEATURE_APIC        0x0400  // Local APIC
+#define CPU_FEATURE_TSC         0x0800
+
+void cpu_features_detect();
+uint32_t cpu_features();
+int cpu_has(uint32_t feature);
+void cpu_cpuid(uint32_t leaf, uint32_t subleaf,
+               uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+
+#endif
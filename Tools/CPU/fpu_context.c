@@ -0,0 +1,474 @@
+// fpu_context.c - Troca preguicosa do estado de FPU/SSE/AVX.
+//
+// O context_switch so salva os registradores inteiros. O estado x87/SSE/AVX
+// fica "vivo" na CPU e pertence a uma tarefa (fpu_owner). Ao trocar para
+// outra tarefa ligamos CR0.TS: se ela tocar na FPU, a CPU levanta #NM (vetor 7)
+// e so entao salvamos o dono antigo e carregamos o estado dela. Tarefas so de
+// inteiros nunca pagam nada (nem memoria: a area e alocada no primeiro #NM).
+//
+// Tarefas que usam a FPU em toda fatia de tempo pagariam um #NM por troca;
+// para elas (modo AUTO) o estado e carregado ja na troca, com XSAVEOPT
+// salvando so os componentes modificados.
+
+#include <stdint.h>
+#include "cpu_features.h"
+#include "fpu_context.h"
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Lib/kmemory.h"
+#include "../../Kernel/Lib/kformat.h"
+
+extern uint32_t alloc_page();
+extern void free_page(uint32_t address);
+extern uint64_t read_tsc(); // Do cpu_diag.c
+extern void idt_set_gate(uint8_t vector, uint32_t handler, uint16_t selector, uint8_t flags);
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+
+#define NM_VECTOR               7       // Device Not Available
+#define KERNEL_CODE_SELECTOR    0x08
+#define IDT_GATE_KERNEL_INTERRUPT 0x8E
+
+#define CR0_MP                  (1u << 1)
+#define CR0_EM                  (1u << 2)
+#define CR0_TS                  (1u << 3)
+#define CR0_NE                  (1u << 5)
+#define CR4_OSFXSR              (1u << 9)
+#define CR4_OSXMMEXCPT          (1u << 10)
+#define CR4_OSXSAVE             (1u << 18)
+
+#define XCR0_X87                (1u << 0)
+#define XCR0_SSE                (1u << 1)
+#define XCR0_AVX                (1u << 2)
+
+#define FPU_AREA_SIZE           4096    // Uma pagina: cabe o XSAVE com AVX (~832 bytes)
+#define FPU_EAGER_THRESHOLD     5       // Fatias seguidas usando a FPU antes de antecipar
+
+// Formato da area de salvamento
+#define FPU_SAVE_FNSAVE         0
+#define FPU_SAVE_FXSAVE         1
+#define FPU_SAVE_XSAVE          2
+
+static int fpu_enabled = 0;
+static int fpu_save_format = FPU_SAVE_FNSAVE;
+static int fpu_has_xsaveopt = 0;
+static uint32_t fpu_xcr0 = 0;
+static uint32_t fpu_xsave_size = 0;
+static int fpu_mode = FPU_MODE_AUTO;
+
+static fpu_ctx_t *fpu_current = 0;  // Tarefa em execucao
+static fpu_ctx_t *fpu_owner = 0;    // Dona dos registradores de FPU vivos na CPU
+static int fpu_ts_set = 0;          // Espelho de CR0.TS (evita reescrever o CR0)
+static int fpu_current_used = 0;    // A tarefa atual usou a FPU nesta fatia
+static int fpu_kernel_depth = 0;    // kernel_fpu_begin() aninhados (ex.: kmemcpy dentro da hibernacao)
+
+// Estatisticas
+static uint32_t fpu_switches = 0;
+static uint32_t fpu_traps = 0;
+static uint32_t fpu_preloads = 0;
+
+// =======================================================
+// 1. ACESSO AO HARDWARE
+// =======================================================
+
+static uint32_t read_cr0() {
+    uint32_t value;
+    __asm__ __volatile__ ("movl %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static void write_cr0(uint32_t value) {
+    __asm__ __volatile__ ("movl %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static uint32_t read_cr4() {
+    uint32_t value;
+    __asm__ __volatile__ ("movl %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static void write_cr4(uint32_t value) {
+    __asm__ __volatile__ ("movl %0, %%cr4" : : "r"(value) : "memory");
+}
+
+static void clts() {
+    __asm__ __volatile__ ("clts" : : : "memory");
+}
+
+static void stts() {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+static void xsetbv(uint32_t index, uint32_t value) {
+    __asm__ __volatile__ ("xsetbv" : : "c"(index), "a"(value), "d"(0));
+}
+
+static void fpu_save(fpu_ctx_t *ctx) {
+    void *area = (void*)ctx->area;
+    if (fpu_save_format == FPU_SAVE_XSAVE) {
+        if (fpu_has_xsaveopt) {
+            __asm__ __volatile__ ("xsaveopt (%0)" : : "r"(area), "a"(fpu_xcr0), "d"(0) : "memory");
+        } else {
+            __asm__ __volatile__ ("xsave (%0)" : : "r"(area), "a"(fpu_xcr0), "d"(0) : "memory");
+        }
+    } else if (fpu_save_format == FPU_SAVE_FXSAVE) {
+        __asm__ __volatile__ ("fxsave (%0)" : : "r"(area) : "memory");
+    } else {
+        __asm__ __volatile__ ("fnsave (%0)" : : "r"(area) : "memory");
+    }
+}
+
+static void fpu_restore(fpu_ctx_t *ctx) {
+    void *area = (void*)ctx->area;
+    if (fpu_save_format == FPU_SAVE_XSAVE) {
+        __asm__ __volatile__ ("xrstor (%0)" : : "r"(area), "a"(fpu_xcr0), "d"(0) : "memory");
+    } else if (fpu_save_format == FPU_SAVE_FXSAVE) {
+        __asm__ __volatile__ ("fxrstor (%0)" : : "r"(area) : "memory");
+    } else {
+        __asm__ __volatile__ ("frstor (%0)" : : "r"(area) : "memory");
+    }
+}
+
+/**
+ * Aloca a area de uma tarefa ja com o estado inicial da FPU
+ * (x87 vazio, excecoes mascaradas, MXCSR padrao, componentes XSAVE em "init").
+ */
+static uint32_t fpu_alloc_area() {
+    uint32_t page = alloc_page();
+    if (!page) return 0;
+
+    uint8_t *area = (uint8_t*)page;
+    kmemset(area, 0, FPU_AREA_SIZE); // Pode usar SSE: so chamar com o TS ainda ligado
+
+    *(uint16_t*)(area + 0) = 0x037F;        // FCW
+    if (fpu_save_format == FPU_SAVE_FNSAVE) {
+        *(uint16_t*)(area + 8) = 0xFFFF;    // FTW: todos os registradores vazios
+    } else {
+        *(uint32_t*)(area + 24) = 0x1F80;   // MXCSR (o cabecalho XSAVE zerado = init)
+    }
+    return page;
+}
+
+// =======================================================
+// 2. #NM E TROCA DE CONTEXTO
+// =======================================================
+
+/**
+ * Rotina do #NM: a tarefa atual tocou na FPU com CR0.TS ligado.
+ */
+void fpu_nm_handler() {
+    fpu_ctx_t *cur = fpu_current;
+
+    // 1. Primeira vez desta tarefa: cria a area antes de mexer no TS
+    // (o kmemset() pode usar SSE e passar pelo kernel_fpu_begin/end)
+    if (cur && fpu_owner != cur && !cur->area) cur->area = fpu_alloc_area();
+
+    clts();
+    fpu_ts_set = 0;
+    fpu_traps++;
+    fpu_current_used = 1;
+    if (!cur || fpu_owner == cur) return; // Os registradores ja sao dela
+
+    // 2. Guarda o estado do dono anterior
+    if (fpu_owner) fpu_save(fpu_owner);
+    fpu_owner = 0;
+
+    if (!cur->area) {
+        // Sem memoria: a tarefa roda com uma FPU limpa que nao sera salva
+        ui_log_status("FPU ERRO: Sem memoria para o contexto da FPU.", 0x0C);
+        __asm__ __volatile__ ("fninit");
+        return;
+    }
+
+    // 3. Carrega o estado dela
+    fpu_restore(cur);
+    fpu_owner = cur;
+    cur->use_count++;
+}
+
+// Ponto de entrada do vetor 7 (sem codigo de erro); conta como interrupcao
+// para o apic_in_irq(), como os stubs de IRQ
+__asm__ (
+    ".globl fpu_nm_entry\n"
+    "fpu_nm_entry:\n"
+    "    pushal\n"
+    "    cld\n"
+    "    call apic_irq_enter\n"
+    "    call fpu_nm_handler\n"
+    "    call apic_irq_exit\n"
+    "    popal\n"
+    "    iret\n"
+);
+extern void fpu_nm_entry();
+
+/**
+ * Chamada pelo agendador ao trocar para a tarefa 'next' (IRQs desligadas).
+ */
+void fpu_switch(fpu_ctx_t *next) {
+    if (!fpu_enabled) return;
+    fpu_switches++;
+
+    // Quem saiu sem tocar na FPU volta a ser tratado como preguicoso
+    if (fpu_current && !fpu_current_used) fpu_current->use_count = 0;
+    fpu_current = next;
+    fpu_current_used = 0;
+
+    // 1. Os registradores ainda sao dela: so desliga o TS
+    if (fpu_owner == next) {
+        if (fpu_ts_set) {
+            clts();
+            fpu_ts_set = 0;
+        }
+        return;
+    }
+
+    // 2. Antecipa para quem usa a FPU sempre (evita o #NM)
+    int eager = next->area && (fpu_mode == FPU_MODE_EAGER ||
+                (fpu_mode == FPU_MODE_AUTO && next->use_count > FPU_EAGER_THRESHOLD));
+    if (eager) {
+        if (fpu_ts_set) {
+            clts();
+            fpu_ts_set = 0;
+        }
+        if (fpu_owner) fpu_save(fpu_owner);
+        fpu_restore(next);
+        fpu_owner = next;
+        fpu_current_used = 1;
+        next->use_count++; // Da a volta em 256: reaprende se a tarefa parou de usar
+        fpu_preloads++;
+        return;
+    }
+
+    // 3. Preguicoso: o primeiro uso levanta #NM
+    if (!fpu_ts_set) {
+        stts();
+        fpu_ts_set = 1;
+    }
+}
+
+/**
+ * Libera a area de uma tarefa que terminou.
+ */
+void fpu_release(fpu_ctx_t *ctx) {
+    uint32_t flags = irq_save();
+    if (fpu_owner == ctx) fpu_owner = 0;
+    if (ctx->area) free_page(ctx->area);
+    ctx->area = 0;
+    ctx->use_count = 0;
+    irq_restore(flags);
+}
+
+void fpu_set_mode(int mode) {
+    fpu_mode = mode;
+}
+
+// =======================================================
+// 3. FPU DENTRO DO KERNEL
+// =======================================================
+
+int fpu_sse_enabled() {
+    return fpu_enabled && fpu_save_format != FPU_SAVE_FNSAVE && cpu_has(CPU_FEATURE_SSE2);
+}
+
+int fpu_avx_enabled() {
+    return fpu_enabled && (fpu_xcr0 & XCR0_AVX) != 0;
+}
+
+/**
+ * Libera os registradores SIMD para o Kernel: guarda o estado da tarefa
+ * dona (se estiver vivo) e desliga as interrupcoes ate kernel_fpu_end().
+ * Sem dono nao ha nada vivo para salvar. Se a dona e a tarefa atual, ela
+ * continua dona: kernel_fpu_end() devolve os registradores a ela.
+ * @return Flags para kernel_fpu_end().
+ */
+uint32_t kernel_fpu_begin() {
+    uint32_t flags = irq_save();
+    // Aninhado: os registradores ja sao do Kernel (salvar agora gravaria lixo no dono)
+    if (fpu_kernel_depth++ > 0) return flags;
+    if (fpu_ts_set) {
+        clts();
+        fpu_ts_set = 0;
+    }
+    if (fpu_owner) {
+        // Com XSAVEOPT, depois do XRSTOR feito por kernel_fpu_end() na mesma
+        // area, so os componentes que a tarefa mudou desde entao sao gravados
+        fpu_save(fpu_owner);
+        if (fpu_owner != fpu_current) fpu_owner = 0; // Outra tarefa: recarrega no #NM dela
+    }
+    return flags;
+}
+
+/**
+ * Fim do uso pelo Kernel. Se a tarefa atual e a dona, recarrega o estado
+ * dela e deixa o TS desligado (sem #NM no proximo uso dela). Senao os
+ * registradores ficaram sujos e sem dono: o TS volta a ser ligado, e o
+ * proximo uso de qualquer tarefa passa pelo #NM.
+ */
+void kernel_fpu_end(uint32_t flags) {
+    if (--fpu_kernel_depth > 0) {
+        irq_restore(flags);
+        return;
+    }
+    if (fpu_owner) {
+        fpu_restore(fpu_owner);
+    } else {
+        stts();
+        fpu_ts_set = 1;
+    }
+    irq_restore(flags);
+}
+
+// =======================================================
+// 4. INICIALIZACAO
+// =======================================================
+
+// Retomada da hibernacao: CR0/CR4 voltam com a imagem, o XCR0 nao
+static void fpu_resume() {
+    if (fpu_xcr0) xsetbv(0, fpu_xcr0);
+    fpu_owner = 0;
+}
+
+/**
+ * Liga x87/SSE/AVX e o #NM. Chamar depois de cpu_features_detect() e
+ * antes de init_scheduler().
+ */
+void init_fpu() {
+    if (!cpu_has(CPU_FEATURE_FPU)) {
+        ui_log_status("FPU: ausente. Tarefas devem usar so inteiros.", 0x0E);
+        return;
+    }
+
+    // 1. CR0: FPU nativa (EM=0), WAIT respeita o TS (MP), erros por #MF (NE)
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    __asm__ __volatile__ ("fninit");
+
+    // 2. SSE: FXSAVE/FXRSTOR e excecoes SIMD
+    if (cpu_has(CPU_FEATURE_FXSR)) {
+        write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+        fpu_save_format = FPU_SAVE_FXSAVE;
+    }
+
+    // 3. XSAVE: habilita os componentes x87, SSE e (se houver) AVX no XCR0
+    if (cpu_has(CPU_FEATURE_XSAVE | CPU_FEATURE_FXSR)) {
+        write_cr4(read_cr4() | CR4_OSXSAVE);
+        fpu_xcr0 = XCR0_X87 | XCR0_SSE;
+        if (cpu_has(CPU_FEATURE_AVX)) fpu_xcr0 |= XCR0_AVX;
+        xsetbv(0, fpu_xcr0);
+
+        uint32_t eax, ebx, ecx, edx;
+        cpu_cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        fpu_xsave_size = ebx; // Tamanho para os componentes ligados no XCR0
+        if (fpu_xsave_size <= FPU_AREA_SIZE) {
+            fpu_save_format = FPU_SAVE_XSAVE;
+            fpu_has_xsaveopt = cpu_has(CPU_FEATURE_XSAVEOPT);
+        }
+    }
+
+    // 4. #NM e TS ligado: ninguem e dono da FPU ainda
+    idt_set_gate(NM_VECTOR, (uint32_t)fpu_nm_entry, KERNEL_CODE_SELECTOR, IDT_GATE_KERNEL_INTERRUPT);
+    fpu_owner = 0;
+    stts();
+    fpu_ts_set = 1;
+    fpu_enabled = 1;
+    hibernate_register_resume(fpu_resume);
+
+    if (fpu_save_format == FPU_SAVE_XSAVE) {
+        ui_log_status(fpu_has_xsaveopt ? "FPU: XSAVEOPT, troca preguicosa (#NM)."
+                                       : "FPU: XSAVE, troca preguicosa (#NM).", 0x0A);
+    } else if (fpu_save_format == FPU_SAVE_FXSAVE) {
+        ui_log_status("FPU: FXSAVE (SSE), troca preguicosa (#NM).", 0x0A);
+    } else {
+        ui_log_status("FPU: x87 (FNSAVE), troca preguicosa (#NM).", 0x0A);
+    }
+}
+
+// =======================================================
+// 5. BENCHMARK (custo da troca por mistura de tarefas)
+// =======================================================
+
+#define FPU_BENCH_SWITCHES  2000
+
+// Usa um registrador SIMD (ou x87) como uma tarefa de verdade faria.
+// O Kernel e compilado sem SSE, entao o compilador nunca guarda nada em XMM.
+static void bench_touch_fpu() {
+    if (fpu_save_format != FPU_SAVE_FNSAVE) {
+        __asm__ __volatile__ ("pxor %%xmm0, %%xmm0\n" "paddd %%xmm0, %%xmm0" : : : "memory");
+    } else {
+        __asm__ __volatile__ ("fldz\n" "fstp %%st(0)" : : : "memory");
+    }
+}
+
+/**
+ * Alterna entre duas tarefas de mentira A e B, cada uma opcionalmente
+ * usando a FPU na sua "fatia".
+ * @return Ciclos medios do caminho de FPU por troca.
+ */
+static uint32_t bench_mix(int a_uses_fpu, int b_uses_fpu, int mode) {
+    fpu_ctx_t a = FPU_CTX_INIT;
+    fpu_ctx_t b = FPU_CTX_INIT;
+    fpu_set_mode(mode);
+
+    // Aquecimento: aloca as areas e deixa o modo AUTO aprender
+    for (int i = 0; i < 2 * FPU_EAGER_THRESHOLD + 2; i++) {
+        fpu_switch(&a);
+        if (a_uses_fpu) bench_touch_fpu();
+        fpu_switch(&b);
+        if (b_uses_fpu) bench_touch_fpu();
+    }
+
+    uint64_t start = read_tsc();
+    for (int i = 0; i < FPU_BENCH_SWITCHES / 2; i++) {
+        fpu_switch(&a);
+        if (a_uses_fpu) bench_touch_fpu();
+        fpu_switch(&b);
+        if (b_uses_fpu) bench_touch_fpu();
+    }
+    uint64_t cycles = read_tsc() - start;
+
+    fpu_release(&a);
+    fpu_release(&b);
+    return (uint32_t)(cycles / FPU_BENCH_SWITCHES);
+}
+
+/**
+ * Mede o custo de FPU por troca de contexto para tres misturas de tarefas
+ * (inteiros/inteiros, SIMD/inteiros, SIMD/SIMD) nos modos preguicoso e
+ * antecipado, e desenha a tabela a partir de 'row'.
+ */
+void fpu_run_benchmark(int row) {
+    static const char *mode_names[2] = { "Preguicoso", "Antecipado" };
+    static const int modes[2] = { FPU_MODE_LAZY, FPU_MODE_EAGER };
+    char buffer[12];
+
+    if (!fpu_enabled) return;
+
+    uint32_t flags = irq_save(); // Nenhuma troca real no meio
+    fpu_ctx_t *saved_current = fpu_current;
+    int saved_used = fpu_current_used;
+    int saved_mode = fpu_mode;
+
+    ui_draw_string("FPU ciclos/troca  int/int  simd/int  simd/simd", row, 0, 0x0E);
+    for (int m = 0; m < 2; m++) {
+        ui_draw_string(mode_names[m], row + 1 + m, 0, 0x0B);
+        ui_draw_string(u32_to_str(bench_mix(0, 0, modes[m]), buffer, 12), row + 1 + m, 18, 0x0F);
+        ui_draw_string(u32_to_str(bench_mix(1, 0, modes[m]), buffer, 12), row + 1 + m, 27, 0x0F);
+        ui_draw_string(u32_to_str(bench_mix(1, 1, modes[m]), buffer, 12), row + 1 + m, 37, 0x0F);
+    }
+
+    // Volta para a tarefa que chamou o benchmark (mesmo sem contexto: 'b' era
+    // local do bench_mix()). O TS segue o dono: se os registradores nao sao
+    // mais dela, o proximo uso recarrega pelo #NM
+    fpu_set_mode(saved_mode);
+    fpu_current = saved_current;
+    fpu_current_used = saved_used;
+    if (saved_current && fpu_owner == saved_current) {
+        if (fpu_ts_set) {
+            clts();
+            fpu_ts_set = 0;
+        }
+    } else if (!fpu_ts_set) {
+        stts();
+        fpu_ts_set = 1;
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,36 @@
+// fpu_context.h - Estado de FPU/SSE/AVX por tarefa (guardado no PCB).
+
+#ifndef FPU_CONTEXT_H
+#define FPU_CONTEXT_H
+
+#include <stdint.h>
+
+// Modos de troca do estado da FPU
+#define FPU_MODE_LAZY   0   // So salva/restaura quando a tarefa usa a FPU (#NM)
+#define FPU_MODE_EAGER  1   // Restaura na troca toda tarefa que ja usou a FPU
+#define FPU_MODE_AUTO   2   // Preguicoso, mas antecipa para quem usa a FPU toda vez
+
+/**
+ * Contexto de FPU de uma tarefa. 'area' fica 0 ate a tarefa tocar na FPU
+ * pela primeira vez: tarefas so de inteiros nao gastam memoria nem ciclos.
+ */
+typedef struct {
+    uint32_t area;      // Pagina de salvamento (FNSAVE/FXSAVE/XSAVE), 0 = nunca usou
+    uint8_t use_count;  // Fatias seguidas em que a tarefa usou a FPU (modo AUTO)
+    uint8_t reserved[3];
+} fpu_ctx_t;
+
+#define FPU_CTX_INIT { 0, 0, { 0, 0, 0 } }
+
+void init_fpu();
+void fpu_switch(fpu_ctx_t *next);
+void fpu_release(fpu_ctx_t *ctx);
+void fpu_set_mode(int mode);
+
+// Uso de SSE/AVX pelo proprio Kernel (rotinas de memoria)
+int fpu_sse_enabled();
+int fpu_avx_enabled();
+uint32_t kernel_fpu_begin();
+void kernel_fpu_end(uint32_t flags);
+
+#endif
@@ -0,0 +1,137 @@
+// top_monitor.c - Tela de uso de CPU por processo (estilo "top").
+//
+// Uma tarefa assincrona acorda a cada TOP_REFRESH_TICKS, copia a
+// contabilidade de cada PID (scheduler_get_stats) e desenha uma linha por
+// processo. O %CPU e calculado sobre o intervalo desde a ultima atualizacao,
+// entao um processo que come a CPU aparece na hora, mesmo com historico longo.
+
+#include <stdint.h>
+#include "../Agendador/sched_stats.h"
+#include "../../Kernel/Async/async.h"
+#include "../../Kernel/Lib/kformat.h"
+
+extern uint64_t read_tsc();                     // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles); // Do cpu_diag.c
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern void ui_fill(int row, int col, int count, char c, char color_byte);
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern int vc_open(const char *name);      // Do virtual_console.c
+extern int vc_select(int console);
+
+#define TOP_REFRESH_TICKS   100     // 1 segundo com o timer a 100Hz
+#define TOP_MAX_PIDS        8       // Linhas da tabela (>= MAX_PROCESSES)
+#define TOP_HOG_PERMILLE    800     // Acima de 80% da CPU a linha fica vermelha
+
+// Colunas da tabela
+#define COL_PID     0
+#define COL_STATE   4
+#define COL_CPU     13
+#define COL_RUN     20
+#define COL_WAIT    32
+#define COL_SLEEP   43
+#define COL_SWITCH  56
+#define COL_VOL     64
+#define COL_INVOL   71
+
+typedef struct {
+    async_task_t task;
+    int row;
+    int console;                // Console virtual proprio (F1..F8)
+    int previous_console;
+    uint64_t last_tsc;
+    uint64_t last_run[TOP_MAX_PIDS];
+} TopFrame;
+
+static const char *state_names[4] = { "LIVRE", "PRONTO", "BLOQ", "RODANDO" };
+
+// Milissegundos de um total em ciclos
+static uint32_t cycles_to_ms(uint64_t cycles) {
+    return (uint32_t)(tsc_cycles_to_ns(cycles) / 1000000ull);
+}
+
+// Desenha "12.3" a partir de um valor em milesimos
+static void draw_percent(uint32_t permille, int row, int col, char color_byte) {
+    char buffer[12];
+    char *text = u32_to_str(permille / 10, buffer, 10);
+    buffer[9] = '.';
+    buffer[10] = (char)('0' + permille % 10);
+    buffer[11] = '\0';
+    ui_draw_string(text, row, col, color_byte);
+}
+
+/**
+ * Desenha a linha de um processo. 'interval' e o tempo de parede (ciclos)
+ * desde a atualizacao anterior.
+ */
+static void draw_process(TopFrame *f, int pid, int state, sched_stats_t *stats, uint64_t interval) {
+    char buffer[12];
+    int r = f->row + 2 + pid;
+
+    uint64_t ran = stats->run_cycles - f->last_run[pid];
+    f->last_run[pid] = stats->run_cycles;
+    uint32_t permille = interval ? (uint32_t)((ran * 1000) / interval) : 0;
+    if (permille > 1000) permille = 1000;
+
+    // O Idle (PID 0) usa a CPU que sobra: nunca e marcado como vilao
+    char color = (pid != 0 && permille >= TOP_HOG_PERMILLE) ? 0x0C : 0x0F;
+
+    ui_fill(r, 0, 80, ' ', 0x00);
+    ui_draw_string(u32_to_str((uint32_t)pid, buffer, 12), r, COL_PID, 0x0B);
+    ui_draw_string(state_names[state], r, COL_STATE, 0x07);
+    if (state == SCHED_STATE_FREE) return;
+
+    draw_percent(permille, r, COL_CPU, color);
+    ui_draw_string(u32_to_str(cycles_to_ms(stats->run_cycles), buffer, 12), r, COL_RUN, color);
+    ui_draw_string(u32_to_str(cycles_to_ms(stats->wait_cycles), buffer, 12), r, COL_WAIT, 0x0F);
+    ui_draw_string(u32_to_str(cycles_to_ms(stats->sleep_cycles), buffer, 12), r, COL_SLEEP, 0x0F);
+    ui_draw_string(u32_to_str(stats->switches, buffer, 12), r, COL_SWITCH, 0x0F);
+    ui_draw_string(u32_to_str(stats->voluntary, buffer, 12), r, COL_VOL, 0x0A);
+    ui_draw_string(u32_to_str(stats->involuntary, buffer, 12), r, COL_INVOL, 0x0E);
+}
+
+// Tarefa do monitor: atualiza a tabela para sempre
+static int top_monitor_task(async_task_t *t) {
+    TopFrame *f = (TopFrame*)t;
+    ASYNC_BEGIN(t);
+
+    // Cada passo desenha no console do monitor e devolve o do executor
+    f->previous_console = vc_select(f->console);
+    ui_draw_string("== TOP: uso de CPU por processo ==", f->row, 0, 0x0E);
+    ui_draw_string("PID ESTADO   %CPU   RODANDO(ms) FILA(ms)   DORMINDO(ms) TROCAS  VOL    INVOL",
+                   f->row + 1, 0, 0x07);
+    vc_select(f->previous_console);
+    f->last_tsc = read_tsc();
+
+    for (;;) {
+        ASYNC_SLEEP(t, TOP_REFRESH_TICKS);
+
+        uint64_t now = read_tsc();
+        uint64_t interval = now - f->last_tsc;
+        f->last_tsc = now;
+
+        sched_stats_t stats;
+        f->previous_console = vc_select(f->console);
+        for (int pid = 0; pid < TOP_MAX_PIDS; pid++) {
+            int state = scheduler_get_stats(pid, &stats);
+            if (state < 0) break;
+            draw_process(f, pid, state, &stats, interval);
+        }
+        vc_select(f->previous_console);
+    }
+
+    ASYNC_END(t);
+}
+
+/**
+ * Inicia o monitor, desenhando a tabela a partir de 'row'.
+ */
+void start_top_monitor(int row) {
+    TopFrame *f = (TopFrame*)async_alloc(top_monitor_task, sizeof(TopFrame));
+    if (!f) {
+        ui_log_status("TOP ERRO: Sem memoria para o monitor.", 0x0C);
+        return;
+    }
+    f->row = row;
+    f->console = vc_open("TOP"); // Sem console livre (-1), desenha no do executor
+    async_start(&f->task);
+}
@@ -1,29 +1,27 @@
 // app_loader.c - Rotina para carregar e iniciar um novo programa.
 
-// Define onde o programa sera carregado na memoria (Endereco de carga).
-// Um Kernel real usaria gerenciamento de memoria virtual para isso.
-#define APP_LOAD_ADDRESS 0x200000 
-// Tamanho maximo do aplicativo em bytes
+#include <stdint.h>
+#include "../../Kernel/Lib/kmemory.h"
+
+// Tamanho maximo do aplicativo em bytes (uma pagina do alocador de memoria)
 #define MAX_APP_SIZE     4096 
 
+// O endereco de carga vem do gerenciador de memoria fisica (page_allocator.c)
+extern uint32_t alloc_page();
+extern void free_page(uint32_t address);
+
+
+// Implementado em blipfs.c (Sistema de arquivos do Core-Blip)
+extern int blipfs_read_file(const char *path, char *buffer, int max_size);
 
-// Simula a funcao de leitura de disco
-// No seu Core-Blip, esta rotina usaria a interrupcao INT 0x13 da BIOS.
-// Aqui, apenas copiamos dados simulados.
+// Le o aplicativo do disco atraves do BlipFS.
+// Custa uma busca no diretorio hash e uma leitura multi-setor por extent.
 int read_from_disk(const char* filename, char* buffer, int max_size) {
-    if (filename[0] == 'A' && filename[1] == 'P' && filename[2] == 'P') {
-        // Simula o codigo do aplicativo sendo lido do disco
-        const char *simulated_app_code = "APP_START: Iniciado o utilitario de teste! APP_END.";
-        int len = 0;
-        
-        while (simulated_app_code[len] != '\0' && len < max_size - 1) {
-            buffer[len] = simulated_app_code[len];
-            len++;
-        }
-        buffer[len] = '\0'; // Garantir que e' uma string terminada em null
-        return len;
-    }
-    return -1; // Arquivo nao encontrado
+    int len = blipfs_read_file(filename, buffer, max_size - 1);
+    if (len < 0) return -1; // Arquivo nao encontrado
+
+    buffer[len] = '\0'; // Garantir que e' uma string terminada em null
+    return len;
 }
 
 /**
@@ -32,10 +30,10 @@ int read_from_disk(const char* filename, char* buffer, int max_size) {
  */
 void launch_application(const char* app_name) {
     
-    char *load_target = (char*)APP_LOAD_ADDRESS;
+    char *load_target = (char*)alloc_page();
     
     // 1. Logica de leitura de disco
-    int size = read_from_disk(app_name, load_target, MAX_APP_SIZE);
+    int size = load_target ? read_from_disk(app_name, load_target, MAX_APP_SIZE) : -1;
     
     if (size > 0) {
         // Log de sucesso (usa a funcao de impressao do Kernel)
@@ -52,15 +50,13 @@ void launch_application(const char* app_name) {
         // Em um Kernel real, voce usaria Assembly para:
         // a) Configurar a pilha do novo aplicativo.
         // b) Salvar o estado do Kernel.
-        // c) Fazer um 'jmp' (salto) para o endereco APP_LOAD_ADDRESS.
+        // c) Fazer um 'jmp' (salto) para o endereco load_target.
         
-        // SIMULACAO: Mostra o conteudo carregado e termina.
-        int col = 0;
-        char *app_data = (char*)APP_LOAD_ADDRESS;
-        
-        while(*app_data != '\0' && col < 50) {
-            putc(*app_data, 21, col++, 0x0F);
-            app_data++;
+        // SIMULACAO: Mostra o conteudo carregado (ate 50 bytes) e termina.
+        char *end = (char*)kmemchr(load_target, '\0', 50);
+        int shown = end ? (int)(end - load_target) : 50;
+        for (int col = 0; col < shown; col++) {
+            putc(load_target[col], 21, col, 0x0F);
         }
         
     } else {
@@ -69,6 +65,9 @@ void launch_application(const char* app_name) {
         putc('R', 20, 2, 0x0C);
         putc('O', 20, 3, 0x0C);
     }
+
+    // O App simulado ja terminou: devolve a pagina de carga
+    free_page((uint32_t)load_target);
 }
 
 // Funcao de inicializacao que o Kernel chamaria (Exemplo de uso)
@@ -3,6 +3,14 @@
 // Presume que funcoes de UI e escrita na tela estao disponiveis
 extern void putc(char c, int row, int col, char color);
 extern void move_selector(int delta_col, int delta_row); // Usado para a escolha
+extern int keyboard_read_key();     // Do keyboard_driver.c (bloqueia ate uma tecla)
+extern void keyboard_flush_keys();
+extern int scheduler_can_block();   // Do scheduler.c
+extern void ui_fill(int row, int col, int count, char c, char color_byte); // Do ui_control.c
+extern int vc_open(const char *name);      // Do virtual_console.c
+extern int vc_select(int console);
+extern int vc_active();
+extern int vc_switch(int console);
 
 // Define o recurso de exemplo que o aplicativo quer acessar
 #define RESOURCE_ID_DISK_IO 1 
@@ -11,6 +19,24 @@ extern void move_selector(int delta_col, int delta_row); // Usado para a escolha
 // Variaveis de estado de permissao
 static int permission_granted = 0;
 static int current_selection_row = 15; // Linha da opcao 'Permitir'
+static int popup_console = -1;         // Console do pop-up (aberto no primeiro pedido)
+
+#define KEY_ENTER 13
+#define KEY_DOWN  400
+
+/**
+ * Desenha as duas opcoes, com destaque AZUL (0x1F) na linha selecionada.
+ */
+static void draw_permission_options() {
+    const char *allow = "Permitir";
+    const char *ignore = "Ignorar";
+    for (int i = 0; allow[i] != '\0'; i++) {
+        putc(allow[i], 15, 20 + i, current_selection_row == 15 ? 0x1F : 0x07);
+    }
+    for (int i = 0; ignore[i] != '\0'; i++) {
+        putc(ignore[i], 16, 20 + i, current_selection_row == 16 ? 0x1F : 0x07);
+    }
+}
 
 /**
  * Funcao central que verifica o manifesto e aciona o pop-up de permissao.
@@ -21,6 +47,13 @@ int check_and_request_permission(const char* app_name, int resource_id) {
     // Se ja foi concedida (simulacao de cache)
     if (permission_granted) return 1;
 
+    // 0. O pop-up tem console proprio: aparece na frente sem apagar a tela
+    //    de ninguem, e a tela anterior volta inteira no fim
+    if (popup_console < 0) popup_console = vc_open("Permissao");
+    int previous_active = vc_active();
+    int previous_console = vc_select(popup_console);
+    vc_switch(popup_console);
+
     // 1. Exibe a Notificacao de Seguranca do Kernel (Pop-up)
     const char *prompt_title = "== SOLICITACAO DE PERMISSAO ==";
     const char *prompt_app = "Aplicativo: ";
@@ -49,37 +82,36 @@ int check_and_request_permission(const char* app_name, int resource_id) {
     putc(' ', 14, 26, 0x0F);
     putc(resource_name[0], 14, 27, 0x0C); // Vermelho para recurso perigoso
 
-    // 2. Opcoes de Escolha (Permitir/Ignorar)
-    putc('P', 15, 20, 0x1F); // Opcao 'Permitir' com destaque AZUL (0x1F)
-    putc('e', 15, 21, 0x1F); 
-    putc('r', 15, 22, 0x1F); 
-    putc('m', 15, 23, 0x1F); 
-    putc('i', 15, 24, 0x1F); 
-    putc('t', 15, 25, 0x1F); 
-    putc('i', 15, 26, 0x1F); 
-    putc('r', 15, 27, 0x1F); 
+    // 2. Opcoes de Escolha (Permitir/Ignorar), comecando em 'Permitir'
+    current_selection_row = 15;
+    draw_permission_options();
 
-    putc('I', 16, 20, 0x07); // Opcao 'Ignorar' (Cor Padrao)
-    putc('g', 16, 21, 0x07); 
-    putc('n', 16, 22, 0x07); 
-    putc('o', 16, 23, 0x07); 
-    putc('r', 16, 24, 0x07); 
-    putc('a', 16, 25, 0x07); 
-    putc('r', 16, 26, 0x07); 
+    // 3. Esperar pela entrada do usuario
+    if (scheduler_can_block()) {
+        // So valem teclas digitadas com o pop-up na tela: um ENTER antigo na
+        // fila concederia a permissao sem o usuario ver a pergunta
+        keyboard_flush_keys();
 
-    // 3. Esperar pela entrada do usuario (Simplificacao)
-    // Em um Kernel real, o sistema entraria em um loop de interrupcao de teclado aqui.
-    
-    // SIMULACAO: Assumimos que o usuario seleciona 'Permitir'
-    // Na sua proxima versao, o 'handle_key_event' do seu servico de acessibilidade
-    // faria o 'move_selector' para mudar a linha (15 ou 16)
-    
-    permission_granted = 1; // Permissao concedida para o exemplo
+        // O processo dorme na fila do teclado ate cada tecla chegar (sem girar)
+        int key;
+        while ((key = keyboard_read_key()) != KEY_ENTER) {
+            if (key == KEY_DOWN) {
+                current_selection_row = (current_selection_row == 15) ? 16 : 15;
+                draw_permission_options();
+            }
+        }
+        permission_granted = (current_selection_row == 15);
+    } else {
+        // Ainda no boot (sem agendador): assume 'Permitir'
+        permission_granted = 1;
+    }
 
     // Limpar o pop-up apos a decisao (simulacao)
     for(int r = 13; r <= 16; r++) {
-        for(int c = 15; c < 50; c++) putc(' ', r, c, 0x00);
+        ui_fill(r, 15, 35, ' ', 0x00);
     }
+    vc_select(previous_console);
+    vc_switch(previous_active);
 
     return permission_granted;
 }
@@ -0,0 +1,321 @@
+// ipc_channel.c - Canais de IPC com nome entre processos do Core-Blip.
+//
+// Cada canal e um anel produtor-unico/consumidor-unico em paginas compartilhadas.
+// O remetente monta a mensagem direto no anel (ipc_reserve/ipc_commit) e o
+// destinatario le no lugar (ipc_peek/ipc_release): nenhuma copia intermediaria.
+// Cargas grandes nao passam pelo anel: o remetente concede as paginas
+// (ipc_send_pages) e o destinatario passa a ser o dono delas.
+// A "campainha" e uma wait queue: o destinatario dorme com o anel vazio e so
+// e acordado se estiver mesmo dormindo.
+
+#include <stdint.h>
+#include "../Agendador/sync.h"
+#include "../../Kernel/Lib/kmemory.h"
+
+extern uint32_t alloc_pages(int order);
+extern void free_pages(uint32_t address, int order);
+extern void ui_log_status(const char *status_msg, char color_byte);
+
+#define IPC_MAX_CHANNELS    16
+#define IPC_NAME_MAX        15
+#define IPC_RING_ORDER      2                       // Anel de 16KB (4 paginas)
+#define IPC_RING_BYTES      (4096 << IPC_RING_ORDER)
+#define IPC_RECORD_ALIGN    16
+
+// Tipos de registro no anel
+#define IPC_RECORD_DATA     1   // Carga inline logo apos o cabecalho
+#define IPC_RECORD_GRANT    2   // Concessao de paginas (IpcGrant apos o cabecalho)
+#define IPC_RECORD_PAD      3   // Preenchimento ate o fim do anel (volta ao inicio)
+
+typedef struct {
+    uint32_t length;    // Bytes de carga (sem o cabecalho)
+    uint32_t type;
+} IpcRecordHeader;
+
+typedef struct {
+    uint32_t address;   // Endereco fisico do bloco concedido
+    uint32_t order;     // Tamanho: 2^order paginas
+    uint32_t length;    // Bytes validos no bloco
+} IpcGrant;
+
+// Controle do anel, no inicio da area compartilhada. Produtor e consumidor
+// escrevem em linhas de cache diferentes.
+// 'head' e 'tail' sao posicoes em [0, capacity) que voltam a 0 explicitamente:
+// a capacidade (16KB menos o controle) nao e potencia de 2, entao contadores
+// livres reduzidos com '%' pulariam de posicao quando passassem de 2^32.
+// head == tail e anel vazio; o produtor nunca deixa head alcancar tail.
+typedef struct {
+    volatile uint32_t head;             // Escrito so pelo produtor (proximo byte a produzir)
+    uint32_t pad0[15];
+    volatile uint32_t tail;             // Escrito so pelo consumidor (proximo byte a consumir)
+    volatile uint32_t receiver_waiting; // Consumidor dormindo: o produtor toca a campainha
+    uint32_t pad1[14];
+} IpcRingControl;
+
+typedef struct {
+    char name[IPC_NAME_MAX + 1];
+    int in_use;
+    IpcRingControl *control;
+    uint8_t *data;                      // IPC_RING_BYTES - sizeof(control) bytes
+    uint32_t capacity;
+    uint32_t reserved_offset;           // Registro reservado e ainda nao publicado
+    uint32_t reserved_size;             // 0 = nada reservado
+    uint32_t reserved_head;             // 'head' depois de publicar a reserva
+    wait_queue_t doorbell;              // Destinatario esperando mensagem
+    wait_queue_t space;                 // Remetente esperando espaco
+} IpcChannel;
+
+static IpcChannel channels[IPC_MAX_CHANNELS];
+static spinlock_t channels_lock = SPINLOCK_INIT;
+
+static int ipc_name_equals(const char *a, const char *b) {
+    int i = 0;
+    while (i < IPC_NAME_MAX && a[i] != '\0' && a[i] == b[i]) i++;
+    return i == IPC_NAME_MAX || a[i] == b[i];
+}
+
+static uint32_t ipc_record_size(uint32_t length) {
+    return (sizeof(IpcRecordHeader) + length + IPC_RECORD_ALIGN - 1) & ~(IPC_RECORD_ALIGN - 1);
+}
+
+// Avanca uma posicao do anel; o fim da area de dados volta ao inicio
+static uint32_t ipc_advance(IpcChannel *ch, uint32_t position, uint32_t bytes) {
+    position += bytes;
+    return (position >= ch->capacity) ? position - ch->capacity : position;
+}
+
+// =======================================================
+// 1. CANAIS COM NOME
+// =======================================================
+
+/**
+ * Abre (ou cria) o canal 'name'.
+ * @return Identificador do canal, ou -1 se a tabela ou a memoria acabarem.
+ */
+int ipc_channel_open(const char *name) {
+    uint32_t flags = spin_lock_irqsave(&channels_lock);
+
+    int free_id = -1;
+    for (int id = 0; id < IPC_MAX_CHANNELS; id++) {
+        if (channels[id].in_use && ipc_name_equals(channels[id].name, name)) {
+            spin_unlock_irqrestore(&channels_lock, flags);
+            return id;
+        }
+        if (!channels[id].in_use && free_id < 0) free_id = id;
+    }
+    if (free_id < 0) {
+        spin_unlock_irqrestore(&channels_lock, flags);
+        ui_log_status("IPC ERRO: Tabela de canais cheia.", 0x0C);
+        return -1;
+    }
+
+    uint32_t ring = alloc_pages(IPC_RING_ORDER);
+    if (!ring) {
+        spin_unlock_irqrestore(&channels_lock, flags);
+        ui_log_status("IPC ERRO: Sem memoria para o anel do canal.", 0x0C);
+        return -1;
+    }
+
+    IpcChannel *ch = &channels[free_id];
+    int i;
+    for (i = 0; i < IPC_NAME_MAX && name[i] != '\0'; i++) ch->name[i] = name[i];
+    ch->name[i] = '\0';
+    ch->control = (IpcRingControl*)ring;
+    ch->control->head = 0;
+    ch->control->tail = 0;
+    ch->control->receiver_waiting = 0;
+    ch->data = (uint8_t*)(ring + sizeof(IpcRingControl));
+    ch->capacity = IPC_RING_BYTES - sizeof(IpcRingControl);
+    ch->reserved_size = 0;
+    wait_queue_init(&ch->doorbell);
+    wait_queue_init(&ch->space);
+    ch->in_use = 1;
+
+    spin_unlock_irqrestore(&channels_lock, flags);
+    return free_id;
+}
+
+static IpcChannel* ipc_get(int id) {
+    if (id < 0 || id >= IPC_MAX_CHANNELS || !channels[id].in_use) return 0;
+    return &channels[id];
+}
+
+// =======================================================
+// 2. LADO DO PRODUTOR
+// =======================================================
+
+/**
+ * Reserva espaco para uma mensagem de 'length' bytes direto no anel.
+ * Nao bloqueia (pode ser usada em rotinas de interrupcao).
+ * @return Ponteiro onde o remetente escreve a carga, ou 0 se o anel estiver cheio.
+ */
+void* ipc_reserve(int id, uint32_t length) {
+    IpcChannel *ch = ipc_get(id);
+    uint32_t size = ipc_record_size(length);
+    if (!ch || size > ch->capacity / 2) return 0;
+
+    uint32_t offset = ch->control->head;
+    uint32_t tail = ch->control->tail;
+    uint32_t used = (offset >= tail) ? offset - tail : ch->capacity - (tail - offset);
+    uint32_t to_end = ch->capacity - offset;
+
+    // Registro nao cabe antes do fim: preenche e comeca do inicio.
+    // Sobra ao menos um alinhamento livre para head nao alcancar tail (cheio != vazio)
+    uint32_t pad = (to_end < size) ? to_end : 0;
+    if (used + pad + size >= ch->capacity) return 0;
+
+    if (pad) {
+        IpcRecordHeader *pad_hdr = (IpcRecordHeader*)(ch->data + offset);
+        pad_hdr->type = IPC_RECORD_PAD;
+        pad_hdr->length = pad - sizeof(IpcRecordHeader);
+        offset = 0;
+    }
+
+    IpcRecordHeader *hdr = (IpcRecordHeader*)(ch->data + offset);
+    hdr->type = IPC_RECORD_DATA;
+    hdr->length = length;
+    ch->reserved_offset = offset;
+    ch->reserved_size = pad + size;
+    ch->reserved_head = ipc_advance(ch, offset, size);
+    return hdr + 1;
+}
+
+/**
+ * Publica a mensagem reservada e toca a campainha se o destinatario dormir.
+ */
+void ipc_commit(int id) {
+    IpcChannel *ch = ipc_get(id);
+    if (!ch || ch->reserved_size == 0) return;
+
+    // A carga precisa estar visivel antes do novo 'head'
+    __atomic_store_n(&ch->control->head, ch->reserved_head, __ATOMIC_RELEASE);
+    ch->reserved_size = 0;
+
+    // Store->load: sem a barreira completa a leitura de 'receiver_waiting' pode
+    // passar na frente do 'head' e perder um destinatario que acabou de dormir
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ch->control->receiver_waiting) wait_queue_wake_one(&ch->doorbell);
+}
+
+/**
+ * Envia uma mensagem pequena (copiando 'length' bytes para o anel).
+ * @return 0 em caso de sucesso, -1 se o anel estiver cheio.
+ */
+int ipc_send(int id, const void *message, uint32_t length) {
+    uint8_t *dest = (uint8_t*)ipc_reserve(id, length);
+    if (!dest) return -1;
+    kmemcpy(dest, message, length);
+    ipc_commit(id);
+    return 0;
+}
+
+/**
+ * Como ipc_send(), mas dorme ate haver espaco no anel.
+ */
+int ipc_send_wait(int id, const void *message, uint32_t length) {
+    IpcChannel *ch = ipc_get(id);
+    if (!ch || ipc_record_size(length) > ch->capacity / 2) return -1;
+    wait_event(&ch->space, ipc_send(id, message, length) == 0);
+    return 0;
+}
+
+/**
+ * Concede um bloco de 2^order paginas ao destinatario, sem copiar.
+ * O remetente nao pode mais tocar no bloco; o destinatario o libera com
+ * free_pages() quando terminar.
+ * @return 0 em caso de sucesso, -1 se o anel estiver cheio.
+ */
+int ipc_send_pages(int id, uint32_t address, int order, uint32_t length) {
+    IpcGrant *grant = (IpcGrant*)ipc_reserve(id, sizeof(IpcGrant));
+    if (!grant) return -1;
+
+    ((IpcRecordHeader*)grant - 1)->type = IPC_RECORD_GRANT;
+    grant->address = address;
+    grant->order = (uint32_t)order;
+    grant->length = length;
+    ipc_commit(id);
+    return 0;
+}
+
+// =======================================================
+// 3. LADO DO CONSUMIDOR
+// =======================================================
+
+/**
+ * Olha a proxima mensagem sem copia-la.
+ * @param length Recebe o tamanho da carga.
+ * @param is_grant Recebe 1 se a mensagem for uma concessao de paginas
+ *                 (a carga e entao um IpcGrant: endereco, ordem, tamanho).
+ * @return Ponteiro para a carga dentro do anel, ou 0 se o anel estiver vazio.
+ */
+void* ipc_peek(int id, uint32_t *length, int *is_grant) {
+    IpcChannel *ch = ipc_get(id);
+    if (!ch) return 0;
+
+    for (;;) {
+        uint32_t tail = ch->control->tail;
+        if (__atomic_load_n(&ch->control->head, __ATOMIC_ACQUIRE) == tail) return 0;
+
+        IpcRecordHeader *hdr = (IpcRecordHeader*)(ch->data + tail);
+        if (hdr->type == IPC_RECORD_PAD) {
+            // Pula o preenchimento do fim do anel
+            __atomic_store_n(&ch->control->tail,
+                             ipc_advance(ch, tail, sizeof(IpcRecordHeader) + hdr->length),
+                             __ATOMIC_RELEASE);
+            continue;
+        }
+
+        *length = hdr->length;
+        if (is_grant) *is_grant = (hdr->type == IPC_RECORD_GRANT);
+        return hdr + 1;
+    }
+}
+
+/**
+ * Libera a mensagem lida com ipc_peek() (o espaco volta ao remetente).
+ */
+void ipc_release(int id) {
+    IpcChannel *ch = ipc_get(id);
+    if (!ch) return;
+
+    uint32_t tail = ch->control->tail;
+    if (ch->control->head == tail) return;
+    IpcRecordHeader *hdr = (IpcRecordHeader*)(ch->data + tail);
+    __atomic_store_n(&ch->control->tail, ipc_advance(ch, tail, ipc_record_size(hdr->length)),
+                     __ATOMIC_RELEASE);
+
+    if (ch->space.count) wait_queue_wake_one(&ch->space);
+}
+
+/**
+ * Espera (dormindo na campainha) ate haver uma mensagem e olha para ela.
+ */
+void* ipc_peek_wait(int id, uint32_t *length, int *is_grant) {
+    IpcChannel *ch = ipc_get(id);
+    if (!ch) return 0;
+
+    void *payload = ipc_peek(id, length, is_grant);
+    if (payload) return payload;
+
+    // Avisa o produtor antes de testar de novo: um commit no meio toca a campainha
+    ch->control->receiver_waiting = 1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST); // Par da barreira do ipc_commit()
+    wait_event(&ch->doorbell, (payload = ipc_peek(id, length, is_grant)) != 0);
+    ch->control->receiver_waiting = 0;
+    return payload;
+}
+
+/**
+ * Recebe uma mensagem copiando-a para 'buffer' (para quem precisa guardar).
+ * @return Tamanho da mensagem, ou -1 se nao houver mensagem ou nao couber.
+ */
+int ipc_receive(int id, void *buffer, uint32_t max_length) {
+    uint32_t length;
+    int is_grant;
+    uint8_t *payload = (uint8_t*)ipc_peek(id, &length, &is_grant);
+    if (!payload || length > max_length) return -1;
+
+    kmemcpy(buffer, payload, length);
+    ipc_release(id);
+    return (int)length;
+}
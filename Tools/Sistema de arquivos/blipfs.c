@@ -0,0 +1,302 @@
+// blipfs.c - Sistema de arquivos nativo do Core-Blip (BlipFS).
+//
+// Cada arquivo e guardado em poucos extents contiguos, entao ler um arquivo
+// inteiro custa uma leitura multi-setor por extent. A busca por caminho e uma
+// unica consulta na tabela hash do diretorio, com caches de dentry e inode.
+// Todo acesso ao disco passa pelo cache de blocos (block_cache.c): gravacoes
+// sao write-back e os inodes mudam por transacoes do journal.
+
+#include <stdint.h>
+#include "blipfs_format.h"
+#include "../Agendador/sync.h"
+#include "../../Kernel/Async/async.h"
+#include "../../Kernel/Lib/kmemory.h"
+
+extern int bcache_read(uint32_t lba, uint32_t count, uint8_t *buffer);     // Do block_cache.c
+extern int bcache_write(uint32_t lba, uint32_t count, const uint8_t *buffer);
+extern int bcache_txn_begin();
+extern int bcache_txn_write(uint32_t lba, const uint8_t *sector);
+extern void bcache_txn_commit();
+extern int bcache_attach_journal(uint32_t lba, uint32_t sectors);
+extern void ui_log_status(const char *status_msg, char color_byte);
+
+#define ATA_MAX_SECTORS_PER_CMD 256
+
+// Tamanhos dos caches (mapeamento direto, potencias de 2)
+#define DENTRY_CACHE_SIZE   64
+#define INODE_CACHE_SIZE    32
+
+typedef struct {
+    uint32_t hash;      // 0 = slot vazio
+    uint32_t inode;
+    char name[BLIPFS_NAME_MAX + 1];
+} DentryCacheEntry;
+
+typedef struct {
+    uint32_t number;
+    int valid;
+    BlipfsInode inode;
+} InodeCacheEntry;
+
+static BlipfsSuperblock superblock;
+static int mounted = 0;
+
+static DentryCacheEntry dentry_cache[DENTRY_CACHE_SIZE];
+static InodeCacheEntry inode_cache[INODE_CACHE_SIZE];
+
+// Setor de trabalho para diretorio, inodes e a cauda parcial de arquivos
+static uint8_t sector_buffer[BLIPFS_SECTOR_SIZE];
+
+// Uma operacao por vez: protege o setor de trabalho, os caches e o superbloco
+static mutex_t fs_lock;
+
+/**
+ * Pega o fs_lock. Dentro de uma tarefa assincrona nao espera (travaria o
+ * executor): falha se outra operacao estiver em andamento.
+ * @return 0 em caso de sucesso, -1 se o lock estiver ocupado.
+ */
+static int blipfs_lock() {
+    if (async_in_task()) return mutex_trylock(&fs_lock) ? 0 : -1;
+    mutex_lock(&fs_lock);
+    return 0;
+}
+
+static int blipfs_name_equals(const char *a, const char *b) {
+    int i = 0;
+    while (a[i] != '\0' && a[i] == b[i]) i++;
+    return a[i] == b[i];
+}
+
+// Monta de fato (chamar com fs_lock)
+static int blipfs_mount_locked() {
+    if (bcache_read(BLIPFS_SUPER_LBA, 1, (uint8_t*)&superblock) != 0) return -1;
+
+    if (superblock.magic != BLIPFS_MAGIC || superblock.version != BLIPFS_VERSION ||
+        superblock.dir_buckets == 0 ||
+        (superblock.dir_buckets & (superblock.dir_buckets - 1)) != 0) {
+        ui_log_status("BlipFS: Superbloco invalido.", 0x0C);
+        return -1;
+    }
+
+    // Refaz a ultima transacao de metadados, se o sistema caiu no meio dela
+    if (bcache_attach_journal(superblock.journal_lba, superblock.journal_sectors) != 0) {
+        ui_log_status("BlipFS: Falha ao reaplicar o journal.", 0x0C);
+        return -1;
+    }
+
+    for (int i = 0; i < DENTRY_CACHE_SIZE; i++) dentry_cache[i].hash = 0;
+    for (int i = 0; i < INODE_CACHE_SIZE; i++) inode_cache[i].valid = 0;
+
+    mounted = 1;
+    ui_log_status("BlipFS montado.", 0x0A);
+    return 0;
+}
+
+/**
+ * Le e valida o superbloco (LBA 1) e limpa os caches.
+ * @return 0 em caso de sucesso, -1 se o disco nao tiver um BlipFS.
+ */
+int blipfs_mount() {
+    if (blipfs_lock() != 0) return -1;
+    int result = blipfs_mount_locked();
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+/**
+ * Resolve um caminho para o numero do inode.
+ * Primeiro no cache de dentries; se falhar, le o balde do diretorio
+ * (e os seguintes, apenas se o balde estiver cheio).
+ * @return Numero do inode, ou -1 se o arquivo nao existir.
+ */
+static int blipfs_lookup(const char *path) {
+    uint32_t hash = blipfs_hash(path);
+
+    DentryCacheEntry *cached = &dentry_cache[hash & (DENTRY_CACHE_SIZE - 1)];
+    if (cached->hash == hash && blipfs_name_equals(cached->name, path)) {
+        return (int)cached->inode;
+    }
+
+    uint32_t bucket = hash & (superblock.dir_buckets - 1);
+    for (uint32_t probe = 0; probe < superblock.dir_buckets; probe++) {
+        uint32_t lba = superblock.dir_lba + ((bucket + probe) & (superblock.dir_buckets - 1));
+        if (bcache_read(lba, 1, sector_buffer) != 0) return -1;
+
+        BlipfsDirent *entries = (BlipfsDirent*)sector_buffer;
+        int bucket_full = 1;
+        for (uint32_t i = 0; i < BLIPFS_DIRENTS_PER_SECTOR; i++) {
+            if (entries[i].hash == 0) {
+                bucket_full = 0;
+                continue;
+            }
+            if (entries[i].hash == hash && blipfs_name_equals(entries[i].name, path)) {
+                // Guarda no cache de dentries para a proxima busca
+                cached->hash = hash;
+                cached->inode = entries[i].inode;
+                for (int c = 0; c <= BLIPFS_NAME_MAX; c++) {
+                    cached->name[c] = entries[i].name[c];
+                    if (entries[i].name[c] == '\0') break;
+                }
+                return (int)entries[i].inode;
+            }
+        }
+
+        // Um balde com espaco livre encerra a sondagem linear
+        if (!bucket_full) break;
+    }
+    return -1;
+}
+
+/**
+ * Busca um inode, passando pelo cache de inodes.
+ */
+static BlipfsInode* blipfs_get_inode(uint32_t number) {
+    if (number >= superblock.inode_count) return 0;
+
+    InodeCacheEntry *slot = &inode_cache[number & (INODE_CACHE_SIZE - 1)];
+    if (slot->valid && slot->number == number) return &slot->inode;
+
+    uint32_t lba = superblock.inode_table_lba + number / BLIPFS_INODES_PER_SECTOR;
+    if (bcache_read(lba, 1, sector_buffer) != 0) return 0;
+
+    BlipfsInode *table = (BlipfsInode*)sector_buffer;
+    slot->inode = table[number % BLIPFS_INODES_PER_SECTOR];
+    slot->number = number;
+    slot->valid = 1;
+    return &slot->inode;
+}
+
+static int blipfs_file_size_locked(const char *path) {
+    if (!mounted && blipfs_mount_locked() != 0) return -1;
+
+    int number = blipfs_lookup(path);
+    if (number < 0) return -1;
+    BlipfsInode *inode = blipfs_get_inode((uint32_t)number);
+    if (!inode || inode->type != BLIPFS_INODE_FILE) return -1;
+    return (int)inode->size;
+}
+
+/**
+ * Retorna o tamanho do arquivo em bytes, ou -1 se ele nao existir.
+ */
+int blipfs_file_size(const char *path) {
+    if (blipfs_lock() != 0) return -1;
+    int result = blipfs_file_size_locked(path);
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+static int blipfs_read_file_locked(const char *path, char *buffer, int max_size) {
+    if (!mounted && blipfs_mount_locked() != 0) return -1;
+
+    int number = blipfs_lookup(path);
+    if (number < 0) return -1;
+    BlipfsInode *inode = blipfs_get_inode((uint32_t)number);
+    if (!inode || inode->type != BLIPFS_INODE_FILE) return -1;
+
+    uint32_t remaining = inode->size < (uint32_t)max_size ? inode->size : (uint32_t)max_size;
+    uint32_t total = remaining;
+    uint8_t *dest = (uint8_t*)buffer;
+
+    for (int e = 0; e < inode->extent_count && remaining > 0; e++) {
+        uint32_t lba = inode->extents[e].start_lba;
+        uint32_t sectors = inode->extents[e].sector_count;
+
+        // Setores inteiros: leitura direta, em blocos de ate 256 setores
+        uint32_t whole = remaining / BLIPFS_SECTOR_SIZE;
+        if (whole > sectors) whole = sectors;
+        while (whole > 0) {
+            uint32_t chunk = whole > ATA_MAX_SECTORS_PER_CMD ? ATA_MAX_SECTORS_PER_CMD : whole;
+            if (bcache_read(lba, chunk, dest) != 0) return -1;
+            lba += chunk;
+            sectors -= chunk;
+            whole -= chunk;
+            dest += chunk * BLIPFS_SECTOR_SIZE;
+            remaining -= chunk * BLIPFS_SECTOR_SIZE;
+        }
+
+        // Cauda parcial (menos de um setor)
+        if (remaining > 0 && remaining < BLIPFS_SECTOR_SIZE && sectors > 0) {
+            if (bcache_read(lba, 1, sector_buffer) != 0) return -1;
+            kmemcpy(dest, sector_buffer, remaining);
+            remaining = 0;
+        }
+    }
+
+    return (int)(total - remaining);
+}
+
+/**
+ * Le um arquivo inteiro para o buffer.
+ * Cada extent vira uma leitura multi-setor direto no destino; apenas o
+ * ultimo setor parcial passa pelo setor de trabalho.
+ * @return Numero de bytes lidos, ou -1 em caso de falha.
+ */
+int blipfs_read_file(const char *path, char *buffer, int max_size) {
+    if (blipfs_lock() != 0) return -1;
+    int result = blipfs_read_file_locked(path, buffer, max_size);
+    mutex_unlock(&fs_lock);
+    return result;
+}
+
+static int blipfs_write_file_locked(const char *path, const char *data, int size) {
+    if (!mounted && blipfs_mount_locked() != 0) return -1;
+
+    int number = blipfs_lookup(path);
+    if (number < 0 || size < 0) return -1;
+    BlipfsInode *inode = blipfs_get_inode((uint32_t)number);
+    if (!inode || inode->type != BLIPFS_INODE_FILE) return -1;
+
+    uint32_t capacity = 0;
+    for (int e = 0; e < inode->extent_count; e++) capacity += inode->extents[e].sector_count;
+    if ((uint32_t)size > capacity * BLIPFS_SECTOR_SIZE) return -1;
+
+    // 1. Dados: setores inteiros direto do buffer, cauda completada com zeros
+    uint32_t remaining = (uint32_t)size;
+    const uint8_t *src = (const uint8_t*)data;
+    for (int e = 0; e < inode->extent_count && remaining > 0; e++) {
+        uint32_t lba = inode->extents[e].start_lba;
+        uint32_t whole = remaining / BLIPFS_SECTOR_SIZE;
+        if (whole > inode->extents[e].sector_count) whole = inode->extents[e].sector_count;
+
+        if (whole > 0 && bcache_write(lba, whole, src) != 0) return -1;
+        src += whole * BLIPFS_SECTOR_SIZE;
+        remaining -= whole * BLIPFS_SECTOR_SIZE;
+
+        if (remaining > 0 && remaining < BLIPFS_SECTOR_SIZE && whole < inode->extents[e].sector_count) {
+            kmemset(sector_buffer, 0, BLIPFS_SECTOR_SIZE);
+            kmemcpy(sector_buffer, src, remaining);
+            if (bcache_write(lba + whole, 1, sector_buffer) != 0) return -1;
+            remaining = 0;
+        }
+    }
+
+    // 2. Metadado: o setor do inode muda dentro de uma transacao do journal
+    uint32_t lba = superblock.inode_table_lba + (uint32_t)number / BLIPFS_INODES_PER_SECTOR;
+    if (bcache_txn_begin() != 0) return -1;
+    int result = -1;
+    if (bcache_read(lba, 1, sector_buffer) == 0) {
+        BlipfsInode *table = (BlipfsInode*)sector_buffer;
+        table[(uint32_t)number % BLIPFS_INODES_PER_SECTOR].size = (uint32_t)size;
+        if (bcache_txn_write(lba, sector_buffer) == 0) {
+            inode->size = (uint32_t)size; // O cache de inodes acompanha
+            result = size;
+        }
+    }
+    bcache_txn_commit(); // Mesmo com falha: libera a transacao (sem o inode, nao muda nada)
+    return result;
+}
+
+/**
+ * Regrava um arquivo existente dentro dos extents que ele ja tem (o BlipFS
+ * nao realoca). Os dados vao pelo cache write-back; o novo tamanho entra no
+ * inode por uma transacao, entao o inode nunca fica pela metade no disco.
+ * Nao espera o disco: use bcache_sync() se precisar de durabilidade.
+ * @return Numero de bytes gravados, ou -1 se o arquivo nao existe ou nao cabe.
+ */
+int blipfs_write_file(const char *path, const char *data, int size) {
+    if (blipfs_lock() != 0) return -1;
+    int result = blipfs_write_file_locked(path, data, size);
+    mutex_unlock(&fs_lock);
+    return result;
+}
@@ -0,0 +1,77 @@
+// blipfs_format.h - Formato em disco do BlipFS (compartilhado entre o Kernel e o mkblipfs).
+//
+// Layout (setores de 512 bytes):
+//   LBA 0                 Setor de boot / MBR (nao pertence ao FS)
+//   LBA 1                 Superbloco
+//   inode_table_lba ...   Tabela de inodes (8 inodes por setor)
+//   dir_lba ...           Diretorio em tabela hash (1 balde = 1 setor = 8 entradas)
+//   journal_lba ...       Journal de metadados (opcional: journal_sectors = 0)
+//   data_lba ...          Dados: cada arquivo e um punhado de extents contiguos
+
+#ifndef BLIPFS_FORMAT_H
+#define BLIPFS_FORMAT_H
+
+#include <stdint.h>
+
+#define BLIPFS_MAGIC            0x53464C42 // "BLFS"
+#define BLIPFS_VERSION          1
+#define BLIPFS_SECTOR_SIZE      512
+#define BLIPFS_SUPER_LBA        1
+
+#define BLIPFS_MAX_EXTENTS      6
+#define BLIPFS_INODES_PER_SECTOR (BLIPFS_SECTOR_SIZE / sizeof(BlipfsInode))
+#define BLIPFS_NAME_MAX         55 // Caminho completo, sem contar o '\0'
+#define BLIPFS_DIRENTS_PER_SECTOR (BLIPFS_SECTOR_SIZE / sizeof(BlipfsDirent))
+
+#define BLIPFS_INODE_FREE       0
+#define BLIPFS_INODE_FILE       1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_sectors;
+    uint32_t inode_table_lba;
+    uint32_t inode_count;
+    uint32_t dir_lba;
+    uint32_t dir_buckets;     // Potencia de 2: balde = hash & (dir_buckets - 1)
+    uint32_t data_lba;
+    uint32_t next_free_lba;   // Alocador sequencial de extents
+    uint32_t journal_lba;     // Cabecalho + registros do journal (block_cache.c)
+    uint32_t journal_sectors; // 0 = volume sem journal (imagens antigas)
+    uint8_t  reserved[BLIPFS_SECTOR_SIZE - 11 * 4];
+} BlipfsSuperblock;
+
+// Um trecho contiguo de setores do arquivo
+typedef struct {
+    uint32_t start_lba;
+    uint32_t sector_count;
+} BlipfsExtent;
+
+typedef struct {
+    uint32_t size;            // Tamanho em bytes
+    uint16_t type;            // BLIPFS_INODE_FREE / BLIPFS_INODE_FILE
+    uint16_t extent_count;
+    BlipfsExtent extents[BLIPFS_MAX_EXTENTS];
+    uint8_t  reserved[8];
+} BlipfsInode; // 64 bytes
+
+typedef struct {
+    uint32_t hash;            // FNV-1a do nome (0 = entrada livre)
+    uint32_t inode;
+    char     name[BLIPFS_NAME_MAX + 1];
+} BlipfsDirent; // 64 bytes
+
+/**
+ * Hash FNV-1a de 32 bits usado para escolher o balde do diretorio.
+ * Nunca retorna 0 (reservado para entrada livre).
+ */
+static inline uint32_t blipfs_hash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; name[i] != '\0'; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+#endif
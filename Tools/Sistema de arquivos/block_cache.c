@@ -0,0 +1,890 @@
+// block_cache.c - Cache de setores com write-back e journal de metadados.
+//
+// Gravacoes so copiam o setor para o cache e o marcam sujo; nenhuma espera
+// o disco. Uma tarefa assincrona (o "flusher") acorda a cada
+// BCACHE_FLUSH_TICKS, ou antes se o cache encher, junta os setores sujos em
+// ordem de LBA e grava cada trecho contiguo com um unico comando ATA.
+//
+// Metadados (inodes, diretorio) mudam dentro de transacoes:
+//   bcache_txn_begin(); bcache_txn_write(...); ...; bcache_txn_commit();
+// O commit tambem nao toca no disco. O flusher grava primeiro todos os
+// setores confirmados no journal, numa unica gravacao com checksum, depois
+// uma barreira (FLUSH CACHE), e so entao os setores nos seus lugares. Se a
+// energia cair no meio, o proximo bcache_attach_journal() refaz a ultima
+// transacao inteira ou nenhuma.
+//
+// Regra: um setor de metadado so pode mudar por transacao (assim refazer o
+// journal nunca volta um setor para uma versao antiga).
+//
+// bcache_sync() e a barreira para quem precisa de durabilidade: volta
+// quando tudo que foi gravado antes ja esta na midia.
+
+#include <stdint.h>
+#include "blipfs_format.h"
+#include "../Agendador/sync.h"
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Async/async.h"
+#include "../../Kernel/Lib/kmemory.h"
+#include "../../Kernel/Lib/kformat.h"
+#include "../../Kernel/Lib/adler32.h"
+
+extern int ata_read_sectors(uint32_t lba_address, uint32_t count, uint8_t* buffer);
+extern int ata_write_sectors(uint32_t lba_address, uint32_t count, const uint8_t* buffer);
+extern int ata_flush_cache();
+extern int ata_write_sectors_async(uint32_t lba_address, uint32_t count, const uint8_t* buffer,
+                                   async_done_t done, void *ctx);
+extern int ata_flush_cache_async(async_done_t done, void *ctx);
+extern uint32_t alloc_pages(int order);
+extern int scheduler_can_block();
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles);  // Do cpu_diag.c
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+
+#define SECTOR_SIZE             512
+#define ATA_MAX_SECTORS_PER_CMD 256
+
+#define BCACHE_ENTRIES          1024    // 512KB de setores
+#define BCACHE_DATA_ORDER       7       // 128 paginas
+#define BCACHE_STAGING_ORDER    5       // 128KB: um comando de 256 setores
+#define BCACHE_HASH_SIZE        256     // Potencia de 2
+#define BCACHE_FLUSH_TICKS      50      // O flusher acorda a cada 500ms...
+#define BCACHE_DIRTY_HIGH       (BCACHE_ENTRIES / 2) // ...ou na hora, acima disto
+#define BCACHE_BYPASS_SECTORS   8       // Leituras maiores vao direto ao disco
+#define BCACHE_TXN_MAX          16      // Setores por transacao
+#define NO_ENTRY                0xFFFF
+
+// Estado do setor
+#define BC_EMPTY        0
+#define BC_CLEAN        1
+#define BC_DIRTY        2
+#define BC_WRITEBACK    3   // Copiado para a gravacao em curso (nao pode sair do cache)
+
+// Papel no journal (bits). Setores com TXN/COMMITTED/JOURNALING nao vao
+// para o seu lugar antes do journal estar na midia.
+#define BC_TXN          0x01    // Alterado pela transacao aberta
+#define BC_COMMITTED    0x02    // Transacao confirmada, ainda fora do journal
+#define BC_JOURNALING   0x04    // No journal sendo gravado
+#define BC_JOURNALED    0x08    // Ja no journal, falta gravar no lugar
+#define BC_PINNED       (BC_TXN | BC_COMMITTED | BC_JOURNALING)
+
+// Formato do journal: cabecalho (1 setor) + 'count' setores de dados
+#define JOURNAL_MAGIC       0x4C4E4A42 // "BJNL"
+#define JOURNAL_MAX_RECORDS ((SECTOR_SIZE - 4 * 4) / 4)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t count;
+    uint32_t checksum;  // Adler-32 das LBAs e dos dados
+    uint32_t lba[JOURNAL_MAX_RECORDS];
+} JournalHeader;
+
+typedef struct {
+    uint32_t lba;
+    uint8_t state;      // BC_*
+    uint8_t journal;    // Bits BC_TXN...BC_JOURNALED
+    uint16_t hash_next;
+    uint16_t lru_prev;  // Cabeca da LRU = usado mais recentemente
+    uint16_t lru_next;
+} BcacheEntry;
+
+static BcacheEntry entries[BCACHE_ENTRIES];
+static uint16_t hash_heads[BCACHE_HASH_SIZE];
+static uint16_t lru_head = NO_ENTRY;
+static uint16_t lru_tail = NO_ENTRY;
+static uint8_t *cache_data = 0;     // Setor i em cache_data + i * 512
+static uint8_t *staging = 0;        // Trecho (ou journal) sendo gravado
+static spinlock_t bcache_lock = SPINLOCK_INIT;
+static int bcache_ready = 0;
+
+static volatile uint32_t busy_count = 0;    // DIRTY + WRITEBACK (nao podem sair)
+
+// Lote do flusher: indices dos sujos em ordem de LBA e o trecho em voo
+static uint16_t batch[BCACHE_ENTRIES];
+static uint32_t batch_len = 0;
+static uint32_t batch_pos = 0;
+static uint16_t inflight[ATA_MAX_SECTORS_PER_CMD];
+static uint32_t inflight_count = 0;
+
+// Journal
+static uint32_t journal_lba = 0;
+static uint32_t journal_capacity = 0;   // 0 = sem journal
+static uint32_t journal_sequence = 1;
+static uint16_t committed[JOURNAL_MAX_RECORDS];
+static volatile uint32_t committed_count = 0;
+static uint32_t txn_count = 0;
+static uint16_t txn_slots[BCACHE_TXN_MAX];
+static volatile uint32_t journaled_dirty = 0;   // No journal, fora do lugar
+static volatile int checkpoint_pending = 0;     // Lugar gravado, falta a barreira
+static volatile int journal_busy = 0;           // Journal sendo gravado
+static volatile int txn_open = 0;
+static mutex_t txn_lock;
+
+// Flusher
+static async_event_t flusher_kick = ASYNC_EVENT_INIT;
+static async_event_t flusher_io_event = ASYNC_EVENT_INIT;
+static volatile int flusher_io_status = 0;
+static volatile int flusher_busy = 0;
+static int flusher_started = 0;
+static volatile uint32_t barrier_requested = 0;
+static volatile uint32_t barrier_done = 0;
+static volatile int barrier_status = 0;
+static wait_queue_t bcache_waiters; // Barreira, espaco livre e journal livre
+
+// Estatisticas
+static uint32_t stat_read_hits = 0;
+static uint32_t stat_read_misses = 0;
+static uint32_t stat_write_commands = 0;
+static uint32_t stat_sectors_written = 0;
+static uint32_t stat_journal_commits = 0;
+
+// =======================================================
+// 1. HASH E LRU (chamar com bcache_lock)
+// =======================================================
+
+static uint8_t* entry_data(uint16_t index) {
+    return cache_data + (uint32_t)index * SECTOR_SIZE;
+}
+
+static uint16_t lookup(uint32_t lba) {
+    uint16_t i = hash_heads[lba & (BCACHE_HASH_SIZE - 1)];
+    while (i != NO_ENTRY && entries[i].lba != lba) i = entries[i].hash_next;
+    return i;
+}
+
+static void hash_insert(uint16_t index) {
+    uint16_t *head = &hash_heads[entries[index].lba & (BCACHE_HASH_SIZE - 1)];
+    entries[index].hash_next = *head;
+    *head = index;
+}
+
+static void hash_remove(uint16_t index) {
+    uint16_t *link = &hash_heads[entries[index].lba & (BCACHE_HASH_SIZE - 1)];
+    while (*link != index) link = &entries[*link].hash_next;
+    *link = entries[index].hash_next;
+}
+
+static void lru_unlink(uint16_t index) {
+    BcacheEntry *e = &entries[index];
+    if (e->lru_prev != NO_ENTRY) entries[e->lru_prev].lru_next = e->lru_next;
+    else lru_head = e->lru_next;
+    if (e->lru_next != NO_ENTRY) entries[e->lru_next].lru_prev = e->lru_prev;
+    else lru_tail = e->lru_prev;
+}
+
+static void lru_touch(uint16_t index) {
+    if (lru_head == index) return;
+    lru_unlink(index);
+    entries[index].lru_prev = NO_ENTRY;
+    entries[index].lru_next = lru_head;
+    entries[lru_head].lru_prev = index;
+    lru_head = index;
+}
+
+/**
+ * Pega o setor limpo (ou vazio) usado ha mais tempo para guardar 'lba'.
+ * @return Indice da entrada, ou NO_ENTRY se todo o cache esta sujo.
+ */
+static uint16_t claim_entry(uint32_t lba) {
+    uint16_t i = lru_tail;
+    while (i != NO_ENTRY && (entries[i].state == BC_DIRTY || entries[i].state == BC_WRITEBACK)) {
+        i = entries[i].lru_prev;
+    }
+    if (i == NO_ENTRY) return NO_ENTRY;
+
+    if (entries[i].state != BC_EMPTY) hash_remove(i);
+    entries[i].lba = lba;
+    entries[i].state = BC_EMPTY;
+    entries[i].journal = 0;
+    hash_insert(i);
+    lru_touch(i);
+    return i;
+}
+
+// Marca sujo um setor que acabou de receber dados novos
+static void mark_dirty(uint16_t index) {
+    if (entries[index].state != BC_DIRTY && entries[index].state != BC_WRITEBACK) busy_count++;
+    entries[index].state = BC_DIRTY;
+}
+
+// =======================================================
+// 2. LOTES DO FLUSHER (preparo e fim de cada gravacao)
+// =======================================================
+
+static uint32_t journal_checksum(const JournalHeader *header, const uint8_t *records) {
+    uint32_t sum = adler32(ADLER32_INIT, (const uint8_t*)header->lba, header->count * 4);
+    return adler32(sum, records, header->count * SECTOR_SIZE);
+}
+
+/**
+ * Copia as transacoes confirmadas para o staging (cabecalho + setores).
+ * So roda quando a transacao anterior ja esta inteira no lugar e nenhuma
+ * outra esta aberta (assim um setor nunca esta em duas ao mesmo tempo).
+ * @return Setores a gravar em journal_lba, ou 0 se nao ha nada.
+ */
+static uint32_t journal_prepare() {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    if (committed_count == 0 || journaled_dirty > 0 || checkpoint_pending || txn_open) {
+        spin_unlock_irqrestore(&bcache_lock, flags);
+        return 0;
+    }
+
+    JournalHeader *header = (JournalHeader*)staging;
+    kmemset(header, 0, SECTOR_SIZE);
+    header->magic = JOURNAL_MAGIC;
+    header->sequence = journal_sequence;
+    header->count = committed_count;
+    for (uint32_t i = 0; i < committed_count; i++) {
+        uint16_t index = committed[i];
+        header->lba[i] = entries[index].lba;
+        kmemcpy(staging + (i + 1) * SECTOR_SIZE, entry_data(index), SECTOR_SIZE);
+        entries[index].journal = (uint8_t)((entries[index].journal & ~BC_COMMITTED) | BC_JOURNALING);
+    }
+    header->checksum = journal_checksum(header, staging + SECTOR_SIZE);
+    journal_busy = 1;
+    uint32_t sectors = committed_count + 1;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+    return sectors;
+}
+
+/**
+ * Fim da gravacao do journal (ja depois da barreira). Com sucesso, os setores
+ * viram sujos comuns e vao para o lugar no mesmo ciclo; com falha voltam a
+ * esperar o proximo ciclo.
+ */
+static void journal_complete(int ok) {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    for (uint32_t i = 0; i < committed_count; i++) {
+        BcacheEntry *e = &entries[committed[i]];
+        if (ok) {
+            e->journal = (uint8_t)((e->journal & ~BC_JOURNALING) | BC_JOURNALED);
+            journaled_dirty++;
+        } else {
+            e->journal = (uint8_t)((e->journal & ~BC_JOURNALING) | BC_COMMITTED);
+        }
+    }
+    if (ok) {
+        committed_count = 0;
+        journal_sequence++;
+        stat_journal_commits++;
+    }
+    journal_busy = 0;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+/**
+ * Cabecalho vazio no staging, para gravar sobre o journal ja aplicado. Sem
+ * isso, um desligamento depois do checkpoint reaplicaria na montagem uma
+ * transacao velha por cima de setores gravados depois dela.
+ */
+static void journal_prepare_invalidate() {
+    kmemset(staging, 0, SECTOR_SIZE);
+}
+
+/**
+ * Junta os setores sujos (fora de transacoes) em ordem de LBA.
+ */
+static void batch_collect() {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    batch_len = 0;
+    batch_pos = 0;
+    for (uint16_t i = 0; i < BCACHE_ENTRIES; i++) {
+        if (entries[i].state == BC_DIRTY && !(entries[i].journal & BC_PINNED)) batch[batch_len++] = i;
+    }
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    // Shell sort: o lote inteiro vira uma passada so pelo disco
+    for (uint32_t gap = batch_len / 2; gap > 0; gap /= 2) {
+        for (uint32_t i = gap; i < batch_len; i++) {
+            uint16_t value = batch[i];
+            uint32_t j = i;
+            while (j >= gap && entries[batch[j - gap]].lba > entries[value].lba) {
+                batch[j] = batch[j - gap];
+                j -= gap;
+            }
+            batch[j] = value;
+        }
+    }
+}
+
+/**
+ * Copia o proximo trecho contiguo do lote para o staging.
+ * @return Setores do trecho (gravar em '*lba'), ou 0 se o lote acabou.
+ */
+static uint32_t batch_next(uint32_t *lba) {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    inflight_count = 0;
+    while (batch_pos < batch_len && inflight_count < ATA_MAX_SECTORS_PER_CMD) {
+        uint16_t index = batch[batch_pos];
+        BcacheEntry *e = &entries[index];
+
+        // Mudou desde a coleta (gravado por outro caminho ou preso numa transacao)
+        if (e->state != BC_DIRTY || (e->journal & BC_PINNED)) {
+            batch_pos++;
+            if (inflight_count > 0) break;
+            continue;
+        }
+        if (inflight_count > 0 && e->lba != *lba + inflight_count) break;
+        if (inflight_count == 0) *lba = e->lba;
+
+        kmemcpy(staging + inflight_count * SECTOR_SIZE, entry_data(index), SECTOR_SIZE);
+        e->state = BC_WRITEBACK;
+        inflight[inflight_count++] = index;
+        batch_pos++;
+    }
+    uint32_t count = inflight_count;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+    return count;
+}
+
+static void batch_complete(int ok) {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    for (uint32_t i = 0; i < inflight_count; i++) {
+        BcacheEntry *e = &entries[inflight[i]];
+        if (e->state != BC_WRITEBACK) continue; // Gravado de novo durante a copia: segue sujo
+
+        if (!ok) {
+            e->state = BC_DIRTY;
+            continue;
+        }
+        e->state = BC_CLEAN;
+        busy_count--;
+        if (e->journal & BC_JOURNALED) {
+            e->journal &= (uint8_t)~BC_JOURNALED;
+            journaled_dirty--;
+            checkpoint_pending = 1;
+        }
+    }
+    if (ok) {
+        stat_write_commands++;
+        stat_sectors_written += inflight_count;
+    }
+    inflight_count = 0;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+}
+
+// =======================================================
+// 3. FLUSHER (tarefa assincrona) E CAMINHO SINCRONO
+// =======================================================
+
+typedef struct {
+    async_task_t task;
+    uint32_t lba;
+    uint32_t count;
+    uint32_t barrier;
+    int checkpoint;     // O ciclo tem setores do journal ja no lugar
+} FlusherFrame;
+
+static void flusher_io_done(async_task_t *io) {
+    flusher_io_status = io->status;
+    async_signal(&flusher_io_event);
+}
+
+// Dispara a E/S; se nem comecou, o evento ja fica sinalizado com erro
+static void flusher_submit(uint32_t lba, uint32_t count) {
+    flusher_io_status = -1;
+    async_event_reset(&flusher_io_event);
+    int started = count ? ata_write_sectors_async(lba, count, staging, flusher_io_done, 0)
+                        : ata_flush_cache_async(flusher_io_done, 0);
+    if (started != 0) async_signal(&flusher_io_event);
+}
+
+/**
+ * O journal so pode ser apagado quando TODOS os seus setores estao no lugar:
+ * um trecho que falhou (ou foi sujo de novo durante a gravacao) ainda depende
+ * dele para sobreviver a um desligamento. Ate la, checkpoint_pending fica.
+ */
+static int checkpoint_ready() {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    int ready = checkpoint_pending && journaled_dirty == 0;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+    return ready;
+}
+
+// Fim de um ciclo com barreira: libera o journal (se foi apagado) e responde quem pediu 'barrier'
+static void flusher_barrier_done(uint32_t barrier, int status, int checkpointed) {
+    if (status == 0 && checkpointed) checkpoint_pending = 0;
+    barrier_status = status;
+    barrier_done = barrier;
+}
+
+static void flusher_idle() {
+    flusher_busy = 0;
+    wait_queue_wake_all(&bcache_waiters);
+}
+
+/**
+ * Um ciclo: journal -> barreira -> setores no lugar (em ordem de LBA) ->
+ * barreira (se alguem pediu ou se o journal precisa ser liberado).
+ */
+static int bcache_flusher_task(async_task_t *t) {
+    FlusherFrame *f = (FlusherFrame*)t;
+    ASYNC_BEGIN(t);
+
+    for (;;) {
+        ASYNC_AWAIT(t, &flusher_kick, BCACHE_FLUSH_TICKS);
+        if (flusher_busy) continue; // Caminho sincrono em andamento
+        flusher_busy = 1;
+        f->barrier = barrier_requested;
+
+        // 1. Journal: uma gravacao sequencial e a barreira antes de tocar no lugar
+        f->count = journal_prepare();
+        if (f->count) {
+            flusher_submit(journal_lba, f->count);
+            ASYNC_AWAIT(t, &flusher_io_event, 0);
+            if (flusher_io_status == 0) {
+                flusher_submit(0, 0);
+                ASYNC_AWAIT(t, &flusher_io_event, 0);
+            }
+            journal_complete(flusher_io_status == 0);
+        }
+
+        // 2. Setores sujos em ordem de LBA, um comando por trecho contiguo
+        batch_collect();
+        while ((f->count = batch_next(&f->lba)) > 0) {
+            flusher_submit(f->lba, f->count);
+            ASYNC_AWAIT(t, &flusher_io_event, 0);
+            batch_complete(flusher_io_status == 0);
+            wait_queue_wake_all(&bcache_waiters); // Quem esperava espaco livre
+        }
+
+        // 3. Barreira final; num checkpoint, depois dela o journal e apagado
+        //    (e outra barreira, antes de qualquer gravacao no lugar seguinte)
+        f->checkpoint = checkpoint_ready();
+        if (f->barrier != barrier_done || f->checkpoint) {
+            flusher_submit(0, 0);
+            ASYNC_AWAIT(t, &flusher_io_event, 0);
+            if (flusher_io_status == 0 && f->checkpoint) {
+                journal_prepare_invalidate();
+                flusher_submit(journal_lba, 1);
+                ASYNC_AWAIT(t, &flusher_io_event, 0);
+                if (flusher_io_status == 0) {
+                    flusher_submit(0, 0);
+                    ASYNC_AWAIT(t, &flusher_io_event, 0);
+                }
+            }
+            flusher_barrier_done(f->barrier, flusher_io_status, f->checkpoint);
+        }
+        flusher_idle();
+    }
+
+    ASYNC_END(t);
+}
+
+/**
+ * O mesmo ciclo, com E/S bloqueante. Usado no boot (sem agendador) e por
+ * processos que nao podem dormir esperando o flusher. Dentro de uma tarefa
+ * assincrona nao faz E/S bloqueante (travaria o executor): so acorda o
+ * flusher e falha, para quem chamou tentar de novo depois.
+ * @return 0 se tudo chegou a midia, -1 em caso de falha ou adiamento.
+ */
+static int bcache_flush_sync() {
+    if (async_in_task()) {
+        async_signal(&flusher_kick);
+        return -1;
+    }
+
+    uint32_t flags = irq_save();
+    if (flusher_busy) {
+        irq_restore(flags);
+        return -1;
+    }
+    flusher_busy = 1;
+    irq_restore(flags);
+
+    int result = 0;
+    uint32_t barrier = barrier_requested;
+    uint32_t count, lba;
+
+    count = journal_prepare();
+    if (count) {
+        int ok = ata_write_sectors(journal_lba, count, staging) == 0 && ata_flush_cache() == 0;
+        journal_complete(ok);
+        if (!ok) result = -1;
+    }
+
+    batch_collect();
+    while ((count = batch_next(&lba)) > 0) {
+        int ok = ata_write_sectors(lba, count, staging) == 0;
+        batch_complete(ok);
+        if (!ok) result = -1;
+    }
+
+    int checkpoint = checkpoint_ready();
+    if (ata_flush_cache() != 0) {
+        result = -1;
+    } else if (checkpoint) {
+        journal_prepare_invalidate();
+        if (ata_write_sectors(journal_lba, 1, staging) != 0 || ata_flush_cache() != 0) result = -1;
+    }
+    flusher_barrier_done(barrier, result, checkpoint);
+    flusher_idle();
+    return result;
+}
+
+// Da para dormir esperando o flusher? Nao dentro de uma tarefa assincrona:
+// o flusher roda no mesmo executor e nunca acordaria quem espera.
+static int bcache_can_sleep() {
+    return flusher_started && scheduler_can_block() && !async_in_task();
+}
+
+// Acorda o flusher e, se der para dormir, espera 'condition'; senao faz o ciclo aqui
+// (dentro de uma tarefa so acorda o flusher e falha se 'condition' ainda nao vale)
+#define bcache_wait_for(condition)                              \
+    do {                                                        \
+        if (bcache_can_sleep()) {                               \
+            async_signal(&flusher_kick);                        \
+            wait_event(&bcache_waiters, (condition));           \
+        } else if (bcache_flush_sync() != 0 && !(condition)) {  \
+            return -1;                                          \
+        }                                                       \
+    } while (0)
+
+// =======================================================
+// 4. API
+// =======================================================
+
+/**
+ * Le 'count' setores. Leituras grandes vao direto ao disco (um extent
+ * inteiro nao deve expulsar o cache) e depois recebem por cima as versoes
+ * mais novas que estiverem no cache.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int bcache_read(uint32_t lba, uint32_t count, uint8_t *buffer) {
+    if (!bcache_ready) return ata_read_sectors(lba, count, buffer);
+
+    if (count > BCACHE_BYPASS_SECTORS) {
+        for (uint32_t done = 0; done < count; ) {
+            uint32_t chunk = count - done < ATA_MAX_SECTORS_PER_CMD ? count - done : ATA_MAX_SECTORS_PER_CMD;
+            if (ata_read_sectors(lba + done, chunk, buffer + done * SECTOR_SIZE) != 0) return -1;
+            done += chunk;
+        }
+
+        uint32_t flags = spin_lock_irqsave(&bcache_lock);
+        for (uint32_t i = 0; i < count; i++) {
+            uint16_t index = lookup(lba + i);
+            if (index != NO_ENTRY && entries[index].state != BC_EMPTY) {
+                kmemcpy(buffer + i * SECTOR_SIZE, entry_data(index), SECTOR_SIZE);
+            }
+        }
+        spin_unlock_irqrestore(&bcache_lock, flags);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t *dest = buffer + i * SECTOR_SIZE;
+        uint32_t flags = spin_lock_irqsave(&bcache_lock);
+        uint16_t index = lookup(lba + i);
+        if (index != NO_ENTRY && entries[index].state != BC_EMPTY) {
+            kmemcpy(dest, entry_data(index), SECTOR_SIZE);
+            lru_touch(index);
+            stat_read_hits++;
+            spin_unlock_irqrestore(&bcache_lock, flags);
+            continue;
+        }
+        spin_unlock_irqrestore(&bcache_lock, flags);
+
+        // Falta: le fora da trava e guarda, a menos que alguem tenha gravado nesse meio tempo
+        if (ata_read_sectors(lba + i, 1, dest) != 0) return -1;
+        flags = spin_lock_irqsave(&bcache_lock);
+        stat_read_misses++;
+        index = lookup(lba + i);
+        if (index != NO_ENTRY && entries[index].state != BC_EMPTY) {
+            kmemcpy(dest, entry_data(index), SECTOR_SIZE);
+        } else {
+            if (index == NO_ENTRY) index = claim_entry(lba + i);
+            if (index != NO_ENTRY) {
+                kmemcpy(entry_data(index), dest, SECTOR_SIZE);
+                entries[index].state = BC_CLEAN;
+            }
+        }
+        spin_unlock_irqrestore(&bcache_lock, flags);
+    }
+    return 0;
+}
+
+// Guarda um setor no cache e devolve a entrada (com bcache_lock), ou NO_ENTRY se esta cheio
+static uint16_t store_sector(uint32_t lba, const uint8_t *data, uint32_t *flags) {
+    *flags = spin_lock_irqsave(&bcache_lock);
+    uint16_t index = lookup(lba);
+    if (index == NO_ENTRY) index = claim_entry(lba);
+    if (index == NO_ENTRY) {
+        spin_unlock_irqrestore(&bcache_lock, *flags);
+        return NO_ENTRY;
+    }
+    kmemcpy(entry_data(index), data, SECTOR_SIZE);
+    lru_touch(index);
+    mark_dirty(index);
+    return index;
+}
+
+/**
+ * Grava 'count' setores no cache (write-back): volta sem esperar o disco.
+ * So espera se o cache inteiro estiver sujo.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int bcache_write(uint32_t lba, uint32_t count, const uint8_t *buffer) {
+    if (!bcache_ready) return ata_write_sectors(lba, count, buffer);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t flags;
+        while (store_sector(lba + i, buffer + i * SECTOR_SIZE, &flags) == NO_ENTRY) {
+            bcache_wait_for(busy_count < BCACHE_ENTRIES);
+        }
+        spin_unlock_irqrestore(&bcache_lock, flags);
+    }
+
+    if (busy_count >= BCACHE_DIRTY_HIGH) async_signal(&flusher_kick);
+    return 0;
+}
+
+/**
+ * Barreira de durabilidade: volta quando tudo que foi gravado (e confirmado
+ * em transacoes) antes da chamada esta na midia. Dentro de uma tarefa
+ * assincrona nao espera: pede a barreira ao flusher e falha.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+int bcache_sync() {
+    if (!bcache_ready) return ata_flush_cache();
+
+    if (bcache_can_sleep()) {
+        uint32_t flags = irq_save();
+        uint32_t ticket = ++barrier_requested;
+        irq_restore(flags);
+
+        async_signal(&flusher_kick);
+        wait_event(&bcache_waiters, (int32_t)(barrier_done - ticket) >= 0);
+        return barrier_status;
+    }
+
+    barrier_requested++;
+    return bcache_flush_sync();
+}
+
+/**
+ * Abre uma transacao de metadados (uma por vez). Espera so se o journal
+ * ainda estiver sendo aplicado ou nao couber mais uma transacao. Dentro de
+ * uma tarefa assincrona nao espera: falha se outra transacao estiver aberta.
+ * @return 0 em caso de sucesso, -1 em caso de falha.
+ */
+static int txn_can_start() {
+    return !journal_busy && journaled_dirty == 0 && !checkpoint_pending &&
+           (journal_capacity == 0 || committed_count + BCACHE_TXN_MAX <= journal_capacity);
+}
+
+int bcache_txn_begin() {
+    if (!bcache_ready) return -1;
+    if (async_in_task()) {
+        if (!mutex_trylock(&txn_lock)) return -1;
+    } else {
+        mutex_lock(&txn_lock);
+    }
+    while (!txn_can_start()) {
+        if (bcache_can_sleep()) {
+            async_signal(&flusher_kick);
+            wait_event(&bcache_waiters, txn_can_start());
+        } else if (bcache_flush_sync() != 0) {
+            mutex_unlock(&txn_lock);
+            return -1;
+        }
+    }
+    txn_count = 0;
+    txn_open = 1;
+    return 0;
+}
+
+/**
+ * Grava um setor de metadado dentro da transacao aberta.
+ * @return 0 em caso de sucesso, -1 se a transacao passou de BCACHE_TXN_MAX setores.
+ */
+int bcache_txn_write(uint32_t lba, const uint8_t *sector) {
+    uint32_t flags;
+    uint16_t index;
+    while ((index = store_sector(lba, sector, &flags)) == NO_ENTRY) {
+        bcache_wait_for(busy_count < BCACHE_ENTRIES);
+    }
+
+    int result = 0;
+    if (!(entries[index].journal & BC_TXN)) {
+        if (txn_count == BCACHE_TXN_MAX) {
+            result = -1;
+        } else {
+            entries[index].journal |= BC_TXN;
+            txn_slots[txn_count++] = index;
+        }
+    }
+    spin_unlock_irqrestore(&bcache_lock, flags);
+    return result;
+}
+
+/**
+ * Confirma a transacao: os setores passam para o proximo journal do flusher.
+ * Nao espera o disco (use bcache_sync() para durabilidade imediata).
+ */
+void bcache_txn_commit() {
+    uint32_t flags = spin_lock_irqsave(&bcache_lock);
+    for (uint32_t i = 0; i < txn_count; i++) {
+        uint16_t index = txn_slots[i];
+        entries[index].journal &= (uint8_t)~BC_TXN;
+        if (journal_capacity == 0) continue; // Volume sem journal: vira sujo comum
+        if (!(entries[index].journal & BC_COMMITTED)) {
+            entries[index].journal |= BC_COMMITTED;
+            committed[committed_count++] = index;
+        }
+    }
+    txn_count = 0;
+    txn_open = 0;
+    spin_unlock_irqrestore(&bcache_lock, flags);
+
+    mutex_unlock(&txn_lock);
+    async_signal(&flusher_kick);
+}
+
+/**
+ * Liga o journal de um volume e refaz a ultima transacao, se ela estiver
+ * inteira no disco. Chamar na montagem, antes de qualquer transacao.
+ * @return 0 em caso de sucesso, -1 se a reaplicacao falhou.
+ */
+int bcache_attach_journal(uint32_t lba, uint32_t sectors) {
+    if (!bcache_ready || sectors < 2) return 0;
+
+    journal_lba = lba;
+    journal_capacity = sectors - 1;
+    if (journal_capacity > JOURNAL_MAX_RECORDS) journal_capacity = JOURNAL_MAX_RECORDS;
+    if (journal_capacity < BCACHE_TXN_MAX) journal_capacity = 0;
+
+    JournalHeader *header = (JournalHeader*)staging;
+    if (ata_read_sectors(lba, 1, staging) != 0) return -1;
+    if (header->magic != JOURNAL_MAGIC || header->count == 0 || header->count > journal_capacity) return 0;
+    if (ata_read_sectors(lba + 1, header->count, staging + SECTOR_SIZE) != 0) return -1;
+    if (journal_checksum(header, staging + SECTOR_SIZE) != header->checksum) return 0; // Gravacao cortada
+
+    // Reaplica: cada setor no lugar (e no cache, se estiver la)
+    for (uint32_t i = 0; i < header->count; i++) {
+        const uint8_t *record = staging + (i + 1) * SECTOR_SIZE;
+        if (ata_write_sectors(header->lba[i], 1, record) != 0) return -1;
+
+        uint32_t flags = spin_lock_irqsave(&bcache_lock);
+        uint16_t index = lookup(header->lba[i]);
+        if (index != NO_ENTRY && entries[index].state == BC_CLEAN) {
+            kmemcpy(entry_data(index), record, SECTOR_SIZE);
+        }
+        spin_unlock_irqrestore(&bcache_lock, flags);
+    }
+    if (ata_flush_cache() != 0) return -1;
+
+    // Ja aplicada: apaga o cabecalho para nao refazer a cada boot
+    journal_sequence = header->sequence + 1;
+    kmemset(staging, 0, SECTOR_SIZE);
+    if (ata_write_sectors(lba, 1, staging) != 0 || ata_flush_cache() != 0) return -1;
+    ui_log_status("BCACHE: Journal reaplicado apos desligamento inesperado.", 0x0E);
+    return 0;
+}
+
+/**
+ * Inicializa o cache e o flusher. Chamar depois de init_async() e
+ * init_ata_driver(); antes disso bcache_* vai direto ao disco.
+ */
+void init_block_cache() {
+    cache_data = (uint8_t*)alloc_pages(BCACHE_DATA_ORDER);
+    staging = (uint8_t*)alloc_pages(BCACHE_STAGING_ORDER);
+    if (!cache_data || !staging) {
+        ui_log_status("BCACHE ERRO: Sem memoria, gravacoes vao direto ao disco.", 0x0C);
+        return;
+    }
+
+    for (int i = 0; i < BCACHE_HASH_SIZE; i++) hash_heads[i] = NO_ENTRY;
+    for (uint16_t i = 0; i < BCACHE_ENTRIES; i++) {
+        entries[i].state = BC_EMPTY;
+        entries[i].journal = 0;
+        entries[i].hash_next = NO_ENTRY;
+        entries[i].lru_prev = i == 0 ? NO_ENTRY : (uint16_t)(i - 1);
+        entries[i].lru_next = i == BCACHE_ENTRIES - 1 ? NO_ENTRY : (uint16_t)(i + 1);
+    }
+    lru_head = 0;
+    lru_tail = BCACHE_ENTRIES - 1;
+    wait_queue_init(&bcache_waiters);
+    mutex_init(&txn_lock);
+    bcache_ready = 1;
+
+    async_task_t *flusher = async_alloc(bcache_flusher_task, sizeof(FlusherFrame));
+    if (flusher) {
+        async_start(flusher);
+        flusher_started = 1;
+    }
+    ui_log_status("BCACHE: Cache de blocos write-back ativo.", 0x0A);
+}
+
+// =======================================================
+// 5. BENCHMARK (vazao de gravacao com e sem write-back)
+// =======================================================
+
+#define BCACHE_BENCH_WRITES 512     // Setores gravados por teste (256KB)
+#define BCACHE_BENCH_SPAN   4096    // Janela dos testes aleatorios (2MB)
+
+static uint8_t bench_sector[SECTOR_SIZE];
+static uint32_t bench_seed;
+
+static uint32_t bench_random() {
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return bench_seed >> 8;
+}
+
+/**
+ * Grava BCACHE_BENCH_WRITES setores de um em um, em sequencia ou em LBAs
+ * aleatorias, e termina com uma barreira (o tempo inclui chegar a midia).
+ * @return KB/s, ou 0 em caso de falha.
+ */
+static uint32_t bench_writes(uint32_t base, int random, int write_back) {
+    bench_seed = 2024;
+    uint64_t start = read_tsc();
+    for (uint32_t i = 0; i < BCACHE_BENCH_WRITES; i++) {
+        uint32_t lba = base + (random ? bench_random() % BCACHE_BENCH_SPAN : i);
+        bench_sector[0] = (uint8_t)i;
+        int result = write_back ? bcache_write(lba, 1, bench_sector) : ata_write_sectors(lba, 1, bench_sector);
+        if (result != 0) return 0;
+    }
+    if ((write_back ? bcache_sync() : ata_flush_cache()) != 0) return 0;
+
+    uint64_t ns = tsc_cycles_to_ns(read_tsc() - start);
+    if (ns == 0) return 0;
+    return (uint32_t)((uint64_t)BCACHE_BENCH_WRITES * (SECTOR_SIZE / 2) * 1000000ull / (ns / 1000 + 1));
+}
+
+/**
+ * Mede a vazao de gravacao sequencial e aleatoria com write-through (um
+ * comando por setor) e com write-back (lotes em ordem de LBA). Usa o espaco
+ * livre do BlipFS (depois de next_free_lba), que nenhum arquivo ocupa.
+ */
+void bcache_run_benchmark(int row) {
+    char buffer[12];
+    BlipfsSuperblock *super = (BlipfsSuperblock*)bench_sector;
+
+    ui_draw_string("== BCACHE: vazao de gravacao (KB/s) ==", row, 0, 0x0E);
+    if (!bcache_ready || ata_read_sectors(BLIPFS_SUPER_LBA, 1, bench_sector) != 0 ||
+        super->magic != BLIPFS_MAGIC || super->total_sectors < super->next_free_lba + BCACHE_BENCH_SPAN) {
+        ui_draw_string("Sem cache ou sem espaco livre no BlipFS.", row + 1, 0, 0x0C);
+        return;
+    }
+    uint32_t base = super->next_free_lba;
+
+    ui_draw_string("Write-through", row + 1, 16, 0x0B);
+    ui_draw_string("Write-back", row + 1, 32, 0x0B);
+
+    const char *labels[2] = { "Sequencial", "Aleatoria" };
+    for (int random = 0; random < 2; random++) {
+        ui_draw_string(labels[random], row + 2 + random, 0, 0x0B);
+        ui_draw_string(u32_to_str(bench_writes(base, random, 0), buffer, 12), row + 2 + random, 16, 0x0F);
+        ui_draw_string(u32_to_str(bench_writes(base, random, 1), buffer, 12), row + 2 + random, 32, 0x0A);
+    }
+
+    ui_draw_string("Comandos/setores gravados", row + 4, 0, 0x0B);
+    ui_draw_string(u32_to_str(stat_write_commands, buffer, 12), row + 4, 28, 0x0F);
+    ui_draw_string(u32_to_str(stat_sectors_written, buffer, 12), row + 4, 38, 0x0F);
+    ui_draw_string("Leituras acerto/falta", row + 5, 0, 0x0B);
+    ui_draw_string(u32_to_str(stat_read_hits, buffer, 12), row + 5, 28, 0x0F);
+    ui_draw_string(u32_to_str(stat_read_misses, buffer, 12), row + 5, 38, 0x0F);
+    ui_draw_string("Commits do journal", row + 6, 0, 0x0B);
+    ui_draw_string(u32_to_str(stat_journal_commits, buffer, 12), row + 6, 28, 0x0F);
+}
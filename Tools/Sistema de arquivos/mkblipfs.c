@@ -0,0 +1,168 @@
+// mkblipfs.c - Gera imagens de disco BlipFS no HOST (para testes no QEMU).
+//
+// Compilar:  cc -O2 -o mkblipfs mkblipfs.c
+// Usar:      ./mkblipfs disco.img <tamanho_mb> [-b boot.bin] arquivo[=NOME] ...
+//            qemu-system-i386 ... -drive file=disco.img,format=raw,if=ide
+//
+// Cada arquivo recebe um unico extent contiguo. NOME e o caminho usado pelo
+// Kernel (ex: APP_TEST); se omitido, usa o nome base do arquivo.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blipfs_format.h"
+
+#define MKBLIPFS_INODE_COUNT    256
+#define MKBLIPFS_DIR_BUCKETS    64
+#define MKBLIPFS_JOURNAL_SECTORS 128
+
+static uint8_t *image;
+static BlipfsSuperblock *sb;
+
+static uint8_t *sector_at(uint32_t lba) {
+    return image + (size_t)lba * BLIPFS_SECTOR_SIZE;
+}
+
+static int add_dirent(const char *name, uint32_t inode) {
+    uint32_t hash = blipfs_hash(name);
+    uint32_t bucket = hash & (sb->dir_buckets - 1);
+
+    for (uint32_t probe = 0; probe < sb->dir_buckets; probe++) {
+        BlipfsDirent *entries =
+            (BlipfsDirent *)sector_at(sb->dir_lba + ((bucket + probe) & (sb->dir_buckets - 1)));
+        for (uint32_t i = 0; i < BLIPFS_DIRENTS_PER_SECTOR; i++) {
+            if (entries[i].hash == hash && strcmp(entries[i].name, name) == 0) {
+                fprintf(stderr, "mkblipfs: nome duplicado: %s\n", name);
+                return -1;
+            }
+            if (entries[i].hash == 0) {
+                entries[i].hash = hash;
+                entries[i].inode = inode;
+                strncpy(entries[i].name, name, BLIPFS_NAME_MAX);
+                return 0;
+            }
+        }
+    }
+    fprintf(stderr, "mkblipfs: diretorio cheio\n");
+    return -1;
+}
+
+static int add_file(const char *spec, uint32_t inode_number) {
+    char host_path[1024];
+    const char *name;
+
+    // "caminho_no_host=NOME" ou apenas "caminho_no_host"
+    const char *eq = strchr(spec, '=');
+    if (eq) {
+        snprintf(host_path, sizeof(host_path), "%.*s", (int)(eq - spec), spec);
+        name = eq + 1;
+    } else {
+        snprintf(host_path, sizeof(host_path), "%s", spec);
+        const char *slash = strrchr(spec, '/');
+        name = slash ? slash + 1 : spec;
+    }
+    if (strlen(name) == 0 || strlen(name) > BLIPFS_NAME_MAX) {
+        fprintf(stderr, "mkblipfs: nome invalido: '%s'\n", name);
+        return -1;
+    }
+
+    FILE *f = fopen(host_path, "rb");
+    if (!f) {
+        perror(host_path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint32_t sectors = (uint32_t)((size + BLIPFS_SECTOR_SIZE - 1) / BLIPFS_SECTOR_SIZE);
+    if (sb->next_free_lba + sectors > sb->total_sectors) {
+        fprintf(stderr, "mkblipfs: sem espaco para %s\n", host_path);
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t start = sb->next_free_lba;
+    if (size > 0 && fread(sector_at(start), 1, (size_t)size, f) != (size_t)size) {
+        perror(host_path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    sb->next_free_lba += sectors;
+
+    BlipfsInode *table = (BlipfsInode *)sector_at(sb->inode_table_lba);
+    BlipfsInode *inode = &table[inode_number];
+    inode->size = (uint32_t)size;
+    inode->type = BLIPFS_INODE_FILE;
+    inode->extent_count = sectors ? 1 : 0;
+    inode->extents[0].start_lba = start;
+    inode->extents[0].sector_count = sectors;
+
+    printf("  %-24s %8ld bytes  inode %3u  LBA %u+%u\n", name, size, inode_number, start, sectors);
+    return add_dirent(name, inode_number);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "uso: %s disco.img <tamanho_mb> [-b boot.bin] arquivo[=NOME] ...\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t total_sectors = (uint32_t)atoi(argv[2]) * 2048u;
+    uint32_t inode_sectors = MKBLIPFS_INODE_COUNT / BLIPFS_INODES_PER_SECTOR;
+    if (total_sectors < 2 + inode_sectors + MKBLIPFS_DIR_BUCKETS + MKBLIPFS_JOURNAL_SECTORS + 1) {
+        fprintf(stderr, "mkblipfs: imagem pequena demais\n");
+        return 1;
+    }
+
+    image = calloc(total_sectors, BLIPFS_SECTOR_SIZE);
+    if (!image) {
+        perror("calloc");
+        return 1;
+    }
+
+    sb = (BlipfsSuperblock *)sector_at(BLIPFS_SUPER_LBA);
+    sb->magic = BLIPFS_MAGIC;
+    sb->version = BLIPFS_VERSION;
+    sb->total_sectors = total_sectors;
+    sb->inode_table_lba = BLIPFS_SUPER_LBA + 1;
+    sb->inode_count = MKBLIPFS_INODE_COUNT;
+    sb->dir_lba = sb->inode_table_lba + inode_sectors;
+    sb->dir_buckets = MKBLIPFS_DIR_BUCKETS;
+    sb->journal_lba = sb->dir_lba + MKBLIPFS_DIR_BUCKETS;
+    sb->journal_sectors = MKBLIPFS_JOURNAL_SECTORS; // Zerado = journal vazio
+    sb->data_lba = sb->journal_lba + MKBLIPFS_JOURNAL_SECTORS;
+    sb->next_free_lba = sb->data_lba;
+
+    uint32_t next_inode = 0;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            // Setor de boot opcional (copiado para o LBA 0)
+            FILE *f = fopen(argv[++i], "rb");
+            if (!f || fread(sector_at(0), 1, BLIPFS_SECTOR_SIZE, f) == 0) {
+                perror(argv[i]);
+                return 1;
+            }
+            fclose(f);
+            continue;
+        }
+        if (next_inode == MKBLIPFS_INODE_COUNT) {
+            fprintf(stderr, "mkblipfs: tabela de inodes cheia\n");
+            return 1;
+        }
+        if (add_file(argv[i], next_inode++) != 0) return 1;
+    }
+
+    FILE *out = fopen(argv[1], "wb");
+    if (!out || fwrite(image, BLIPFS_SECTOR_SIZE, total_sectors, out) != total_sectors) {
+        perror(argv[1]);
+        return 1;
+    }
+    fclose(out);
+
+    printf("%s: %u setores, %u arquivos, dados em LBA %u..%u\n", argv[1], total_sectors,
+           next_inode, sb->data_lba, sb->next_free_lba);
+    return 0;
+}
@@ -0,0 +1,734 @@
+// framebuffer.c - Backend grafico da UI sobre um framebuffer linear (VBE/Multiboot).
+//
+// O modo de video vem do bootloader (campos de framebuffer do Multiboot, ou o
+// bloco VBE), ou, sem nenhum dos dois, e programado direto no adaptador
+// Bochs/QEMU std VGA. So 32 bits por pixel sao suportados.
+//
+// Desenho:
+//   - A fonte 8x8 e expandida uma vez por atributo (cor de frente + fundo) em
+//     sprites 8x16 de pixels prontos. Desenhar um caractere vira copiar 16
+//     linhas de 32 bytes (2 registradores SSE por linha), sem testar bits.
+//   - Tudo e desenhado num back buffer em RAM. As regioes tocadas (damage)
+//     sao copiadas para o framebuffer por fb_present(), chamada a cada
+//     FB_PRESENT_TICKS por uma tarefa assincrona (e na hora pelo ui_log_status).
+
+#include <stdint.h>
+#include "framebuffer.h"
+#include "../CPU/fpu_context.h"
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Lib/kmemory.h"
+#include "../../Kernel/Lib/kformat.h"
+#include "../../Kernel/Lib/pci.h"
+#include "../../Kernel/Async/async.h"
+
+extern const uint8_t font8x8_basic[96][8]; // Do font8x8.c
+
+extern uint32_t alloc_pages(int order);
+extern void outw(uint16_t port, uint16_t value);
+extern uint16_t inw(uint16_t port);
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern uint32_t tsc_get_khz();                      // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles);  // Do cpu_diag.c
+extern void ui_log_status(const char *status_msg, char color_byte);
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+extern int hibernate_register_resume(void (*fn)()); // Do hibernate.c
+extern void vc_refresh();                           // Do virtual_console.c
+
+#define PAGE_SIZE           4096
+#define MAX_PAGE_ORDER      10      // Maior bloco do buddy: 4MB
+
+// Campos da estrutura Multiboot (deslocamentos em bytes)
+#define MB_FLAG_VBE         (1 << 11)
+#define MB_FLAG_FRAMEBUFFER (1 << 12)
+#define MB_VBE_MODE_INFO    76
+#define MB_FB_ADDR          88
+#define MB_FB_PITCH         96
+#define MB_FB_WIDTH         100
+#define MB_FB_HEIGHT        104
+#define MB_FB_BPP           108
+#define MB_FB_TYPE          109
+#define MB_FB_COLOR_INFO    110     // red pos/size, green pos/size, blue pos/size
+#define MB_FB_TYPE_RGB      1
+
+// Bloco de informacao do modo VBE
+#define VBE_PITCH           16
+#define VBE_WIDTH           18
+#define VBE_HEIGHT          20
+#define VBE_BPP             25
+#define VBE_COLOR_INFO      31      // red size/pos, green size/pos, blue size/pos
+#define VBE_LFB_ADDR        40
+
+// Adaptador Bochs/QEMU std VGA (extensoes "DISPI")
+#define DISPI_INDEX_PORT    0x01CE
+#define DISPI_DATA_PORT     0x01CF
+#define DISPI_INDEX_ID      0
+#define DISPI_INDEX_XRES    1
+#define DISPI_INDEX_YRES    2
+#define DISPI_INDEX_BPP     3
+#define DISPI_INDEX_ENABLE  4
+#define DISPI_ID_MIN        0xB0C0
+#define DISPI_ENABLED       0x01
+#define DISPI_LFB_ENABLED   0x40
+#define BOCHS_VGA_VENDOR    0x1234
+#define BOCHS_VGA_DEVICE    0x1111
+#define DEFAULT_WIDTH       1024
+#define DEFAULT_HEIGHT      768
+
+// Cache de sprites
+#define FB_GLYPH_FIRST      0x20
+#define FB_GLYPH_COUNT      96
+#define FB_GLYPH_MISSING    0x7F    // Caixa para caracteres fora da fonte
+#define FB_SPRITE_PIXELS    (FB_CELL_W * FB_CELL_H)
+#define FB_CACHE_SLOTS      16      // Atributos com sprites prontos ao mesmo tempo
+#define FB_SLOT_ORDER       4       // 64KB por atributo (96 sprites de 512 bytes)
+#define NO_SLOT             0xFF
+
+#define FB_SSE_MIN_GLYPHS   8       // Menos que isso: o kernel_fpu_begin/end custa mais que o SSE poupa
+#define FB_MAX_DAMAGE       8
+#define FB_PRESENT_TICKS    2       // 50 quadros por segundo com o timer a 100Hz
+
+typedef struct {
+    uint32_t pixels;    // Pagina(s) com os 96 sprites, 0 = ainda nao alocado
+    uint32_t last_use;
+    uint8_t attr;
+    uint8_t valid;
+} GlyphSlot;
+
+// Retangulo em celulas, fim exclusivo
+typedef struct {
+    uint16_t row0, col0, row1, col1;
+} DamageRect;
+
+static uint32_t *fb_front = 0;      // Framebuffer linear
+static uint32_t *fb_back = 0;       // Back buffer (== fb_front se nao houve memoria)
+static uint32_t fb_front_pitch = 0; // Bytes por linha
+static uint32_t fb_back_pitch = 0;
+static uint32_t fb_width = 0;
+static uint32_t fb_height = 0;
+static int fb_grid_rows = 0;
+static int fb_grid_cols = 0;
+static int fb_sse = 0;
+
+static uint32_t fb_palette[16];     // Cores VGA ja no formato de pixel do modo
+
+static GlyphSlot glyph_slots[FB_CACHE_SLOTS];
+static uint8_t attr_slot[256];
+static uint32_t cache_clock = 0;
+
+static DamageRect damage[FB_MAX_DAMAGE];
+static int damage_count = 0;
+
+// As 16 cores do modo texto (0xRRGGBB)
+static const uint32_t vga_colors[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+// =======================================================
+// 1. DESCOBERTA DO MODO DE VIDEO
+// =======================================================
+
+// Monta a paleta a partir da posicao/tamanho de cada componente no pixel
+static void build_palette(uint8_t r_pos, uint8_t r_size, uint8_t g_pos, uint8_t g_size,
+                          uint8_t b_pos, uint8_t b_size) {
+    for (int i = 0; i < 16; i++) {
+        uint32_t r = (vga_colors[i] >> 16) & 0xFF;
+        uint32_t g = (vga_colors[i] >> 8) & 0xFF;
+        uint32_t b = vga_colors[i] & 0xFF;
+        fb_palette[i] = ((r >> (8 - r_size)) << r_pos) |
+                        ((g >> (8 - g_size)) << g_pos) |
+                        ((b >> (8 - b_size)) << b_pos);
+    }
+}
+
+static uint16_t dispi_read(uint16_t index) {
+    outw(DISPI_INDEX_PORT, index);
+    return inw(DISPI_DATA_PORT);
+}
+
+static void dispi_write(uint16_t index, uint16_t value) {
+    outw(DISPI_INDEX_PORT, index);
+    outw(DISPI_DATA_PORT, value);
+}
+
+/**
+ * Sem modo do bootloader: procura o std VGA do QEMU/Bochs no barramento 0 e
+ * liga 1024x768x32 com o framebuffer linear (BAR0).
+ * @return Endereco do framebuffer, ou 0 se o adaptador nao existe.
+ */
+static uint32_t dispi_set_mode(uint32_t width, uint32_t height) {
+    if (dispi_read(DISPI_INDEX_ID) < DISPI_ID_MIN) return 0;
+
+    uint32_t lfb = 0;
+    for (uint8_t slot = 0; slot < 32 && !lfb; slot++) {
+        uint32_t id = pci_read32(slot, 0, 0);
+        if ((id & 0xFFFF) == BOCHS_VGA_VENDOR && (id >> 16) == BOCHS_VGA_DEVICE) {
+            lfb = pci_read32(slot, 0, 0x10) & 0xFFFFFFF0;
+        }
+    }
+    if (!lfb) return 0;
+
+    dispi_write(DISPI_INDEX_ENABLE, 0);
+    dispi_write(DISPI_INDEX_XRES, (uint16_t)width);
+    dispi_write(DISPI_INDEX_YRES, (uint16_t)height);
+    dispi_write(DISPI_INDEX_BPP, 32);
+    dispi_write(DISPI_INDEX_ENABLE, DISPI_ENABLED | DISPI_LFB_ENABLED);
+    return lfb;
+}
+
+// Le o modo informado pelo bootloader (campos de framebuffer ou bloco VBE)
+static int read_boot_mode(uint32_t multiboot_info, uint32_t *bpp) {
+    if (!multiboot_info) return 0;
+    uint8_t *info = (uint8_t*)multiboot_info;
+    uint32_t flags = *(uint32_t*)info;
+
+    if ((flags & MB_FLAG_FRAMEBUFFER) && info[MB_FB_TYPE] == MB_FB_TYPE_RGB) {
+        uint8_t *c = &info[MB_FB_COLOR_INFO];
+        fb_front = (uint32_t*)(uint32_t)*(uint64_t*)&info[MB_FB_ADDR];
+        fb_front_pitch = *(uint32_t*)&info[MB_FB_PITCH];
+        fb_width = *(uint32_t*)&info[MB_FB_WIDTH];
+        fb_height = *(uint32_t*)&info[MB_FB_HEIGHT];
+        *bpp = info[MB_FB_BPP];
+        build_palette(c[0], c[1], c[2], c[3], c[4], c[5]);
+        return 1;
+    }
+
+    if (flags & MB_FLAG_VBE) {
+        uint8_t *mode = (uint8_t*)*(uint32_t*)&info[MB_VBE_MODE_INFO];
+        uint8_t *c = &mode[VBE_COLOR_INFO];
+        fb_front = (uint32_t*)*(uint32_t*)&mode[VBE_LFB_ADDR];
+        fb_front_pitch = *(uint16_t*)&mode[VBE_PITCH];
+        fb_width = *(uint16_t*)&mode[VBE_WIDTH];
+        fb_height = *(uint16_t*)&mode[VBE_HEIGHT];
+        *bpp = mode[VBE_BPP];
+        build_palette(c[1], c[0], c[3], c[2], c[5], c[4]);
+        return fb_front != 0;
+    }
+    return 0;
+}
+
+// =======================================================
+// 2. CACHE DE SPRITES DOS GLIFOS
+// =======================================================
+
+// Expande os 96 glifos para o atributo 'attr' (linhas da fonte dobradas)
+static void expand_glyphs(uint32_t *pixels, uint8_t attr) {
+    uint32_t fg = fb_palette[attr & 0x0F];
+    uint32_t bg = fb_palette[(attr >> 4) & 0x0F];
+
+    for (int g = 0; g < FB_GLYPH_COUNT; g++) {
+        for (int y = 0; y < FB_CELL_H; y++) {
+            uint8_t bits = font8x8_basic[g][y >> 1];
+            for (int x = 0; x < FB_CELL_W; x++) {
+                *pixels++ = (bits & (1 << x)) ? fg : bg;
+            }
+        }
+    }
+}
+
+/**
+ * Da um slot com os sprites de 'attr', expulsando o menos usado se preciso.
+ * @return Indice do slot, ou NO_SLOT se nao houve memoria.
+ */
+static uint8_t cache_fill(uint8_t attr) {
+    int victim = -1;
+    for (int i = 0; i < FB_CACHE_SLOTS; i++) {
+        if (!glyph_slots[i].valid) { victim = i; break; }
+        if (victim < 0 || glyph_slots[i].last_use < glyph_slots[victim].last_use) victim = i;
+    }
+
+    GlyphSlot *slot = &glyph_slots[victim];
+    if (slot->valid) attr_slot[slot->attr] = NO_SLOT;
+    if (!slot->pixels) {
+        slot->pixels = alloc_pages(FB_SLOT_ORDER);
+        if (!slot->pixels) return NO_SLOT;
+    }
+
+    expand_glyphs((uint32_t*)slot->pixels, attr);
+    slot->attr = attr;
+    slot->valid = 1;
+    attr_slot[attr] = (uint8_t)victim;
+    return (uint8_t)victim;
+}
+
+// Sprite de 'c' no atributo 'attr' (0 se nao houve memoria para o cache)
+static const uint32_t* glyph_sprite(char c, uint8_t attr) {
+    uint8_t s = attr_slot[attr];
+    if (s == NO_SLOT) {
+        s = cache_fill(attr);
+        if (s == NO_SLOT) return 0;
+    }
+    glyph_slots[s].last_use = ++cache_clock;
+
+    uint8_t ch = (uint8_t)c;
+    if (ch < FB_GLYPH_FIRST || ch > FB_GLYPH_MISSING) ch = FB_GLYPH_MISSING;
+    return (const uint32_t*)glyph_slots[s].pixels + (ch - FB_GLYPH_FIRST) * FB_SPRITE_PIXELS;
+}
+
+// Esquece todos os sprites (as paginas ficam para a proxima expansao)
+static void cache_invalidate() {
+    for (int i = 0; i < 256; i++) attr_slot[i] = NO_SLOT;
+    for (int i = 0; i < FB_CACHE_SLOTS; i++) glyph_slots[i].valid = 0;
+}
+
+// =======================================================
+// 3. COPIA DE PIXELS
+// =======================================================
+
+// Copia um sprite 8x16 com SSE2: cada linha de 32 bytes sao dois registradores
+static void blit_sprite_sse2(uint32_t *dest, const uint32_t *sprite, uint32_t pitch) {
+    uint32_t rows = FB_CELL_H / 2;
+    __asm__ __volatile__ (
+        "1:\n\t"
+        "movdqa   (%1), %%xmm0\n\t"
+        "movdqa 16(%1), %%xmm1\n\t"
+        "movdqa 32(%1), %%xmm2\n\t"
+        "movdqa 48(%1), %%xmm3\n\t"
+        "movdqu %%xmm0,   (%0)\n\t"
+        "movdqu %%xmm1, 16(%0)\n\t"
+        "movdqu %%xmm2,   (%0,%3)\n\t"
+        "movdqu %%xmm3, 16(%0,%3)\n\t"
+        "add $64, %1\n\t"
+        "lea (%0,%3,2), %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        : "+r"(dest), "+r"(sprite), "+r"(rows)
+        : "r"(pitch)
+        : "memory", "cc"
+    );
+}
+
+// Mesma copia sem SSE (CPU antiga ou FPU ainda nao iniciada)
+static void blit_sprite_scalar(uint32_t *dest, const uint32_t *sprite, uint32_t pitch) {
+    for (int y = 0; y < FB_CELL_H; y++) {
+        for (int x = 0; x < FB_CELL_W; x++) dest[x] = sprite[x];
+        sprite += FB_CELL_W;
+        dest = (uint32_t*)((uint8_t*)dest + pitch);
+    }
+}
+
+// Preenche 'count' pixels com a mesma cor
+static void fill_pixels(uint32_t *dest, uint32_t color, uint32_t count) {
+    __asm__ __volatile__ (
+        "cld\n\t"
+        "rep stosl"
+        : "+D"(dest), "+c"(count)
+        : "a"(color)
+        : "memory", "cc"
+    );
+}
+
+static uint32_t* cell_address(int row, int col) {
+    return (uint32_t*)((uint8_t*)fb_back + (uint32_t)row * FB_CELL_H * fb_back_pitch) + col * FB_CELL_W;
+}
+
+// Desenha um caractere no back buffer (ja dentro de fb_begin/fb_end; 'sse' como la)
+static void draw_glyph(char c, int row, int col, uint8_t attr, int sse) {
+    uint32_t *dest = cell_address(row, col);
+    const uint32_t *sprite = glyph_sprite(c, attr);
+
+    if (!sprite) {
+        // Sem cache: expande direto no destino
+        uint8_t ch = (uint8_t)c;
+        if (ch < FB_GLYPH_FIRST || ch > FB_GLYPH_MISSING) ch = FB_GLYPH_MISSING;
+        for (int y = 0; y < FB_CELL_H; y++) {
+            uint8_t bits = font8x8_basic[ch - FB_GLYPH_FIRST][y >> 1];
+            for (int x = 0; x < FB_CELL_W; x++) {
+                dest[x] = fb_palette[(bits & (1 << x)) ? (attr & 0x0F) : ((attr >> 4) & 0x0F)];
+            }
+            dest = (uint32_t*)((uint8_t*)dest + fb_back_pitch);
+        }
+        return;
+    }
+
+    if (sse) blit_sprite_sse2(dest, sprite, fb_back_pitch);
+    else blit_sprite_scalar(dest, sprite, fb_back_pitch);
+}
+
+// O SSE so compensa a partir de FB_SSE_MIN_GLYPHS caracteres num mesmo trecho
+static int fb_use_sse(int glyphs) {
+    return fb_sse && glyphs >= FB_SSE_MIN_GLYPHS;
+}
+
+// Trecho de desenho: desliga as IRQs (protege cache e damage) e, com 'sse', libera o SSE
+static uint32_t fb_begin(int sse) {
+    return sse ? kernel_fpu_begin() : irq_save();
+}
+
+static void fb_end(int sse, uint32_t flags) {
+    if (sse) kernel_fpu_end(flags);
+    else irq_restore(flags);
+}
+
+// =======================================================
+// 4. REGIOES ALTERADAS (DAMAGE)
+// =======================================================
+
+// Marca celulas como alteradas (chamar com as IRQs desligadas)
+static void damage_add(int row, int col, int rows, int cols) {
+    if (fb_back == fb_front) return; // Desenhando direto na tela
+
+    DamageRect r = { (uint16_t)row, (uint16_t)col, (uint16_t)(row + rows), (uint16_t)(col + cols) };
+
+    // Junta com um retangulo que encoste nele (texto seguido na mesma linha)
+    for (int i = 0; i < damage_count; i++) {
+        DamageRect *d = &damage[i];
+        if (r.row0 <= d->row1 && r.row1 >= d->row0 && r.col0 <= d->col1 && r.col1 >= d->col0) {
+            if (r.row0 < d->row0) d->row0 = r.row0;
+            if (r.col0 < d->col0) d->col0 = r.col0;
+            if (r.row1 > d->row1) d->row1 = r.row1;
+            if (r.col1 > d->col1) d->col1 = r.col1;
+            return;
+        }
+    }
+
+    if (damage_count < FB_MAX_DAMAGE) {
+        damage[damage_count++] = r;
+        return;
+    }
+
+    // Lista cheia: tudo vira um unico retangulo envolvente
+    DamageRect *all = &damage[0];
+    for (int i = 1; i < damage_count; i++) {
+        if (damage[i].row0 < all->row0) all->row0 = damage[i].row0;
+        if (damage[i].col0 < all->col0) all->col0 = damage[i].col0;
+        if (damage[i].row1 > all->row1) all->row1 = damage[i].row1;
+        if (damage[i].col1 > all->col1) all->col1 = damage[i].col1;
+    }
+    damage_count = 1;
+    damage_add(row, col, rows, cols);
+}
+
+/**
+ * Copia as regioes alteradas do back buffer para a tela.
+ */
+void fb_present() {
+    if (!fb_front || fb_back == fb_front) return;
+
+    DamageRect pending[FB_MAX_DAMAGE];
+    uint32_t flags = irq_save();
+    int count = damage_count;
+    for (int i = 0; i < count; i++) pending[i] = damage[i];
+    damage_count = 0;
+    irq_restore(flags);
+
+    // O que for desenhado durante a copia marca damage de novo: sai no proximo quadro
+    for (int i = 0; i < count; i++) {
+        uint32_t x = (uint32_t)pending[i].col0 * FB_CELL_W * 4;
+        uint32_t bytes = (uint32_t)(pending[i].col1 - pending[i].col0) * FB_CELL_W * 4;
+        uint32_t y0 = (uint32_t)pending[i].row0 * FB_CELL_H;
+        uint32_t y1 = (uint32_t)pending[i].row1 * FB_CELL_H;
+
+        for (uint32_t y = y0; y < y1; y++) {
+            kmemcpy((uint8_t*)fb_front + y * fb_front_pitch + x,
+                    (uint8_t*)fb_back + y * fb_back_pitch + x, bytes);
+        }
+    }
+}
+
+// Tarefa que apresenta o back buffer em ritmo fixo
+static int fb_present_task(async_task_t *t) {
+    ASYNC_BEGIN(t);
+    for (;;) {
+        ASYNC_SLEEP(t, FB_PRESENT_TICKS);
+        fb_present();
+    }
+    ASYNC_END(t);
+}
+
+// =======================================================
+// 5. API USADA PELO ui_control.c
+// =======================================================
+
+int fb_active() {
+    return fb_front != 0;
+}
+
+int fb_rows() {
+    return fb_grid_rows;
+}
+
+int fb_cols() {
+    return fb_grid_cols;
+}
+
+/**
+ * Desenha um caractere na celula (row, col) com a cor VGA 'attr'.
+ */
+void fb_put_glyph(char c, int row, int col, uint8_t attr) {
+    if (row < 0 || row >= fb_grid_rows || col < 0 || col >= fb_grid_cols) return;
+
+    // Um caractere so: caminho de inteiros, sem salvar o estado SIMD de ninguem
+    uint32_t flags = irq_save();
+    draw_glyph(c, row, col, attr, 0);
+    damage_add(row, col, 1, 1);
+    irq_restore(flags);
+}
+
+/**
+ * Desenha uma string numa linha (cortada na borda direita), com um unico
+ * trecho de SSE para a string inteira (se ela for longa o bastante).
+ */
+void fb_draw_text(const char *str, int row, int col, uint8_t attr) {
+    if (row < 0 || row >= fb_grid_rows || col < 0) return;
+
+    int length = 0;
+    while (str[length] && col + length < fb_grid_cols) length++;
+    if (length == 0) return;
+
+    int sse = fb_use_sse(length);
+    uint32_t flags = fb_begin(sse);
+    for (int i = 0; i < length; i++) {
+        draw_glyph(str[i], row, col + i, attr, sse);
+    }
+    damage_add(row, col, 1, length);
+    fb_end(sse, flags);
+}
+
+/**
+ * Preenche 'count' celulas a partir de (row, col), continuando nas linhas
+ * seguintes como a memoria do modo texto.
+ */
+void fb_fill_cells(int row, int col, int count, char c, uint8_t attr) {
+    if (row < 0 || col < 0 || col >= fb_grid_cols || count <= 0) return;
+
+    // Espacos sao so REP STOSL: o SSE so entra para desenhar muitos caracteres
+    int sse = (c != ' ') && fb_use_sse(count);
+    uint32_t flags = fb_begin(sse);
+    uint32_t bg = fb_palette[(attr >> 4) & 0x0F];
+    while (count > 0 && row < fb_grid_rows) {
+        int n = fb_grid_cols - col;
+        if (n > count) n = count;
+        if (n <= 0) break;
+
+        if (c == ' ') {
+            // Espaco e so a cor de fundo: preenche as 16 linhas de pixels
+            uint32_t *dest = cell_address(row, col);
+            for (int y = 0; y < FB_CELL_H; y++) {
+                fill_pixels(dest, bg, (uint32_t)n * FB_CELL_W);
+                dest = (uint32_t*)((uint8_t*)dest + fb_back_pitch);
+            }
+        } else {
+            for (int i = 0; i < n; i++) draw_glyph(c, row, col + i, attr, sse);
+        }
+        damage_add(row, col, 1, n);
+
+        count -= n;
+        row++;
+        col = 0;
+    }
+    fb_end(sse, flags);
+}
+
+/**
+ * Desenha um bloco de celulas do modo texto (caractere | cor << 8), 'rows'
+ * linhas de 'cols' celulas, a partir de (first_row, 0). Usado na troca de
+ * console, uma faixa de linhas por vez.
+ * @param stride Celulas entre o inicio de uma linha e o da seguinte na origem
+ *               (continua valendo quando 'cols' e cortado na largura da grade).
+ */
+void fb_load_cells(const uint16_t *cells, int first_row, int rows, int cols, int stride) {
+    if (first_row < 0 || first_row >= fb_grid_rows) return;
+    if (rows > fb_grid_rows - first_row) rows = fb_grid_rows - first_row;
+    if (cols > fb_grid_cols) cols = fb_grid_cols;
+
+    int sse = fb_use_sse(rows * cols);
+    uint32_t flags = fb_begin(sse);
+    for (int row = 0; row < rows; row++) {
+        const uint16_t *line = cells + row * stride;
+        for (int col = 0; col < cols; col++) {
+            uint16_t cell = line[col];
+            char c = (char)(cell & 0xFF);
+            draw_glyph(c ? c : ' ', first_row + row, col, (uint8_t)(cell >> 8), sse); // Celula zerada = vazia
+        }
+    }
+    damage_add(first_row, 0, rows, cols);
+    fb_end(sse, flags);
+}
+
+/**
+ * Pinta a tela inteira com a cor de fundo de 'attr'.
+ */
+void fb_clear(uint8_t attr) {
+    if (!fb_front) return;
+
+    uint32_t flags = irq_save();
+    uint32_t bg = fb_palette[(attr >> 4) & 0x0F];
+    uint32_t *line = fb_back;
+    for (uint32_t y = 0; y < fb_height; y++) {
+        fill_pixels(line, bg, fb_width);
+        line = (uint32_t*)((uint8_t*)line + fb_back_pitch);
+    }
+    damage_count = 0;
+    damage_add(0, 0, fb_grid_rows, fb_grid_cols);
+    irq_restore(flags);
+}
+
+static int fb_dispi = 0; // 1 = o modo foi ligado por nos (DISPI), nao pelo boot
+
+/**
+ * Retomada da hibernacao: o back buffer voltou com a imagem, mas o modo de
+ * video e a VRAM nao. Refaz o modo (se fomos nos que o ligamos) e manda a
+ * tela inteira de novo.
+ */
+static void fb_resume() {
+    if (fb_dispi) dispi_set_mode(fb_width, fb_height);
+    if (fb_back == fb_front) return; // Sem back buffer: o conteudo da tela se perdeu
+
+    uint32_t flags = irq_save();
+    damage_count = 0;
+    damage_add(0, 0, fb_grid_rows, fb_grid_cols);
+    irq_restore(flags);
+    fb_present();
+}
+
+/**
+ * Liga o backend grafico.
+ * @param multiboot_info Estrutura Multiboot passada em EBX (0 = nenhuma).
+ * @return 0 se ha framebuffer de 32 bpp, -1 se a UI deve ficar em modo texto.
+ */
+int fb_init(uint32_t multiboot_info) {
+    uint32_t bpp = 0;
+
+    if (!read_boot_mode(multiboot_info, &bpp)) {
+        uint32_t lfb = dispi_set_mode(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+        if (lfb) {
+            fb_front = (uint32_t*)lfb;
+            fb_width = DEFAULT_WIDTH;
+            fb_height = DEFAULT_HEIGHT;
+            fb_front_pitch = DEFAULT_WIDTH * 4;
+            bpp = 32;
+            fb_dispi = 1;
+            build_palette(16, 8, 8, 8, 0, 8);
+        }
+    }
+    if (!fb_front || bpp != 32) {
+        fb_front = 0;
+        return -1;
+    }
+
+    fb_grid_cols = (int)(fb_width / FB_CELL_W);
+    fb_grid_rows = (int)(fb_height / FB_CELL_H);
+    fb_sse = fpu_sse_enabled();
+    cache_invalidate();
+
+    // Back buffer: um bloco do buddy (ate 4MB, o bastante para 1024x768x32)
+    fb_back_pitch = fb_width * 4;
+    uint32_t pages = (fb_back_pitch * fb_height + PAGE_SIZE - 1) / PAGE_SIZE;
+    int order = 0;
+    while ((1u << order) < pages) order++;
+    uint32_t back = (order <= MAX_PAGE_ORDER) ? alloc_pages(order) : 0;
+
+    if (back) {
+        fb_back = (uint32_t*)back;
+    } else {
+        // Sem memoria: desenha direto no framebuffer, sem fb_present()
+        fb_back = fb_front;
+        fb_back_pitch = fb_front_pitch;
+        ui_log_status("FB AVISO: Sem back buffer, desenhando direto na tela.", 0x0E);
+    }
+
+    fb_clear(0x00);
+    fb_present();
+
+    async_task_t *presenter = async_alloc(fb_present_task, sizeof(async_task_t));
+    if (presenter) async_start(presenter);
+    hibernate_register_resume(fb_resume);
+    return 0;
+}
+
+// =======================================================
+// 6. BENCHMARK
+// =======================================================
+
+#define FB_BENCH_FRAMES     4
+
+// Desenha o texto de teste em todas as linhas, FB_BENCH_FRAMES vezes
+static uint64_t bench_text(uint32_t *glyphs) {
+    static const char sample[] = "Core-Blip: The quick brown fox jumps over the lazy dog 0123456789 ";
+    char line[256];
+    int cols = fb_grid_cols < 255 ? fb_grid_cols : 255;
+    for (int i = 0; i < cols; i++) line[i] = sample[i % (sizeof(sample) - 1)];
+    line[cols] = '\0';
+
+    uint64_t start = read_tsc();
+    for (int frame = 0; frame < FB_BENCH_FRAMES; frame++) {
+        for (int row = 0; row < fb_grid_rows; row++) {
+            fb_draw_text(line, row, 0, (uint8_t)(0x0F - (row & 7)));
+        }
+    }
+    *glyphs = (uint32_t)(FB_BENCH_FRAMES * fb_grid_rows * cols);
+    return read_tsc() - start;
+}
+
+// glifos/s = glifos * (ciclos por ms) * 1000 / ciclos
+static uint64_t per_second(uint32_t count, uint64_t cycles) {
+    if (cycles == 0) return 0;
+    return (uint64_t)count * tsc_get_khz() * 1000 / cycles;
+}
+
+/**
+ * Mede a vazao de texto (glifos/s, com e sem SSE), o custo de expandir um
+ * atributo novo e o tempo de um quadro inteiro e de uma so linha ate a tela.
+ * Desenha a tabela a partir de 'row'.
+ */
+void fb_run_benchmark(int row) {
+    char buffer[24];
+
+    if (!fb_front) {
+        ui_draw_string("FB: sem framebuffer linear (modo texto)", row, 0, 0x0C);
+        return;
+    }
+
+    // 1. Falta no cache: expansao dos 96 sprites de um atributo
+    cache_invalidate();
+    uint64_t start = read_tsc();
+    fb_put_glyph('A', 0, 0, 0x1E);
+    uint64_t miss_cycles = read_tsc() - start;
+
+    // 2. Vazao de texto com os sprites ja no cache
+    uint32_t glyphs;
+    bench_text(&glyphs); // Aquece o cache com os 8 atributos usados
+    uint64_t simd_cycles = bench_text(&glyphs);
+
+    int saved_sse = fb_sse;
+    fb_sse = 0;
+    uint64_t scalar_cycles = bench_text(&glyphs);
+    fb_sse = saved_sse;
+
+    // 3. Quadro inteiro: limpa, redesenha todas as linhas e apresenta
+    start = read_tsc();
+    fb_clear(0x00);
+    for (int r = 0; r < fb_grid_rows; r++) fb_fill_cells(r, 0, fb_grid_cols, '#', 0x0A);
+    fb_present();
+    uint64_t frame_cycles = read_tsc() - start;
+
+    // 4. So a linha de status alterada
+    start = read_tsc();
+    fb_draw_text("[STATUS] benchmark", fb_grid_rows - 1, 0, 0x07);
+    fb_present();
+    uint64_t line_cycles = read_tsc() - start;
+
+    fb_clear(0x00);
+    ui_draw_string("== FRAMEBUFFER: texto e quadros ==", row, 0, 0x0E);
+    ui_draw_string(u64_to_str(fb_width, buffer, 24), row + 1, 0, 0x07);
+    ui_draw_string("x", row + 1, 5, 0x07);
+    ui_draw_string(u64_to_str(fb_height, buffer, 24), row + 1, 6, 0x07);
+    ui_draw_string("x32", row + 1, 10, 0x07);
+
+    ui_draw_string("Glifos/s (SSE2)", row + 2, 0, 0x0B);
+    ui_draw_string(u64_to_str(per_second(glyphs, simd_cycles), buffer, 24), row + 2, 24, 0x0A);
+    ui_draw_string(saved_sse ? "" : "(sem SSE)", row + 2, 38, 0x0C);
+    ui_draw_string("Glifos/s (escalar)", row + 3, 0, 0x0B);
+    ui_draw_string(u64_to_str(per_second(glyphs, scalar_cycles), buffer, 24), row + 3, 24, 0x0F);
+    ui_draw_string("Falta no cache (ciclos)", row + 4, 0, 0x0B);
+    ui_draw_string(u64_to_str(miss_cycles, buffer, 24), row + 4, 24, 0x0F);
+    ui_draw_string("Quadro inteiro (us)", row + 5, 0, 0x0B);
+    ui_draw_string(u64_to_str(tsc_cycles_to_ns(frame_cycles) / 1000, buffer, 24), row + 5, 24, 0x0F);
+    ui_draw_string("Uma linha (us)", row + 6, 0, 0x0B);
+    ui_draw_string(u64_to_str(tsc_cycles_to_ns(line_cycles) / 1000, buffer, 24), row + 6, 24, 0x0F);
+
+    // Os quadros de teste passaram por cima do console: redesenha o ativo inteiro
+    vc_refresh();
+    fb_present();
+}
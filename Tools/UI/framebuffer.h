@@ -0,0 +1,28 @@
+// framebuffer.h - Backend grafico da UI sobre um framebuffer linear (32 bpp).
+//
+// O ui_control.c continua falando em celulas (linha, coluna, cor VGA); quando
+// ha framebuffer, cada celula vira um bloco de FB_CELL_W x FB_CELL_H pixels.
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdint.h>
+
+#define FB_CELL_W   8
+#define FB_CELL_H   16
+
+int fb_init(uint32_t multiboot_info);
+int fb_active();
+int fb_rows();
+int fb_cols();
+
+void fb_put_glyph(char c, int row, int col, uint8_t attr);
+void fb_draw_text(const char *str, int row, int col, uint8_t attr);
+void fb_fill_cells(int row, int col, int count, char c, uint8_t attr);
+void fb_clear(uint8_t attr);
+void fb_load_cells(const uint16_t *cells, int first_row, int rows, int cols, int stride);
+void fb_present();
+
+void fb_run_benchmark(int row);
+
+#endif
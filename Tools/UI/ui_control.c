@@ -1,19 +1,51 @@
 // ui_control.c - Servico centralizado para todo o desenho de interface.
+//
+// Dois backends atras da mesma API de celulas (linha, coluna, cor VGA):
+// o modo texto 80x25 em 0xb8000 e, se ui_init_graphics() achar um, o
+// framebuffer linear de 32 bpp (framebuffer.c).
+//
+// A API dos modulos (put_char, ui_draw_string, ...) desenha no console
+// virtual de quem chama (virtual_console.c); so o console visivel chega as
+// funcoes ui_screen_*, que sao as que tocam a tela.
 
 #include <stdint.h>
+#include "../../Kernel/Lib/kmemory.h" // kmemset16/kmemcpy para celulas
+#include "framebuffer.h"
+#include "virtual_console.h"
 
 // Endereco de memoria de video (VGA Text Mode)
 #define VIDEO_MEMORY_START 0xb8000
+#define TEXT_ROWS          25
+#define TEXT_COLS          80
+
+// Redirecionamento do putc() do Kernel (Kernel.c)
+extern void (*putc_redirect)(char c, int row, int col, char color);
+
+static int ui_graphics = 0; // 1 = desenhando no framebuffer
 
 // =======================================================
-// Funcoes de Controle de Baixo Nivel
+// Backend da Tela (so o console visivel)
 // =======================================================
 
 /**
- * Funcao de baixo nivel: Escreve um caractere na posicao exata.
- * ESTA E A UNICA FUNCAO QUE TOCA DIRETAMENTE NA MEMORIA DE VIDEO.
+ * Linhas de celulas da tela.
  */
-void put_char(char c, int row, int col, char color_byte) {
+int ui_screen_rows() {
+    return ui_graphics ? fb_rows() : TEXT_ROWS;
+}
+
+/**
+ * Escreve um caractere na posicao exata da tela.
+ * ESTA E A UNICA FUNCAO QUE TOCA DIRETAMENTE NA MEMORIA DE VIDEO (com as
+ * variantes em bloco abaixo).
+ */
+void ui_screen_put(char c, int row, int col, char color_byte) {
+    if (ui_graphics) {
+        fb_put_glyph(c, row, col, (uint8_t)color_byte);
+        return;
+    }
+    if (col >= TEXT_COLS) return;
+
     unsigned char* video_memory = (unsigned char*)VIDEO_MEMORY_START;
     int offset = (row * 80 + col) * 2;
     
@@ -22,14 +54,77 @@ void put_char(char c, int row, int col, char color_byte) {
 }
 
 /**
- * Funcao de controle: Limpa a tela.
+ * Escreve uma string numa linha da tela.
  */
-void ui_clear_screen() {
-    for (int row = 0; row < 25; row++) {
-        for (int col = 0; col < 80; col++) {
-            put_char(' ', row, col, 0x00); // Fundo Preto
-        }
+void ui_screen_text(const char *str, int row, int col, char color_byte) {
+    if (ui_graphics) {
+        fb_draw_text(str, row, col, (uint8_t)color_byte);
+        return;
+    }
+    for (int i = 0; str[i] != '\0'; i++) ui_screen_put(str[i], row, col + i, color_byte);
+}
+
+/**
+ * Preenche 'count' celulas seguidas a partir de (row, col) com o mesmo
+ * caractere e cor (uma unica escrita em bloco na memoria de video).
+ */
+void ui_screen_fill(int row, int col, int count, char c, char color_byte) {
+    if (ui_graphics) {
+        fb_fill_cells(row, col, count, c, (uint8_t)color_byte);
+        return;
+    }
+
+    uint16_t *cells = (uint16_t*)VIDEO_MEMORY_START + row * 80 + col;
+    kmemset16(cells, (uint16_t)((uint8_t)c | ((uint8_t)color_byte << 8)), (uint32_t)count);
+}
+
+/**
+ * Copia uma grade de celulas (rows x cols, linhas a 'stride' celulas uma da
+ * outra) para a tela, a partir da linha 'first_row'. No modo texto, com a
+ * largura da tela, e um unico kmemcpy.
+ */
+void ui_screen_load(const uint16_t *cells, int first_row, int rows, int cols, int stride) {
+    if (ui_graphics) {
+        fb_load_cells(cells, first_row, rows, cols, stride);
+        return;
+    }
+    if (first_row < 0 || first_row >= TEXT_ROWS) return;
+    if (rows > TEXT_ROWS - first_row) rows = TEXT_ROWS - first_row;
+    if (cols > TEXT_COLS) cols = TEXT_COLS;
+
+    uint16_t *video = (uint16_t*)VIDEO_MEMORY_START + first_row * TEXT_COLS;
+    if (cols == TEXT_COLS && stride == TEXT_COLS) {
+        kmemcpy(video, cells, (uint32_t)(rows * cols) * 2);
+        return;
     }
+    for (int row = 0; row < rows; row++) kmemcpy(video + row * TEXT_COLS, cells + row * stride, (uint32_t)cols * 2);
+}
+
+// =======================================================
+// Funcoes de Controle de Baixo Nivel
+// =======================================================
+
+/**
+ * Funcao de baixo nivel: Escreve um caractere na posicao exata do console
+ * de quem chama.
+ */
+void put_char(char c, int row, int col, char color_byte) {
+    vc_put(vc_current(), row, col, c, (uint8_t)color_byte);
+}
+
+/**
+ * Funcao de baixo nivel: Preenche 'count' celulas seguidas a partir de (row, col)
+ * com o mesmo caractere e cor.
+ */
+void ui_fill(int row, int col, int count, char c, char color_byte) {
+    vc_fill(vc_current(), row, col, count, c, (uint8_t)color_byte);
+}
+
+/**
+ * Funcao de controle: Limpa a tela (o console de quem chama).
+ */
+void ui_clear_screen() {
+    vc_clear(vc_current());
 }
 
 // =======================================================
@@ -40,30 +135,53 @@ void ui_clear_screen() {
  * Funcao de desenho: Desenha uma string em uma linha/coluna.
  */
 void ui_draw_string(const char *str, int row, int col, char color_byte) {
-    int i = 0;
-    while (str[i] != '\0') {
-        put_char(str[i], row, col + i, color_byte);
-        i++;
-    }
+    vc_draw_text(vc_current(), row, col, str, (uint8_t)color_byte);
 }
 
 /**
  * Funcao de utilidade: Desenha uma linha de separacao/borda.
  */
 void ui_draw_separator(int row, char color_byte) {
-    for (int col = 0; col < 80; col++) {
-        put_char('-', row, col, color_byte);
-    }
+    ui_fill(row, 0, 80, '-', color_byte);
 }
 
 /**
- * Funcao de Log: Exibe uma mensagem de status/erro do sistema (Linha 24).
+ * Funcao de Log: Exibe uma mensagem de status/erro do sistema (ultima linha).
  */
 void ui_log_status(const char *status_msg, char color_byte) {
+    // Ultima linha visivel do console de quem chama (segue a rolagem)
+    int row = vc_status_row(vc_current());
+
     // 1. Limpa a linha de log
-    for(int c = 0; c < 80; c++) put_char(' ', 24, c, 0x00);
+    ui_fill(row, 0, VC_COLS, ' ', 0x00);
     
     // 2. Escreve a nova mensagem
-    ui_draw_string("[STATUS] ", 24, 0, 0x07); // Prefixo cinza
-    ui_draw_string(status_msg, 24, 9, color_byte);
+    ui_draw_string("[STATUS] ", row, 0, 0x07); // Prefixo cinza
+    ui_draw_string(status_msg, row, 9, color_byte);
+
+    // 3. Erros nao esperam o proximo quadro
+    if (ui_graphics) fb_present();
+}
+
+/**
+ * Funcao de controle: Troca para o framebuffer linear, se houver um.
+ * @param multiboot_info Estrutura Multiboot passada em EBX (0 = nenhuma).
+ * @return 1 se a UI passou para o modo grafico, 0 se continua em modo texto.
+ */
+int ui_init_graphics(uint32_t multiboot_info) {
+    if (fb_init(multiboot_info) != 0) return 0;
+
+    ui_graphics = 1;
+    putc_redirect = put_char; // O putc() dos drivers tambem passa pelos consoles
+    vc_refresh(); // O console visivel passa para o framebuffer
+    ui_log_status("UI: Framebuffer linear ativo.", 0x0A);
+    return 1;
+}
+
+/**
+ * Funcao de controle: Passa o putc() do Kernel (usado pelos drivers) para os
+ * consoles virtuais. Chamar no inicio do boot, antes dos drivers.
+ */
+void ui_init() {
+    putc_redirect = put_char;
 }
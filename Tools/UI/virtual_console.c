@@ -0,0 +1,396 @@
+// virtual_console.c - Consoles virtuais por processo/servico.
+//
+// Cada modulo desenhava em linhas fixas da mesma tela e um apagava o outro.
+// Agora cada servico abre seu console e o processo que o escolheu com
+// vc_select() desenha nele; as rotinas de IRQ e o boot desenham no console
+// do sistema. O ui_control.c manda todo desenho para vc_current().
+//
+// Custos:
+//   - console de fundo: so a escrita na grade em RAM, nada de VRAM;
+//   - console visivel: a grade em RAM e a mesma celula na tela;
+//   - troca (F1..F8): uma copia em bloco da parte visivel da grade (no modo
+//     texto, um kmemcpy de 4000 bytes para 0xb8000). Pedida pela IRQ do
+//     teclado, a copia fica com uma tarefa assincrona, VC_PRESENT_BAND linhas
+//     por vez: no modo grafico redesenhar a tela inteira levaria milissegundos
+//     com as interrupcoes desligadas.
+//
+// A grade tem VC_ROWS linhas; no modo texto so 25 aparecem, e vc_scroll()
+// (PgUp/PgDn) escolhe quais.
+
+#include <stdint.h>
+#include "virtual_console.h"
+#include "../../Kernel/spinlock.h"
+#include "../../Kernel/Lib/kmemory.h"
+#include "../../Kernel/Lib/kformat.h"
+#include "../../Kernel/Async/async.h"
+
+// Backend da tela (Do ui_control.c)
+extern int ui_screen_rows();
+extern void ui_screen_put(char c, int row, int col, char color_byte);
+extern void ui_screen_text(const char *str, int row, int col, char color_byte);
+extern void ui_screen_fill(int row, int col, int count, char c, char color_byte);
+extern void ui_screen_load(const uint16_t *cells, int first_row, int rows, int cols, int stride);
+
+extern int scheduler_current_pid();                 // Do scheduler.c
+extern int apic_in_irq();                           // Do apic.c
+extern uint64_t read_tsc();                         // Do cpu_diag.c
+extern uint64_t tsc_cycles_to_ns(uint64_t cycles);  // Do cpu_diag.c
+extern void ui_draw_string(const char *str, int row, int col, char color_byte);
+
+#define VC_MAX_PIDS     8   // >= MAX_PROCESSES do scheduler.c
+#define VC_CELLS        (VC_ROWS * VC_COLS)
+#define VC_PRESENT_BAND 6   // Linhas por passo da tarefa de troca
+
+static uint16_t vc_cells[VC_MAX][VC_CELLS];
+static const char *vc_names[VC_MAX] = { "Sistema" };
+static uint8_t vc_in_use[VC_MAX] = { 1 };
+static int vc_view_top[VC_MAX];             // Primeira linha da grade na tela
+static int8_t pid_console[VC_MAX_PIDS];     // Console de cada processo (0 = sistema)
+static int active_console = VC_SYSTEM;
+static spinlock_t vc_lock = SPINLOCK_INIT;
+
+// Troca adiada: proxima linha da tela a copiar (>= VC_ROWS = nada pendente)
+static int present_row = VC_ROWS;
+static uint64_t present_start = 0;
+static async_event_t present_event = ASYNC_EVENT_INIT;
+static int present_task_started = 0;
+
+// Estatisticas
+static uint32_t cells_to_screen = 0;        // Celulas escritas na tela
+static uint32_t cells_background = 0;       // Celulas que ficaram so na RAM
+static uint32_t switches = 0;
+static uint64_t switch_max_cycles = 0;
+
+// =======================================================
+// 1. CONSOLES E PROCESSOS
+// =======================================================
+
+static int vc_valid(int console) {
+    return console >= 0 && console < VC_MAX && vc_in_use[console];
+}
+
+/**
+ * Cria um console (vazio, em segundo plano).
+ * @return O numero do console, ou -1 se todos estao em uso.
+ */
+int vc_open(const char *name) {
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    for (int console = 1; console < VC_MAX; console++) {
+        if (vc_in_use[console]) continue;
+        kmemset16(vc_cells[console], 0x0020, VC_CELLS); // Espacos em preto
+        vc_names[console] = name;
+        vc_view_top[console] = 0;
+        vc_in_use[console] = 1;
+        spin_unlock_irqrestore(&vc_lock, flags);
+        return console;
+    }
+    spin_unlock_irqrestore(&vc_lock, flags);
+    return -1;
+}
+
+/**
+ * Faz o processo atual desenhar em 'console'.
+ * @return O console anterior (para restaurar), ou -1 se 'console' nao existe.
+ */
+int vc_select(int console) {
+    int pid = scheduler_current_pid();
+    if (!vc_valid(console) || pid < 0 || pid >= VC_MAX_PIDS) return -1;
+    int previous = pid_console[pid];
+    pid_console[pid] = (int8_t)console;
+    return previous;
+}
+
+/**
+ * Volta 'pid' para o console do sistema. Chamado pelo agendador quando o
+ * slot do processo e reusado: sem isso, o novo processo herdaria o console
+ * que o antigo escolheu.
+ */
+void vc_reset_pid(int pid) {
+    if (pid >= 0 && pid < VC_MAX_PIDS) pid_console[pid] = VC_SYSTEM;
+}
+
+/**
+ * Console onde o codigo atual desenha: o do processo, ou o do sistema dentro
+ * de uma IRQ (que interrompe um processo qualquer).
+ */
+int vc_current() {
+    if (apic_in_irq()) return VC_SYSTEM;
+    int pid = scheduler_current_pid();
+    return (pid >= 0 && pid < VC_MAX_PIDS) ? pid_console[pid] : VC_SYSTEM;
+}
+
+int vc_active() {
+    return active_console;
+}
+
+// Linhas da grade que cabem na tela
+static int visible_rows() {
+    int rows = ui_screen_rows();
+    return rows < VC_ROWS ? rows : VC_ROWS;
+}
+
+// Copia as linhas [first, first + count) da parte visivel do console ativo
+// para a tela. Chamar com vc_lock.
+static void present_band(int first, int count) {
+    const uint16_t *cells = vc_cells[active_console] + (vc_view_top[active_console] + first) * VC_COLS;
+    ui_screen_load(cells, first, count, VC_COLS, VC_COLS);
+    cells_to_screen += (uint32_t)(count * VC_COLS);
+}
+
+// A parte visivel inteira, de uma vez (cancela uma troca adiada). Chamar com vc_lock.
+static void present_active() {
+    present_band(0, visible_rows());
+    present_row = VC_ROWS;
+}
+
+static void switch_done(uint64_t start) {
+    uint64_t cycles = read_tsc() - start;
+    if (cycles > switch_max_cycles) switch_max_cycles = cycles;
+    switches++;
+}
+
+/**
+ * Adia a copia para a tarefa (chamar com vc_lock). O console ja vale para os
+ * desenhos novos; as linhas ainda nao copiadas mostram o anterior por alguns
+ * passos. Sem a tarefa, ou fora de uma IRQ, copia tudo na hora.
+ * @return 1 se a copia foi adiada.
+ */
+static int present_deferred() {
+    if (!present_task_started || !apic_in_irq()) return 0;
+    if (present_row >= VC_ROWS) present_start = read_tsc(); // Um pedido no meio de outro reinicia
+    present_row = 0;
+    return 1;
+}
+
+/**
+ * Mostra 'console' na tela (uma copia em bloco da grade). Da IRQ do teclado,
+ * so marca a troca e acorda a tarefa de copia.
+ * @return 0 em caso de sucesso, -1 se o console nao existe.
+ */
+int vc_switch(int console) {
+    if (!vc_valid(console)) return -1;
+
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    active_console = console;
+    int deferred = present_deferred();
+    if (!deferred) {
+        uint64_t start = read_tsc();
+        present_active();
+        switch_done(start);
+    }
+    spin_unlock_irqrestore(&vc_lock, flags);
+
+    if (deferred) async_signal(&present_event);
+    return 0;
+}
+
+/**
+ * Linha da grade que aparece por ultimo na tela para 'console' (a linha de
+ * status): acompanha a rolagem, senao o log sumiria com PgUp.
+ */
+int vc_status_row(int console) {
+    if (!vc_valid(console)) console = VC_SYSTEM;
+    return vc_view_top[console] + visible_rows() - 1;
+}
+
+/**
+ * Rola a janela do console ativo sobre a grade (modo texto: 25 de VC_ROWS linhas).
+ */
+void vc_scroll(int delta_rows) {
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    int top = vc_view_top[active_console] + delta_rows;
+    int max_top = VC_ROWS - visible_rows();
+    if (top > max_top) top = max_top;
+    if (top < 0) top = 0;
+    int deferred = 0;
+    if (top != vc_view_top[active_console]) {
+        vc_view_top[active_console] = top;
+        deferred = present_deferred();
+        if (!deferred) present_active();
+    }
+    spin_unlock_irqrestore(&vc_lock, flags);
+
+    if (deferred) async_signal(&present_event);
+}
+
+/**
+ * Redesenha o console ativo inteiro (ex.: depois de a tela trocar de backend).
+ */
+void vc_refresh() {
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    present_active();
+    spin_unlock_irqrestore(&vc_lock, flags);
+}
+
+// Tarefa da troca adiada: uma faixa de linhas por passo, com as interrupcoes
+// ligadas entre uma faixa e outra
+static int vc_present_task(async_task_t *t) {
+    ASYNC_BEGIN(t);
+    for (;;) {
+        ASYNC_AWAIT(t, &present_event, 0);
+        for (;;) {
+            uint32_t flags = spin_lock_irqsave(&vc_lock);
+            int rows = visible_rows();
+            if (present_row >= rows) {
+                if (present_row < VC_ROWS) {
+                    present_row = VC_ROWS;
+                    switch_done(present_start);
+                }
+                spin_unlock_irqrestore(&vc_lock, flags);
+                break;
+            }
+            int count = rows - present_row < VC_PRESENT_BAND ? rows - present_row : VC_PRESENT_BAND;
+            present_band(present_row, count);
+            present_row += count;
+            spin_unlock_irqrestore(&vc_lock, flags);
+            ASYNC_YIELD(t);
+        }
+    }
+    ASYNC_END(t);
+}
+
+/**
+ * Inicia a tarefa que faz as trocas pedidas pela IRQ do teclado. Chamar
+ * depois de init_async(); antes disso (ou sem memoria) a troca e na hora.
+ */
+void init_virtual_consoles() {
+    async_task_t *t = async_alloc(vc_present_task, sizeof(async_task_t));
+    if (!t) return;
+    async_start(t);
+    present_task_started = 1;
+}
+
+// =======================================================
+// 2. DESENHO
+// =======================================================
+
+// Linha da tela onde 'row' do console aparece, ou -1 se nao aparece
+static int screen_row(int console, int row) {
+    if (console != active_console) return -1;
+    int screen = row - vc_view_top[console];
+    return (screen >= 0 && screen < visible_rows()) ? screen : -1;
+}
+
+static uint16_t make_cell(char c, uint8_t attr) {
+    return (uint16_t)((uint8_t)c | ((uint16_t)attr << 8));
+}
+
+void vc_put(int console, int row, int col, char c, uint8_t attr) {
+    if (!vc_valid(console) || row < 0 || row >= VC_ROWS || col < 0 || col >= VC_COLS) return;
+
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    vc_cells[console][row * VC_COLS + col] = make_cell(c, attr);
+    int screen = screen_row(console, row);
+    if (screen >= 0) {
+        ui_screen_put(c, screen, col, (char)attr);
+        cells_to_screen++;
+    } else {
+        cells_background++;
+    }
+    spin_unlock_irqrestore(&vc_lock, flags);
+}
+
+/**
+ * Escreve uma string numa linha, cortada na borda direita da grade.
+ */
+void vc_draw_text(int console, int row, int col, const char *str, uint8_t attr) {
+    if (!vc_valid(console) || row < 0 || row >= VC_ROWS || col < 0) return;
+
+    char clipped[VC_COLS + 1];
+    int count = 0;
+    while (str[count] != '\0' && col + count < VC_COLS) {
+        clipped[count] = str[count];
+        count++;
+    }
+    clipped[count] = '\0';
+    if (count == 0) return;
+
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    uint16_t *cells = &vc_cells[console][row * VC_COLS + col];
+    for (int i = 0; i < count; i++) cells[i] = make_cell(clipped[i], attr);
+
+    int screen = screen_row(console, row);
+    if (screen >= 0) {
+        ui_screen_text(clipped, screen, col, (char)attr);
+        cells_to_screen += (uint32_t)count;
+    } else {
+        cells_background += (uint32_t)count;
+    }
+    spin_unlock_irqrestore(&vc_lock, flags);
+}
+
+/**
+ * Preenche 'count' celulas a partir de (row, col), continuando nas linhas
+ * seguintes como a memoria do modo texto.
+ */
+void vc_fill(int console, int row, int col, int count, char c, uint8_t attr) {
+    if (!vc_valid(console) || row < 0 || col < 0 || col >= VC_COLS) return;
+    int first = row * VC_COLS + col;
+    if (first >= VC_CELLS) return;
+    if (count > VC_CELLS - first) count = VC_CELLS - first;
+    if (count <= 0) return;
+
+    uint32_t flags = spin_lock_irqsave(&vc_lock);
+    kmemset16(&vc_cells[console][first], make_cell(c, attr), (uint32_t)count);
+
+    // Na tela, um trecho por linha (a tela pode ter mais colunas que a grade)
+    while (count > 0) {
+        int n = VC_COLS - col;
+        if (n > count) n = count;
+        int screen = screen_row(console, row);
+        if (screen >= 0) {
+            ui_screen_fill(screen, col, n, c, (char)attr);
+            cells_to_screen += (uint32_t)n;
+        } else {
+            cells_background += (uint32_t)n;
+        }
+        count -= n;
+        row++;
+        col = 0;
+    }
+    spin_unlock_irqrestore(&vc_lock, flags);
+}
+
+void vc_clear(int console) {
+    vc_fill(console, 0, 0, VC_CELLS, ' ', 0x00);
+}
+
+/**
+ * Le o caractere de uma celula da grade (visivel ou nao).
+ */
+char vc_get_char(int console, int row, int col) {
+    if (!vc_valid(console) || row < 0 || row >= VC_ROWS || col < 0 || col >= VC_COLS) return '\0';
+    return (char)(vc_cells[console][row * VC_COLS + col] & 0xFF);
+}
+
+// =======================================================
+// 3. RELATORIO
+// =======================================================
+
+/**
+ * Mostra os consoles abertos, celulas escritas na tela e so na RAM, e o
+ * custo da troca.
+ */
+void vc_report(int row) {
+    char buffer[12];
+    ui_draw_string("== Consoles virtuais ==", row, 0, 0x0E);
+
+    int col = 0;
+    for (int console = 0; console < VC_MAX; console++) {
+        if (!vc_in_use[console]) continue;
+        ui_draw_string(u32_to_str((uint32_t)console + 1, buffer, 12), row + 1, col, 0x0B);
+        ui_draw_string(vc_names[console], row + 1, col + 2, console == active_console ? 0x0A : 0x07);
+        col += 16;
+        if (col >= VC_COLS) break;
+    }
+
+    ui_draw_string("Celulas na tela:", row + 2, 0, 0x0B);
+    ui_draw_string(u32_to_str(cells_to_screen, buffer, 12), row + 2, 17, 0x0F);
+    ui_draw_string("so em RAM:", row + 2, 29, 0x0B);
+    ui_draw_string(u32_to_str(cells_background, buffer, 12), row + 2, 40, 0x0F);
+    ui_draw_string("Trocas:", row + 3, 0, 0x0B);
+    ui_draw_string(u32_to_str(switches, buffer, 12), row + 3, 8, 0x0F);
+    ui_draw_string("pior troca (us):", row + 3, 20, 0x0B);
+    ui_draw_string(u32_to_str((uint32_t)(tsc_cycles_to_ns(switch_max_cycles) / 1000), buffer, 12),
+                   row + 3, 37, 0x0F);
+}
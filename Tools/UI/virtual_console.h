@@ -0,0 +1,37 @@
+// virtual_console.h - Consoles virtuais: uma grade de celulas em RAM por servico.
+//
+// Cada console e uma grade VC_ROWS x VC_COLS no formato do modo texto
+// (caractere | cor << 8). Desenhar num console de fundo so escreve na RAM;
+// so o console visivel tambem escreve na tela. Trocar de console e uma copia
+// em bloco da grade para a tela.
+
+#ifndef VIRTUAL_CONSOLE_H
+#define VIRTUAL_CONSOLE_H
+
+#include <stdint.h>
+
+#define VC_MAX      8       // F1..F8
+#define VC_ROWS     48      // Cabe a grade do framebuffer 1024x768 inteira
+#define VC_COLS     80
+#define VC_SYSTEM   0       // Console do Kernel, das IRQs e de quem nao escolheu outro
+
+void init_virtual_consoles();
+int vc_open(const char *name);
+int vc_select(int console);
+void vc_reset_pid(int pid);
+int vc_current();
+int vc_active();
+int vc_switch(int console);
+void vc_scroll(int delta_rows);
+int vc_status_row(int console);
+
+void vc_put(int console, int row, int col, char c, uint8_t attr);
+void vc_draw_text(int console, int row, int col, const char *str, uint8_t attr);
+void vc_fill(int console, int row, int col, int count, char c, uint8_t attr);
+void vc_clear(int console);
+char vc_get_char(int console, int row, int col);
+void vc_refresh();
+
+void vc_report(int row);
+
+#endif